@@ -5,4 +5,6 @@
 rm *.gv*
 rm *.h5
 rm *.log
+rm rsg_dump*.rsgsnap
+rm rsg_dump*.ldjson
 #rm fmpc_world_model.log
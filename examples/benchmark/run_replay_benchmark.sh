@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Replays a recorded HDF5 update log. Usage:
+#   ./run_replay_benchmark.sh <recording.h5> [speed_factor] [updates_per_step]
+# Call start_all() in the interactive terminal to start the replay.
+
+if [ "$1" = "" ]; then
+  echo "Usage: $0 <recording.h5> [speed_factor] [updates_per_step]"
+  exit 1
+fi
+
+# set up some environtment scripts
+source $FBX_MODULES/env.sh
+
+export SWM_REPLAY_FILE=$1
+if [ "$2" != "" ]; then
+  export SWM_REPLAY_SPEED_FACTOR=$2
+fi
+if [ "$3" != "" ]; then
+  export SWM_REPLAY_UPDATES_PER_STEP=$3
+fi
+
+exec $UBX_ROOT/tools/ubx_launch -webif 8888 -c examples/benchmark/replay_benchmark.usc
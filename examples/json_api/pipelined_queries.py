@@ -0,0 +1,43 @@
+#   Pipelined client in Python
+#   Connects a DEALER socket to the query server at tcp://localhost:22423
+#   Sends a JSON query as specified by a file several times without waiting
+#   for the replies and matches the replies by their queryId
+#
+import zmq
+import sys
+import json
+import uuid
+import time
+
+# Setup query
+if len(sys.argv) > 1:
+    fileName =  sys.argv[1]
+    with open (fileName, "r") as messagefile:
+      message=messagefile.read()
+else:
+    message="{\"@worldmodeltype\": \"RSGQuery\", \"query\": \"GET_ROOT_NODE\"}"
+count = int(sys.argv[2]) if len(sys.argv) > 2 else 10
+
+#  Prepare our context and sockets
+context = zmq.Context()
+socket = context.socket(zmq.DEALER)
+socket.connect("tcp://localhost:22423")
+
+pending = {}
+start = time.time()
+for i in range(count):
+    query = json.loads(message)
+    query["queryId"] = str(uuid.uuid4())
+    pending[query["queryId"]] = time.time()
+    socket.send_multipart([b"", json.dumps(query).encode()]) # empty delimiter frame as sent by REQ sockets
+
+while pending:
+    frames = socket.recv_multipart()
+    result = json.loads(frames[-1].decode().rstrip("\0"))
+    queryId = result.get("queryId")
+    if queryId in pending:
+        print("Received result for %s after %.3f [s]: %s" % (queryId, time.time() - pending.pop(queryId), result.get("querySuccess")))
+    else:
+        print("Received unexpected result: %s " % (result))
+
+print("Received %d results in %.3f [s]" % (count, time.time() - start))
@@ -8,4 +8,8 @@ wm:addNodeAttribute(rootId, "rsg:agent_policy", "send no TransformUpdates with f
 -- Constraint for rceiving data:
 --wm:addNodeAttribute(rootId, "rsg:agent_policy", "receive no Atoms from context osm"); -- use this to exclude OpenStreetMap data
 --wm:addNodeAttribute(rootId, "rsg:agent_policy", "receive no Connections"); 
---wm:addNodeAttribute(rootId, "rsg:agent_policy", "receive no Connections from context osm"); -- this one still does not work
\ No newline at end of file
+--wm:addNodeAttribute(rootId, "rsg:agent_policy", "receive no Connections from context osm"); -- this one still does not work
+
+-- Retention policies (enforced by the rsgretention block, cf. SWM_RETENTION_PERIOD):
+--wm:addNodeAttribute(rootId, "rsg:retention_policy", "keep Nodes with sherpa:observation_type for 2 h"); -- deletes old observations (and the Connections that point to them)
+--wm:addNodeAttribute(rootId, "rsg:retention_policy", "keep 100 Nodes with sherpa:observation_type=image per parent"); -- keeps the newest 100 images per parent
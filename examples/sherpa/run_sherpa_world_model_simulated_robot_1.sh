@@ -31,6 +31,7 @@ export SWM_MAX_TRANSFORM_FREQ=5 # default value = 5
 # Map files settings (optional)
 export SWM_RSG_MAP_FILE=../maps/rsg/sherpa_basic_mission_setup.json # default value = examples/maps/rsg/cesena_lab.json
 export SWM_OSM_MAP_FILE=../maps/osm/map_micro_champoluc.osm # default value = examples/maps/osm/map_micro_champoluc.osm
+export SWM_STATIC_MAP_SEGMENT=/swm_static_map # snapshot cache: the first SWM on this computer parses the RSG map file, the others copy its snapshot. default value = "" (disabled)
 
 # Start the ubx system
 exec $UBX_ROOT/tools/ubx_launch -webif 8888 -c sherpa_world_model_no_ros.usc	
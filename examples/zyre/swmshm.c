@@ -0,0 +1,141 @@
+#include "swmshm.h"
+#include "ShmRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ERR(fmt, args...) ( fprintf(stderr, "ERR %s: ", __FUNCTION__),	\
+			    fprintf(stderr, fmt, ##args),		\
+			    fprintf(stderr, "\n") )
+
+static int64_t now_in_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+shm_client_t* shm_client_new(const char *segment_name) {
+	int fd = shm_open(segment_name, O_RDWR, 0);
+	if (fd < 0) {
+		ERR("Cannot open shared memory segment %s: %s", segment_name, strerror(errno));
+		return NULL;
+	}
+	void *memory = mmap(NULL, sizeof(rsg_shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		ERR("Cannot map shared memory segment %s: %s", segment_name, strerror(errno));
+		return NULL;
+	}
+	rsg_shm_segment_t *segment = (rsg_shm_segment_t *) memory;
+	if ((__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != RSG_SHM_MAGIC) || (segment->ring_size != RSG_SHM_RING_SIZE)) {
+		ERR("Shared memory segment %s is not ready or has another layout.", segment_name);
+		munmap(memory, sizeof(rsg_shm_segment_t));
+		return NULL;
+	}
+
+	/* Claim a free slot */
+	rsg_shm_slot_t *slot = NULL;
+	for (unsigned int i = 0; i < segment->slot_count && i < RSG_SHM_MAX_CLIENTS; ++i) {
+		uint32_t expected = RSG_SHM_SLOT_FREE;
+		if (__atomic_compare_exchange_n(&segment->slots[i].state, &expected, RSG_SHM_SLOT_USED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			slot = &segment->slots[i];
+			slot->pid = getpid();
+			break;
+		}
+	}
+	if (!slot) {
+		ERR("No free client slot in shared memory segment %s.", segment_name);
+		munmap(memory, sizeof(rsg_shm_segment_t));
+		return NULL;
+	}
+
+	shm_client_t *self = (shm_client_t *) calloc(1, sizeof(shm_client_t));
+	self->segment_name = strdup(segment_name);
+	self->segment = segment;
+	self->slot = slot;
+	self->buffer_size = 4096; // grows with the replies
+	self->buffer = (char *) malloc(self->buffer_size);
+	return self;
+}
+
+void shm_client_destroy(shm_client_t **self_p) {
+	if (self_p && *self_p) {
+		shm_client_t *self = *self_p;
+		if (shm_client_is_connected(self)) {
+			__atomic_store_n(&self->slot->state, RSG_SHM_SLOT_CLOSING, __ATOMIC_RELEASE); // freed by the server
+			rsg_shm_notify(&self->segment->doorbell, &self->segment->doorbell_waiters);
+		}
+		munmap(self->segment, sizeof(rsg_shm_segment_t));
+		free(self->segment_name);
+		free(self->buffer);
+		free(self);
+		*self_p = NULL;
+	}
+}
+
+bool shm_client_is_connected(shm_client_t *self) {
+	return self && (__atomic_load_n(&self->segment->server_alive, __ATOMIC_ACQUIRE) != 0);
+}
+
+int shm_client_send(shm_client_t *self, const char *message, int timeout) {
+	int64_t deadline = now_in_ms() + timeout;
+	uint32_t length = (uint32_t) strlen(message);
+	while (shm_client_is_connected(self)) {
+		uint32_t seen = __atomic_load_n(&self->slot->requests.space_signal, __ATOMIC_SEQ_CST);
+		int rc = rsg_shm_ring_try_write(&self->slot->requests, message, length);
+		if (rc == 0) {
+			rsg_shm_notify(&self->segment->doorbell, &self->segment->doorbell_waiters);
+			return 0;
+		}
+		if (rc != EAGAIN) {
+			ERR("Message with %u bytes is too large for shared memory segment %s.", length, self->segment_name);
+			return -1;
+		}
+		int64_t remaining = deadline - now_in_ms();
+		if (remaining <= 0) {
+			ERR("Timeout while waiting for space in shared memory segment %s.", self->segment_name);
+			return -1;
+		}
+		rsg_shm_wait(&self->slot->requests.space_signal, &self->slot->requests.space_waiters, seen, (int) remaining);
+	}
+	return -1;
+}
+
+char* shm_client_recv(shm_client_t *self, int timeout) {
+	int64_t deadline = now_in_ms() + timeout;
+	while (shm_client_is_connected(self)) {
+		uint32_t seen = __atomic_load_n(&self->slot->replies.data_signal, __ATOMIC_SEQ_CST);
+		uint32_t length = 0;
+		int rc = rsg_shm_ring_try_read(&self->slot->replies, self->buffer, self->buffer_size - 1, &length);
+		if (rc == EMSGSIZE) {
+			self->buffer_size = length + 1;
+			self->buffer = (char *) realloc(self->buffer, self->buffer_size);
+			continue;
+		}
+		if (rc == 0) {
+			rsg_shm_notify(&self->slot->replies.space_signal, &self->slot->replies.space_waiters);
+			self->buffer[length] = '\0';
+			return strdup(self->buffer);
+		}
+		int64_t remaining = deadline - now_in_ms();
+		if (remaining <= 0) {
+			break;
+		}
+		rsg_shm_wait(&self->slot->replies.data_signal, &self->slot->replies.data_waiters, seen, (int) remaining);
+	}
+	return NULL;
+}
+
+void shm_client_discard_replies(shm_client_t *self) {
+	char *reply;
+	while ((reply = shm_client_recv(self, 0)) != NULL) {
+		free(reply);
+	}
+}
@@ -0,0 +1,54 @@
+/**
+ * Client for the shared memory transport of a SWM on the same computer.
+ * It is used by swmzyre if the config has a "shm_segment", but can be used
+ * on its own as well.
+ *
+ * Cf. ShmRing.h for the layout of the segment.
+ */
+
+#ifndef SWMSHM_H_
+#define SWMSHM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct rsg_shm_segment;
+struct rsg_shm_slot;
+
+typedef struct _shm_client_t {
+	char *segment_name;
+	struct rsg_shm_segment *segment;
+	struct rsg_shm_slot *slot;          // claimed by this client
+	char *buffer;                       // for incoming replies
+	uint32_t buffer_size;
+} shm_client_t;
+
+/**
+ * Attach to the shared memory segment of a running SWM and claim a client slot.
+ * @param segment_name E.g. "/swm_query" as set by the shm_segment configuration of the SWM.
+ * @return NULL if there is no SWM or no free slot.
+ */
+shm_client_t* shm_client_new(const char *segment_name);
+
+/// Release the slot and detach from the segment.
+void shm_client_destroy(shm_client_t **self_p);
+
+/// True as long as the SWM serves the segment.
+bool shm_client_is_connected(shm_client_t *self);
+
+/**
+ * Send a message. Waits at most timeout [ms] if the requests ring is full.
+ * @return 0 on success, -1 otherwise.
+ */
+int shm_client_send(shm_client_t *self, const char *message, int timeout);
+
+/**
+ * Receive the next reply. Waits at most timeout [ms].
+ * @return The reply. Must be freed by the user. NULL on timeout.
+ */
+char* shm_client_recv(shm_client_t *self, int timeout);
+
+/// Drop all replies that have not been received.
+void shm_client_discard_replies(shm_client_t *self);
+
+#endif /* SWMSHM_H_ */
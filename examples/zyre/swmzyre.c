@@ -54,6 +54,10 @@ void destroy_component (component_t **self_p) {
         	query_destroy(&it);
         }
         zlist_destroy (&self->query_list);
+        zhash_destroy (&self->swm_peers);
+        zsock_destroy (&self->ready_signal);
+        zsock_destroy (&self->ready_signal_backend);
+        shm_client_destroy (&self->shm);
 
         free (self);
         *self_p = NULL;
@@ -107,6 +111,8 @@ static void communication_actor (zsock_t *pipe, void *args)
 				handle_whisper (self, msg);
 			} else if (streq (event, "JOIN")) {
 				handle_join (self, msg);
+			} else if (streq (event, "LEAVE")) {
+				handle_leave (self, msg);
 			} else if (streq (event, "EVASIVE")) {
 				handle_evasive (self, msg);
 			} else {
@@ -166,6 +172,31 @@ component_t* new_component(json_t *config) {
     	destroy_component (&self);
         return NULL;
     }
+
+	self->connect_timeout = 1000; // upper bound, formerly a fixed sleep
+	if (json_is_integer(json_object_get(config, "connect_timeout"))) {
+		self->connect_timeout = json_integer_value(json_object_get(config, "connect_timeout"));
+	}
+
+	//  Optional shared memory transport for queries and updates
+	if (json_is_string(json_object_get(config, "shm_segment"))) {
+		const char *shm_segment = json_string_value(json_object_get(config, "shm_segment"));
+		self->shm = shm_client_new(shm_segment);
+		if (self->shm) {
+			printf("[%s] using shared memory segment '%s' for queries and updates.\n", self->name, shm_segment);
+		} else {
+			printf("[%s] WARNING: cannot attach shared memory segment '%s'. Using Zyre instead.\n", self->name, shm_segment);
+		}
+	}
+
+	//  Readiness is tracked by the communication actor and signaled via a pipe
+	self->swm_peers = zhash_new();
+	__atomic_store_n (&self->swm_peer_count, 0, __ATOMIC_RELEASE);
+	self->ready_signal = zsys_create_pipe(&self->ready_signal_backend);
+	if (!self->swm_peers || !self->ready_signal) {
+		destroy_component (&self);
+		return NULL;
+	}
 	//  Create local gossip node
 	self->local = zyre_new (self->name);
     if (!self->local) {
@@ -215,14 +246,21 @@ component_t* new_component(json_t *config) {
 	///TODO: romove hardcoding of group name!
 	self->localgroup = strdup("local");
 	zyre_join (self->local, self->localgroup);
-	//  Give time for them to connect
-	zclock_sleep (1000);
 
 	self->communication_actor = zactor_new (communication_actor, self);
 	assert (self->communication_actor);
 	///TODO: move to debug
 	zstr_sendx (self->communication_actor, "VERBOSE", NULL);
 
+	//  Wait until a SWM is connected, rather than for a fixed time
+	if (self->connect_timeout > 0 && !self->shm) {
+		if (wait_for_swm(self, self->connect_timeout)) {
+			printf("[%s] SWM peer joined group '%s'.\n", self->name, self->localgroup);
+		} else {
+			printf("[%s] WARNING: no SWM peer joined group '%s' within %d ms.\n", self->name, self->localgroup, self->connect_timeout);
+		}
+	}
+
 	return self;
 }
 
@@ -243,6 +281,33 @@ void register_monitor_callback(component_t* self, monitor_callback_t monitor) {
 	self->monitor = monitor;
 }
 
+bool wait_for_swm(component_t* self, int timeout) {
+	assert(self);
+	if (self->shm && shm_client_is_connected(self->shm)) {
+		return true;
+	}
+	int64_t deadline = zclock_mono() + timeout;
+	while (!zsys_interrupted && (__atomic_load_n (&self->swm_peer_count, __ATOMIC_ACQUIRE) == 0)) {
+		int64_t remaining = deadline - zclock_mono();
+		if (remaining <= 0) {
+			break;
+		}
+		zsock_set_rcvtimeo (self->ready_signal, (int)remaining);
+		if (zsock_wait (self->ready_signal) < 0) { // timeout or interrupted
+			break;
+		}
+	}
+	return (__atomic_load_n (&self->swm_peer_count, __ATOMIC_ACQUIRE) > 0);
+}
+
+bool is_swm_ready(component_t* self) {
+	assert(self);
+	if (self->shm && shm_client_is_connected(self->shm)) {
+		return true;
+	}
+	return (__atomic_load_n (&self->swm_peer_count, __ATOMIC_ACQUIRE) > 0);
+}
+
 int decode_json(char* message, json_msg_t *result) {
 	/**
 	 * decodes a received msg to json_msg types
@@ -371,8 +436,60 @@ char* encode_json_message(component_t* self, json_t* message) {
     return ret;
 }
 
+static int send_shm_message(component_t* self, char* message) {
+	// the SWM expects the bare RSG-JSON message, i.e. the payload of the envelope
+	json_error_t error;
+	json_t *env = json_loads(message, 0, &error);
+	json_t *pl = json_object_get(env, "payload");
+	char *payload = pl ? json_dumps(pl, JSON_ENCODE_ANY) : NULL;
+	shm_client_discard_replies(self->shm); // replies nobody waits for any more
+	int rc = shm_client_send(self->shm, payload ? payload : message, self->timeout);
+	free(payload);
+	json_decref(env);
+	return rc;
+}
+
+static char* wait_for_shm_reply(component_t* self, const char *queryID, int timeout) {
+	int64_t deadline = zclock_mono() + timeout;
+	while (!zsys_interrupted) {
+		int64_t remaining = deadline - zclock_mono();
+		if (remaining <= 0) {
+			printf("[%s] Timeout! No query answer received.\n",self->name);
+			break;
+		}
+		char *reply = shm_client_recv(self->shm, (int)remaining);
+		if (!reply) {
+			continue;
+		}
+		json_error_t error;
+		json_t *pl = json_loads(reply, 0, &error);
+		const char *received_queryID = json_string_value(json_object_get(pl, "queryId"));
+		bool is_match = received_queryID && streq(received_queryID, queryID);
+		json_decref(pl);
+		if (is_match) {
+			// the reply does not pass the communication actor, so the query is removed here
+			query_t *it = zlist_first(self->query_list);
+			while (it != NULL) {
+				if (streq(it->uid, queryID)) {
+					zlist_remove(self->query_list, it);
+					query_destroy(&it);
+					break;
+				}
+				it = zlist_next(self->query_list);
+			}
+			return reply;
+		}
+		DBG("[%s] Skipping shared memory reply of another query: %s\n", self->name, reply);
+		free(reply);
+	}
+	return NULL;
+}
+
 int shout_message(component_t* self, char* message) {
-	 return zyre_shouts(self->local, self->localgroup, "%s", message);
+	if (self->shm) {
+		return send_shm_message(self, message);
+	}
+	return zyre_shouts(self->local, self->localgroup, "%s", message);
 }
 
 char* wait_for_reply(component_t* self, char *msg, int timeout) {
@@ -408,6 +525,11 @@ char* wait_for_reply(component_t* self, char *msg, int timeout) {
     	}
     }
 
+    if (self->shm) {
+    	ret = wait_for_shm_reply(self, queryID, timeout);
+    	goto cleanup;
+    }
+
     //do this with poller?
     zsock_set_rcvtimeo (self->communication_actor, timeout); //set timeout for socket
     while (!zsys_interrupted){
@@ -587,6 +709,8 @@ void handle_exit(component_t *self, zmsg_t *msg) {
 	char *peerid = zmsg_popstr (msg);
 	char *name = zmsg_popstr (msg);
 	printf ("[%s] EXIT %s %s\n", self->name, peerid, name);
+	zhash_delete (self->swm_peers, peerid);
+	__atomic_store_n (&self->swm_peer_count, (int)zhash_size (self->swm_peers), __ATOMIC_RELEASE);
 	zstr_free(&peerid);
 	zstr_free(&name);
 }
@@ -718,6 +842,30 @@ void handle_shout(component_t *self, zmsg_t *msg, char **rep) {
 				free (monitor_msg);
 				json_decref(payload);
 			}
+		} else if (streq (result->type, "RSGMonitorBatch")) {
+			// load the payload as json
+			json_t *payload;
+			json_error_t error;
+			payload= json_loads(result->payload,0,&error);
+			if(!payload) {
+				ERR("Error parsing JSON send_remote! line %d: %s\n", error.line, error.text);
+			} else {
+
+				DBG("[%s] received a RSGMonitorBatch message: %s \n", self->name, result->payload);
+
+				/* Inform potential listener once per batched monitor message */
+				json_t *monitors = json_object_get(payload, "monitors");
+				size_t index;
+				json_t *monitor;
+				json_array_foreach(monitors, index, monitor) {
+					char* monitor_msg = json_dumps(monitor, JSON_ENCODE_ANY);
+					if(self->monitor && monitor_msg) {
+						(*self->monitor)(monitor_msg);
+					}
+					free (monitor_msg);
+				}
+				json_decref(payload);
+			}
 		} else if (streq (result->type, "mediator_uuid")) {
 			// load the payload as json
 			json_t *payload;
@@ -765,6 +913,33 @@ void handle_join (component_t *self, zmsg_t *msg) {
 	char *name = zmsg_popstr (msg);
 	char *group = zmsg_popstr (msg);
 	printf ("[%s] JOIN %s %s %s\n", self->name, peerid, name, group);
+	const char *swm_peer_name = json_string_value(json_object_get(self->config, "swm_peer_name"));
+	if (!swm_peer_name) {
+		swm_peer_name = "SWM_zyre_bridge"; // wm_name of the zyre_local_bridge, so other components do not count as SWM
+	}
+	if (streq(group, self->localgroup) && (streq(swm_peer_name, "") || streq(name, swm_peer_name))) {
+		int was_ready = (zhash_size (self->swm_peers) > 0);
+		zhash_insert (self->swm_peers, peerid, "SWM");
+		__atomic_store_n (&self->swm_peer_count, (int)zhash_size (self->swm_peers), __ATOMIC_RELEASE);
+		if (!was_ready) {
+			zsock_signal (self->ready_signal_backend, 0); // wakes up wait_for_swm
+		}
+	}
+	zstr_free(&peerid);
+	zstr_free(&name);
+	zstr_free(&group);
+}
+
+void handle_leave (component_t *self, zmsg_t *msg) {
+	assert (zmsg_size(msg) == 3);
+	char *peerid = zmsg_popstr (msg);
+	char *name = zmsg_popstr (msg);
+	char *group = zmsg_popstr (msg);
+	printf ("[%s] LEAVE %s %s %s\n", self->name, peerid, name, group);
+	if (streq(group, self->localgroup)) {
+		zhash_delete (self->swm_peers, peerid);
+		__atomic_store_n (&self->swm_peer_count, (int)zhash_size (self->swm_peers), __ATOMIC_RELEASE);
+	}
 	zstr_free(&peerid);
 	zstr_free(&name);
 	zstr_free(&group);
@@ -9,6 +9,7 @@
 #include <jansson.h>
 #include <uuid/uuid.h>
 #include <string.h>
+#include "swmshm.h"
 
 // (Internal) Helper structs
 
@@ -43,6 +44,12 @@ typedef struct _component_t {
 	int no_of_fcn_block_calls;
 	int alive;
 	monitor_callback_t monitor;
+	int connect_timeout;           // [ms] new_component waits at most this long for an SWM peer
+	zhash_t *swm_peers;            // peers that joined localgroup, only used by the communication actor
+	int swm_peer_count;            // written by the communication actor, read via __atomic_load_n by the caller
+	zsock_t *ready_signal;         // signaled by the communication actor when the first SWM peer joined
+	zsock_t *ready_signal_backend;
+	shm_client_t *shm;             // optional shared memory transport to a SWM on the same computer
 } component_t;
 
 
@@ -113,8 +120,30 @@ void register_monitor_callback(component_t* self, monitor_callback_t monitor);
 
 query_t * query_new (const char *uid, const char *requester, json_msg_t *msg, zactor_t *loop);
 
+/**
+ * Create a communication component and join its Zyre group.
+ * The function returns as soon as an SWM peer joined the group, or after the
+ * optional "connect_timeout" in [ms] of the config (default 1000). With a
+ * "connect_timeout" of 0 it does not wait; use wait_for_swm() or is_swm_ready() later.
+ * If the config has a "swm_peer_name", only a peer with that Zyre name counts as SWM.
+ * If the config has a "shm_segment", e.g. "/swm_query", queries and updates are sent
+ * via shared memory to a SWM on the same computer. Monitors are still received via Zyre.
+ */
 component_t* new_component(json_t *config);
 
+/**
+ * Wait until an SWM peer joined the group of the component, or the shared memory transport is connected.
+ * @param self Communication component.
+ * @param timeout Maximum waiting time in [ms]. 0 does not block.
+ * @return True if an SWM peer is available, false if the timeout expired.
+ */
+bool wait_for_swm(component_t* self, int timeout);
+
+/**
+ * Non-blocking check if an SWM peer joined the group of the component.
+ */
+bool is_swm_ready(component_t* self);
+
 json_t * load_config_file(char* file);
 
 int decode_json(char* message, json_msg_t *result);
@@ -395,6 +424,8 @@ void handle_shout(component_t *self, zmsg_t *msg, char **rep);
 
 void handle_join (component_t *self, zmsg_t *msg);
 
+void handle_leave (component_t *self, zmsg_t *msg);
+
 void handle_evasive (component_t *self, zmsg_t *msg);
 
 
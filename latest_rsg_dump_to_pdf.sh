@@ -15,12 +15,15 @@
 #
 # evince `(./latest_rsg_dump_to_pdf.sh)`
 # 
+# Only dot files (*.gv) are considered. For large graphs configure the rsg_dump block
+# with dot_max_depth or dot_attribute_filter to keep the dot files small.
+#
 #
 # Authors
 # -------
 #  * Sebastian Blumenthal (blumenthal@locomotec.com)
 
-LATEST_FILE=`(ls rsg_dump* -t1 | head -n1)`
+LATEST_FILE=`(ls rsg_dump*.gv -t1 | head -n1)`
 
 dot ${LATEST_FILE} -Tpdf -o ${LATEST_FILE}.pdf
 echo "${LATEST_FILE}.pdf"
@@ -3,18 +3,33 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/core/HomogeneousMatrix44.h>
 #include <brics_3d/worldModel/WorldModel.h>
 #include <brics_3d/worldModel/sceneGraph/DotGraphGenerator.h>
 #include <brics_3d/worldModel/sceneGraph/HDF5UpdateSerializer.h>
+#include <brics_3d/worldModel/sceneGraph/UuidGenerator.h>
+
+/* Snapshot format */
+#include "util/SnapshotWriter.h"
+#include "util/SnapshotReader.h"
+#include "util/SnapshotFilter.h"
+#include "util/LDJSONWriter.h"
+
+/* Boost includes */
+#include <boost/thread.hpp>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip> 	//for setw and setfill
 #include <ctime>
+#include <set>
+#include <deque>
 
 using namespace brics_3d;
 using brics_3d::Logger;
@@ -24,6 +39,300 @@ UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
 
 
 
+/*
+ * Keeps track of all nodes that have been changed since the last dump. Deleted
+ * nodes and removed parent relations are kept as tombstones, since a delta that
+ * only contains the changed subgraphs would otherwise bring them back on replay.
+ * Nodes that have been added since the last dump are known, so all others are
+ * written as updates of the nodes that the previous dump contains.
+ */
+class DirtyNodeTracker : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	DirtyNodeTracker(){};
+	virtual ~DirtyNodeTracker(){};
+
+	bool addNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, bool forcedId = false) {
+		return markAdded(assignedId, assignedId);
+	}
+	bool addGroup(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, bool forcedId = false) {
+		return markAdded(assignedId, assignedId);
+	}
+	bool addTransformNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return markAdded(assignedId, assignedId);
+	}
+	bool addUncertainTransformNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, ITransformUncertainty::ITransformUncertaintyPtr uncertainty, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return markAdded(assignedId, assignedId);
+	}
+	bool addGeometricNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, rsg::Shape::ShapePtr shape, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return markAdded(assignedId, assignedId);
+	}
+	bool addRemoteRootNode(rsg::Id rootId, vector<rsg::Attribute> attributes) {
+		return markAdded(rootId, rootId);
+	}
+	bool addConnection(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, vector<rsg::Id> sourceIds, vector<rsg::Id> targetIds, rsg::TimeStamp start, rsg::TimeStamp end, bool forcedId = false) {
+		return markAdded(assignedId, parentId); // Connections are written as part of their parent
+	}
+	bool setNodeAttributes(rsg::Id id, vector<rsg::Attribute> newAttributes, rsg::TimeStamp timeStamp = rsg::TimeStamp(0)) {
+		return markDirty(id);
+	}
+	bool setTransform(rsg::Id id, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, rsg::TimeStamp timeStamp) {
+		return markDirty(id);
+	}
+	bool setUncertainTransform(rsg::Id id, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, ITransformUncertainty::ITransformUncertaintyPtr uncertainty, rsg::TimeStamp timeStamp) {
+		return markDirty(id);
+	}
+	bool deleteNode(rsg::Id id) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		dirtyIds.erase(id);
+		deletedIds.insert(id);
+		return true;
+	}
+	bool addParent(rsg::Id id, rsg::Id parentId) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		removedParents.erase(std::make_pair(id, parentId));
+		dirtyIds.insert(id);
+		return true;
+	}
+	bool removeParent(rsg::Id id, rsg::Id parentId) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		removedParents.insert(std::make_pair(id, parentId));
+		return true;
+	}
+
+	void clear() {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		dirtyIds.clear();
+		addedIds.clear();
+		deletedIds.clear();
+		removedParents.clear();
+	}
+
+	bool isEmpty() {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		return dirtyIds.empty() && deletedIds.empty() && removedParents.empty();
+	}
+
+	/*
+	 * Hands out the tombstones since the last dump and removes them from the tracker.
+	 */
+	void takeTombstones(std::set<rsg::Id>& deleted, std::set<std::pair<rsg::Id, rsg::Id> >& removed) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		deleted.clear();
+		deleted.swap(deletedIds);
+		removed.clear();
+		removed.swap(removedParents);
+	}
+
+	/*
+	 * Returns the changed nodes that have no changed ancestor, i.e. the roots of
+	 * all changed subgraphs, and the nodes added since the last dump. Resets the tracker.
+	 */
+	void takeSubgraphRoots(brics_3d::WorldModel* wm, vector<rsg::Id>& subgraphRootIds, std::set<rsg::Id>& added) {
+		std::set<rsg::Id> ids;
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			ids.swap(dirtyIds);
+			added.clear();
+			added.swap(addedIds);
+		}
+
+		subgraphRootIds.clear();
+		for (std::set<rsg::Id>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+			bool hasDirtyAncestor = false;
+			std::set<rsg::Id> visited;
+			vector<rsg::Id> pending;
+			wm->scene.getNodeParents(*it, pending);
+			while (!pending.empty() && !hasDirtyAncestor) {
+				rsg::Id ancestor = pending.back();
+				pending.pop_back();
+				if (!visited.insert(ancestor).second) {
+					continue;
+				}
+				if (ids.find(ancestor) != ids.end()) {
+					hasDirtyAncestor = true;
+					break;
+				}
+				vector<rsg::Id> parentIds;
+				wm->scene.getNodeParents(ancestor, parentIds);
+				pending.insert(pending.end(), parentIds.begin(), parentIds.end());
+			}
+			if (!hasDirtyAncestor) {
+				subgraphRootIds.push_back(*it);
+			}
+		}
+	}
+
+private:
+	bool markDirty(rsg::Id id) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		dirtyIds.insert(id);
+		deletedIds.erase(id); // added again
+		return true;
+	}
+
+	bool markAdded(rsg::Id id, rsg::Id dirtyId) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		addedIds.insert(id);
+		dirtyIds.insert(dirtyId);
+		deletedIds.erase(id); // added again
+		return true;
+	}
+
+	std::set<rsg::Id> dirtyIds;
+	std::set<rsg::Id> addedIds;
+	std::set<rsg::Id> deletedIds;
+	std::set<std::pair<rsg::Id, rsg::Id> > removedParents; // child, parent
+	boost::mutex mutex;
+};
+
+/*
+ * A captured copy of (a part of) the graph that still needs to be written.
+ */
+struct DumpJob {
+	std::vector<char> snapshot;
+	std::string fileName;
+	bool writeDot;
+	bool writeSnapshot;
+	bool writeLdjson;
+	rsg_bridge::SnapshotFilter dotFilter;
+};
+
+/*
+ * Formats and writes a captured graph. This does not access the world model,
+ * so it can run on any thread.
+ */
+static void processDumpJob(const DumpJob& job) {
+	if (job.snapshot.empty()) {
+		return;
+	}
+
+	if (job.writeSnapshot) {
+		std::ofstream output;
+		output.open((job.fileName + RSG_SNAPSHOT_FILE_SUFFIX).c_str(), std::ios::trunc | std::ios::binary);
+		if (!output.fail()) {
+			output.write(&job.snapshot[0], job.snapshot.size());
+		} else {
+			LOG(ERROR) << "rsg_dump: Cannot write to file " << job.fileName << RSG_SNAPSHOT_FILE_SUFFIX;
+		}
+		output.close();
+	}
+
+	rsg_bridge::SnapshotReader reader;
+	if ((job.writeDot || job.writeLdjson) && !reader.open(&job.snapshot[0], job.snapshot.size())) {
+		return;
+	}
+
+	if (job.writeLdjson) {
+		rsg_bridge::LDJSONWriter ldjsonWriter;
+		ldjsonWriter.write(reader, job.fileName + RSG_LDJSON_FILE_SUFFIX);
+	}
+
+	if (job.writeDot) {
+		/* Restore the (filtered) copy into a private world model with the same root Id */
+		brics_3d::rsg::Id rootId = rsg_bridge::SnapshotReader::toId(reader.getHeader()->rootId);
+		brics_3d::WorldModel privateWm(new brics_3d::rsg::UuidGenerator(rootId));
+		if (job.dotFilter.isActive()) {
+			std::vector<bool> selection;
+			job.dotFilter.select(reader, selection);
+			reader.apply(&privateWm, true, &selection);
+		} else {
+			reader.apply(&privateWm, true);
+		}
+
+		brics_3d::rsg::DotGraphGenerator printer;
+		brics_3d::rsg::VisualizationConfiguration config;
+		config.abbreviateIds = false;
+		printer.setConfig(config);
+		privateWm.scene.executeGraphTraverser(&printer, privateWm.getRootNodeId());
+		vector<brics_3d::rsg::Id> remoteRootNodeIds;
+		privateWm.scene.getRemoteRootNodes(remoteRootNodeIds);
+		for(vector<brics_3d::rsg::Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
+			privateWm.scene.executeGraphTraverser(&printer, *it);
+		}
+
+		std::ofstream output;
+		output.open((job.fileName + ".gv").c_str(), std::ios::trunc);
+		if (!output.fail()) {
+			output << printer.getDotGraph();
+		} else {
+			LOG(ERROR) << "rsg_dump: Cannot write to file " << job.fileName << ".gv";
+		}
+		output.close();
+	}
+	LOG(INFO) << "rsg_dump: Finished writing " << job.fileName;
+}
+
+/*
+ * Background thread that processes the dump jobs in the order of their creation.
+ */
+class AsyncDumpWriter {
+public:
+	AsyncDumpWriter() : isRunning(false) {};
+	virtual ~AsyncDumpWriter() {
+		stop();
+	};
+
+	void start() {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (isRunning) {
+			return;
+		}
+		isRunning = true;
+		worker = boost::thread(boost::bind(&AsyncDumpWriter::work, this));
+	}
+
+	/* Finishes all pending jobs. */
+	void stop() {
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			if (!isRunning) {
+				return;
+			}
+			isRunning = false;
+		}
+		jobAvailable.notify_all();
+		worker.join();
+	}
+
+	/* Takes the ownership of the job. */
+	void push(DumpJob* job) {
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			jobs.push_back(job);
+			if (jobs.size() > 1) {
+				LOG(WARNING) << "rsg_dump: " << jobs.size() << " dumps are waiting to be written.";
+			}
+		}
+		jobAvailable.notify_all();
+	}
+
+private:
+	void work() {
+		while (true) {
+			DumpJob* job = 0;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				while (jobs.empty() && isRunning) {
+					jobAvailable.wait(lock);
+				}
+				if (jobs.empty()) {
+					return; // stopped and nothing left to do
+				}
+				job = jobs.front();
+				jobs.pop_front();
+			}
+			processDumpJob(*job);
+			delete job;
+		}
+	}
+
+	bool isRunning;
+	std::deque<DumpJob*> jobs;
+	boost::mutex mutex;
+	boost::condition_variable jobAvailable;
+	boost::thread worker;
+};
+
 /* define a structure for holding the block local state. By assigning an
  * instance of this struct to the block private_data pointer (see init), this
  * information becomes accessible within the hook functions.
@@ -32,6 +341,7 @@ struct rsg_dump_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotGraphGenerator* wm_printer;
 
 		std::ofstream* output;
@@ -39,6 +349,14 @@ struct rsg_dump_info
 		std::string* directoryName;
 		int counter;
 
+		rsg_bridge::SnapshotWriter* snapshotWriter; // captures the graph
+		bool storeSnapshotFiles;
+		bool storeDotFiles;
+		bool storeLdjsonFiles;
+		rsg_bridge::SnapshotFilter* dotFilter;
+		AsyncDumpWriter* asyncWriter;     // optional
+		DirtyNodeTracker* dirtyTracker;   // optional
+
         /* this is to have fast access to ports for reading and writing, without
          * needing a hash table lookup */
         struct rsg_dump_port_cache ports;
@@ -70,6 +388,7 @@ int rsg_dump_init(ubx_block_t *b)
     		LOG(FATAL) << " World model handle could not be initialized.";
     		return -1;
     	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
     	inf->output = new std::ofstream();
     	inf->fileNamePrefix = new std::string("rsg_dump");
@@ -104,6 +423,90 @@ int rsg_dump_init(ubx_block_t *b)
 
     	inf->counter = 0;
 
+    	/* retrive optional snapshot setting from config */
+    	int* store_snapshot_files =  ((int*) ubx_config_get_data_ptr(b, "store_snapshot_files", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_dump: No store_snapshot_files configuation given. Turned off by default.";
+    	} else {
+    		if (*store_snapshot_files == 1) {
+    			LOG(INFO) << "rsg_dump: store_snapshot_files turned on.";
+    			inf->storeSnapshotFiles = true;
+    		} else {
+    			LOG(INFO) << "rsg_dump: store_snapshot_files turned off.";
+    		}
+    	}
+    	inf->snapshotWriter = new rsg_bridge::SnapshotWriter();
+
+    	/* retrive optional dump formats from config */
+    	inf->storeDotFiles = true;
+    	chrptr = (char*) ubx_config_get_data_ptr(b, "dump_format", &clen);
+    	if(clen == 0 || strcmp(chrptr, "")==0) {
+    		LOG(INFO) << "rsg_dump: No dump_format configuation given. Writing dot files by default.";
+    	} else {
+    		inf->storeDotFiles = false;
+    		std::stringstream formats(chrptr);
+    		std::string format;
+    		while (std::getline(formats, format, ',')) {
+    			format.erase(0, format.find_first_not_of(" "));
+    			format.erase(format.find_last_not_of(" ") + 1);
+    			if (format.compare("dot") == 0) {
+    				inf->storeDotFiles = true;
+    			} else if (format.compare("snapshot") == 0) {
+    				inf->storeSnapshotFiles = true;
+    			} else if (format.compare("ldjson") == 0) {
+    				inf->storeLdjsonFiles = true;
+    			} else {
+    				LOG(WARNING) << "rsg_dump: Unknown dump_format " << format << ". Skipping it.";
+    			}
+    		}
+    		LOG(INFO) << "rsg_dump: dump_format = " << chrptr;
+    	}
+
+    	/* retrive optional filters for the dot files from config */
+    	inf->dotFilter = new rsg_bridge::SnapshotFilter();
+    	int* dot_max_depth =  ((int*) ubx_config_get_data_ptr(b, "dot_max_depth", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_dump: No dot_max_depth configuation given. Dot files are not limited in depth.";
+    	} else {
+    		LOG(INFO) << "rsg_dump: dot_max_depth = " << *dot_max_depth;
+    		inf->dotFilter->setMaxDepth(*dot_max_depth);
+    	}
+    	chrptr = (char*) ubx_config_get_data_ptr(b, "dot_attribute_filter", &clen);
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_dump: No dot_attribute_filter configuation given. Dot files are not filtered by attributes.";
+    	} else {
+    		LOG(INFO) << "rsg_dump: dot_attribute_filter = " << chrptr;
+    		inf->dotFilter->setAttributeFilter(std::string(chrptr));
+    	}
+
+    	/* retrive optional asynchronous mode from config */
+    	int* async_dump =  ((int*) ubx_config_get_data_ptr(b, "async_dump", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_dump: No async_dump configuation given. Turned off by default.";
+    	} else {
+    		if (*async_dump == 1) {
+    			LOG(INFO) << "rsg_dump: async_dump turned on.";
+    			inf->asyncWriter = new AsyncDumpWriter();
+    			inf->asyncWriter->start();
+    		} else {
+    			LOG(INFO) << "rsg_dump: async_dump turned off.";
+    		}
+    	}
+
+    	/* retrive optional incremental mode from config */
+    	int* incremental_dump =  ((int*) ubx_config_get_data_ptr(b, "incremental_dump", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_dump: No incremental_dump configuation given. Turned off by default.";
+    	} else {
+    		if (*incremental_dump == 1) {
+    			LOG(INFO) << "rsg_dump: incremental_dump turned on.";
+    			inf->dirtyTracker = new DirtyNodeTracker();
+    			inf->wm->scene.attachUpdateObserver(inf->dirtyTracker);
+    		} else {
+    			LOG(INFO) << "rsg_dump: incremental_dump turned off.";
+    		}
+    	}
+
         return 0;
 }
 
@@ -141,6 +544,23 @@ void rsg_dump_cleanup(ubx_block_t *b)
 			delete inf->output;
 			inf->output = 0;
 		}
+		if(inf->asyncWriter) {
+			delete inf->asyncWriter; // finishes pending dumps
+			inf->asyncWriter = 0;
+		}
+		if(inf->dirtyTracker) {
+			inf->wm->scene.detachUpdateObserver(inf->dirtyTracker);
+			delete inf->dirtyTracker;
+			inf->dirtyTracker = 0;
+		}
+		if(inf->snapshotWriter) {
+			delete inf->snapshotWriter;
+			inf->snapshotWriter = 0;
+		}
+		if(inf->dotFilter) {
+			delete inf->dotFilter;
+			inf->dotFilter = 0;
+		}
 		free(b->private_data);
 }
 
@@ -174,31 +594,111 @@ void rsg_dump_step(ubx_block_t *b)
 
 
 		fileName = *inf->directoryName + *inf->fileNamePrefix + "_" + tmpFileName.str();
+
+		/*
+		 * Asynchronous, incremental, filtered and LDJSON dumps: capture a copy of
+		 * the (changed) graph and format it afterwards without access to the world model.
+		 */
+		bool isIncremental = (inf->dirtyTracker != 0) && (inf->counter > 0);
+		bool isFiltered = inf->storeDotFiles && inf->dotFilter->isActive();
+		if(inf->asyncWriter || isIncremental || isFiltered || inf->storeLdjsonFiles) {
+			{
+				rsg_bridge::WorldModelReadLock lock(inf->wm_access); // only while the copy is taken
+				if(isIncremental) {
+					if(inf->dirtyTracker->isEmpty()) {
+						LOG(INFO) << "rsg_dump: Nothing changed since the last dump.";
+						return;
+					}
+					vector<brics_3d::rsg::Id> subgraphRootIds;
+					std::set<brics_3d::rsg::Id> addedIds;
+					inf->dirtyTracker->takeSubgraphRoots(wm, subgraphRootIds, addedIds);
+					inf->snapshotWriter->captureSubgraphs(wm, subgraphRootIds, &addedIds); // all other nodes are updates
+
+					/* Tombstones, so replaying base + deltas does not restore removed nodes and relations */
+					std::set<brics_3d::rsg::Id> deletedIds;
+					std::set<std::pair<brics_3d::rsg::Id, brics_3d::rsg::Id> > removedParents;
+					inf->dirtyTracker->takeTombstones(deletedIds, removedParents);
+					for(std::set<brics_3d::rsg::Id>::const_iterator it = deletedIds.begin(); it != deletedIds.end(); ++it) {
+						inf->snapshotWriter->deleteNode(*it);
+					}
+					for(std::set<std::pair<brics_3d::rsg::Id, brics_3d::rsg::Id> >::const_iterator it = removedParents.begin(); it != removedParents.end(); ++it) {
+						inf->snapshotWriter->removeParent(it->first, it->second);
+					}
+					fileName += "_delta";
+				} else {
+					if(inf->dirtyTracker) {
+						inf->dirtyTracker->clear();
+					}
+					inf->snapshotWriter->capture(wm);
+				}
+			}
+
+			DumpJob* job = new DumpJob();
+			job->fileName = fileName;
+			job->writeDot = inf->storeDotFiles;
+			job->writeSnapshot = inf->storeSnapshotFiles;
+			job->writeLdjson = inf->storeLdjsonFiles;
+			job->dotFilter = *inf->dotFilter;
+			bool isWritten = inf->snapshotWriter->write(job->snapshot);
+			inf->snapshotWriter->reset();
+			if(!isWritten) {
+				LOG(ERROR) << "rsg_dump: Cannot serialize the captured graph. Skipping the dump " << fileName;
+				delete job;
+				return;
+			}
+			inf->counter++;
+
+			if(inf->asyncWriter) {
+				LOG(INFO) << "rsg_dump: Captured graph. Printing it in background to file " << fileName;
+				inf->asyncWriter->push(job);
+			} else {
+				LOG(INFO) << "rsg_dump: Printing graph to file " << fileName;
+				processDumpJob(*job);
+				delete job;
+			}
+			LOG(INFO) << "rsg_dump: World model access statistics: " << inf->wm_access->getStatisticsAsJSON();
+			return;
+		}
+		if(inf->dirtyTracker) {
+			inf->dirtyTracker->clear();
+		}
+
 		LOG(INFO) << "rsg_dump: Printing graph to file " << fileName;
+		rsg_bridge::WorldModelReadLock lock(inf->wm_access);
 
 		/* Save a complete snapshopt relative to the root node */
-		wm->scene.executeGraphTraverser(inf->wm_printer, wm->scene.getRootId());
-		bool printRemoteRootNodes = true;
-		if(printRemoteRootNodes) {
-			vector<brics_3d::rsg::Id> remoteRootNodeIds;
-			wm->scene.getRemoteRootNodes(remoteRootNodeIds);
-			for(vector<brics_3d::rsg::Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
-				wm->scene.executeGraphTraverser(inf->wm_printer, *it);
+		if(inf->storeDotFiles) {
+			wm->scene.executeGraphTraverser(inf->wm_printer, wm->scene.getRootId());
+			bool printRemoteRootNodes = true;
+			if(printRemoteRootNodes) {
+				vector<brics_3d::rsg::Id> remoteRootNodeIds;
+				wm->scene.getRemoteRootNodes(remoteRootNodeIds);
+				for(vector<brics_3d::rsg::Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
+					wm->scene.executeGraphTraverser(inf->wm_printer, *it);
+				}
 			}
-		}
 
-		inf->output->open((fileName + ".gv").c_str(), std::ios::trunc);
-		if (!inf->output->fail()) {
-			*inf->output << inf->wm_printer->getDotGraph();
-		} else {
-			LOG(ERROR) << "DotVisualizer: Cannot write to file " << fileName << ".gv";
+			inf->output->open((fileName + ".gv").c_str(), std::ios::trunc);
+			if (!inf->output->fail()) {
+				*inf->output << inf->wm_printer->getDotGraph();
+			} else {
+				LOG(ERROR) << "DotVisualizer: Cannot write to file " << fileName << ".gv";
+			}
+
+			inf->output->flush();
+			inf->output->close();
+			inf->wm_printer->reset();
 		}
 
-		inf->output->flush();
-		inf->output->close();
-		inf->wm_printer->reset();
+		/* Save a binary snapshot that can be loaded without parsing */
+		if(inf->storeSnapshotFiles) {
+			inf->snapshotWriter->capture(wm);
+			inf->snapshotWriter->write(fileName + RSG_SNAPSHOT_FILE_SUFFIX);
+			inf->snapshotWriter->reset();
+		}
 		inf->counter++;
 
 		LOG(INFO) << "rsg_dump: Done.";
+		LOG(INFO) << "rsg_dump: World model access statistics: " << inf->wm_access->getStatisticsAsJSON();
 }
 
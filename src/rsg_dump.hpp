@@ -20,6 +20,12 @@ char rsg_dump_meta[] =
 ubx_config_t rsg_dump_config[] = {
         { .name="wm_handle", .type_name = "struct rsg_wm_handle", .doc="Handle to the world wodel instance. This parameter is mandatory." },
         { .name="dot_name_prefix", .type_name = "char" , .doc="Optional prefix for stored dot files." },
+        { .name="store_snapshot_files", .type_name = "int" , .doc="If true (=1) a binary snapshot (.rsgsnap) is stored along with the dot file. It can be loaded by the rsg_scene_setup block. Default is 0." },
+        { .name="dump_format", .type_name = "char" , .doc="Comma separated list of formats to be written: dot, snapshot (binary .rsgsnap) and ldjson (one RSG-JSON update per line). Default is dot." },
+        { .name="dot_max_depth", .type_name = "int" , .doc="Only nodes up to this depth below the root node are written to the dot file. Default is -1 (unlimited)." },
+        { .name="dot_attribute_filter", .type_name = "char" , .doc="Only nodes with a matching attribute (key or key=value) and their ancestors are written to the dot file. Default is no filter." },
+        { .name="async_dump", .type_name = "int" , .doc="If true (=1) the step function only captures a copy of the graph. Formatting and writing of the files is done by a background thread. Default is 0." },
+        { .name="incremental_dump", .type_name = "int" , .doc="If true (=1) only the subgraphs that changed since the last dump are written (with suffix _delta), plus tombstones for deleted nodes and removed parents. The first dump is always complete. Default is 0." },
         { NULL },
 };
 
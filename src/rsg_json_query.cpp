@@ -3,6 +3,36 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+#include "util/WorldModelVersions.h"
+
+/* Subscriptions of peers, served by rsg_json_sender */
+#include "util/SubscriptionRegistry.h"
+
+/* Continuous queries, pushed via the monitor port of rsg_json_sender */
+#include "util/ContinuousQueryRegistry.h"
+
+/* Area and proximity queries */
+#include "util/SpatialIndex.h"
+
+/* Repeated pose lookups */
+#include "util/TransformCache.h"
+#include "util/TransformHistoryStore.h"
+#include "util/TransformBatchQuery.h"
+
+/* Polled read-only queries */
+#include "util/QueryResultCache.h"
+
+/* Queries that are registered once and executed by handle */
+#include "util/PreparedQueryRegistry.h"
+
+/* Concurrent clients via a ROUTER socket (only built with ZMQ) */
+#include "util/QueryServer.h"
+
+/* Clients on the same computer via shared memory */
+#include "util/ShmServer.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/worldModel/WorldModel.h>
@@ -11,6 +41,9 @@
 #include <brics_3d/worldModel/sceneGraph/UpdatesToSceneGraphListener.h>
 #include <brics_3d/worldModel/sceneGraph/GraphConstraintUpdateFilter.h>
 
+/* Boost includes */
+#include <boost/regex.hpp>
+#include <boost/bind.hpp>
 
 using namespace brics_3d;
 using brics_3d::Logger;
@@ -19,6 +52,58 @@ using brics_3d::Logger;
 UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
 
 #define DEFAULT_BUFFER_SIZE 20000
+#define SNAPSHOT_READ_VERSIONS 2
+#define SNAPSHOT_READ_MAX_LOG_SIZE 100000
+#define DEFAULT_SPATIAL_INDEX_CELL_SIZE 0.001
+#define DEFAULT_TRANSFORM_CACHE_BUCKET 0.1
+#define TRANSFORM_CACHE_SIZE 10000
+#define DEFAULT_TRANSFORM_HISTORY_CAPACITY 1000
+#define PREPARED_QUERIES_SIZE 1000
+#define QUERY_CACHE_SIZE 10000
+#define DEFAULT_QUERY_WORKERS 4
+#define MAX_TYPED_REQUESTS_PER_STEP 100 // bounds the time of a step
+
+/* Pure queries only need read access. Updates and function blocks might change the graph. */
+static const boost::regex readOnlyQueryPattern("\"@worldmodeltype\"\\s*:\\s*\"RSGQuery\"");
+static const boost::regex accessStatisticsQueryPattern("\"query\"\\s*:\\s*\"GET_ACCESS_STATISTICS\"");
+static const boost::regex statisticsQueryPattern("\"query\"\\s*:\\s*\"GET_STATS\"");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+
+/*
+ * Answers a GET_ACCESS_STATISTICS query with the contention metrics of the world model.
+ */
+static void getAccessStatistics(rsg_bridge::WorldModelAccess* access, const std::string& query, std::string& result) {
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"GET_ACCESS_STATISTICS\", ";
+	boost::smatch queryId;
+	if (boost::regex_search(query, queryId, queryIdPattern)) {
+		reply << "\"queryId\": \"" << queryId[1] << "\", ";
+	}
+	reply << "\"querySuccess\": true, \"statistics\": " << access->getStatisticsAsJSON() << "}";
+	result = reply.str();
+}
+
+/* Where a query is processed and which lock it needs. Prepared queries store this plan. */
+enum rsg_json_query_route {
+	ROUTE_ACCESS_STATISTICS,
+	ROUTE_SUBSCRIPTION,
+	ROUTE_CONTINUOUS_QUERY,
+	ROUTE_SPATIAL,
+	ROUTE_TRANSFORM_HISTORY,
+	ROUTE_TRANSFORM_BATCH,
+	ROUTE_TRANSFORM_CACHE,
+	ROUTE_STATISTICS,
+	ROUTE_QUERY_CACHE,
+	ROUTE_READ_ONLY_VERSION,
+	ROUTE_READ_ONLY,
+	ROUTE_UPDATE
+};
+
+/* Query runners keep state between calls, so every thread that executes queries has its own set. */
+struct rsg_json_query_runners {
+		brics_3d::rsg::JSONQueryRunner* live;                  // with the constraint filter for updates
+		std::vector<brics_3d::rsg::JSONQueryRunner*> versions; // one per version, for snapshot reads
+};
 
 /* define a structure for holding the block local state. By assigning ano
  * instance of this struct to the block private_data pointer (see init), this
@@ -28,10 +113,21 @@ struct rsg_json_query_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
-		brics_3d::rsg::JSONQueryRunner* wm_query_runner;
+		rsg_json_query_runners* runners;                                 // for queries via the ports
 		brics_3d::rsg::GraphConstraintUpdateFilter* constraint_filter; // optional
 		brics_3d::rsg::UpdatesToSceneGraphListener* wm_updates_to_wm;  // for constraint_filter
+		rsg_bridge::WorldModelVersions* wm_versions;                     // optional, for snapshot reads
+		rsg_bridge::SpatialIndex* spatial_index;                         // optional, shared by all blocks
+		rsg_bridge::TransformCache* transform_cache;                     // optional, shared by all blocks
+		rsg_bridge::TransformHistoryStore* transform_history;            // optional, shared by all blocks
+		rsg_bridge::QueryResultCache* query_cache;                       // optional, shared by all blocks
+		rsg_bridge::PreparedQueryRegistry* prepared_queries;             // per block, as handles are not shared
+		rsg_bridge::QueryServer* query_server;                           // optional, for concurrent clients
+		std::vector<rsg_json_query_runners*>* worker_runners;            // one set per worker of the query_server
+		rsg_bridge::ShmServer* shm_server;                               // optional, for clients on the same computer
+		rsg_json_query_runners* shm_runners;                             // for the thread of the shm_server
 
         /* this is to have fast access to ports for reading and writing, without
          * needing a hash table lookup */
@@ -48,6 +144,29 @@ struct rsg_json_query_info
 
 };
 
+#ifdef USE_ZMQ
+static void serveQuery(struct rsg_json_query_info *inf, unsigned int worker, std::string& query, std::string& result);
+#endif
+static void serveShmQuery(struct rsg_json_query_info *inf, std::string& query, std::string& result);
+
+static rsg_json_query_runners* createRunners(struct rsg_json_query_info *inf) {
+	rsg_json_query_runners* runners = new rsg_json_query_runners();
+//	runners->live = new brics_3d::rsg::JSONQueryRunner(inf->wm); // without filter for updates
+	runners->live = new brics_3d::rsg::JSONQueryRunner(inf->wm, inf->constraint_filter); // with filter for updates
+	for (unsigned int i = 0; (inf->wm_versions != 0) && (i < inf->wm_versions->getVersionCount()); ++i) {
+		runners->versions.push_back(new brics_3d::rsg::JSONQueryRunner(inf->wm_versions->getVersion(i)));
+	}
+	return runners;
+}
+
+static void deleteRunners(rsg_json_query_runners* runners) {
+	for (unsigned int i = 0; i < runners->versions.size(); ++i) {
+		delete runners->versions[i];
+	}
+	delete runners->live;
+	delete runners;
+}
+
 /* init */
 int rsg_json_query_init(ubx_block_t *b)
 {
@@ -76,6 +195,7 @@ int rsg_json_query_init(ubx_block_t *b)
     					  "Please check your system design if this is intended!";
     		inf->wm = new brics_3d::WorldModel();
         }
+        inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
 
         /*
@@ -93,10 +213,126 @@ int rsg_json_query_init(ubx_block_t *b)
     	inf->wm_updates_to_wm->setForcedIdPolicy(false);
     	inf->constraint_filter->attachUpdateObserver(inf->wm_updates_to_wm); // handle used for updates
 
+        /* Optionally answer queries on pinned versions of the world model */
+        int* snapshot_reads =  ((int*) ubx_config_get_data_ptr(b, "snapshot_reads", &clen));
+        if(clen == 0) {
+        	LOG(INFO) << "rsg_json_query: No snapshot_reads configuration given. Turned off by default.";
+        } else {
+        	if (*snapshot_reads == 1) {
+        		LOG(INFO) << "rsg_json_query: snapshot_reads turned on.";
+        		inf->wm_versions = new rsg_bridge::WorldModelVersions(inf->wm_access, SNAPSHOT_READ_VERSIONS, SNAPSHOT_READ_MAX_LOG_SIZE);
+        	} else {
+        		LOG(INFO) << "rsg_json_query: snapshot_reads turned off.";
+        	}
+        }
+
         /* Setup query runner module  */
-//        inf->wm_query_runner = new brics_3d::rsg::JSONQueryRunner(inf->wm); // without filter for updates
-        inf->wm_query_runner = new brics_3d::rsg::JSONQueryRunner(inf->wm, inf->constraint_filter); // with filter for updates
+        inf->runners = createRunners(inf);
+
+        /* Optionally answer area and proximity queries with a spatial index */
+        int* spatial_index =  ((int*) ubx_config_get_data_ptr(b, "spatial_index", &clen));
+        if(clen == 0) {
+        	LOG(INFO) << "rsg_json_query: No spatial_index configuration given. Turned off by default.";
+        } else {
+        	if (*spatial_index == 1) {
+        		LOG(INFO) << "rsg_json_query: spatial_index turned on.";
+        		double cellSize = DEFAULT_SPATIAL_INDEX_CELL_SIZE;
+        		double* spatial_index_cell_size =  ((double*) ubx_config_get_data_ptr(b, "spatial_index_cell_size", &clen));
+        		if((clen != 0) && (*spatial_index_cell_size > 0)) {
+        			cellSize = *spatial_index_cell_size;
+        		}
+        		rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // the index attaches itself to the scene
+        		inf->spatial_index = rsg_bridge::SpatialIndex::get(inf->wm, cellSize);
+        	} else {
+        		LOG(INFO) << "rsg_json_query: spatial_index turned off.";
+        	}
+        }
 
+        /* Optionally cache the replies of GET_TRANSFORM queries */
+        int* transform_cache =  ((int*) ubx_config_get_data_ptr(b, "transform_cache", &clen));
+        if(clen == 0) {
+        	LOG(INFO) << "rsg_json_query: No transform_cache configuration given. Turned off by default.";
+        } else {
+        	if (*transform_cache == 1) {
+        		LOG(INFO) << "rsg_json_query: transform_cache turned on.";
+        		double bucket = DEFAULT_TRANSFORM_CACHE_BUCKET;
+        		double* transform_cache_bucket =  ((double*) ubx_config_get_data_ptr(b, "transform_cache_bucket", &clen));
+        		if((clen != 0) && (*transform_cache_bucket >= 0)) {
+        			bucket = *transform_cache_bucket;
+        		}
+        		rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // the cache attaches itself to the scene
+        		inf->transform_cache = rsg_bridge::TransformCache::get(inf->wm, bucket, TRANSFORM_CACHE_SIZE);
+        	} else {
+        		LOG(INFO) << "rsg_json_query: transform_cache turned off.";
+        	}
+        }
+
+        /* Optionally keep the histories of all Transforms */
+        int* transform_history =  ((int*) ubx_config_get_data_ptr(b, "transform_history", &clen));
+        if(clen == 0) {
+        	LOG(INFO) << "rsg_json_query: No transform_history configuration given. Turned off by default.";
+        } else {
+        	if (*transform_history == 1) {
+        		LOG(INFO) << "rsg_json_query: transform_history turned on.";
+        		unsigned int capacity = DEFAULT_TRANSFORM_HISTORY_CAPACITY;
+        		uint32_t* transform_history_capacity =  ((uint32_t*) ubx_config_get_data_ptr(b, "transform_history_capacity", &clen));
+        		if((clen != 0) && (*transform_history_capacity > 0)) {
+        			capacity = *transform_history_capacity;
+        		}
+        		rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // the store attaches itself to the scene
+        		inf->transform_history = rsg_bridge::TransformHistoryStore::get(inf->wm, capacity);
+        	} else {
+        		LOG(INFO) << "rsg_json_query: transform_history turned off.";
+        	}
+        }
+
+        /* Optionally cache the replies of polled read-only queries */
+        int* query_cache =  ((int*) ubx_config_get_data_ptr(b, "query_cache", &clen));
+        if(clen == 0) {
+        	LOG(INFO) << "rsg_json_query: No query_cache configuration given. Turned off by default.";
+        } else {
+        	if (*query_cache == 1) {
+        		LOG(INFO) << "rsg_json_query: query_cache turned on.";
+        		rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // the cache attaches itself to the scene
+        		inf->query_cache = rsg_bridge::QueryResultCache::get(inf->wm, QUERY_CACHE_SIZE);
+        	} else {
+        		LOG(INFO) << "rsg_json_query: query_cache turned off.";
+        	}
+        }
+
+        inf->prepared_queries = new rsg_bridge::PreparedQueryRegistry(PREPARED_QUERIES_SIZE);
+
+        /* Optionally serve many clients in parallel, each worker with its own query runners */
+        char* server_endpoint = (char*) ubx_config_get_data_ptr(b, "server_endpoint", &clen);
+        if((clen == 0) || (strcmp(server_endpoint, "") == 0)) {
+        	LOG(INFO) << "rsg_json_query: No server_endpoint configuration given. Turned off by default.";
+        } else {
+#ifdef USE_ZMQ
+        	unsigned int workerCount = DEFAULT_QUERY_WORKERS;
+        	int* query_workers =  ((int*) ubx_config_get_data_ptr(b, "query_workers", &clen));
+        	if((clen != 0) && (*query_workers > 0)) {
+        		workerCount = *query_workers;
+        	}
+        	LOG(INFO) << "rsg_json_query: server_endpoint = " << server_endpoint << " with query_workers = " << workerCount;
+        	inf->worker_runners = new std::vector<rsg_json_query_runners*>();
+        	for (unsigned int i = 0; i < workerCount; ++i) {
+        		inf->worker_runners->push_back(createRunners(inf));
+        	}
+        	inf->query_server = new rsg_bridge::QueryServer(std::string(server_endpoint), workerCount, boost::bind(&serveQuery, inf, _1, _2, _3));
+#else
+        	LOG(ERROR) << "rsg_json_query: server_endpoint = " << server_endpoint << " is ignored. This block is built without ZMQ.";
+#endif
+        }
+
+        /* Optionally serve clients on the same computer via shared memory */
+        char* shm_segment = (char*) ubx_config_get_data_ptr(b, "shm_segment", &clen);
+        if((clen == 0) || (strcmp(shm_segment, "") == 0)) {
+        	LOG(INFO) << "rsg_json_query: No shm_segment configuration given. Turned off by default.";
+        } else {
+        	LOG(INFO) << "rsg_json_query: shm_segment = " << shm_segment;
+        	inf->shm_runners = createRunners(inf);
+        	inf->shm_server = new rsg_bridge::ShmServer(std::string(shm_segment), boost::bind(&serveShmQuery, inf, _1, _2));
+        }
 
 
         /* Setup input buffer for JSON messages */
@@ -120,7 +356,7 @@ int rsg_json_query_init(ubx_block_t *b)
 /* start */
 int rsg_json_query_start(ubx_block_t *b)
 {
-        /* struct rsg_json_query_info *inf = (struct rsg_json_query_info*) b->private_data; */
+        struct rsg_json_query_info *inf = (struct rsg_json_query_info*) b->private_data;
         int ret = 0;
     	unsigned int clen;
 
@@ -184,19 +420,71 @@ int rsg_json_query_start(ubx_block_t *b)
     			LOG(INFO) << "rsg_json_query: unknown log_level = " << *log_level;		}
     	}
 
+#ifdef USE_ZMQ
+    	if((inf->query_server != 0) && !inf->query_server->start()) {
+    		LOG(ERROR) << "rsg_json_query: Cannot start the query server.";
+    		ret = -1;
+    	}
+#endif
+    	if((inf->shm_server != 0) && !inf->shm_server->start()) {
+    		LOG(ERROR) << "rsg_json_query: Cannot start the shared memory server.";
+    		ret = -1;
+    	}
+
         return ret;
 }
 
 /* stop */
 void rsg_json_query_stop(ubx_block_t *b)
 {
-        /* struct rsg_json_query_info *inf = (struct rsg_json_query_info*) b->private_data; */
+        struct rsg_json_query_info *inf = (struct rsg_json_query_info*) b->private_data;
+        if(inf->transform_cache != 0) {
+        	LOG(INFO) << "rsg_json_query: " << inf->transform_cache->getStatisticsAsString();
+        }
+        if(inf->query_cache != 0) {
+        	LOG(INFO) << "rsg_json_query: " << inf->query_cache->getStatisticsAsString();
+        }
+#ifdef USE_ZMQ
+        if(inf->query_server != 0) {
+        	inf->query_server->stop(); // no queries while the block is stopped
+        	LOG(INFO) << "rsg_json_query: " << inf->query_server->getStatisticsAsString();
+        }
+#endif
+        if(inf->shm_server != 0) {
+        	inf->shm_server->stop();
+        	LOG(INFO) << "rsg_json_query: " << inf->shm_server->getStatisticsAsString();
+        }
 }
 
 /* cleanup */
 void rsg_json_query_cleanup(ubx_block_t *b)
 {
         struct rsg_json_query_info *inf = (struct rsg_json_query_info*) b->private_data;
+#ifdef USE_ZMQ
+		if(inf->query_server != 0) {
+			delete inf->query_server; // stops the workers
+			inf->query_server = 0;
+		}
+#endif
+		if(inf->worker_runners != 0) {
+			for (unsigned int i = 0; i < inf->worker_runners->size(); ++i) {
+				deleteRunners((*inf->worker_runners)[i]);
+			}
+			delete inf->worker_runners;
+			inf->worker_runners = 0;
+		}
+		if(inf->shm_server != 0) {
+			delete inf->shm_server;
+			inf->shm_server = 0;
+		}
+		if(inf->shm_runners != 0) {
+			deleteRunners(inf->shm_runners);
+			inf->shm_runners = 0;
+		}
+		if(inf->runners != 0) {
+			deleteRunners(inf->runners);
+			inf->runners = 0;
+		}
 		if(inf->constraint_filter != 0) {
 			delete inf->constraint_filter;
 			inf->constraint_filter = 0;
@@ -205,10 +493,275 @@ void rsg_json_query_cleanup(ubx_block_t *b)
 			delete inf->wm_updates_to_wm;
 			inf->wm_updates_to_wm = 0;
 		}
+		if(inf->wm_versions != 0) {
+			delete inf->wm_versions;
+			inf->wm_versions = 0;
+		}
+		if(inf->prepared_queries != 0) {
+			delete inf->prepared_queries;
+			inf->prepared_queries = 0;
+		}
         free(inf->input_buffer);
         free(b->private_data);
 }
 
+/*
+ * Answers a GET_STATS query with the hit rates of the enabled caches.
+ */
+static void getStatistics(struct rsg_json_query_info *inf, const std::string& query, std::string& result) {
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"GET_STATS\", ";
+	boost::smatch queryId;
+	if (boost::regex_search(query, queryId, queryIdPattern)) {
+		reply << "\"queryId\": \"" << queryId[1] << "\", ";
+	}
+	reply << "\"querySuccess\": true, \"statistics\": {";
+	rsg_bridge::DispatchStatistics dispatch = {0, 0, 0, 0, 0};
+	rsg_bridge::ContinuousQueryRegistry* continuousQueries = rsg_bridge::ContinuousQueryRegistry::find(inf->wm);
+	if (continuousQueries != 0) {
+		dispatch = continuousQueries->getDispatchStatistics();
+	}
+	reply << "\"continuousQueryDispatch\": {\"dispatches\": " << dispatch.dispatchCount
+			<< ", \"evaluatedListeners\": " << dispatch.candidateCount
+			<< ", \"registeredListeners\": " << dispatch.listenerCount
+			<< ", \"dispatchTime\": " << dispatch.dispatchTime << "}";
+	if (inf->query_cache != 0) {
+		reply << ", \"queryCache\": " << inf->query_cache->getStatisticsAsJSON();
+	}
+	if (inf->transform_cache != 0) {
+		rsg_bridge::TransformCacheStatistics transformCache = inf->transform_cache->getStatistics();
+		reply << ", \"transformCache\": {\"hits\": " << transformCache.hitCount
+				<< ", \"misses\": " << transformCache.missCount
+				<< ", \"invalidated\": " << transformCache.invalidatedCount
+				<< ", \"size\": " << transformCache.size << "}";
+	}
+	reply << "}}";
+	result = reply.str();
+}
+
+/*
+ * Continuous queries are evaluated by a registry that is shared by all blocks and
+ * pushed via the monitor port. It attaches itself to the scene and runs a timer
+ * thread, so it is only created by the first REGISTER and under the write lock.
+ */
+static void handleContinuousQuery(struct rsg_json_query_info *inf, const std::string& query, std::string& result) {
+	rsg_bridge::ContinuousQueryRegistry* registry = rsg_bridge::ContinuousQueryRegistry::find(inf->wm);
+	if(registry == 0) {
+		if(!rsg_bridge::ContinuousQueryRegistry::isRegisterMessage(query)) {
+			rsg_bridge::ContinuousQueryRegistry::createResult(query, false, result); // nothing registered yet
+			return;
+		}
+		rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+		registry = rsg_bridge::ContinuousQueryRegistry::get(inf->wm);
+	}
+	registry->handleMessage(query, result); // no lock on the world model required
+}
+
+/*
+ * The versions only hold the latest sample of each transform and no uncertainties, so
+ * queries at a past stamp are answered by the live World Model and its temporal caches.
+ */
+static bool isStamped(const std::string& query) {
+	double stamp;
+	return rsg_bridge::TransformHistoryStore::getStamp(query, "timeStamp", stamp);
+}
+
+/*
+ * Decides once per query where it is processed. The order matters, as e.g. a
+ * GET_TRANSFORM query is also a read-only query.
+ */
+static int classify(struct rsg_json_query_info *inf, const std::string& query) {
+	if(boost::regex_search(query, accessStatisticsQueryPattern)) {
+		return ROUTE_ACCESS_STATISTICS;
+	} else if(rsg_bridge::SubscriptionRegistry::isSubscriptionMessage(query)) {
+		return ROUTE_SUBSCRIPTION;
+	} else if(rsg_bridge::ContinuousQueryRegistry::isContinuousQueryMessage(query)) {
+		return ROUTE_CONTINUOUS_QUERY;
+	} else if((inf->spatial_index != 0) && rsg_bridge::SpatialIndex::isSpatialQuery(query)) {
+		return ROUTE_SPATIAL;
+	} else if((inf->transform_history != 0) && (rsg_bridge::TransformHistoryStore::isHistoryQuery(query) || rsg_bridge::TransformHistoryStore::isTransformQuery(query))) {
+		return ROUTE_TRANSFORM_HISTORY;
+	} else if(rsg_bridge::TransformBatchQuery::isBatchQuery(query)) {
+		return ROUTE_TRANSFORM_BATCH;
+	} else if((inf->transform_cache != 0) && rsg_bridge::TransformCache::isTransformQuery(query)) {
+		return ROUTE_TRANSFORM_CACHE;
+	} else if(boost::regex_search(query, statisticsQueryPattern)) {
+		return ROUTE_STATISTICS;
+	} else if((inf->query_cache != 0) && rsg_bridge::QueryResultCache::isCacheable(query)) {
+		return ROUTE_QUERY_CACHE;
+	} else if(boost::regex_search(query, readOnlyQueryPattern) && (inf->wm_versions != 0)) {
+		return ROUTE_READ_ONLY_VERSION;
+	} else if(boost::regex_search(query, readOnlyQueryPattern)) {
+		return ROUTE_READ_ONLY;
+	}
+	return ROUTE_UPDATE;
+}
+
+/*
+ * Processes a query with the handler and the lock of its route. The runners belong to the calling thread.
+ */
+static void execute(struct rsg_json_query_info *inf, rsg_json_query_runners* runners, int route, std::string& query, std::string& result) {
+	switch (route) {
+	case ROUTE_ACCESS_STATISTICS:
+		getAccessStatistics(inf->wm_access, query, result);
+		break;
+	case ROUTE_SUBSCRIPTION:
+		rsg_bridge::SubscriptionRegistry::get(inf->wm)->handleMessage(query, result); // no lock on the world model required
+		break;
+	case ROUTE_CONTINUOUS_QUERY:
+		handleContinuousQuery(inf, query, result);
+		break;
+	case ROUTE_SPATIAL: {
+		rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+		inf->spatial_index->handleQuery(query, result);
+		break;
+	}
+	case ROUTE_TRANSFORM_HISTORY:
+		if(rsg_bridge::TransformHistoryStore::isTransformQuery(query)) {
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access); // the paths to the root are taken from the World Model
+			if(!inf->transform_history->handleTransformQuery(query, result)) {
+				runners->live->query(query, result); // e.g. an unknown node
+			}
+		} else if(rsg_bridge::TransformHistoryStore::hasReferenceNode(query)) {
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+			inf->transform_history->handleQuery(query, result);
+		} else {
+			inf->transform_history->handleQuery(query, result); // the store has its own lock
+		}
+		break;
+	case ROUTE_TRANSFORM_BATCH:
+		if((inf->wm_versions != 0) && !isStamped(query)) {
+			unsigned int version = inf->wm_versions->pin(); // no lock on the world model required
+			rsg_bridge::TransformBatchQuery::handleQuery(inf->wm_versions->getVersion(version), query, result);
+			inf->wm_versions->unpin(version);
+		} else {
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+			rsg_bridge::TransformBatchQuery::handleQuery(inf->wm, query, result);
+		}
+		break;
+	case ROUTE_TRANSFORM_CACHE:
+		if(!inf->transform_cache->lookup(query, result)) { // a hit needs no lock on the world model
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access); // live world model, as versions may lag behind the invalidations
+			runners->live->query(query, result);
+			inf->transform_cache->insert(query, result);
+		}
+		break;
+	case ROUTE_STATISTICS:
+		getStatistics(inf, query, result);
+		break;
+	case ROUTE_QUERY_CACHE:
+		if(!inf->query_cache->lookup(query, result)) { // a hit needs no lock on the world model
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access); // live world model, so the versions belong to the reply
+			runners->live->query(query, result);
+			inf->query_cache->insert(query, result);
+		}
+		break;
+	case ROUTE_READ_ONLY_VERSION: {
+		if(isStamped(query)) { // checked here, as a prepared query gets its stamp on execution
+			rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+			runners->live->query(query, result);
+			break;
+		}
+		unsigned int version = inf->wm_versions->pin(); // no lock on the world model required
+		runners->versions[version]->query(query, result);
+		inf->wm_versions->unpin(version);
+		break;
+	}
+	case ROUTE_READ_ONLY: {
+		rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+		runners->live->query(query, result);
+		break;
+	}
+	default: {
+		rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+		runners->live->query(query, result);
+		break;
+	}
+	}
+}
+
+/*
+ * Processes any incoming message: prepared queries, queries and updates.
+ */
+static void process(struct rsg_json_query_info *inf, rsg_json_query_runners* runners, std::string& query, std::string& result) {
+	if(rsg_bridge::PreparedQueryRegistry::isPreparedQueryMessage(query)) {
+		if(rsg_bridge::PreparedQueryRegistry::isExecution(query)) {
+			std::string preparedQuery;
+			int route;
+			if(inf->prepared_queries->expand(query, preparedQuery, route, result)) {
+				execute(inf, runners, route, preparedQuery, result); // no classification required
+			}
+		} else {
+			inf->prepared_queries->handleMessage(query, boost::bind(&classify, inf, _1), result);
+		}
+	} else {
+		execute(inf, runners, classify(inf, query), query, result);
+	}
+}
+
+#ifdef USE_ZMQ
+/*
+ * Handler of the query_server, called concurrently by its workers.
+ */
+static void serveQuery(struct rsg_json_query_info *inf, unsigned int worker, std::string& query, std::string& result) {
+	process(inf, (*inf->worker_runners)[worker], query, result);
+}
+#endif
+
+/*
+ * Handler of the shm_server, called by its thread.
+ */
+static void serveShmQuery(struct rsg_json_query_info *inf, std::string& query, std::string& result) {
+	process(inf, inf->shm_runners, query, result);
+}
+
+/*
+ * Processes a typed request with the same locks as the corresponding RSG-JSON message.
+ */
+static void processTyped(struct rsg_json_query_info *inf, const rsg_typed_request& request, rsg_typed_reply& reply) {
+	if(rsg_bridge::TypedQuery::isUpdate(request)) {
+		rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+		rsg_bridge::TypedQuery::update(inf->wm, inf->constraint_filter, request, reply); // same filter as for RSG-JSON updates
+	} else if(inf->wm_versions != 0) {
+		unsigned int version = inf->wm_versions->pin(); // no lock on the world model required
+		rsg_bridge::TypedQuery::query(inf->wm_versions->getVersion(version), request, reply);
+		inf->wm_versions->unpin(version);
+	} else {
+		rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+		rsg_bridge::TypedQuery::query(inf->wm, request, reply);
+	}
+}
+
+/*
+ * Reads the pending typed requests and writes a reply for each.
+ */
+static void processTypedRequests(struct rsg_json_query_info *inf) {
+	ubx_port_t* port = inf->ports.typed_query;
+	ubx_port_t* result_port = inf->ports.typed_result;
+	assert(port != 0);
+	assert(result_port != 0);
+	checktype(port->block->ni, port->in_type, "struct rsg_typed_request", port->name, 1);
+
+	rsg_typed_request request;
+	rsg_typed_reply reply;
+	for (unsigned int i = 0; i < MAX_TYPED_REQUESTS_PER_STEP; ++i) {
+		ubx_data_t msg;
+		msg.type = port->in_type;
+		msg.len = 1;
+		msg.data = (void *)&request;
+		if(__port_read(port, &msg) <= 0) {
+			break; // nothing pending or not connected
+		}
+		processTyped(inf, request, reply);
+
+		ubx_data_t msg_result;
+		msg_result.data = (void *)&reply;
+		msg_result.len = 1;
+		msg_result.type = result_port->out_type;
+		__port_write(result_port, &msg_result);
+	}
+}
+
 /* step */
 void rsg_json_query_step(ubx_block_t *b)
 {
@@ -245,7 +798,7 @@ void rsg_json_query_step(ubx_block_t *b)
 			/*
 			 * process query
 			 */
-			inf->wm_query_runner->query(query, result);
+			process(inf, inf->runners, query, result);
 
 			/*
 			 * write data
@@ -277,6 +830,8 @@ void rsg_json_query_step(ubx_block_t *b)
 			//LOG(DEBUG) << "Incoming update has not enough data to be processed. Aborting this update.";
 		}
 
+		processTypedRequests(inf);
+
 
 
 }
@@ -5,8 +5,12 @@
 #include <ubx.h>
 
 /* includes types and type metadata */
+#include "util/TypedQuery.h"
+#include "types/rsg_typed_query.h.hexarr"
 
 ubx_type_t types[] = {
+        def_struct_type(struct rsg_typed_request, &rsg_typed_query_h),
+        def_struct_type(struct rsg_typed_reply, &rsg_typed_query_h),
         { NULL },
 };
 
@@ -22,6 +26,17 @@ ubx_config_t rsg_json_query_config[] = {
     	{ .name="buffer_len", .type_name = "uint32_t", .doc="Maximum number of data elements the of the input buffer." },
         { .name="log_level", .type_name = "int", .doc="Set the log level: LOGDEBUG = 0, INFO = 1, WARNING = 2, LOGERROR = 3, FATAL = 4" },
         { .name="store_log_files", .type_name = "int", .doc="If store_log_files is set to true (=1), the log messages will be stored in a .log file. For debugging only, can degenerate system performance." },
+        { .name="snapshot_reads", .type_name = "int", .doc="If true (=1) queries (RSGQuery) are answered on a pinned copy of the world model, so they never block incoming updates. Default is 0." },
+        { .name="spatial_index", .type_name = "int", .doc="If true (=1) an index over the geo-located Transforms below the gis:origin node answers GET_NODES_IN_BOX, GET_NODES_IN_POLYGON and GET_NEAREST_NODES queries. Default is 0." },
+        { .name="spatial_index_cell_size", .type_name = "double", .doc="Cell size of the spatial index in units of the gis:origin frame. Default is 0.001 (degrees for wgs84, approx. 100 m)." },
+        { .name="transform_cache", .type_name = "int", .doc="If true (=1) the replies of GET_TRANSFORM queries are cached until a Transform on the path is updated. Default is 0." },
+        { .name="transform_cache_bucket", .type_name = "double", .doc="Queries with TimeStampUTCms stamps within the same bucket of this duration in [s] share a cache entry. Default is 0.1." },
+        { .name="query_cache", .type_name = "int", .doc="If true (=1) the replies of polled read-only queries like GET_NODES are cached until a node they touched changes. Hit rates via GET_STATS. Default is 0." },
+        { .name="transform_history", .type_name = "int", .doc="If true (=1) the samples of all Transforms are additionally kept in compact ring buffers to answer GET_TRANSFORM_HISTORY and stamped GET_TRANSFORM queries. Give the Transforms a small tf:max_duration, so the World Model does not keep the same samples. Default is 0." },
+        { .name="transform_history_capacity", .type_name = "uint32_t", .doc="Number of samples kept per Transform. Default is 1000." },
+        { .name="server_endpoint", .type_name = "char", .doc="Optional ZMQ endpoint, e.g. tcp://*:22423. If set, a ROUTER socket serves queries of many clients in parallel, in addition to the rsq_query port." },
+        { .name="query_workers", .type_name = "int", .doc="Number of threads that process the queries of the server_endpoint. Default is 4." },
+        { .name="shm_segment", .type_name = "char", .doc="Optional name of a shared memory segment, e.g. /swm_query. Clients on the same computer send queries and updates via lock-free rings in it and get the replies the same way." },
     	{ NULL },
 };
 
@@ -29,6 +44,8 @@ ubx_config_t rsg_json_query_config[] = {
 ubx_port_t rsg_json_query_ports[] = {
         { .name="rsq_query", .in_type_name="unsigned char", .doc="JSON based byte stream for queries on RSG based world model."  },
         { .name="rsg_result", .out_type_name="unsigned char", .out_data_len=1, .doc="JSON based data stream for query results for RSG based world model."  },
+        { .name="typed_query", .in_type_name="struct rsg_typed_request", .doc="Optional typed queries and updates of function blocks in the same process. No JSON is involved."  },
+        { .name="typed_result", .out_type_name="struct rsg_typed_reply", .out_data_len=1, .doc="Replies to the typed_query port, with the request_id of the request."  },
         { NULL },
 };
 
@@ -36,6 +53,8 @@ ubx_port_t rsg_json_query_ports[] = {
 struct rsg_json_query_port_cache {
         ubx_port_t* rsq_query;
         ubx_port_t* rsg_result;
+        ubx_port_t* typed_query;
+        ubx_port_t* typed_result;
 };
 
 /* declare a helper function to update the port cache this is necessary
@@ -47,6 +66,8 @@ static void update_port_cache(ubx_block_t *b, struct rsg_json_query_port_cache *
 {
         pc->rsq_query = ubx_port_get(b, "rsq_query");
         pc->rsg_result = ubx_port_get(b, "rsg_result");
+        pc->typed_query = ubx_port_get(b, "typed_query");
+        pc->typed_result = ubx_port_get(b, "typed_result");
 }
 
 
@@ -3,6 +3,12 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
+/* Updates of co-located clients via shared memory */
+#include "util/ShmServer.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/worldModel/WorldModel.h>
@@ -13,6 +19,9 @@
 #include <brics_3d/worldModel/sceneGraph/UpdatesToSceneGraphListener.h>
 #include <brics_3d/worldModel/sceneGraph/RemoteRootNodeAutoMounter.h>
 
+/* Boost includes */
+#include <boost/bind.hpp>
+
 using namespace brics_3d;
 using brics_3d::Logger;
 
@@ -29,12 +38,14 @@ struct rsg_json_reciever_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
 		brics_3d::rsg::JSONDeserializer* wm_deserializer;
 		brics_3d::rsg::SemanticContextUpdateFilter* wm_input_filter; // optional
 		brics_3d::rsg::GraphConstraintUpdateFilter* constraint_filter; // Supersedes the wm_input_filter
 		brics_3d::rsg::UpdatesToSceneGraphListener* wm_updates_to_wm; // optional
 		brics_3d::rsg::RemoteRootNodeAutoMounter* wm_auto_mounter;
+		rsg_bridge::ShmServer* shm_server; // optional, for clients on the same computer
 
         /* this is to have fast access to ports for reading and writing, without
          * needing a hash table lookup */
@@ -51,6 +62,15 @@ struct rsg_json_reciever_info
 
 };
 
+/*
+ * Handler of the shm_server. Updates are not answered, as for the rsg_in port.
+ */
+static void receiveUpdate(struct rsg_json_reciever_info *inf, std::string& message, std::string& reply) {
+	int transferred_bytes;
+	rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // also serializes the use of the deserializer with the step function
+	inf->wm_deserializer->write(message.c_str(), static_cast<int>(message.size()), transferred_bytes);
+}
+
 /* init */
 int rsg_json_reciever_init(ubx_block_t *b)
 {
@@ -81,6 +101,7 @@ int rsg_json_reciever_init(ubx_block_t *b)
     					  "Please check your system design if this is intended!";
     		inf->wm = new brics_3d::WorldModel();
         }
+        inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
         bool inputFilterIsEnabled = false;
         int* enable_input_filter =  ((int*) ubx_config_get_data_ptr(b, "enable_input_filter", &clen));
@@ -186,13 +207,22 @@ int rsg_json_reciever_init(ubx_block_t *b)
           return 0;
         }
 
+        /* Optionally receive updates of clients on the same computer via shared memory */
+        char* shm_segment = (char*) ubx_config_get_data_ptr(b, "shm_segment", &clen);
+        if((clen == 0) || (strcmp(shm_segment, "") == 0)) {
+        	LOG(INFO) << "rsg_json_reciever: No shm_segment configuration given. Turned off by default.";
+        } else {
+        	LOG(INFO) << "rsg_json_reciever: shm_segment = " << shm_segment;
+        	inf->shm_server = new rsg_bridge::ShmServer(std::string(shm_segment), boost::bind(&receiveUpdate, inf, _1, _2));
+        }
+
         return 0;
 }
 
 /* start */
 int rsg_json_reciever_start(ubx_block_t *b)
 {
-        /* struct rsg_json_reciever_info *inf = (struct rsg_json_reciever_info*) b->private_data; */
+        struct rsg_json_reciever_info *inf = (struct rsg_json_reciever_info*) b->private_data;
         int ret = 0;
     	unsigned int clen;
 
@@ -256,19 +286,32 @@ int rsg_json_reciever_start(ubx_block_t *b)
     			LOG(INFO) << "rsg_json_reciever: unknown log_level = " << *log_level;		}
     	}
 
+    	if((inf->shm_server != 0) && !inf->shm_server->start()) {
+    		LOG(ERROR) << "rsg_json_reciever: Cannot start the shared memory server.";
+    		ret = -1;
+    	}
+
         return ret;
 }
 
 /* stop */
 void rsg_json_reciever_stop(ubx_block_t *b)
 {
-        /* struct rsg_json_reciever_info *inf = (struct rsg_json_reciever_info*) b->private_data; */
+        struct rsg_json_reciever_info *inf = (struct rsg_json_reciever_info*) b->private_data;
+        if(inf->shm_server != 0) {
+        	inf->shm_server->stop();
+        	LOG(INFO) << "rsg_json_reciever: " << inf->shm_server->getStatisticsAsString();
+        }
 }
 
 /* cleanup */
 void rsg_json_reciever_cleanup(ubx_block_t *b)
 {
 		struct rsg_json_reciever_info *inf = (struct rsg_json_reciever_info*) b->private_data;
+		if(inf->shm_server != 0) {
+			delete inf->shm_server;
+			inf->shm_server = 0;
+		}
 		if(inf->wm_input_filter != 0) {
 			delete inf->wm_input_filter;
 			inf->wm_input_filter = 0;
@@ -310,6 +353,7 @@ void rsg_json_reciever_step(ubx_block_t *b)
 		int transferred_bytes;
 		if ((dataBuffer!=0) && (msg.len > 1) && (readBytes > 1)) {
 			LOG(INFO) << dataBuffer;
+			rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
 			inf->wm_deserializer->write(dataBuffer, readBytes, transferred_bytes);
 			LOG(INFO) << "rsg_json_reciever: \t transferred_bytes = " << transferred_bytes;
 		} else if (dataBuffer == 0) {
@@ -3,6 +3,24 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
+/* Priority lanes for outgoing updates */
+#include "util/PriorityLaneScheduler.h"
+
+/* Latest-value-wins rate limit for Transform updates */
+#include "util/CoalescingTransformFilter.h"
+
+/* Selective replication to subscribed peers */
+#include "util/SubscriptionRouter.h"
+
+/* Results of continuous queries (registered by rsg_json_query) */
+#include "util/ContinuousQueryRegistry.h"
+
+/* Batching and rate limits for monitor messages */
+#include "util/MonitorBatcher.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/worldModel/WorldModel.h>
@@ -27,12 +45,24 @@ UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
  */
 class RsgToUbxPort : public brics_3d::rsg::IOutputPort {
 public:
-	RsgToUbxPort(ubx_port_t* port, ubx_type_t* type) : port(port), type(type){};
+	/**
+	 * @param fallbackPort Optional port that is used instead of port, as long as port is not connected.
+	 * @param fallbackOutput Optional output that is used instead of port, as long as port is not connected. Not owned.
+	 */
+	RsgToUbxPort(ubx_port_t* port, ubx_type_t* type, ubx_port_t* fallbackPort = 0, brics_3d::rsg::IOutputPort* fallbackOutput = 0) :
+		port(port), type(type), fallbackPort(fallbackPort), fallbackOutput(fallbackOutput){};
 	virtual ~RsgToUbxPort(){};
 
 	int write(const char *dataBuffer, int dataLength, int &transferredBytes) {
 		LOG(DEBUG) << "RsgToUbxPort: Feeding data forwards.";
 		assert(port != 0);
+		ubx_port_t* targetPort = port;
+		if(fallbackOutput != 0 && (port->out_interaction == 0 || port->out_interaction[0] == 0)) {
+			return fallbackOutput->write(dataBuffer, dataLength, transferredBytes);
+		}
+		if(fallbackPort != 0 && (port->out_interaction == 0 || port->out_interaction[0] == 0)) {
+			targetPort = fallbackPort;
+		}
 
 		ubx_data_t msg;
 		msg.data = (void *)dataBuffer;
@@ -41,7 +71,7 @@ public:
 
 		LOG(INFO) << "Sending " << msg.len << " bytes: ";
 		LOG(INFO) << (char*) msg.data; // We know that it is a string.
-		__port_write(port, &msg);
+		__port_write(targetPort, &msg);
 
 		return 0;
 	};
@@ -49,6 +79,8 @@ public:
 private:
 	ubx_port_t* port;
 	ubx_type_t* type;
+	ubx_port_t* fallbackPort;
+	brics_3d::rsg::IOutputPort* fallbackOutput;
 };
 
 /**
@@ -151,6 +183,7 @@ struct rsg_json_sender_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
 		brics_3d::rsg::SceneGraphToUpdatesTraverser* wm_resender;
 		brics_3d::rsg::FrequencyAwareUpdateFilter* frequency_filter;
@@ -158,6 +191,13 @@ struct rsg_json_sender_info
 		RemoteRootNodeAdditionTrigger* remote_root_trigger;
 		OnErrorTrigger* error_trigger;
 		TimeStamper* time_stamper;
+		rsg_bridge::CoalescingTransformFilter* transform_filter; // optional, in front of the constraint_filter
+		rsg_bridge::PriorityLaneScheduler* lane_scheduler; // optional, 0 if all updates go directly to rsg_out
+		RsgToUbxPort* lane_ports[rsg_bridge::LANE_COUNT];
+		rsg_bridge::SubscriptionRouter* subscription_router;
+		RsgToUbxPort* subscription_port;
+		rsg_bridge::MonitorBatcher* monitor_batcher; // in front of monitor_port
+		RsgToUbxPort* monitor_port; // falls back to the update output if monitor_out is not connected
 
         /* this is to have fast access to ports for reading and writing, without
          * needing a hash table lookup */
@@ -194,6 +234,7 @@ int rsg_json_sender_init(ubx_block_t *b)
     					  "Please check your system design if this is intended!";
     		inf->wm = new brics_3d::WorldModel();
     	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
 
     	/* Attach debug graph printer */
@@ -265,34 +306,95 @@ int rsg_json_sender_init(ubx_block_t *b)
     	}
 
 
+    	double maxFreq = 1.0;
     	float* max_freq =  ((float*) ubx_config_get_data_ptr(b, "max_freq", &clen));
     	if(clen == 0) {
-    		*max_freq = 1.0;
-    		LOG(WARNING) << "rsg_json_sender: No max_freq configuration given. Setting it to " << *max_freq;
+    		LOG(WARNING) << "rsg_json_sender: No max_freq configuration given. Setting it to " << maxFreq;
     	} else {
     		if (*max_freq <= 0) {
-    			*max_freq = 1.0;
-    			LOG(WARNING) << "rsg_json_sender: max_freq <= 0. Resetting it to " << *max_freq;
+    			LOG(WARNING) << "rsg_json_sender: max_freq <= 0. Resetting it to " << maxFreq;
+    	    } else {
+    	    	maxFreq = *max_freq;
     	    }
     	}
-		LOG(INFO) << "rsg_json_sender: max_freq = " << *max_freq;
+		LOG(INFO) << "rsg_json_sender: max_freq = " << maxFreq;
 
     	/* Attach filter */
     	inf->frequency_filter = new brics_3d::rsg::FrequencyAwareUpdateFilter();
     	inf->frequency_filter->setMaxGeometricNodeUpdateFrequency(0); // everything;
-    	inf->frequency_filter->setMaxTransformUpdateFrequency(*max_freq); // not more then x Hz;
+    	inf->frequency_filter->setMaxTransformUpdateFrequency(maxFreq); // not more then x Hz;
 
     	inf->constraint_filter = new brics_3d::rsg::GraphConstraintUpdateFilter(inf->wm);
 
     	/* Attach the UBX port to the world model */
     	ubx_type_t* type =  ubx_type_get(b->ni, "unsigned char");
-    	RsgToUbxPort* wmUpdatesUbxPort = new RsgToUbxPort(inf->ports.rsg_out, type);
+    	brics_3d::rsg::IOutputPort* wmUpdatesUbxPort = new RsgToUbxPort(inf->ports.rsg_out, type);
+
+    	/* Optional priority lanes: transforms and monitors are not queued behind bulk traffic */
+    	int* enable_priority_lanes =  ((int*) ubx_config_get_data_ptr(b, "enable_priority_lanes", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No enable_priority_lanes configuration given. Turned off by default.";
+    	} else if (*enable_priority_lanes == 1) {
+    		LOG(INFO) << "rsg_json_sender: enable_priority_lanes turned on.";
+    		inf->lane_scheduler = new rsg_bridge::PriorityLaneScheduler();
+    		inf->lane_ports[rsg_bridge::HIGH_LANE] = new RsgToUbxPort(inf->ports.rsg_out_high, type, inf->ports.rsg_out);
+    		inf->lane_ports[rsg_bridge::NORMAL_LANE] = new RsgToUbxPort(inf->ports.rsg_out, type);
+    		inf->lane_ports[rsg_bridge::BULK_LANE] = new RsgToUbxPort(inf->ports.rsg_out_bulk, type, inf->ports.rsg_out);
+    		for (int i = 0; i < rsg_bridge::LANE_COUNT; ++i) {
+    			inf->lane_scheduler->setLaneOutput(static_cast<rsg_bridge::PriorityLane>(i), inf->lane_ports[i]);
+    		}
+
+    		int* lane_weights =  ((int*) ubx_config_get_data_ptr(b, "lane_weights", &clen));
+    		if(clen == 0) {
+    			LOG(INFO) << "rsg_json_sender: No lane_weights configuration given. Using {16, 4, 1}.";
+    		} else if (clen != rsg_bridge::LANE_COUNT) {
+    			LOG(WARNING) << "rsg_json_sender: lane_weights needs " << rsg_bridge::LANE_COUNT << " values but " << clen << " are given. Using {16, 4, 1}.";
+    		} else {
+    			LOG(INFO) << "rsg_json_sender: lane_weights = {" << lane_weights[0] << ", " << lane_weights[1] << ", " << lane_weights[2] << "}";
+    			inf->lane_scheduler->setWeights(std::max(lane_weights[0], 1), std::max(lane_weights[1], 1), std::max(lane_weights[2], 1));
+    		}
+
+    		double maxBulkRate = 200;
+    		float* max_bulk_rate =  ((float*) ubx_config_get_data_ptr(b, "max_bulk_rate", &clen));
+    		if(clen == 0) {
+    			LOG(INFO) << "rsg_json_sender: No max_bulk_rate configuration given. Using default.";
+    		} else {
+    			maxBulkRate = *max_bulk_rate;
+    		}
+    		LOG(INFO) << "rsg_json_sender: max_bulk_rate = " << maxBulkRate;
+    		inf->lane_scheduler->setMaxBulkRate(maxBulkRate);
+
+    		wmUpdatesUbxPort = inf->lane_scheduler;
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: enable_priority_lanes turned off.";
+    	}
+
     	brics_3d::rsg::JSONSerializer* wmUpdatesToJSONSerializer = new brics_3d::rsg::JSONSerializer(inf->wm, wmUpdatesUbxPort);
 //    	inf->wm->scene.attachUpdateObserver(inf->frequency_filter);
-    	inf->wm->scene.attachUpdateObserver(inf->constraint_filter);
+    	bool coalesceTransforms = false;
+    	int* coalesce_transforms =  ((int*) ubx_config_get_data_ptr(b, "coalesce_transforms", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No coalesce_transforms configuration given. Turned off by default.";
+    	} else if (*coalesce_transforms == 1) {
+    		LOG(INFO) << "rsg_json_sender: coalesce_transforms turned on.";
+    		coalesceTransforms = true;
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: coalesce_transforms turned off.";
+    	}
+    	if(coalesceTransforms) { // Transform updates faster than max_freq are delayed rather than dropped
+    		inf->transform_filter = new rsg_bridge::CoalescingTransformFilter(inf->constraint_filter, maxFreq);
+    		inf->wm->scene.attachUpdateObserver(inf->transform_filter);
+    	} else {
+    		inf->wm->scene.attachUpdateObserver(inf->constraint_filter);
+    	}
 //    	inf->frequency_filter->attachUpdateObserver(wmUpdatesToJSONSerializer);
     	inf->constraint_filter->attachUpdateObserver(wmUpdatesToJSONSerializer);
 
+    	/* Updates for peers that subscribed to parts of the graph (registered by rsg_json_query) */
+    	inf->subscription_port = new RsgToUbxPort(inf->ports.rsg_out_subscriptions, type);
+    	inf->subscription_router = new rsg_bridge::SubscriptionRouter(inf->wm, rsg_bridge::SubscriptionRegistry::get(inf->wm), inf->subscription_port);
+    	inf->constraint_filter->attachUpdateObserver(inf->subscription_router);
+
     	/* Set error policy of RSG */
     	inf->wm->scene.setCallObserversEvenIfErrorsOccurred(false);
 
@@ -307,8 +409,46 @@ int rsg_json_sender_init(ubx_block_t *b)
     	inf->error_trigger = new OnErrorTrigger(b);
 //    	inf->wm->scene.attachErrorObserver(inf->error_trigger);
 
-    	/* Use sender port also for monitor messages */
-    	inf->wm->scene.setMonitorPort(wmUpdatesUbxPort);
+    	/* Monitor messages go via monitor_out, or along with the updates if it is not connected */
+    	inf->monitor_port = new RsgToUbxPort(inf->ports.monitor_out, type, 0, wmUpdatesUbxPort);
+    	inf->monitor_batcher = new rsg_bridge::MonitorBatcher(inf->monitor_port);
+
+    	float* monitor_batch_window =  ((float*) ubx_config_get_data_ptr(b, "monitor_batch_window", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No monitor_batch_window configuration given. Turned off by default.";
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: monitor_batch_window = " << *monitor_batch_window;
+    		inf->monitor_batcher->setWindow(*monitor_batch_window);
+    	}
+
+    	float* monitor_max_rate =  ((float*) ubx_config_get_data_ptr(b, "monitor_max_rate", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No monitor_max_rate configuration given. Turned off by default.";
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: monitor_max_rate = " << *monitor_max_rate;
+    		inf->monitor_batcher->setMaxRate(*monitor_max_rate);
+    	}
+
+    	uint32_t* monitor_max_batch_size =  ((uint32_t*) ubx_config_get_data_ptr(b, "monitor_max_batch_size", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No monitor_max_batch_size configuration given. Using default.";
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: monitor_max_batch_size = " << *monitor_max_batch_size;
+    		inf->monitor_batcher->setMaxBatchSize(*monitor_max_batch_size);
+    	}
+
+    	int* monitor_latest_only =  ((int*) ubx_config_get_data_ptr(b, "monitor_latest_only", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_json_sender: No monitor_latest_only configuration given. Turned off by default.";
+    	} else if (*monitor_latest_only == 1) {
+    		LOG(INFO) << "rsg_json_sender: monitor_latest_only turned on.";
+    		inf->monitor_batcher->setLatestOnly(true);
+    	} else {
+    		LOG(INFO) << "rsg_json_sender: monitor_latest_only turned off.";
+    	}
+
+    	inf->wm->scene.setMonitorPort(inf->monitor_batcher);
+    	rsg_bridge::ContinuousQueryRegistry::setOutputPort(inf->wm, inf->monitor_batcher); // also for a registry that is created later
 
     	/* Benchmark tool */
     	if(doBenchmark) {
@@ -339,10 +479,18 @@ int rsg_json_sender_init(ubx_block_t *b)
 /* start */
 int rsg_json_sender_start(ubx_block_t *b)
 {
-        /* struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data; */
+        struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data;
         int ret = 0;
     	unsigned int clen;
 
+    	if(inf->lane_scheduler) {
+    		inf->lane_scheduler->start();
+    	}
+    	inf->monitor_batcher->start();
+    	if(inf->transform_filter) {
+    		inf->transform_filter->start(inf->wm_access); // delayed Transform updates are sent in time without any step
+    	}
+
         /* Set up log file */
     	int* store_log_files =  ((int*) ubx_config_get_data_ptr(b, "store_log_files", &clen));
     	if(clen == 0) {
@@ -410,13 +558,31 @@ int rsg_json_sender_start(ubx_block_t *b)
 /* stop */
 void rsg_json_sender_stop(ubx_block_t *b)
 {
-        /* struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data; */
+        struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data;
+        if(inf->transform_filter) {
+        	inf->transform_filter->stop(); // before the lock, as the timer might wait for it
+        	rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+        	inf->transform_filter->flush(); // the latest poses are not lost
+        	LOG(INFO) << "rsg_json_sender: " << inf->transform_filter->getStatisticsAsString();
+        }
+        if(inf->subscription_router) {
+        	LOG(INFO) << "rsg_json_sender: " << inf->subscription_router->getStatisticsAsString();
+        }
+        if(inf->monitor_batcher) {
+        	inf->monitor_batcher->stop(); // pending batches are sent, before the lanes are stopped
+        	LOG(INFO) << "rsg_json_sender: " << inf->monitor_batcher->getStatisticsAsString();
+        }
+        if(inf->lane_scheduler) {
+        	LOG(INFO) << "rsg_json_sender: " << inf->lane_scheduler->getStatisticsAsString();
+        	inf->lane_scheduler->stop(); // updates are sent directly from now on
+        }
 }
 
 /* cleanup */
 void rsg_json_sender_cleanup(ubx_block_t *b)
 {
         struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data;
+        rsg_bridge::ContinuousQueryRegistry::setOutputPort(inf->wm, 0); // the port is deleted below
         if(inf->wm_printer) {
         	delete inf->wm_printer;
         	inf->wm_printer = 0;
@@ -429,6 +595,10 @@ void rsg_json_sender_cleanup(ubx_block_t *b)
         	delete inf->frequency_filter;
         	inf->frequency_filter = 0;
         }
+        if(inf->transform_filter){
+        	delete inf->transform_filter;
+        	inf->transform_filter = 0;
+        }
         if(inf->constraint_filter){
         	delete inf->constraint_filter;
         	inf->constraint_filter = 0;
@@ -445,6 +615,32 @@ void rsg_json_sender_cleanup(ubx_block_t *b)
         	delete inf->time_stamper;
         	inf->time_stamper = 0;
         }
+        if(inf->subscription_router){
+        	delete inf->subscription_router;
+        	inf->subscription_router = 0;
+        }
+        if(inf->subscription_port){
+        	delete inf->subscription_port;
+        	inf->subscription_port = 0;
+        }
+        if(inf->monitor_batcher){
+        	delete inf->monitor_batcher;
+        	inf->monitor_batcher = 0;
+        }
+        if(inf->monitor_port){
+        	delete inf->monitor_port;
+        	inf->monitor_port = 0;
+        }
+        if(inf->lane_scheduler){
+        	delete inf->lane_scheduler;
+        	inf->lane_scheduler = 0;
+        }
+        for (int i = 0; i < rsg_bridge::LANE_COUNT; ++i) {
+        	if(inf->lane_ports[i]){
+        		delete inf->lane_ports[i];
+        		inf->lane_ports[i] = 0;
+        	}
+        }
         free(b->private_data);
 }
 
@@ -454,10 +650,24 @@ void rsg_json_sender_step(ubx_block_t *b)
 
         struct rsg_json_sender_info *inf = (struct rsg_json_sender_info*) b->private_data;
         brics_3d::WorldModel* wm = inf->wm;
+        {
+        	rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // advertising the root node calls all update observers
+
+        	/* Send the delayed Transform updates first, so they cannot overwrite the resent poses */
+        	if(inf->transform_filter) {
+        		inf->transform_filter->flush();
+        	}
+
+        	/* Resend the complete scene graph */
+        	LOG(INFO) << "rsg_json_sender: Resending the complete RSG now.";
+        	inf->wm->scene.advertiseRootNode(); // Make sure root node is always send; The graph traverser cannot handle this.
+        }
 
-        /* Resend the complete scene graph */
-        LOG(INFO) << "rsg_json_sender: Resending the complete RSG now.";
-        inf->wm->scene.advertiseRootNode(); // Make sure root node is always send; The graph traverser cannot handle this.
+        /*
+         * The traversal only needs the read lock: it excludes the update observers that use the
+         * same serializer and port (they run under the write lock), but not the query workers.
+         */
+        rsg_bridge::WorldModelReadLock lock(inf->wm_access);
         inf->wm_resender->reset();
         Id localRootId = wm->scene.getRootId();
         /*
@@ -493,7 +703,14 @@ void rsg_json_sender_step(ubx_block_t *b)
     		LOG(DEBUG) << "rsg_json_sender: using rootId = " << rootId << ", while localRootId = " << localRootId;
         }
 
+        if(inf->lane_scheduler) {
+        	inf->lane_scheduler->setBulkMode(true); // the resent graph must not delay pose updates
+        }
         wm->scene.executeGraphTraverser(inf->wm_resender, rootId); // Note: addRemoteRoot node is only forwarded once
+        if(inf->lane_scheduler) {
+        	inf->lane_scheduler->setBulkMode(false);
+        	LOG(INFO) << "rsg_json_sender: " << inf->lane_scheduler->getStatisticsAsString();
+        }
 
 }
 
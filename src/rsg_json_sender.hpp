@@ -27,20 +27,36 @@ ubx_config_t rsg_json_sender_config[] = {
     	{ .name="dot_name_prefix", .type_name = "char" , .doc="Optional prefix for stored dot files." },
         { .name="log_level", .type_name = "int", .doc="Set the log level: LOGDEBUG = 0, INFO = 1, WARNING = 2, LOGERROR = 3, FATAL = 4" },
         { .name="max_freq", .type_name = "float", .doc="Defines the maximum frequency for publishing Transform updates." },
+        { .name="coalesce_transforms", .type_name = "int", .doc="If true (=1), Transform updates that exceed max_freq are delayed and only the latest one is sent at the next allowed time, instead of dropping them. They are sent by a timer thread under the World Model lock. Default is 0." },
         { .name="store_log_files", .type_name = "int", .doc="If store_log_files is set to true (=1), the log messages will be stored in a .log file. For debugging only, can degenerate system performance." },
         { .name="store_hdf_files", .type_name = "int", .doc="If store_hdf_files is set to true (=1), all subsequent graph updates are stored in a .hdf5 file. A SWM can be recoverd from this file." },
+        { .name="enable_priority_lanes", .type_name = "int", .doc="If true (=1), updates are sorted into a high (transforms, monitors), normal (attributes, other updates) and bulk (geometry, OSM, resync) lane. The lanes are sent in weighted order by a separate thread. Default is 0." },
+        { .name="lane_weights", .type_name = "int", .doc="Array with the number of messages per scheduling round for the high, normal and bulk lane. Default is {16, 4, 1}." },
+        { .name="max_bulk_rate", .type_name = "float", .doc="Maximum number of bulk lane messages per second. 0 means unlimited. Default is 200." },
+        { .name="monitor_batch_window", .type_name = "float", .doc="Time window in [s] to collect monitor messages of the same monitorId into one RSGMonitorBatch. 0 means no batching. Default is 0." },
+        { .name="monitor_max_rate", .type_name = "float", .doc="Maximum number of monitor messages (or batches) per second and monitorId. 0 means unlimited. Default is 0." },
+        { .name="monitor_latest_only", .type_name = "int", .doc="If true (=1), only the latest pending monitor message per monitorId is sent. Default is 0." },
+        { .name="monitor_max_batch_size", .type_name = "uint32_t", .doc="Maximum size of an RSGMonitorBatch in bytes. Larger batches are split. Should not exceed the element size of the connected buffer and the message length of the transport. Default is 90000." },
         { NULL },
 };
 
 /* declaration port block ports */
 ubx_port_t rsg_json_sender_ports[] = {
         { .name="rsg_out", .out_type_name="unsigned char", .out_data_len=1, .doc="JSON based data stream for updates for RSG based world model."  },
+        { .name="rsg_out_high", .out_type_name="unsigned char", .out_data_len=1, .doc="Optional port for the high priority lane. If not connected, the messages are sent via rsg_out."  },
+        { .name="rsg_out_bulk", .out_type_name="unsigned char", .out_data_len=1, .doc="Optional port for the bulk lane. If not connected, the messages are sent via rsg_out."  },
+        { .name="rsg_out_subscriptions", .out_type_name="unsigned char", .out_data_len=1, .doc="Updates for subscribed peers as RSGSubscriptionUpdate envelopes with the subscriberId."  },
+        { .name="monitor_out", .out_type_name="unsigned char", .out_data_len=1, .doc="Optional port for monitor messages and batches. If not connected, they are sent along with the updates via rsg_out."  },
         { NULL },
 };
 
 /* declare a struct port_cache */
 struct rsg_json_sender_port_cache {
         ubx_port_t* rsg_out;
+        ubx_port_t* rsg_out_high;
+        ubx_port_t* rsg_out_bulk;
+        ubx_port_t* rsg_out_subscriptions;
+        ubx_port_t* monitor_out;
 };
 
 /* declare a helper function to update the port cache this is necessary
@@ -51,6 +67,10 @@ struct rsg_json_sender_port_cache {
 static void update_port_cache(ubx_block_t *b, struct rsg_json_sender_port_cache *pc)
 {
         pc->rsg_out = ubx_port_get(b, "rsg_out");
+        pc->rsg_out_high = ubx_port_get(b, "rsg_out_high");
+        pc->rsg_out_bulk = ubx_port_get(b, "rsg_out_bulk");
+        pc->rsg_out_subscriptions = ubx_port_get(b, "rsg_out_subscriptions");
+        pc->monitor_out = ubx_port_get(b, "monitor_out");
 }
 
 
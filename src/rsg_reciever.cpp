@@ -3,6 +3,9 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/worldModel/WorldModel.h>
@@ -26,6 +29,7 @@ struct rsg_reciever_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
 		brics_3d::rsg::HDF5UpdateDeserializer* wm_deserializer;
 		brics_3d::rsg::RemoteRootNodeAutoMounter* wm_auto_mounter;
@@ -75,6 +79,7 @@ int rsg_reciever_init(ubx_block_t *b)
     					  "Please check your system design if this is intended!";
     		inf->wm = new brics_3d::WorldModel();
         }
+        inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
         /* Attach debug graph printer */
         inf->wm_printer = new brics_3d::rsg::DotVisualizer(&inf->wm->scene);
@@ -178,6 +183,7 @@ void rsg_reciever_step(ubx_block_t *b)
 		const char *dataBuffer = (char *)msg.data;
 		int transferred_bytes;
 		if ((dataBuffer!=0) && (msg.len > 1) && (readBytes > 1)) {
+			rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
 			inf->wm_deserializer->write(dataBuffer, readBytes, transferred_bytes);
 			LOG(INFO) << "rsg_reciever: \t transferred_bytes = " << transferred_bytes;
 		} else if (dataBuffer == 0) {
@@ -0,0 +1,459 @@
+#include "rsg_replay.hpp"
+
+/* microblx type for the robot scene graph */
+#include "types/rsg/types/rsg_types.h"
+
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
+/* BRICS_3D includes */
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/HDF5UpdateDeserializer.h>
+
+/* HDF5 includes */
+#include <hdf5.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <sys/resource.h>
+
+using namespace brics_3d;
+using brics_3d::Logger;
+
+
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
+
+/* Name of the group that carries a single update within a HDF5 message as
+ * it is created by the HDF5UpdateSerializer. Each top level group of a
+ * recording (HDF5AppendOnlyLogger) holds one such update. */
+#define RSG_HDF5_UPDATE_GROUP_NAME "Scenegraph"
+
+/* Attribute that stores the time stamp of an update in seconds. The
+ * HDF5UpdateSerializer attaches it to the payload of time stamped updates
+ * (Transforms, geometric nodes, Connections), i.e. to the update group
+ * or to one of its sub groups. Used for pacing if speed_factor > 0. */
+#define RSG_HDF5_TIME_STAMP_ATTRIBUTE_NAME "timeStamp"
+
+/*
+ * Helper to get a monotonic time in seconds.
+ */
+static double replayNow() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Helper to compare group names like "Update-2" and "Update-10" by their
+ * trailing number. Used when the recording does not track the creation order.
+ */
+static bool naturalLess(const std::string& a, const std::string& b) {
+	std::string::size_type aPos = a.find_last_not_of("0123456789");
+	std::string::size_type bPos = b.find_last_not_of("0123456789");
+	std::string aPrefix = a.substr(0, aPos + 1);
+	std::string bPrefix = b.substr(0, bPos + 1);
+	if ((aPrefix != bPrefix) || (aPos + 1 == a.size()) || (bPos + 1 == b.size())) {
+		return a < b;
+	}
+	return atol(a.c_str() + aPos + 1) < atol(b.c_str() + bPos + 1);
+}
+
+static herr_t collectGroupName(hid_t group, const char* name, const H5L_info_t* info, void* data) {
+	hid_t object = H5Oopen(group, name, H5P_DEFAULT);
+	if (object >= 0) {
+		if (H5Iget_type(object) == H5I_GROUP) {
+			reinterpret_cast<std::vector<std::string>* >(data)->push_back(std::string(name));
+		}
+		H5Oclose(object);
+	}
+	return 0;
+}
+
+/* define a structure for holding the block local state. By assigning an
+ * instance of this struct to the block private_data pointer (see init), this
+ * information becomes accessible within the hook functions.
+ */
+struct rsg_replay_info
+{
+        /* add custom block local data here */
+		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
+		brics_3d::rsg::HDF5UpdateDeserializer* wm_deserializer;
+
+		hid_t recordingFile;
+		std::vector<std::string>* updateNames; // recorded updates in replay order
+		std::vector<unsigned char>* imageBuffer;
+		unsigned long nextUpdate;
+
+		double speedFactor;
+		unsigned int maxUpdatesPerStep;
+		bool applyToWm;
+
+		/* statistics */
+		unsigned long replayedUpdates;
+		unsigned long replayedBytes;
+		unsigned long failedUpdates;
+		double startTime;
+		double firstStamp;
+		double applyTimeTotal;
+		double applyTimeMin;
+		double applyTimeMax;
+		bool statsReported;
+
+        /* this is to have fast access to ports for reading and writing, without
+         * needing a hash table lookup */
+        struct rsg_replay_port_cache ports;
+};
+
+static herr_t findStampAttribute(hid_t object, const char* name, const H5O_info_t* info, void* data) {
+	if (H5Aexists_by_name(object, name, RSG_HDF5_TIME_STAMP_ATTRIBUTE_NAME, H5P_DEFAULT) <= 0) {
+		return 0; // continue
+	}
+	hid_t attribute = H5Aopen_by_name(object, name, RSG_HDF5_TIME_STAMP_ATTRIBUTE_NAME, H5P_DEFAULT, H5P_DEFAULT);
+	if (attribute < 0) {
+		return 0;
+	}
+	herr_t status = H5Aread(attribute, H5T_NATIVE_DOUBLE, data);
+	H5Aclose(attribute);
+	return (status >= 0) ? 1 : 0; // stop at the first stamp
+}
+
+/*
+ * Reads the time stamp of a recorded update from its payload. Returns false if
+ * the update has none, e.g. for added groups or attribute updates.
+ */
+static bool getRecordedStamp(struct rsg_replay_info* inf, const std::string& updateName, double& stamp) {
+	hid_t update = H5Oopen(inf->recordingFile, updateName.c_str(), H5P_DEFAULT);
+	if (update < 0) {
+		return false;
+	}
+	herr_t status = H5Ovisit(update, H5_INDEX_NAME, H5_ITER_INC, findStampAttribute, &stamp);
+	H5Oclose(update);
+	return status > 0;
+}
+
+/*
+ * Converts a single recorded update into the byte stream format as it is
+ * produced by the HDF5UpdateSerializer. The group is copied into an in-memory
+ * file and the file image is handed out.
+ */
+static bool getUpdateImage(struct rsg_replay_info* inf, const std::string& updateName) {
+	bool success = false;
+	hid_t accessProperties = H5Pcreate(H5P_FILE_ACCESS);
+	H5Pset_fapl_core(accessProperties, 1024, 0); // no backing store
+	hid_t imageFile = H5Fcreate("rsg_replay_image.h5", H5F_ACC_TRUNC, H5P_DEFAULT, accessProperties);
+	H5Pclose(accessProperties);
+	if (imageFile < 0) {
+		LOG(ERROR) << "rsg_replay: Cannot create an in-memory HDF5 file.";
+		return false;
+	}
+
+	if (H5Ocopy(inf->recordingFile, updateName.c_str(), imageFile, RSG_HDF5_UPDATE_GROUP_NAME, H5P_DEFAULT, H5P_DEFAULT) >= 0) {
+		H5Fflush(imageFile, H5F_SCOPE_GLOBAL);
+		ssize_t imageSize = H5Fget_file_image(imageFile, NULL, 0);
+		if (imageSize > 0) {
+			inf->imageBuffer->resize(imageSize);
+			success = (H5Fget_file_image(imageFile, &(*inf->imageBuffer)[0], imageSize) == imageSize);
+		}
+	} else {
+		LOG(ERROR) << "rsg_replay: Cannot copy recorded update " << updateName;
+	}
+
+	H5Fclose(imageFile);
+	return success;
+}
+
+/*
+ * Peak resident set size of this process in kB.
+ */
+static long getPeakMemory() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+	return usage.ru_maxrss;
+}
+
+static void reportStats(struct rsg_replay_info* inf) {
+	double elapsed = replayNow() - inf->startTime;
+	double avgApplyTime = 0;
+	if (inf->replayedUpdates > 0) {
+		avgApplyTime = inf->applyTimeTotal / inf->replayedUpdates;
+	}
+
+	LOG(INFO) << "rsg_replay: Statistics:";
+	LOG(INFO) << "rsg_replay: \t updates replayed   = " << inf->replayedUpdates << " of " << inf->updateNames->size()
+			  << " (" << inf->failedUpdates << " failed)";
+	LOG(INFO) << "rsg_replay: \t bytes replayed     = " << inf->replayedBytes;
+	LOG(INFO) << "rsg_replay: \t elapsed time [s]   = " << elapsed;
+	if (elapsed > 0) {
+		LOG(INFO) << "rsg_replay: \t throughput [1/s]   = " << inf->replayedUpdates / elapsed;
+		LOG(INFO) << "rsg_replay: \t throughput [B/s]   = " << inf->replayedBytes / elapsed;
+	}
+	LOG(INFO) << "rsg_replay: \t apply time [ms]    = min " << inf->applyTimeMin * 1000.0
+			  << " / avg " << avgApplyTime * 1000.0
+			  << " / max " << inf->applyTimeMax * 1000.0;
+	LOG(INFO) << "rsg_replay: \t peak memory [kB]   = " << getPeakMemory();
+	inf->statsReported = true;
+}
+
+/* init */
+int rsg_replay_init(ubx_block_t *b)
+{
+        int ret = -1;
+        struct rsg_replay_info *inf;
+
+    	/* Configure the logger - default level won't tell us much */
+    	brics_3d::Logger::setMinLoglevel(brics_3d::Logger::LOGDEBUG);
+
+        /* allocate memory for the block local state */
+        if ((inf = (struct rsg_replay_info*)calloc(1, sizeof(struct rsg_replay_info)))==NULL) {
+                ERR("rsg_replay: failed to alloc memory");
+                ret=EOUTOFMEM;
+                return -1;
+        }
+        b->private_data=inf;
+        update_port_cache(b, &inf->ports);
+
+    	unsigned int clen;
+    	rsg_wm_handle tmpWmHandle =  *((rsg_wm_handle*) ubx_config_get_data_ptr(b, "wm_handle", &clen));
+    	assert(clen != 0);
+    	inf->wm = reinterpret_cast<brics_3d::WorldModel*>(tmpWmHandle.wm); // We know that this pointer stores the world model type
+    	if(inf->wm == 0) {
+    		LOG(FATAL) << "rsg_replay: World model handle could not be initialized.";
+    		return -1;
+    	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
+
+    	/* Attach deserializer (invoked at step function) */
+    	inf->wm_deserializer = new brics_3d::rsg::HDF5UpdateDeserializer(inf->wm);
+    	inf->updateNames = new std::vector<std::string>();
+    	inf->imageBuffer = new std::vector<unsigned char>();
+    	inf->recordingFile = -1;
+
+    	/* open the recording */
+    	char* chrptr = (char*) ubx_config_get_data_ptr(b, "hdf_file", &clen);
+    	if(clen == 0) {
+    		LOG(FATAL) << "rsg_replay: No hdf_file configuation given.";
+    		return -1;
+    	}
+    	std::string fileName(chrptr);
+    	inf->recordingFile = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    	if(inf->recordingFile < 0) {
+    		LOG(FATAL) << "rsg_replay: Cannot open recording " << fileName;
+    		return -1;
+    	}
+
+    	/* Prefer the creation order. Otherwise fall back to names with a trailing update counter. */
+    	hsize_t index = 0;
+    	if (H5Literate(inf->recordingFile, H5_INDEX_CRT_ORDER, H5_ITER_INC, &index, collectGroupName, inf->updateNames) < 0) {
+    		LOG(DEBUG) << "rsg_replay: Recording does not track the creation order. Sorting updates by name.";
+    		inf->updateNames->clear();
+    		index = 0;
+    		H5Literate(inf->recordingFile, H5_INDEX_NAME, H5_ITER_INC, &index, collectGroupName, inf->updateNames);
+    		std::sort(inf->updateNames->begin(), inf->updateNames->end(), naturalLess);
+    	}
+    	LOG(INFO) << "rsg_replay: Recording " << fileName << " contains " << inf->updateNames->size() << " updates.";
+
+        return 0;
+}
+
+/* start */
+int rsg_replay_start(ubx_block_t *b)
+{
+        struct rsg_replay_info *inf = (struct rsg_replay_info*) b->private_data;
+        int ret = 0;
+
+    	/* Set logger level */
+    	unsigned int clen;
+    	int* log_level =  ((int*) ubx_config_get_data_ptr(b, "log_level", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_replay: No log_level configuation given.";
+    	} else {
+    		if (*log_level == 0) {
+    			LOG(INFO) << "rsg_replay: log_level set to DEBUG level.";
+    			brics_3d::Logger::setMinLoglevel(brics_3d::Logger::LOGDEBUG);
+    		} else if (*log_level == 1) {
+    			LOG(INFO) << "rsg_replay: log_level set to INFO level.";
+    			brics_3d::Logger::setMinLoglevel(brics_3d::Logger::INFO);
+    		} else if (*log_level == 2) {
+    			LOG(INFO) << "rsg_replay: log_level set to WARNING level.";
+    			brics_3d::Logger::setMinLoglevel(brics_3d::Logger::WARNING);
+    		} else if (*log_level == 3) {
+    			LOG(INFO) << "rsg_replay: log_level set to LOGERROR level.";
+    			brics_3d::Logger::setMinLoglevel(brics_3d::Logger::LOGERROR);
+    		} else if (*log_level == 4) {
+    			LOG(INFO) << "rsg_replay: log_level set to FATAL level.";
+    			brics_3d::Logger::setMinLoglevel(brics_3d::Logger::FATAL);
+    		} else {
+    			LOG(INFO) << "rsg_replay: unknown log_level = " << *log_level;		}
+    	}
+
+    	float* speed_factor =  ((float*) ubx_config_get_data_ptr(b, "speed_factor", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_replay: No speed_factor configuation given. Replaying as fast as possible.";
+    		inf->speedFactor = 0;
+    	} else {
+    		inf->speedFactor = *speed_factor;
+    		if (inf->speedFactor < 0) {
+    			LOG(WARNING) << "rsg_replay: Negative speed_factor given. Replaying as fast as possible.";
+    			inf->speedFactor = 0;
+    		}
+    		LOG(INFO) << "rsg_replay: speed_factor = " << inf->speedFactor;
+    	}
+
+    	uint32_t* max_updates_per_step =  ((uint32_t*) ubx_config_get_data_ptr(b, "max_updates_per_step", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_replay: No max_updates_per_step configuation given. Replaying without limit.";
+    		inf->maxUpdatesPerStep = 0;
+    	} else {
+    		inf->maxUpdatesPerStep = *max_updates_per_step;
+    		LOG(INFO) << "rsg_replay: max_updates_per_step = " << inf->maxUpdatesPerStep;
+    	}
+
+    	int* apply_to_wm =  ((int*) ubx_config_get_data_ptr(b, "apply_to_wm", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_replay: No apply_to_wm configuation given. Turned on by default.";
+    		inf->applyToWm = true;
+    	} else {
+    		inf->applyToWm = (*apply_to_wm == 1);
+    		LOG(INFO) << "rsg_replay: apply_to_wm turned " << (inf->applyToWm ? "on." : "off.");
+    	}
+
+    	/* Pacing needs time stamps. Do not silently fall back to full speed. */
+    	if(inf->speedFactor > 0) {
+    		double stamp;
+    		bool hasStamps = false;
+    		for(unsigned long i = 0; (i < inf->updateNames->size()) && !hasStamps; ++i) {
+    			hasStamps = getRecordedStamp(inf, (*inf->updateNames)[i], stamp);
+    		}
+    		if(!hasStamps) {
+    			LOG(FATAL) << "rsg_replay: speed_factor = " << inf->speedFactor << " requires time stamps, but the recording has none. Use speed_factor = 0 to replay it as fast as possible.";
+    			return -1;
+    		}
+    	}
+
+    	/* (re)start the replay */
+    	inf->nextUpdate = 0;
+    	inf->replayedUpdates = 0;
+    	inf->replayedBytes = 0;
+    	inf->failedUpdates = 0;
+    	inf->applyTimeTotal = 0;
+    	inf->applyTimeMin = 0;
+    	inf->applyTimeMax = 0;
+    	inf->firstStamp = -1;
+    	inf->statsReported = false;
+    	inf->startTime = replayNow();
+
+        return ret;
+}
+
+/* stop */
+void rsg_replay_stop(ubx_block_t *b)
+{
+        struct rsg_replay_info *inf = (struct rsg_replay_info*) b->private_data;
+        if(!inf->statsReported) {
+        	reportStats(inf);
+        }
+}
+
+/* cleanup */
+void rsg_replay_cleanup(ubx_block_t *b)
+{
+        struct rsg_replay_info *inf = (struct rsg_replay_info*) b->private_data;
+        if(inf->recordingFile >= 0) {
+        	H5Fclose(inf->recordingFile);
+        	inf->recordingFile = -1;
+        }
+        if(inf->wm_deserializer) {
+        	delete inf->wm_deserializer;
+        	inf->wm_deserializer = 0;
+        }
+        if(inf->updateNames) {
+        	delete inf->updateNames;
+        	inf->updateNames = 0;
+        }
+        if(inf->imageBuffer) {
+        	delete inf->imageBuffer;
+        	inf->imageBuffer = 0;
+        }
+        free(b->private_data);
+}
+
+/* step */
+void rsg_replay_step(ubx_block_t *b)
+{
+        struct rsg_replay_info *inf = (struct rsg_replay_info*) b->private_data;
+
+        if(inf->nextUpdate >= inf->updateNames->size()) {
+        	if(!inf->statsReported) {
+        		LOG(INFO) << "rsg_replay: Replay finished.";
+        		reportStats(inf);
+        	}
+        	return;
+        }
+
+        unsigned int updatesInThisStep = 0;
+        while(inf->nextUpdate < inf->updateNames->size()) {
+        	if((inf->maxUpdatesPerStep > 0) && (updatesInThisStep >= inf->maxUpdatesPerStep)) {
+        		break;
+        	}
+        	const std::string& updateName = (*inf->updateNames)[inf->nextUpdate];
+
+        	/* pacing with respect to the recorded time stamps */
+        	double stamp;
+        	if((inf->speedFactor > 0) && getRecordedStamp(inf, updateName, stamp)) {
+        		if(inf->firstStamp < 0) {
+        			inf->firstStamp = stamp;
+        		}
+        		double due = (stamp - inf->firstStamp) / inf->speedFactor;
+        		if(replayNow() - inf->startTime < due) {
+        			break; // not yet due, continue at next step
+        		}
+        	}
+
+        	if(!getUpdateImage(inf, updateName)) {
+        		inf->failedUpdates++;
+        		inf->nextUpdate++;
+        		continue;
+        	}
+        	const char* dataBuffer = reinterpret_cast<const char*>(&(*inf->imageBuffer)[0]);
+        	int dataLength = static_cast<int>(inf->imageBuffer->size());
+
+        	double applyTime = 0;
+        	if(inf->applyToWm) {
+        		int transferred_bytes = 0;
+        		rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+        		double applyStart = replayNow(); // without waiting for the lock
+        		inf->wm_deserializer->write(dataBuffer, dataLength, transferred_bytes);
+        		applyTime = replayNow() - applyStart;
+        	}
+
+        	/* forward the update to the rsg_out port */
+        	ubx_port_t* port = inf->ports.rsg_out;
+        	if(port != 0) {
+        		ubx_data_t msg;
+        		msg.data = (void *)dataBuffer;
+        		msg.len = dataLength;
+        		msg.type = ubx_type_get(b->ni, "unsigned char");
+        		__port_write(port, &msg);
+        	}
+
+        	if((inf->replayedUpdates == 0) || (applyTime < inf->applyTimeMin)) {
+        		inf->applyTimeMin = applyTime;
+        	}
+        	if(applyTime > inf->applyTimeMax) {
+        		inf->applyTimeMax = applyTime;
+        	}
+        	inf->applyTimeTotal += applyTime;
+        	inf->replayedUpdates++;
+        	inf->replayedBytes += dataLength;
+        	inf->nextUpdate++;
+        	updatesInThisStep++;
+        	LOG(DEBUG) << "rsg_replay: Replayed update " << updateName << " with " << dataLength << " bytes.";
+        }
+}
+
@@ -0,0 +1,115 @@
+/*
+ * rsg_replay microblx function block (autogenerated, don't edit)
+ */
+
+#include <ubx.h>
+
+/* includes types and type metadata */
+
+ubx_type_t types[] = {
+        { NULL },
+};
+
+/* block meta information */
+char rsg_replay_meta[] =
+        " { doc='A block that replays a recorded HDF5 update log (as written by the HDF5AppendOnlyLogger) into the Robot Scene Graph and reports the apply throughput.',"
+        "   real-time=false,"
+        "}";
+
+/* declaration of block configuration */
+ubx_config_t rsg_replay_config[] = {
+        { .name="wm_handle", .type_name = "struct rsg_wm_handle", .doc="Handle to the world wodel instance. This parameter is mandatory." },
+        { .name="hdf_file", .type_name = "char" , .doc="File name of the recorded .h5 update log. This parameter is mandatory." },
+        { .name="speed_factor", .type_name = "float", .doc="Replay speed w.r.t. the recorded time stamps. 1.0 = recorded speed, 2.0 = twice as fast. 0 (default) replays as fast as possible." },
+        { .name="max_updates_per_step", .type_name = "uint32_t", .doc="Maximum number of updates that are replayed within a single step. 0 (default) means no limit." },
+        { .name="apply_to_wm", .type_name = "int", .doc="If true (=1, default) every replayed update is applied to the world model. Otherwise updates are only forwarded to the rsg_out port." },
+        { .name="log_level", .type_name = "int", .doc="Set the log level: LOGDEBUG = 0, INFO = 1, WARNING = 2, LOGERROR = 3, FATAL = 4" },
+        { NULL },
+};
+
+/* declaration port block ports */
+ubx_port_t rsg_replay_ports[] = {
+        { .name="rsg_out", .out_type_name="unsigned char", .out_data_len=1, .doc="HDF5 based byte stream of the replayed updates. Can be connected to a rsg_reciever block."  },
+        { NULL },
+};
+
+/* declare a struct port_cache */
+struct rsg_replay_port_cache {
+        ubx_port_t* rsg_out;
+};
+
+/* declare a helper function to update the port cache this is necessary
+ * because the port ptrs can change if ports are dynamically added or
+ * removed. This function should hence be called after all
+ * initialization is done, i.e. typically in 'start'
+ */
+static void update_port_cache(ubx_block_t *b, struct rsg_replay_port_cache *pc)
+{
+        pc->rsg_out = ubx_port_get(b, "rsg_out");
+}
+
+
+/* for each port type, declare convenience functions to read/write from ports */
+//def_write_fun(write_rsg_out, unsigned char)
+
+/* block operation forward declarations */
+int rsg_replay_init(ubx_block_t *b);
+int rsg_replay_start(ubx_block_t *b);
+void rsg_replay_stop(ubx_block_t *b);
+void rsg_replay_cleanup(ubx_block_t *b);
+void rsg_replay_step(ubx_block_t *b);
+
+
+/* put everything together */
+ubx_block_t rsg_replay_block = {
+        .name = "rsg_replay",
+        .type = BLOCK_TYPE_COMPUTATION,
+        .meta_data = rsg_replay_meta,
+        .configs = rsg_replay_config,
+        .ports = rsg_replay_ports,
+
+        /* ops */
+        .init = rsg_replay_init,
+        .start = rsg_replay_start,
+        .stop = rsg_replay_stop,
+        .cleanup = rsg_replay_cleanup,
+        .step = rsg_replay_step,
+};
+
+
+/* rsg_replay module init and cleanup functions */
+int rsg_replay_mod_init(ubx_node_info_t* ni)
+{
+        DBG(" ");
+        int ret = -1;
+        ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++) {
+                if(ubx_type_register(ni, tptr) != 0) {
+                        goto out;
+                }
+        }
+
+        if(ubx_block_register(ni, &rsg_replay_block) != 0)
+                goto out;
+
+        ret=0;
+out:
+        return ret;
+}
+
+void rsg_replay_mod_cleanup(ubx_node_info_t *ni)
+{
+        DBG(" ");
+        const ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++)
+                ubx_type_unregister(ni, tptr->name);
+
+        ubx_block_unregister(ni, "rsg_replay");
+}
+
+/* declare module init and cleanup functions, so that the ubx core can
+ * find these when the module is loaded/unloaded */
+UBX_MODULE_INIT(rsg_replay_mod_init)
+UBX_MODULE_CLEANUP(rsg_replay_mod_cleanup)
@@ -0,0 +1,121 @@
+#include "rsg_retention.hpp"
+
+/* microblx type for the robot scene graph */
+#include "types/rsg/types/rsg_types.h"
+
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+#include "util/RetentionSweeper.h"
+
+/* BRICS_3D includes */
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/WorldModel.h>
+
+using namespace brics_3d;
+using brics_3d::Logger;
+
+
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
+
+#define DEFAULT_MAX_DELETIONS_PER_STEP 100
+
+/* define a structure for holding the block local state. By assigning an
+ * instance of this struct to the block private_data pointer (see init), this
+ * information becomes accessible within the hook functions.
+ */
+struct rsg_retention_info
+{
+        /* add custom block local data here */
+		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
+		rsg_bridge::RetentionSweeper* sweeper;
+
+		unsigned int maxDeletionsPerStep;
+
+        /* this is to have fast access to ports for reading and writing, without
+         * needing a hash table lookup */
+        struct rsg_retention_port_cache ports;
+};
+
+/* init */
+int rsg_retention_init(ubx_block_t *b)
+{
+        int ret = -1;
+        struct rsg_retention_info *inf;
+
+        /* allocate memory for the block local state */
+        if ((inf = (struct rsg_retention_info*)calloc(1, sizeof(struct rsg_retention_info)))==NULL) {
+                ERR("rsg_retention: failed to alloc memory");
+                ret=EOUTOFMEM;
+                return -1;
+        }
+        b->private_data=inf;
+        update_port_cache(b, &inf->ports);
+
+    	unsigned int clen;
+    	rsg_wm_handle tmpWmHandle =  *((rsg_wm_handle*) ubx_config_get_data_ptr(b, "wm_handle", &clen));
+    	assert(clen != 0);
+    	inf->wm = reinterpret_cast<brics_3d::WorldModel*>(tmpWmHandle.wm); // We know that this pointer stores the world model type
+    	if(inf->wm == 0) {
+    		LOG(FATAL) << "rsg_retention: World model handle could not be initialized.";
+    		return -1;
+    	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
+
+    	/* Index nodes from now on, even before the block is started */
+    	rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+    	inf->sweeper = new rsg_bridge::RetentionSweeper(inf->wm);
+
+        return 0;
+}
+
+/* start */
+int rsg_retention_start(ubx_block_t *b)
+{
+        struct rsg_retention_info *inf = (struct rsg_retention_info*) b->private_data;
+        int ret = 0;
+
+    	unsigned int clen;
+    	inf->maxDeletionsPerStep = DEFAULT_MAX_DELETIONS_PER_STEP;
+    	uint32_t* max_deletions_per_step =  ((uint32_t*) ubx_config_get_data_ptr(b, "max_deletions_per_step", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_retention: No max_deletions_per_step configuation given. Selecting a default.";
+    	} else if (*max_deletions_per_step > 0) {
+    		inf->maxDeletionsPerStep = *max_deletions_per_step;
+    	}
+    	LOG(INFO) << "rsg_retention: max_deletions_per_step = " << inf->maxDeletionsPerStep;
+
+        return ret;
+}
+
+/* stop */
+void rsg_retention_stop(ubx_block_t *b)
+{
+        struct rsg_retention_info *inf = (struct rsg_retention_info*) b->private_data;
+        if(inf->sweeper) {
+        	LOG(INFO) << "rsg_retention: " << inf->sweeper->getStatisticsAsString();
+        }
+}
+
+/* cleanup */
+void rsg_retention_cleanup(ubx_block_t *b)
+{
+        struct rsg_retention_info *inf = (struct rsg_retention_info*) b->private_data;
+        if(inf->sweeper) {
+        	rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // detaches from the scene
+        	delete inf->sweeper;
+        	inf->sweeper = 0;
+        }
+        free(b->private_data);
+}
+
+/* step */
+void rsg_retention_step(ubx_block_t *b)
+{
+        struct rsg_retention_info *inf = (struct rsg_retention_info*) b->private_data;
+
+        /* A bounded amount of work per step, so the write lock is held only briefly */
+        rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+        inf->sweeper->sweep(inf->maxDeletionsPerStep);
+}
+
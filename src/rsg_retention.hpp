@@ -0,0 +1,105 @@
+/*
+ * rsg_retention microblx function block (autogenerated, don't edit)
+ */
+
+#include <ubx.h>
+
+/* includes types and type metadata */
+
+ubx_type_t types[] = {
+        { NULL },
+};
+
+/* block meta information */
+char rsg_retention_meta[] =
+        " { doc='A block that enforces the retention policies (rsg:retention_policy attributes of the root node) of the Robot Scene Graph. Expired nodes are deleted with regular delete updates.',"
+        "   real-time=false,"
+        "}";
+
+/* declaration of block configuration */
+ubx_config_t rsg_retention_config[] = {
+        { .name="wm_handle", .type_name = "struct rsg_wm_handle", .doc="Handle to the world wodel instance. This parameter is mandatory." },
+        { .name="max_deletions_per_step", .type_name = "uint32_t", .doc="Maximum number of expired nodes that are deleted within a single step. The rest follows in the next steps. Default is 100." },
+        { NULL },
+};
+
+/* declaration port block ports */
+ubx_port_t rsg_retention_ports[] = {
+        { NULL },
+};
+
+/* declare a struct port_cache */
+struct rsg_retention_port_cache {
+};
+
+/* declare a helper function to update the port cache this is necessary
+ * because the port ptrs can change if ports are dynamically added or
+ * removed. This function should hence be called after all
+ * initialization is done, i.e. typically in 'start'
+ */
+static void update_port_cache(ubx_block_t *b, struct rsg_retention_port_cache *pc)
+{
+}
+
+
+/* block operation forward declarations */
+int rsg_retention_init(ubx_block_t *b);
+int rsg_retention_start(ubx_block_t *b);
+void rsg_retention_stop(ubx_block_t *b);
+void rsg_retention_cleanup(ubx_block_t *b);
+void rsg_retention_step(ubx_block_t *b);
+
+
+/* put everything together */
+ubx_block_t rsg_retention_block = {
+        .name = "rsg_retention",
+        .type = BLOCK_TYPE_COMPUTATION,
+        .meta_data = rsg_retention_meta,
+        .configs = rsg_retention_config,
+        .ports = rsg_retention_ports,
+
+        /* ops */
+        .init = rsg_retention_init,
+        .start = rsg_retention_start,
+        .stop = rsg_retention_stop,
+        .cleanup = rsg_retention_cleanup,
+        .step = rsg_retention_step,
+};
+
+
+/* rsg_retention module init and cleanup functions */
+int rsg_retention_mod_init(ubx_node_info_t* ni)
+{
+        DBG(" ");
+        int ret = -1;
+        ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++) {
+                if(ubx_type_register(ni, tptr) != 0) {
+                        goto out;
+                }
+        }
+
+        if(ubx_block_register(ni, &rsg_retention_block) != 0)
+                goto out;
+
+        ret=0;
+out:
+        return ret;
+}
+
+void rsg_retention_mod_cleanup(ubx_node_info_t *ni)
+{
+        DBG(" ");
+        const ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++)
+                ubx_type_unregister(ni, tptr->name);
+
+        ubx_block_unregister(ni, "rsg_retention");
+}
+
+/* declare module init and cleanup functions, so that the ubx core can
+ * find these when the module is loaded/unloaded */
+UBX_MODULE_INIT(rsg_retention_mod_init)
+UBX_MODULE_CLEANUP(rsg_retention_mod_cleanup)
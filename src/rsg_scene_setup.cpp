@@ -3,12 +3,31 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/core/HomogeneousMatrix44.h>
 #include <brics_3d/worldModel/WorldModel.h>
 #include <brics_3d/worldModel/sceneGraph/DotVisualizer.h>
 #include <brics_3d/worldModel/sceneGraph/JSONDeserializer.h>
+#include <brics_3d/worldModel/sceneGraph/SceneGraphToUpdatesTraverser.h>
+#include <brics_3d/worldModel/sceneGraph/UuidGenerator.h>
+
+/* Boost includes */
+#include <boost/thread.hpp>
+
+#include <algorithm>
+
+/* Snapshot format */
+#include "util/SnapshotReader.h"
+#include "util/LDJSONWriter.h"
+#include "util/JSONChunkSplitter.h"
+#include "util/SnapshotWriter.h"
+#include "util/StaticMapSegment.h"
+
+#define STATIC_MAP_MOUNT_TIMEOUT 5000 // [ms] default wait for a publisher that still loads the map; the step blocks meanwhile
 
 //#define GENERATED_SCENE_SETUP
 
@@ -54,6 +73,246 @@ private:
 
 
 
+/*
+ * Forwards the updates of a traversed private world model to the scene of the actual
+ * world model. The private root node is replaced by the actual root node, all other
+ * Ids are preserved.
+ */
+class ReRootingUpdateForwarder : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	ReRootingUpdateForwarder(brics_3d::rsg::ISceneGraphUpdate* scene, brics_3d::rsg::Id privateRootId, brics_3d::rsg::Id rootId) :
+		scene(scene), privateRootId(privateRootId), rootId(rootId) {};
+	virtual ~ReRootingUpdateForwarder(){};
+
+	bool addNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, bool forcedId = false) {
+		return scene->addNode(map(parentId), assignedId, attributes, true);
+	}
+	bool addGroup(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, bool forcedId = false) {
+		return scene->addGroup(map(parentId), assignedId, attributes, true);
+	}
+	bool addTransformNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return scene->addTransformNode(map(parentId), assignedId, attributes, transform, timeStamp, true);
+	}
+	bool addUncertainTransformNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, ITransformUncertainty::ITransformUncertaintyPtr uncertainty, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return scene->addUncertainTransformNode(map(parentId), assignedId, attributes, transform, uncertainty, timeStamp, true);
+	}
+	bool addGeometricNode(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, rsg::Shape::ShapePtr shape, rsg::TimeStamp timeStamp, bool forcedId = false) {
+		return scene->addGeometricNode(map(parentId), assignedId, attributes, shape, timeStamp, true);
+	}
+	bool addRemoteRootNode(rsg::Id rootId, vector<rsg::Attribute> attributes) {
+		return scene->addRemoteRootNode(rootId, attributes);
+	}
+	bool addConnection(rsg::Id parentId, rsg::Id& assignedId, vector<rsg::Attribute> attributes, vector<rsg::Id> sourceIds, vector<rsg::Id> targetIds, rsg::TimeStamp start, rsg::TimeStamp end, bool forcedId = false) {
+		for (vector<rsg::Id>::iterator it = sourceIds.begin(); it != sourceIds.end(); ++it) {
+			*it = map(*it);
+		}
+		for (vector<rsg::Id>::iterator it = targetIds.begin(); it != targetIds.end(); ++it) {
+			*it = map(*it);
+		}
+		return scene->addConnection(map(parentId), assignedId, attributes, sourceIds, targetIds, start, end, true);
+	}
+	bool setNodeAttributes(rsg::Id id, vector<rsg::Attribute> newAttributes, rsg::TimeStamp timeStamp = rsg::TimeStamp(0)) {
+		return scene->setNodeAttributes(map(id), newAttributes, timeStamp);
+	}
+	bool setTransform(rsg::Id id, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, rsg::TimeStamp timeStamp) {
+		return scene->setTransform(id, transform, timeStamp);
+	}
+	bool setUncertainTransform(rsg::Id id, IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, ITransformUncertainty::ITransformUncertaintyPtr uncertainty, rsg::TimeStamp timeStamp) {
+		return scene->setUncertainTransform(id, transform, uncertainty, timeStamp);
+	}
+	bool deleteNode(rsg::Id id) {
+		return scene->deleteNode(id);
+	}
+	bool addParent(rsg::Id id, rsg::Id parentId) {
+		return scene->addParent(id, map(parentId));
+	}
+	bool removeParent(rsg::Id id, rsg::Id parentId) {
+		return scene->removeParent(id, map(parentId));
+	}
+
+private:
+	rsg::Id map(rsg::Id id) {
+		return (id == privateRootId) ? rootId : id;
+	}
+
+	brics_3d::rsg::ISceneGraphUpdate* scene;
+	brics_3d::rsg::Id privateRootId;
+	brics_3d::rsg::Id rootId;
+};
+
+/*
+ * Parses the independent chunks of a scene setup file into private world models.
+ * The results can be picked up in document order by a single consumer.
+ */
+class ParallelChunkParser {
+public:
+	ParallelChunkParser(std::vector<rsg_bridge::JSONChunk>* chunks, brics_3d::rsg::Id privateRootId) :
+		chunks(chunks), privateRootId(privateRootId), nextChunk(0) {
+		results.resize(chunks->size(), 0);
+		isDone.resize(chunks->size(), false);
+		for (unsigned int i = 0; i < chunks->size(); ++i) {
+			if (!(*chunks)[i].isIndependent) {
+				isDone[i] = true; // handled by the consumer
+			}
+		}
+	};
+	virtual ~ParallelChunkParser(){
+		join();
+		for (unsigned int i = 0; i < results.size(); ++i) {
+			delete results[i];
+		}
+	};
+
+	void start(unsigned int threadCount) {
+		for (unsigned int i = 0; i < threadCount; ++i) {
+			workers.create_thread(boost::bind(&ParallelChunkParser::work, this));
+		}
+	}
+
+	void join() {
+		workers.join_all();
+	}
+
+	/* Blocks until chunk i is parsed. The ownership of the result is passed to the caller. */
+	brics_3d::WorldModel* take(unsigned int i) {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		while (!isDone[i]) {
+			chunkDone.wait(lock);
+		}
+		brics_3d::WorldModel* result = results[i];
+		results[i] = 0;
+		return result;
+	}
+
+private:
+	void work() {
+		while (true) {
+			unsigned int i;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				while ((nextChunk < chunks->size()) && !(*chunks)[nextChunk].isIndependent) {
+					nextChunk++;
+				}
+				if (nextChunk >= chunks->size()) {
+					return;
+				}
+				i = nextChunk++;
+			}
+
+			/* The private world model has the same root Id as the file */
+			brics_3d::WorldModel* privateWm = new brics_3d::WorldModel(new brics_3d::rsg::UuidGenerator(privateRootId));
+			brics_3d::rsg::JSONDeserializer deserializer(privateWm);
+			deserializer.setMapUnknownParentIdsToRootId(true);
+			const std::string& document = (*chunks)[i].document;
+			int transferredBytes = 0;
+			deserializer.write(document.c_str(), static_cast<int>(document.size()), transferredBytes);
+
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				results[i] = privateWm;
+				isDone[i] = true;
+			}
+			chunkDone.notify_all();
+		}
+	}
+
+	std::vector<rsg_bridge::JSONChunk>* chunks;
+	brics_3d::rsg::Id privateRootId;
+	unsigned int nextChunk;
+	std::vector<brics_3d::WorldModel*> results;
+	std::vector<bool> isDone;
+	boost::mutex mutex;
+	boost::condition_variable chunkDone;
+	boost::thread_group workers;
+};
+
+/*
+ * Copies a parsed private world model into the actual world model.
+ */
+static void commitPrivateWorldModel(brics_3d::WorldModel* privateWm, brics_3d::WorldModel* wm) {
+	ReRootingUpdateForwarder forwarder(&wm->scene, privateWm->getRootNodeId(), wm->getRootNodeId());
+	brics_3d::rsg::SceneGraphToUpdatesTraverser traverser(&forwarder);
+	privateWm->scene.executeGraphTraverser(&traverser, privateWm->getRootNodeId());
+
+	vector<brics_3d::rsg::Id> remoteRootNodeIds;
+	privateWm->scene.getRemoteRootNodes(remoteRootNodeIds);
+	for(vector<brics_3d::rsg::Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
+		vector<brics_3d::rsg::Attribute> attributes;
+		privateWm->scene.getNodeAttributes(*it, attributes);
+		forwarder.addRemoteRootNode(*it, attributes);
+		traverser.reset();
+		privateWm->scene.executeGraphTraverser(&traverser, *it);
+	}
+}
+
+/*
+ * Loads a JSON model by parsing independent subgraphs in parallel. Returns false
+ * if the model cannot be split. Then nothing has been loaded.
+ */
+static bool loadJsonModelInParallel(brics_3d::WorldModel* wm, const std::string& serializedModel, unsigned int threadCount) {
+	rsg_bridge::JSONChunkSplitter splitter;
+	std::string header;
+	std::string trailer;
+	std::vector<rsg_bridge::JSONChunk> chunks;
+	if (!splitter.split(serializedModel, header, chunks, trailer)) {
+		LOG(WARNING) << "rsg_scene_setup: JSON model cannot be split into chunks.";
+		return false;
+	}
+
+	brics_3d::rsg::Id privateRootId = wm->getRootNodeId();
+	if (!splitter.getRootId().empty()) {
+		privateRootId.fromString(splitter.getRootId());
+	}
+	unsigned int independentCount = 0;
+	for (unsigned int i = 0; i < chunks.size(); ++i) {
+		if (chunks[i].isIndependent) {
+			independentCount++;
+		}
+	}
+	threadCount = std::min(threadCount, independentCount);
+	LOG(INFO) << "rsg_scene_setup: JSON model has " << chunks.size() << " chunks (" << independentCount
+			<< " independent). Parsing with " << threadCount << " threads.";
+
+	brics_3d::rsg::JSONDeserializer deserializer(wm);
+	deserializer.setMapUnknownParentIdsToRootId(true);
+	int transferredBytes = 0;
+
+	/* root node attributes first */
+	if (!header.empty()) {
+		deserializer.write(header.c_str(), static_cast<int>(header.size()), transferredBytes);
+	}
+
+	/* independent chunks in document order, as soon as they are parsed */
+	ParallelChunkParser parser(&chunks, privateRootId);
+	parser.start(threadCount);
+	for (unsigned int i = 0; i < chunks.size(); ++i) {
+		if (!chunks[i].isIndependent) {
+			continue;
+		}
+		brics_3d::WorldModel* privateWm = parser.take(i);
+		if (privateWm != 0) {
+			commitPrivateWorldModel(privateWm, wm);
+			delete privateWm;
+		}
+	}
+	parser.join();
+
+	/* chunks that refer to other chunks need the complete graph so far */
+	for (unsigned int i = 0; i < chunks.size(); ++i) {
+		if (chunks[i].isIndependent) {
+			continue;
+		}
+		LOG(DEBUG) << "rsg_scene_setup: Loading dependent chunk " << i;
+		deserializer.write(chunks[i].document.c_str(), static_cast<int>(chunks[i].document.size()), transferredBytes);
+	}
+
+	/* connections of the root node last */
+	if (!trailer.empty()) {
+		deserializer.write(trailer.c_str(), static_cast<int>(trailer.size()), transferredBytes);
+	}
+	return true;
+}
+
 /* define a structure for holding the block local state. By assigning an
  * instance of this struct to the block private_data pointer (see init), this
  * information becomes accessible within the hook functions.
@@ -62,6 +321,7 @@ struct rsg_scene_setup_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
 
         /* this is to have fast access to ports for reading and writing, without
@@ -95,6 +355,7 @@ int rsg_scene_setup_init(ubx_block_t *b)
     		LOG(FATAL) << " World model handle could not be initialized.";
     		return -1;
     	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
     	/* Attach debug graph printe */
     	inf->wm_printer = new brics_3d::rsg::DotVisualizer(&inf->wm->scene);
@@ -152,12 +413,123 @@ void rsg_scene_setup_cleanup(ubx_block_t *b)
         free(b->private_data);
 }
 
-/* step */
-void rsg_scene_setup_step(ubx_block_t *b)
+static bool hasSuffix(const std::string& fileName, const std::string& suffix) {
+	return (fileName.size() > suffix.size()) && (fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+/*
+ * Loads a binary snapshot. The snapshot is memory mapped and applied without parsing.
+ * Records of nodes that exist already update them, so deltas can follow a base dump.
+ */
+static bool loadSnapshotFile(brics_3d::WorldModel* wm, const std::string& fileName) {
+	LOG(INFO) << "rsg_scene_setup: Loading binary snapshot " << fileName;
+	rsg_bridge::SnapshotReader reader;
+	if(!reader.open(fileName)) {
+		LOG(ERROR) << "rsg_scene_setup: Cannot load snapshot " << fileName;
+		return false;
+	}
+	reader.apply(wm, true);
+	reader.close();
+	return true;
+}
+
+/* Loads a line delimited JSON dump. Every line is a single update, so the file is streamed rather than loaded as a whole. */
+static bool loadLdjsonFile(brics_3d::WorldModel* wm, const std::string& fileName) {
+	LOG(INFO) << "rsg_scene_setup: Loading line delimited JSON model " << fileName;
+	std::ifstream inputFile;
+	inputFile.open(fileName.c_str(), std::ifstream::in);
+	if(inputFile.fail()) {
+		LOG(ERROR) << "rsg_scene_setup: Cannot read file " << fileName;
+		return false;
+	}
+	brics_3d::rsg::JSONDeserializer deserializer(wm);
+	deserializer.setMapUnknownParentIdsToRootId(true);
+	std::string rootId = wm->getRootNodeId().toString();
+	std::string dumpedRootId;
+	std::string line;
+	unsigned int lineCount = 0;
+	int transferredBytes = 0;
+	while(std::getline(inputFile, line)) {
+		if(line.empty()) {
+			continue;
+		}
+		if((lineCount == 0) && rsg_bridge::LDJSONWriter::getRootId(line, dumpedRootId)) {
+			LOG(DEBUG) << "rsg_scene_setup: Mapping dumped root node " << dumpedRootId << " to " << rootId;
+		}
+		lineCount++;
+		if(rsg_bridge::LDJSONWriter::isHeader(line)) {
+			continue; // not an update
+		}
+
+		/* Root attributes are merged like for snapshots, so the name and policies of this agent stay */
+		if(rsg_bridge::LDJSONWriter::isRootAttributesUpdate(line, dumpedRootId)) {
+			brics_3d::rsg::Id privateRootId;
+			privateRootId.fromString(dumpedRootId);
+			brics_3d::WorldModel privateWm(new brics_3d::rsg::UuidGenerator(privateRootId));
+			brics_3d::rsg::JSONDeserializer privateDeserializer(&privateWm);
+			privateDeserializer.write(line.c_str(), static_cast<int>(line.size()), transferredBytes);
+			vector<brics_3d::rsg::Attribute> dumpedRootAttributes;
+			privateWm.scene.getNodeAttributes(privateWm.getRootNodeId(), dumpedRootAttributes);
+			rsg_bridge::SnapshotReader::mergeRootAttributes(wm, dumpedRootAttributes);
+			continue;
+		}
+
+		/* The root node of the dump is replaced by the root node of this world model */
+		rsg_bridge::LDJSONWriter::mapRootId(line, dumpedRootId, rootId);
+		deserializer.write(line.c_str(), static_cast<int>(line.size()), transferredBytes);
+	}
+	inputFile.close();
+	LOG(INFO) << "rsg_scene_setup: Loaded " << lineCount << " updates.";
+	return true;
+}
+
+/*
+ * Applies the incremental dumps of rsg_dump (files with the suffix _delta) in the given
+ * order on top of rsg_file, which has to be the complete dump they are based on.
+ */
+static void loadDeltaFiles(ubx_block_t *b)
+{
+        struct rsg_scene_setup_info *inf = (struct rsg_scene_setup_info*) b->private_data;
+    	unsigned int clen;
+    	char* chrptr = (char*) ubx_config_get_data_ptr(b, "rsg_delta_files", &clen);
+    	if((clen == 0) || (strcmp(chrptr, "") == 0)) {
+    		return;
+    	}
+
+    	rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+    	std::stringstream deltaFiles(chrptr);
+    	std::string deltaFile;
+    	unsigned int deltaCount = 0;
+    	while (std::getline(deltaFiles, deltaFile, ',')) {
+    		deltaFile.erase(0, deltaFile.find_first_not_of(" "));
+    		deltaFile.erase(deltaFile.find_last_not_of(" ") + 1);
+    		if(deltaFile.empty()) {
+    			continue;
+    		}
+    		bool success = false;
+    		if(hasSuffix(deltaFile, RSG_SNAPSHOT_FILE_SUFFIX)) {
+    			success = loadSnapshotFile(inf->wm, deltaFile);
+    		} else if(hasSuffix(deltaFile, RSG_LDJSON_FILE_SUFFIX)) {
+    			success = loadLdjsonFile(inf->wm, deltaFile);
+    		} else {
+    			LOG(ERROR) << "rsg_scene_setup: Delta " << deltaFile << " is neither a " << RSG_SNAPSHOT_FILE_SUFFIX << " nor a " << RSG_LDJSON_FILE_SUFFIX << " file.";
+    		}
+    		if(!success) {
+    			LOG(ERROR) << "rsg_scene_setup: Skipping the remaining deltas, as they depend on " << deltaFile;
+    			return;
+    		}
+    		deltaCount++;
+    	}
+    	LOG(INFO) << "rsg_scene_setup: Applied " << deltaCount << " deltas.";
+}
+
+/* Loads the scene as configured by rsg_file */
+static void loadRsgFile(ubx_block_t *b)
 {
 
         struct rsg_scene_setup_info *inf = (struct rsg_scene_setup_info*) b->private_data;
         brics_3d::WorldModel* wm = inf->wm;
+        rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
 
         /*
          * Load scene based on JSON file.
@@ -178,21 +550,57 @@ void rsg_scene_setup_step(ubx_block_t *b)
     	}
     	LOG(INFO) << "rsg_scene_setup: file name = " << *fileName;
 
+    	if(hasSuffix(*fileName, RSG_SNAPSHOT_FILE_SUFFIX)) {
+    		loadSnapshotFile(wm, *fileName);
+    		delete fileName;
+    		return;
+    	}
+
+    	if(hasSuffix(*fileName, RSG_LDJSON_FILE_SUFFIX)) {
+    		loadLdjsonFile(wm, *fileName);
+    		delete fileName;
+    		return;
+    	}
+
     	if(fileName->compare("") != 0) {
     		LOG(INFO) << "rsg_scene_setup: Loading JSON model.";
 
-    		/* Read file */
+    		/* Read file (with a single copy) */
     		std::ifstream inputFile;
-    		inputFile.open (fileName->c_str(), std::ifstream::in);
-    		std::stringstream serializedModel;
-    		serializedModel << inputFile.rdbuf();
+    		inputFile.open (fileName->c_str(), std::ifstream::in | std::ifstream::binary);
+    		inputFile.seekg(0, std::ios::end);
+    		std::streamoff fileSize = inputFile.tellg();
+    		if(inputFile.fail() || (fileSize <= 0)) {
+    			LOG(ERROR) << "rsg_scene_setup: Cannot read file " << *fileName;
+    			delete fileName;
+    			return;
+    		}
+    		std::string serializedModel(static_cast<size_t>(fileSize), '\0');
+    		inputFile.seekg(0, std::ios::beg);
+    		inputFile.read(&serializedModel[0], fileSize);
+    		inputFile.close();
+    		LOG(INFO) << "rsg_scene_setup: Read " << serializedModel.size() << " bytes from " << *fileName;
+
+    		/* Optionally parse independent subgraphs in parallel */
+    		unsigned int loaderThreads = 1;
+    		uint32_t* loader_threads = ((uint32_t*) ubx_config_get_data_ptr(b, "loader_threads", &clen));
+    		if(clen == 0) {
+    			LOG(DEBUG) << "rsg_scene_setup: No loader_threads configuation given. Parsing the file as a whole.";
+    		} else {
+    			loaderThreads = *loader_threads;
+    		}
+    		if((loaderThreads > 1) && loadJsonModelInParallel(wm, serializedModel, loaderThreads)) {
+    			delete fileName;
+    			return;
+    		}
 
     		/* Do the actual JSON parsing. */
-    		LOG(INFO) << serializedModel.str();
     		brics_3d::rsg::JSONDeserializer deserializer(wm);
     		deserializer.setMapUnknownParentIdsToRootId(true);
-    		deserializer.write(serializedModel.str());
+    		int transferredBytes = 0;
+    		deserializer.write(serializedModel.c_str(), static_cast<int>(serializedModel.size()), transferredBytes);
 
+    		delete fileName;
     		return;
 
     	}
@@ -246,3 +654,86 @@ void rsg_scene_setup_step(ubx_block_t *b)
 
 }
 
+/* Loads the scene as configured by rsg_file and rsg_delta_files */
+static void setupScene(ubx_block_t *b)
+{
+        loadRsgFile(b);
+        loadDeltaFiles(b);
+}
+
+/*
+ * Loads the static map from the snapshot cache that another world model has filled,
+ * which saves reading and parsing the file but not the memory of the nodes.
+ * The root attributes of the publisher are skipped, they belong to another agent.
+ */
+static bool mountStaticMap(struct rsg_scene_setup_info *inf, rsg_bridge::StaticMapSegment& segment, int timeout) {
+	if(!segment.mount(timeout)) {
+		return false;
+	}
+	rsg_bridge::SnapshotReader reader;
+	if(!reader.open(segment.getSnapshot(), segment.getSnapshotSize())) {
+		return false;
+	}
+	std::vector<bool> selection(reader.getHeader()->nodeCount, true);
+	for (unsigned int i = 0; i < selection.size(); ++i) {
+		selection[i] = (reader.getNodes()[i].type != rsg_bridge::SNAPSHOT_ROOT_ATTRIBUTES);
+	}
+	rsg_bridge::WorldModelWriteLock lock(inf->wm_access);
+	unsigned int count = reader.apply(inf->wm, true, &selection);
+	reader.close();
+	LOG(INFO) << "rsg_scene_setup: Loaded " << count << " primitives of the static map from the snapshot cache.";
+	return true;
+}
+
+/* step */
+void rsg_scene_setup_step(ubx_block_t *b)
+{
+        struct rsg_scene_setup_info *inf = (struct rsg_scene_setup_info*) b->private_data;
+
+        /* Optionally cache the static map as snapshot for the other world models on this computer */
+    	unsigned int clen;
+    	char* segmentName = (char*) ubx_config_get_data_ptr(b, "static_map_segment", &clen);
+    	if((clen == 0) || (strcmp(segmentName, "") == 0)) {
+    		setupScene(b);
+    		return;
+    	}
+    	char* rsgFile = (char*) ubx_config_get_data_ptr(b, "rsg_file", &clen);
+    	if((clen == 0) || (strcmp(rsgFile, "") == 0)) {
+    		LOG(WARNING) << "rsg_scene_setup: static_map_segment requires an rsg_file. Loading the default scene.";
+    		setupScene(b);
+    		return;
+    	}
+
+    	int timeout = STATIC_MAP_MOUNT_TIMEOUT;
+    	uint32_t* static_map_timeout = ((uint32_t*) ubx_config_get_data_ptr(b, "static_map_timeout", &clen));
+    	if(clen == 0) {
+    		LOG(DEBUG) << "rsg_scene_setup: No static_map_timeout configuation given. Waiting at most " << timeout << " ms for a publisher.";
+    	} else {
+    		timeout = static_cast<int>(*static_map_timeout);
+    	}
+
+    	rsg_bridge::StaticMapSegment segment(segmentName, rsg_bridge::StaticMapSegment::describeFile(rsgFile));
+    	if(!segment.acquire()) {
+    		if(mountStaticMap(inf, segment, timeout)) {
+    			loadDeltaFiles(b); // not part of the cache, as the source only describes the rsg_file
+    			return;
+    		}
+    		LOG(WARNING) << "rsg_scene_setup: Cannot mount static map segment " << segmentName << ". Loading " << rsgFile << " instead.";
+    		setupScene(b);
+    		return;
+    	}
+
+    	/* This world model is the first one: load the map and publish it for the others */
+    	loadRsgFile(b);
+    	std::vector<char> snapshot;
+    	{
+    		rsg_bridge::WorldModelReadLock lock(inf->wm_access);
+    		rsg_bridge::SnapshotWriter writer;
+    		writer.capture(inf->wm);
+    		if(writer.getNodeCount() > 0) {
+    			writer.write(snapshot);
+    		}
+    	}
+    	segment.publish(snapshot); // an empty snapshot abandons the segment
+    	loadDeltaFiles(b);
+}
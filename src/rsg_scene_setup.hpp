@@ -20,7 +20,11 @@ char rsg_scene_setup_meta[] =
 ubx_config_t rsg_scene_setup_config[] = {
         { .name="wm_handle", .type_name = "struct rsg_wm_handle", .doc="Handle to the world wodel instance. This parameter is mandatory." },
         { .name="log_level", .type_name = "int", .doc="Set the log level: LOGDEBUG = 0, INFO = 1, WARNING = 2, LOGERROR = 3, FATAL = 4" },
-        { .name="rsg_file",  .type_name = "char" , .doc="JSON file name to be loaded to RSG." },
+        { .name="rsg_file",  .type_name = "char" , .doc="JSON file name to be loaded to RSG. Files with the suffix .rsgsnap are loaded as binary snapshot (cf. store_snapshot_files of rsg_dump)." },
+        { .name="rsg_delta_files",  .type_name = "char" , .doc="Optional comma separated list of incremental dumps (.rsgsnap or .ldjson files with the suffix _delta of rsg_dump) that are applied in this order after rsg_file. rsg_file has to be the complete dump they are based on." },
+        { .name="static_map_segment", .type_name = "char" , .doc="Optional name of a shared memory segment, e.g. /swm_static_map. It caches the loaded rsg_file as snapshot: the first world model on a computer publishes it, all others copy it into their World Model instead of reading and parsing the file. Each world model keeps its own nodes." },
+        { .name="static_map_timeout", .type_name = "uint32_t", .doc="Time in [ms] to wait for a publisher that is still loading the static map, before the file is loaded instead. Default is 5000." },
+        { .name="loader_threads", .type_name = "uint32_t", .doc="Number of threads to parse independent subgraphs of a large JSON file in parallel. 0 or 1 (default) parses the file as a whole." },
         { NULL },
 };
 
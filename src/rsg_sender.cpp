@@ -3,6 +3,9 @@
 /* microblx type for the robot scene graph */
 #include "types/rsg/types/rsg_types.h"
 
+/* Shared access to the world model */
+#include "util/WorldModelAccess.h"
+
 /* BRICS_3D includes */
 #include <brics_3d/core/Logger.h>
 #include <brics_3d/worldModel/WorldModel.h>
@@ -108,6 +111,7 @@ struct rsg_sender_info
 {
         /* add custom block local data here */
 		brics_3d::WorldModel* wm;
+		rsg_bridge::WorldModelAccess* wm_access; // lock for blocks running on different threads
 		brics_3d::rsg::DotVisualizer* wm_printer;
 		brics_3d::rsg::SceneGraphToUpdatesTraverser* wm_resender;
 		brics_3d::rsg::FrequencyAwareUpdateFilter* frequency_filter;
@@ -148,6 +152,7 @@ int rsg_sender_init(ubx_block_t *b)
     					  "Please check your system design if this is intended!";
     		inf->wm = new brics_3d::WorldModel();
     	}
+    	inf->wm_access = rsg_bridge::WorldModelAccess::get(inf->wm);
 
     	/* Attach debug graph printer */
     	brics_3d::rsg::VisualizationConfiguration dotConfig;
@@ -296,6 +301,7 @@ void rsg_sender_step(ubx_block_t *b)
 
         struct rsg_sender_info *inf = (struct rsg_sender_info*) b->private_data;
         brics_3d::WorldModel* wm = inf->wm;
+        rsg_bridge::WorldModelWriteLock lock(inf->wm_access); // serializes with the update observers that use the same port
 
         /* Resend the complete scene graph */
         LOG(INFO) << "rsg_sender: Resending the complete RSG now.";
@@ -0,0 +1,326 @@
+#include "rsg_zyre_subscriptions.hpp"
+
+/* microblx type for the robot scene graph */
+#include "types/rsg/types/rsg_types.h"
+
+/* Subscriptions of peers, registered here or by rsg_json_query */
+#include "util/SubscriptionRegistry.h"
+
+/* BRICS_3D includes */
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/WorldModel.h>
+
+/* Zyre includes */
+#include <zyre.h>
+
+#include <cstring>
+#include <string>
+#include <map>
+#include <set>
+
+using namespace brics_3d;
+using brics_3d::Logger;
+
+
+UBX_MODULE_LICENSE_SPDX(BSD-3-Clause)
+
+#define DEFAULT_BUFFER_SIZE 90000
+#define DEFAULT_NODE_NAME "SWM_subscriptions"
+#define DEFAULT_GROUP "local"
+#define DEFAULT_SUBSCRIBER_TIMEOUT 30.0
+#define DEFAULT_MAX_SEND 100
+
+/* define a structure for holding the block local state. By assigning an
+ * instance of this struct to the block private_data pointer (see init), this
+ * information becomes accessible within the hook functions.
+ */
+struct rsg_zyre_subscriptions_info
+{
+        /* add custom block local data here */
+		brics_3d::WorldModel* wm;
+		rsg_bridge::SubscriptionRegistry* registry;
+
+		zyre_t* node;
+		zpoller_t* poller;
+		std::string* group;
+		std::map<std::string, std::string>* peers;  // name -> Zyre UUID of the peers in the network
+		std::map<std::string, int64_t>* absentSince; // subscribers without a peer [ms]
+
+		unsigned char* input_buffer;
+		unsigned long input_buffer_size;
+		int64_t subscriberTimeout; // [ms]
+		unsigned int maxSend;
+
+		uint64_t whisperedCount;
+		uint64_t undeliverableCount;
+
+        /* this is to have fast access to ports for reading and writing, without
+         * needing a hash table lookup */
+        struct rsg_zyre_subscriptions_port_cache ports;
+};
+
+static std::string getStringConfig(ubx_block_t *b, const char* name, const std::string& defaultValue) {
+	unsigned int clen;
+	char* value = (char*) ubx_config_get_data_ptr(b, name, &clen);
+	if((clen == 0) || (value == 0) || (strlen(value) == 0)) {
+		LOG(INFO) << "rsg_zyre_subscriptions: No " << name << " configuration given. Using " << defaultValue;
+		return defaultValue;
+	}
+	return std::string(value);
+}
+
+static void removeSubscriber(struct rsg_zyre_subscriptions_info *inf, const std::string& subscriberId, const char* reason) {
+	if(inf->registry->unsubscribeAll(subscriberId) > 0) {
+		LOG(INFO) << "rsg_zyre_subscriptions: Removed the subscriptions of " << subscriberId << " (" << reason << ").";
+	}
+	inf->absentSince->erase(subscriberId);
+}
+
+/*
+ * Handles the events of the Zyre node: keeps track of the peers and answers
+ * RSGSubscription messages that are whispered to this node.
+ */
+static void processEvents(struct rsg_zyre_subscriptions_info *inf) {
+	while (zpoller_wait(inf->poller, 0) != 0) {
+		zmsg_t* msg = zyre_recv(inf->node);
+		if (!msg) {
+			break;
+		}
+		char* event = zmsg_popstr(msg);
+		char* peerId = zmsg_popstr(msg);
+		char* peerName = zmsg_popstr(msg);
+
+		if (streq(event, "ENTER")) {
+			(*inf->peers)[peerName] = peerId;
+			inf->absentSince->erase(peerName);
+		} else if (streq(event, "EXIT")) {
+			inf->peers->erase(peerName);
+			removeSubscriber(inf, peerName, "left the network");
+		} else if (streq(event, "LEAVE")) {
+			char* group = zmsg_popstr(msg);
+			if (*inf->group == group) {
+				removeSubscriber(inf, peerName, "left the group");
+			}
+			zstr_free(&group);
+		} else if (streq(event, "WHISPER")) {
+			char* message = zmsg_popstr(msg);
+			std::string request(message ? message : "");
+			if (rsg_bridge::SubscriptionRegistry::isSubscriptionMessage(request)) {
+				std::string result;
+				inf->registry->handleMessage(request, result); // no lock on the world model required
+				zyre_whispers(inf->node, peerId, "%s", result.c_str());
+			} else {
+				LOG(DEBUG) << "rsg_zyre_subscriptions: Ignoring a message of " << peerName << " that is not an RSGSubscription.";
+			}
+			zstr_free(&message);
+		}
+
+		zstr_free(&peerName);
+		zstr_free(&peerId);
+		zstr_free(&event);
+		zmsg_destroy(&msg);
+	}
+}
+
+/*
+ * Removes the subscriptions of subscribers that are absent from the network for too long.
+ * This also covers subscriptions of peers that were registered while this node did not run.
+ */
+static void expireSubscribers(struct rsg_zyre_subscriptions_info *inf) {
+	std::set<std::string> subscriberIds;
+	inf->registry->getSubscriberIds(subscriberIds);
+	int64_t now = zclock_mono();
+	for (std::set<std::string>::const_iterator it = subscriberIds.begin(); it != subscriberIds.end(); ++it) {
+		if (inf->peers->find(*it) != inf->peers->end()) {
+			inf->absentSince->erase(*it);
+			continue;
+		}
+		std::map<std::string, int64_t>::iterator absent = inf->absentSince->find(*it);
+		if (absent == inf->absentSince->end()) {
+			(*inf->absentSince)[*it] = now;
+		} else if (now - absent->second > inf->subscriberTimeout) {
+			removeSubscriber(inf, *it, "absent");
+		}
+	}
+}
+
+/* init */
+int rsg_zyre_subscriptions_init(ubx_block_t *b)
+{
+        int ret = -1;
+        struct rsg_zyre_subscriptions_info *inf;
+
+        /* allocate memory for the block local state */
+        if ((inf = (struct rsg_zyre_subscriptions_info*)calloc(1, sizeof(struct rsg_zyre_subscriptions_info)))==NULL) {
+                ERR("rsg_zyre_subscriptions: failed to alloc memory");
+                ret=EOUTOFMEM;
+                return -1;
+        }
+        b->private_data=inf;
+        update_port_cache(b, &inf->ports);
+
+    	unsigned int clen;
+    	rsg_wm_handle tmpWmHandle =  *((rsg_wm_handle*) ubx_config_get_data_ptr(b, "wm_handle", &clen));
+    	assert(clen != 0);
+    	inf->wm = reinterpret_cast<brics_3d::WorldModel*>(tmpWmHandle.wm); // We know that this pointer stores the world model type
+    	if(inf->wm == 0) {
+    		LOG(FATAL) << "rsg_zyre_subscriptions: World model handle could not be initialized.";
+    		return -1;
+    	}
+    	inf->registry = rsg_bridge::SubscriptionRegistry::get(inf->wm);
+
+    	inf->input_buffer_size = DEFAULT_BUFFER_SIZE;
+    	uint32_t* buffer_len =  ((uint32_t*) ubx_config_get_data_ptr(b, "buffer_len", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_zyre_subscriptions: No buffer_len configuation given. Selecting a default.";
+    	} else if (*buffer_len > 0) {
+    		inf->input_buffer_size = *buffer_len;
+    	}
+    	LOG(INFO) << "rsg_zyre_subscriptions: buffer_len = " << inf->input_buffer_size;
+    	inf->input_buffer = (unsigned char*) malloc(inf->input_buffer_size*sizeof(unsigned char));
+
+    	inf->peers = new std::map<std::string, std::string>();
+    	inf->absentSince = new std::map<std::string, int64_t>();
+
+        return 0;
+}
+
+/* start */
+int rsg_zyre_subscriptions_start(ubx_block_t *b)
+{
+        struct rsg_zyre_subscriptions_info *inf = (struct rsg_zyre_subscriptions_info*) b->private_data;
+    	unsigned int clen;
+
+    	double subscriberTimeout = DEFAULT_SUBSCRIBER_TIMEOUT;
+    	double* subscriber_timeout =  ((double*) ubx_config_get_data_ptr(b, "subscriber_timeout", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_zyre_subscriptions: No subscriber_timeout configuation given. Selecting a default.";
+    	} else if (*subscriber_timeout > 0) {
+    		subscriberTimeout = *subscriber_timeout;
+    	}
+    	LOG(INFO) << "rsg_zyre_subscriptions: subscriber_timeout = " << subscriberTimeout;
+    	inf->subscriberTimeout = static_cast<int64_t>(subscriberTimeout * 1000.0);
+
+    	inf->maxSend = DEFAULT_MAX_SEND;
+    	uint32_t* max_send =  ((uint32_t*) ubx_config_get_data_ptr(b, "max_send", &clen));
+    	if(clen == 0) {
+    		LOG(INFO) << "rsg_zyre_subscriptions: No max_send configuation given. Selecting a default.";
+    	} else if (*max_send > 0) {
+    		inf->maxSend = *max_send;
+    	}
+    	LOG(INFO) << "rsg_zyre_subscriptions: max_send = " << inf->maxSend;
+
+    	/* Zyre node */
+    	std::string nodeName = getStringConfig(b, "node_name", DEFAULT_NODE_NAME);
+    	inf->group = new std::string(getStringConfig(b, "group", DEFAULT_GROUP));
+    	inf->node = zyre_new(nodeName.c_str());
+    	if(!inf->node) {
+    		LOG(ERROR) << "rsg_zyre_subscriptions: Cannot create the Zyre node " << nodeName;
+    		return -1;
+    	}
+
+    	int* gossip_flag =  ((int*) ubx_config_get_data_ptr(b, "gossip_flag", &clen));
+    	if((clen != 0) && (*gossip_flag == 1)) {
+    		std::string localEndpoint = getStringConfig(b, "local_endpoint", "ipc:///tmp/sherpa_wm_subscriptions");
+    		std::string gossipEndpoint = getStringConfig(b, "gossip_endpoint", "ipc:///tmp/local-hub");
+    		LOG(INFO) << "rsg_zyre_subscriptions: Using gossip discovery via " << gossipEndpoint << " with the local endpoint " << localEndpoint;
+    		if(zyre_set_endpoint(inf->node, "%s", localEndpoint.c_str()) != 0) {
+    			LOG(ERROR) << "rsg_zyre_subscriptions: Cannot bind the local endpoint " << localEndpoint;
+    			zyre_destroy(&inf->node);
+    			return -1;
+    		}
+    		zyre_gossip_connect(inf->node, "%s", gossipEndpoint.c_str());
+    	} else {
+    		LOG(INFO) << "rsg_zyre_subscriptions: Using UDP beaconing.";
+    	}
+
+    	if(zyre_start(inf->node) != 0) {
+    		LOG(ERROR) << "rsg_zyre_subscriptions: Cannot start the Zyre node " << nodeName;
+    		zyre_destroy(&inf->node);
+    		return -1;
+    	}
+    	zyre_join(inf->node, inf->group->c_str());
+    	inf->poller = zpoller_new(zyre_socket(inf->node), NULL);
+    	LOG(INFO) << "rsg_zyre_subscriptions: Zyre node " << nodeName << " joined group " << *inf->group;
+
+        return 0;
+}
+
+/* stop */
+void rsg_zyre_subscriptions_stop(ubx_block_t *b)
+{
+        struct rsg_zyre_subscriptions_info *inf = (struct rsg_zyre_subscriptions_info*) b->private_data;
+        LOG(INFO) << "rsg_zyre_subscriptions: whispered = " << inf->whisperedCount << ", undeliverable = " << inf->undeliverableCount;
+        if(inf->poller) {
+        	zpoller_destroy(&inf->poller);
+        }
+        if(inf->node) {
+        	zyre_stop(inf->node);
+        	zyre_destroy(&inf->node);
+        }
+        if(inf->group) {
+        	delete inf->group;
+        	inf->group = 0;
+        }
+        inf->peers->clear();
+}
+
+/* cleanup */
+void rsg_zyre_subscriptions_cleanup(ubx_block_t *b)
+{
+        struct rsg_zyre_subscriptions_info *inf = (struct rsg_zyre_subscriptions_info*) b->private_data;
+        if(inf->peers) {
+        	delete inf->peers;
+        	inf->peers = 0;
+        }
+        if(inf->absentSince) {
+        	delete inf->absentSince;
+        	inf->absentSince = 0;
+        }
+        free(inf->input_buffer);
+        free(b->private_data);
+}
+
+/* step */
+void rsg_zyre_subscriptions_step(ubx_block_t *b)
+{
+        struct rsg_zyre_subscriptions_info *inf = (struct rsg_zyre_subscriptions_info*) b->private_data;
+        if(!inf->node) {
+        	return;
+        }
+
+        processEvents(inf);
+        expireSubscribers(inf);
+
+		ubx_port_t* port = inf->ports.rsg_in;
+		assert(port != 0);
+		for (unsigned int i = 0; i < inf->maxSend; ++i) {
+			ubx_data_t msg;
+			checktype(port->block->ni, port->in_type, "unsigned char", port->name, 1);
+			msg.type = port->in_type;
+			msg.len = inf->input_buffer_size;
+			msg.data = (void *)inf->input_buffer;
+			int readBytes = __port_read(port, &msg);
+			if (readBytes <= 1) {
+				break; // regular case if no new data is available
+			}
+
+			std::string envelope((char *)msg.data, readBytes);
+			if (envelope[envelope.size() - 1] == '\0') {
+				envelope.resize(envelope.size() - 1);
+			}
+			std::string subscriberId;
+			if (!rsg_bridge::SubscriptionRegistry::getSubscriberId(envelope, subscriberId)) {
+				LOG(WARNING) << "rsg_zyre_subscriptions: Envelope without subscriberId.";
+				continue;
+			}
+			std::map<std::string, std::string>::const_iterator peer = inf->peers->find(subscriberId);
+			if (peer == inf->peers->end()) {
+				LOG(DEBUG) << "rsg_zyre_subscriptions: Subscriber " << subscriberId << " is not in the Zyre network. Dropping an update.";
+				inf->undeliverableCount++;
+				continue;
+			}
+			zyre_whispers(inf->node, peer->second.c_str(), "%s", envelope.c_str());
+			inf->whisperedCount++;
+		}
+}
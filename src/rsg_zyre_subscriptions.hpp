@@ -0,0 +1,115 @@
+/*
+ * rsg_zyre_subscriptions microblx function block (autogenerated, don't edit)
+ */
+
+#include <ubx.h>
+
+/* includes types and type metadata */
+
+ubx_type_t types[] = {
+        { NULL },
+};
+
+/* block meta information */
+char rsg_zyre_subscriptions_meta[] =
+        " { doc='A block that delivers the updates of subscribed peers (rsg_out_subscriptions of rsg_json_sender) as Zyre whispers to the peer with the subscriberId. It also accepts RSGSubscription messages as whispers and removes the subscriptions of peers that left.',"
+        "   real-time=false,"
+        "}";
+
+/* declaration of block configuration */
+ubx_config_t rsg_zyre_subscriptions_config[] = {
+        { .name="wm_handle", .type_name = "struct rsg_wm_handle", .doc="Handle to the world wodel instance. This parameter is mandatory." },
+        { .name="buffer_len", .type_name = "uint32_t", .doc="Maximum length of an RSGSubscriptionUpdate envelope. Default is 90000." },
+        { .name="node_name", .type_name = "char", .doc="Name of this node in the Zyre network. Subscribers whisper their RSGSubscription messages to it. Default is SWM_subscriptions." },
+        { .name="group", .type_name = "char", .doc="Zyre group to join. Subscribers that leave it lose their subscriptions. Default is local." },
+        { .name="gossip_flag", .type_name = "int", .doc="1 for using gossip; 0 for using UDP beaconing instead. Default is 0." },
+        { .name="gossip_endpoint", .type_name = "char", .doc="Endpoint for zyre gossip discovery, e.g. ipc:///tmp/local-hub. The node connects to it." },
+        { .name="local_endpoint", .type_name = "char", .doc="Local endpoint of this node for gossip discovery. MUST differ from the one of the zyre bridge." },
+        { .name="subscriber_timeout", .type_name = "double", .doc="Seconds a subscriber may be absent from the Zyre network before its subscriptions are removed. Default is 30." },
+        { .name="max_send", .type_name = "uint32_t", .doc="Maximum number of envelopes that are sent within a single step. Default is 100." },
+        { NULL },
+};
+
+/* declaration port block ports */
+ubx_port_t rsg_zyre_subscriptions_ports[] = {
+        { .name="rsg_in", .in_type_name="unsigned char", .doc="RSGSubscriptionUpdate envelopes, i.e. the rsg_out_subscriptions port of rsg_json_sender."  },
+        { NULL },
+};
+
+/* declare a struct port_cache */
+struct rsg_zyre_subscriptions_port_cache {
+        ubx_port_t* rsg_in;
+};
+
+/* declare a helper function to update the port cache this is necessary
+ * because the port ptrs can change if ports are dynamically added or
+ * removed. This function should hence be called after all
+ * initialization is done, i.e. typically in 'start'
+ */
+static void update_port_cache(ubx_block_t *b, struct rsg_zyre_subscriptions_port_cache *pc)
+{
+        pc->rsg_in = ubx_port_get(b, "rsg_in");
+}
+
+
+/* block operation forward declarations */
+int rsg_zyre_subscriptions_init(ubx_block_t *b);
+int rsg_zyre_subscriptions_start(ubx_block_t *b);
+void rsg_zyre_subscriptions_stop(ubx_block_t *b);
+void rsg_zyre_subscriptions_cleanup(ubx_block_t *b);
+void rsg_zyre_subscriptions_step(ubx_block_t *b);
+
+
+/* put everything together */
+ubx_block_t rsg_zyre_subscriptions_block = {
+        .name = "rsg_zyre_subscriptions",
+        .type = BLOCK_TYPE_COMPUTATION,
+        .meta_data = rsg_zyre_subscriptions_meta,
+        .configs = rsg_zyre_subscriptions_config,
+        .ports = rsg_zyre_subscriptions_ports,
+
+        /* ops */
+        .init = rsg_zyre_subscriptions_init,
+        .start = rsg_zyre_subscriptions_start,
+        .stop = rsg_zyre_subscriptions_stop,
+        .cleanup = rsg_zyre_subscriptions_cleanup,
+        .step = rsg_zyre_subscriptions_step,
+};
+
+
+/* rsg_zyre_subscriptions module init and cleanup functions */
+int rsg_zyre_subscriptions_mod_init(ubx_node_info_t* ni)
+{
+        DBG(" ");
+        int ret = -1;
+        ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++) {
+                if(ubx_type_register(ni, tptr) != 0) {
+                        goto out;
+                }
+        }
+
+        if(ubx_block_register(ni, &rsg_zyre_subscriptions_block) != 0)
+                goto out;
+
+        ret=0;
+out:
+        return ret;
+}
+
+void rsg_zyre_subscriptions_mod_cleanup(ubx_node_info_t *ni)
+{
+        DBG(" ");
+        const ubx_type_t *tptr;
+
+        for(tptr=types; tptr->name!=NULL; tptr++)
+                ubx_type_unregister(ni, tptr->name);
+
+        ubx_block_unregister(ni, "rsg_zyre_subscriptions");
+}
+
+/* declare module init and cleanup functions, so that the ubx core can
+ * find these when the module is loaded/unloaded */
+UBX_MODULE_INIT(rsg_zyre_subscriptions_mod_init)
+UBX_MODULE_CLEANUP(rsg_zyre_subscriptions_mod_cleanup)
@@ -0,0 +1,53 @@
+/*
+ * Typed requests and replies of the rsg_json_query block for function blocks in
+ * the same process. They are sent via the typed_query and typed_result ports
+ * without any serialization.
+ *
+ * The definitions are also loaded by the microblx type system, so this file
+ * must not contain preprocessor directives. Sizes:
+ *   ids:        37 characters, i.e. a UUID string with its terminator
+ *   attributes: up to 16 per message, keys up to 63 and values up to 255 characters
+ *   GET_NODES:  up to 64 ids per reply
+ * Ids and attributes that do not fit into a reply are counted in "truncated".
+ * Matrices are homogeneous 4x4 matrices in column-major order, as in RSG-JSON.
+ * Time stamps are in [s]; 0 means now.
+ */
+
+enum rsg_typed_operation {
+	RSG_TYPED_GET_NODES = 1,            /* nodes with all "attributes" */
+	RSG_TYPED_GET_NODE_ATTRIBUTES = 2,  /* attributes of "id" */
+	RSG_TYPED_GET_TRANSFORM = 3,        /* pose of "id" w.r.t. "reference_id" at "time_stamp" */
+	RSG_TYPED_ADD_NODE = 10,            /* new node below the parent "id" */
+	RSG_TYPED_ADD_TRANSFORM_NODE = 11,  /* new Transform with "transform" below the parent "id" */
+	RSG_TYPED_UPDATE_ATTRIBUTES = 12,   /* replace the attributes of "id" */
+	RSG_TYPED_UPDATE_TRANSFORM = 13,    /* new "transform" of the Transform "id" */
+	RSG_TYPED_DELETE_NODE = 14          /* "id" */
+};
+
+struct rsg_typed_attribute {
+	char key[64];
+	char value[256];
+};
+
+struct rsg_typed_request {
+	uint32_t request_id;                /* chosen by the caller, copied to the reply */
+	int32_t operation;                  /* rsg_typed_operation */
+	char id[37];
+	char reference_id[37];
+	double time_stamp;
+	double transform[16];
+	uint32_t attribute_count;
+	struct rsg_typed_attribute attributes[16];
+};
+
+struct rsg_typed_reply {
+	uint32_t request_id;
+	int32_t operation;
+	int32_t success;                    /* 1 or 0 */
+	uint32_t id_count;                  /* GET_NODES, or the new id of ADD_NODE and ADD_TRANSFORM_NODE */
+	uint32_t truncated;
+	char ids[64][37];
+	double transform[16];               /* GET_TRANSFORM */
+	uint32_t attribute_count;           /* GET_NODE_ATTRIBUTES */
+	struct rsg_typed_attribute attributes[16];
+};
@@ -0,0 +1,271 @@
+#include "CoalescingTransformFilter.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+
+#include <sstream>
+#include <cstring>
+#include <cassert>
+#include <time.h>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+CoalescingTransformFilter::CoalescingTransformFilter(ISceneGraphUpdateObserver* next, double maxFrequency) :
+		next(next), pendingCount(0), timer(0), isRunning(false), access(0) {
+	assert(next != 0);
+	minInterval = (maxFrequency > 0) ? 1.0 / maxFrequency : 0;
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+CoalescingTransformFilter::~CoalescingTransformFilter() {
+	stop();
+	if (pendingCount > 0) {
+		LOG(WARNING) << "CoalescingTransformFilter: Discarded " << pendingCount << " pending Transform updates.";
+	}
+}
+
+void CoalescingTransformFilter::start(WorldModelAccess* access) {
+	assert(access != 0);
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (isRunning) {
+		return;
+	}
+	this->access = access;
+	isRunning = true;
+	timer = new boost::thread(boost::bind(&CoalescingTransformFilter::forwardDueSamples, this));
+}
+
+void CoalescingTransformFilter::stop() {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (!isRunning) {
+			return;
+		}
+		isRunning = false;
+		samplePending.notify_all();
+	}
+	timer->join();
+	delete timer;
+	timer = 0;
+}
+
+double CoalescingTransformFilter::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+CoalescingTransformStatistics CoalescingTransformFilter::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	CoalescingTransformStatistics result = statistics;
+	result.pendingCount = pendingCount;
+	return result;
+}
+
+std::string CoalescingTransformFilter::getStatisticsAsString() {
+	CoalescingTransformStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Transform updates: forwarded = " << current.forwardedCount
+			<< ", delayed = " << current.delayedCount
+			<< ", coalesced = " << current.coalescedCount
+			<< ", pending = " << current.pendingCount;
+	return result.str();
+}
+
+bool CoalescingTransformFilter::limit(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform,
+		brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, bool hasUncertainty, TimeStamp timeStamp) {
+	forwardPendingSamples(true);
+	double currentTime = now();
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		std::map<Id, TransformSlot>::iterator slot = slots.find(id);
+		if (slot == slots.end()) {
+			TransformSlot newSlot;
+			newSlot.lastForwardTime = currentTime;
+			newSlot.isPending = false;
+			newSlot.hasUncertainty = false;
+			slots.insert(std::make_pair(id, newSlot));
+			statistics.forwardedCount++;
+		} else if (!slot->second.isPending && (currentTime - slot->second.lastForwardTime >= minInterval)) {
+			slot->second.lastForwardTime = currentTime;
+			statistics.forwardedCount++;
+		} else {
+
+			/* Keep only the newest sample until its slot is due */
+			if (slot->second.isPending) {
+				statistics.coalescedCount++;
+			} else {
+				slot->second.isPending = true;
+				pendingCount++;
+				samplePending.notify_all();
+			}
+			brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr copy(new brics_3d::HomogeneousMatrix44());
+			if (transform) {
+				memcpy(copy->setRawData(), transform->getRawData(), 16 * sizeof(double));
+			}
+			slot->second.transform = copy;
+			slot->second.uncertainty = uncertainty;
+			slot->second.hasUncertainty = hasUncertainty;
+			slot->second.timeStamp = timeStamp;
+			return true;
+		}
+	}
+
+	if (hasUncertainty) {
+		return next->setUncertainTransform(id, transform, uncertainty, timeStamp);
+	}
+	return next->setTransform(id, transform, timeStamp);
+}
+
+void CoalescingTransformFilter::flush() {
+	forwardPendingSamples(false);
+}
+
+void CoalescingTransformFilter::forwardPendingSamples(bool dueOnly) {
+	std::vector<std::pair<Id, TransformSlot> > dueSamples;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (pendingCount == 0) {
+			return;
+		}
+		double currentTime = now();
+		for (std::map<Id, TransformSlot>::iterator it = slots.begin(); it != slots.end(); ++it) {
+			if (it->second.isPending && (!dueOnly || (currentTime - it->second.lastForwardTime >= minInterval))) {
+				dueSamples.push_back(*it);
+				it->second.isPending = false;
+				it->second.lastForwardTime = currentTime;
+				it->second.transform.reset();
+				it->second.uncertainty.reset();
+				pendingCount--;
+				statistics.delayedCount++;
+			}
+		}
+	}
+
+	for (std::vector<std::pair<Id, TransformSlot> >::iterator it = dueSamples.begin(); it != dueSamples.end(); ++it) {
+		LOG(DEBUG) << "CoalescingTransformFilter: Forwarding delayed update of Transform " << it->first;
+		if (it->second.hasUncertainty) {
+			next->setUncertainTransform(it->first, it->second.transform, it->second.uncertainty, it->second.timeStamp);
+		} else {
+			next->setTransform(it->first, it->second.transform, it->second.timeStamp);
+		}
+	}
+}
+
+double CoalescingTransformFilter::getNextDueTime() const {
+	double nextDueTime = -1;
+	if (pendingCount == 0) {
+		return nextDueTime;
+	}
+	for (std::map<Id, TransformSlot>::const_iterator it = slots.begin(); it != slots.end(); ++it) {
+		if (it->second.isPending) {
+			double dueTime = it->second.lastForwardTime + minInterval;
+			if ((nextDueTime < 0) || (dueTime < nextDueTime)) {
+				nextDueTime = dueTime;
+			}
+		}
+	}
+	return nextDueTime;
+}
+
+void CoalescingTransformFilter::forwardDueSamples() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (isRunning) {
+		double dueTime = getNextDueTime();
+		if (dueTime < 0) {
+			samplePending.wait(lock);
+			continue;
+		}
+		double currentTime = now();
+		if (currentTime < dueTime) {
+			samplePending.timed_wait(lock, boost::posix_time::microseconds(static_cast<long>((dueTime - currentTime) * 1.0e6) + 1));
+			continue;
+		}
+
+		/* Same lock order as the updates: the World Model first, then this filter */
+		lock.unlock();
+		{
+			WorldModelWriteLock writeLock(access);
+			forwardPendingSamples(true);
+		}
+		lock.lock();
+	}
+}
+
+bool CoalescingTransformFilter::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addNode(parentId, assignedId, attributes, forcedId);
+}
+
+bool CoalescingTransformFilter::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addGroup(parentId, assignedId, attributes, forcedId);
+}
+
+bool CoalescingTransformFilter::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addTransformNode(parentId, assignedId, attributes, transform, timeStamp, forcedId);
+}
+
+bool CoalescingTransformFilter::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addUncertainTransformNode(parentId, assignedId, attributes, transform, uncertainty, timeStamp, forcedId);
+}
+
+bool CoalescingTransformFilter::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addGeometricNode(parentId, assignedId, attributes, shape, timeStamp, forcedId);
+}
+
+bool CoalescingTransformFilter::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	forwardPendingSamples(true);
+	return next->addRemoteRootNode(rootId, attributes);
+}
+
+bool CoalescingTransformFilter::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	forwardPendingSamples(true);
+	return next->addConnection(parentId, assignedId, attributes, sourceIds, targetIds, start, end, forcedId);
+}
+
+bool CoalescingTransformFilter::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	forwardPendingSamples(true);
+	return next->setNodeAttributes(id, newAttributes, timeStamp);
+}
+
+bool CoalescingTransformFilter::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	return limit(id, transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr(), false, timeStamp);
+}
+
+bool CoalescingTransformFilter::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	return limit(id, transform, uncertainty, true, timeStamp);
+}
+
+bool CoalescingTransformFilter::deleteNode(Id id) {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		std::map<Id, TransformSlot>::iterator slot = slots.find(id);
+		if (slot != slots.end()) {
+			if (slot->second.isPending) {
+				pendingCount--; // the node is gone, so its last pose is obsolete
+			}
+			slots.erase(slot);
+		}
+	}
+	forwardPendingSamples(true);
+	return next->deleteNode(id);
+}
+
+bool CoalescingTransformFilter::addParent(Id id, Id parentId) {
+	forwardPendingSamples(true);
+	return next->addParent(id, parentId);
+}
+
+bool CoalescingTransformFilter::removeParent(Id id, Id parentId) {
+	forwardPendingSamples(true);
+	return next->removeParent(id, parentId);
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,115 @@
+/*
+ * Rate limiter for Transform updates that never drops the latest sample.
+ */
+
+#ifndef RSG_BRIDGE_COALESCINGTRANSFORMFILTER_H_
+#define RSG_BRIDGE_COALESCINGTRANSFORMFILTER_H_
+
+#include "WorldModelAccess.h"
+
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <map>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Counters of a CoalescingTransformFilter.
+ */
+struct CoalescingTransformStatistics {
+	uint64_t forwardedCount; // forwarded immediately
+	uint64_t delayedCount;   // forwarded later by flush() or with a subsequent update
+	uint64_t coalescedCount; // replaced by a newer sample before it was forwarded
+	unsigned int pendingCount;
+};
+
+/**
+ * @brief Limits the rate of Transform updates per Id with latest-value-wins semantics.
+ *
+ * An update of a Transform is forwarded immediately if the last forwarded update of
+ * the same Transform is at least 1/maxFrequency seconds ago. Otherwise it is kept as
+ * pending sample and replaced by any newer update. Pending samples whose slot is due
+ * are forwarded ahead of the next update that passes this filter, and by a timer
+ * thread once start() has been called. So the receivers get the final pose at the
+ * latest 1/maxFrequency seconds after the last update, while the bandwidth per
+ * Transform is bounded.
+ *
+ * Samples are always forwarded under the write lock of the World Model: by the thread
+ * that updates the World Model, by the caller of flush() or by the timer, which takes
+ * the write lock itself. Thus, the observers behind this filter are never called concurrently.
+ */
+class CoalescingTransformFilter : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	/**
+	 * @param next Observer that gets the filtered updates. Not owned.
+	 * @param maxFrequency Maximum number of updates per second and Transform.
+	 */
+	CoalescingTransformFilter(brics_3d::rsg::ISceneGraphUpdateObserver* next, double maxFrequency);
+	virtual ~CoalescingTransformFilter();
+
+	/// Start the timer thread that forwards the due samples under the write lock of access.
+	void start(WorldModelAccess* access);
+
+	/// Stop the timer thread. The caller must not hold the lock of the World Model.
+	void stop();
+
+	/// Forward all pending samples, regardless of their slot. The caller holds the write lock of the World Model.
+	void flush();
+
+	CoalescingTransformStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	struct TransformSlot {
+		double lastForwardTime;
+		bool isPending;
+		bool hasUncertainty;
+		brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform;
+		brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty;
+		brics_3d::rsg::TimeStamp timeStamp;
+	};
+
+	bool limit(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform,
+			brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, bool hasUncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	void forwardPendingSamples(bool dueOnly);
+	double getNextDueTime() const;
+	void forwardDueSamples();
+	static double now();
+
+	brics_3d::rsg::ISceneGraphUpdateObserver* next;
+	double minInterval;
+
+	std::map<brics_3d::rsg::Id, TransformSlot> slots;
+	unsigned int pendingCount;
+	CoalescingTransformStatistics statistics;
+
+	boost::mutex mutex;
+	boost::condition_variable samplePending;
+	boost::thread* timer;
+	bool isRunning;
+	WorldModelAccess* access;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_COALESCINGTRANSFORMFILTER_H_ */
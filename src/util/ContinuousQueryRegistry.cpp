@@ -0,0 +1,567 @@
+#include "ContinuousQueryRegistry.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/regex.hpp>
+#include <boost/bind.hpp>
+
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <time.h>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+static const boost::regex continuousQueryMessagePattern("\"@worldmodeltype\"\\s*:\\s*\"RSGContinuousQuery\"");
+static const boost::regex readOnlyQueryPattern("\"@worldmodeltype\"\\s*:\\s*\"RSGQuery\"");
+static const boost::regex searchQueryPattern("\"query\"\\s*:\\s*\"(GET_NODES|GET_ROOT_NODE|GET_REMOTE_ROOT_NODES)\"");
+static const boost::regex uuidPattern("[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}");
+static const boost::regex nowPattern("\"\\$now\"");
+static const boost::regex firstAttributeKeyPattern("\"attributes\"\\s*:\\s*\\[\\s*\\{[^}]*\"key\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex successPattern("\"querySuccess\"\\s*:\\s*true");
+
+/* One registry per World Model. Blocks of the same process share it via this library. */
+static boost::mutex registryMutex;
+static std::map<brics_3d::WorldModel*, ContinuousQueryRegistry*> registries;
+static std::map<brics_3d::WorldModel*, IOutputPort*> outputs; // also for registries that do not exist yet
+
+ContinuousQueryRegistry* ContinuousQueryRegistry::get(brics_3d::WorldModel* wm) {
+	boost::unique_lock<boost::mutex> lock(registryMutex);
+	std::map<brics_3d::WorldModel*, ContinuousQueryRegistry*>::iterator it = registries.find(wm);
+	if (it != registries.end()) {
+		return it->second;
+	}
+	ContinuousQueryRegistry* registry = new ContinuousQueryRegistry(wm); // lives as long as the process
+	std::map<brics_3d::WorldModel*, IOutputPort*>::iterator output = outputs.find(wm);
+	if (output != outputs.end()) {
+		registry->setOutputPort(output->second);
+	}
+	registries.insert(std::make_pair(wm, registry));
+	return registry;
+}
+
+ContinuousQueryRegistry* ContinuousQueryRegistry::find(brics_3d::WorldModel* wm) {
+	boost::unique_lock<boost::mutex> lock(registryMutex);
+	std::map<brics_3d::WorldModel*, ContinuousQueryRegistry*>::iterator it = registries.find(wm);
+	return (it != registries.end()) ? it->second : 0;
+}
+
+void ContinuousQueryRegistry::setOutputPort(brics_3d::WorldModel* wm, IOutputPort* output) {
+	boost::unique_lock<boost::mutex> lock(registryMutex);
+	outputs[wm] = output;
+	std::map<brics_3d::WorldModel*, ContinuousQueryRegistry*>::iterator it = registries.find(wm);
+	if (it != registries.end()) {
+		it->second->setOutputPort(output);
+	}
+}
+
+ContinuousQueryRegistry::ContinuousQueryRegistry(brics_3d::WorldModel* wm) :
+		wm(wm), output(0), writeCount(0), isRunning(true) {
+	access = WorldModelAccess::get(wm);
+	queryRunner = new JSONQueryRunner(wm);
+	wm->scene.attachUpdateObserver(this);
+	timer = new boost::thread(boost::bind(&ContinuousQueryRegistry::evaluateDueQueries, this));
+}
+
+ContinuousQueryRegistry::~ContinuousQueryRegistry() {
+	wm->scene.detachUpdateObserver(this);
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		isRunning = false;
+		queryDirty.notify_all();
+	}
+	timer->join();
+	delete timer;
+	timer = 0;
+	delete queryRunner;
+	queryRunner = 0;
+}
+
+double ContinuousQueryRegistry::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+bool ContinuousQueryRegistry::isContinuousQueryMessage(const std::string& message) {
+	return boost::regex_search(message, continuousQueryMessagePattern);
+}
+
+void ContinuousQueryRegistry::setOutputPort(IOutputPort* output) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->output = output;
+	while (writeCount > 0) {
+		writeDone.wait(lock);
+	}
+}
+
+unsigned int ContinuousQueryRegistry::getSize() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return static_cast<unsigned int>(queries.size());
+}
+
+bool ContinuousQueryRegistry::getString(const std::string& message, const std::string& key, std::string& value) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+	value = match[1];
+	return true;
+}
+
+bool ContinuousQueryRegistry::getNumber(const std::string& message, const std::string& key, double& value) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*([-+0-9.eE]+)");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+	value = atof(std::string(match[1]).c_str());
+	return true;
+}
+
+bool ContinuousQueryRegistry::getObject(const std::string& message, const std::string& key, std::string& object) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*\\{");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+
+	/* Find the matching brace, skipping strings */
+	size_t begin = match.position(static_cast<size_t>(0)) + match.length(0) - 1;
+	int depth = 0;
+	bool isString = false;
+	for (size_t i = begin; i < message.size(); ++i) {
+		char c = message[i];
+		if (isString) {
+			if (c == '\\') {
+				++i;
+			} else if (c == '"') {
+				isString = false;
+			}
+		} else if (c == '"') {
+			isString = true;
+		} else if (c == '{') {
+			depth++;
+		} else if (c == '}') {
+			if (--depth == 0) {
+				object = message.substr(begin, i - begin + 1);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * Splits a reply into its structure and the numbers outside of strings. The reply
+ * has changed if the structure differs or if any number differs by more than threshold.
+ */
+static void split(const std::string& reply, std::string& structure, std::vector<double>& numbers) {
+	bool isString = false;
+	for (size_t i = 0; i < reply.size(); ++i) {
+		char c = reply[i];
+		if (isString) {
+			if (c == '\\' && (i + 1 < reply.size())) {
+				structure.push_back(c);
+				c = reply[++i];
+			} else if (c == '"') {
+				isString = false;
+			}
+		} else if (c == '"') {
+			isString = true;
+		} else if (c == '-' || (c >= '0' && c <= '9')) {
+			char* end = 0;
+			double number = strtod(reply.c_str() + i, &end);
+			if (end != reply.c_str() + i) {
+				numbers.push_back(number);
+				i = (end - reply.c_str()) - 1;
+				c = '#';
+			}
+		}
+		structure.push_back(c);
+	}
+}
+
+bool ContinuousQueryRegistry::hasChanged(const std::string& lastResult, const std::string& result, double threshold) {
+	std::string lastStructure;
+	std::string structure;
+	std::vector<double> lastNumbers;
+	std::vector<double> numbers;
+	split(lastResult, lastStructure, lastNumbers);
+	split(result, structure, numbers);
+	if ((structure != lastStructure) || (numbers.size() != lastNumbers.size())) {
+		return true;
+	}
+	for (unsigned int i = 0; i < numbers.size(); ++i) {
+		if (fabs(numbers[i] - lastNumbers[i]) > threshold) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ContinuousQueryRegistry::isRegisterMessage(const std::string& message) {
+	std::string operation;
+	return isContinuousQueryMessage(message) && getString(message, "operation", operation) && (operation == "REGISTER");
+}
+
+void ContinuousQueryRegistry::createResult(const std::string& message, bool success, std::string& result) {
+	std::string operation;
+	std::string queryId;
+	std::string monitorId;
+	getString(message, "operation", operation);
+	getString(message, "monitorId", monitorId);
+	bool hasQueryId = getString(message, "queryId", queryId);
+
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGContinuousQueryResult\", \"operation\": \"" << operation << "\", ";
+	if (hasQueryId) {
+		reply << "\"queryId\": \"" << queryId << "\", ";
+	}
+	if (!monitorId.empty()) {
+		reply << "\"monitorId\": \"" << monitorId << "\", ";
+	}
+	reply << "\"querySuccess\": " << (success ? "true" : "false") << "}";
+	result = reply.str();
+}
+
+bool ContinuousQueryRegistry::handleMessage(const std::string& message, std::string& result) {
+	std::string operation;
+	std::string monitorId;
+	bool success = false;
+	getString(message, "operation", operation);
+	getString(message, "monitorId", monitorId);
+
+	if (operation == "REGISTER") {
+		ContinuousQuery query;
+		if (monitorId.empty()) {
+			LOG(ERROR) << "ContinuousQueryRegistry: REGISTER requires a monitorId.";
+		} else if (!getObject(message, "query", query.query) || !boost::regex_search(query.query, readOnlyQueryPattern)) {
+			LOG(ERROR) << "ContinuousQueryRegistry: REGISTER requires an RSGQuery as query.";
+		} else {
+			query.monitorId = monitorId;
+			query.isSearch = boost::regex_search(query.query, searchQueryPattern);
+			query.minPeriod = 0;
+			query.threshold = 0;
+			getNumber(message, "minPeriod", query.minPeriod);
+			getNumber(message, "threshold", query.threshold);
+			query.lastEvaluationTime = 0;
+			query.isDirty = true; // first evaluation as soon as possible
+			query.pushCount = 0;
+
+			boost::unique_lock<boost::mutex> lock(mutex);
+			std::map<std::string, ContinuousQuery>::iterator existing = queries.find(monitorId);
+			if (existing != queries.end()) {
+				removeDependencies(existing->second);
+			}
+			queries[monitorId] = query;
+			indexSearches();
+			queryDirty.notify_all();
+			success = true;
+			LOG(INFO) << "ContinuousQueryRegistry: Registered " << monitorId << " with a minimum period of " << query.minPeriod << " s.";
+		}
+	} else if (operation == "UNREGISTER") {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		std::map<std::string, ContinuousQuery>::iterator existing = queries.find(monitorId);
+		if (existing != queries.end()) {
+			removeDependencies(existing->second);
+			queries.erase(existing);
+			indexSearches();
+			success = true;
+		}
+	} else {
+		LOG(ERROR) << "ContinuousQueryRegistry: Unknown operation " << operation;
+	}
+
+	createResult(message, success, result);
+	return success;
+}
+
+void ContinuousQueryRegistry::getDependencies(const std::string& query, const std::string& result, std::set<Id>& dependencies) {
+	boost::sregex_iterator end;
+	for (boost::sregex_iterator it(query.begin(), query.end(), uuidPattern); it != end; ++it) {
+		Id id;
+		if (!id.fromString((*it)[0])) {
+			continue;
+		}
+
+		/* The path of a node to the root, e.g. for GET_TRANSFORM */
+		std::vector<Id> pending(1, id);
+		while (!pending.empty()) {
+			Id current = pending.back();
+			pending.pop_back();
+			if (!dependencies.insert(current).second) {
+				continue;
+			}
+			vector<Id> parentIds;
+			if (wm->scene.getNodeParents(current, parentIds)) {
+				pending.insert(pending.end(), parentIds.begin(), parentIds.end());
+			}
+		}
+	}
+	for (boost::sregex_iterator it(result.begin(), result.end(), uuidPattern); it != end; ++it) {
+		Id id;
+		if (id.fromString((*it)[0])) {
+			dependencies.insert(id);
+		}
+	}
+}
+
+void ContinuousQueryRegistry::removeDependencies(const ContinuousQuery& query) {
+	for (std::set<Id>::const_iterator it = query.dependencies.begin(); it != query.dependencies.end(); ++it) {
+		std::map<Id, std::set<std::string> >::iterator monitorIds = dependents.find(*it);
+		if (monitorIds != dependents.end()) {
+			monitorIds->second.erase(query.monitorId);
+			if (monitorIds->second.empty()) {
+				dependents.erase(monitorIds);
+			}
+		}
+	}
+}
+
+void ContinuousQueryRegistry::indexSearches() {
+	searches.clear();
+	searchIndex.clear();
+	for (std::map<std::string, ContinuousQuery>::const_iterator it = queries.begin(); it != queries.end(); ++it) {
+		if (!it->second.isSearch) {
+			continue;
+		}
+		boost::smatch key;
+		if (boost::regex_search(it->second.query, key, firstAttributeKeyPattern)) {
+			searchIndex.addListener(searches.size(), key[1]);
+		} else {
+			searchIndex.addListener(searches.size(), ""); // e.g. GET_ROOT_NODE
+		}
+		searches.push_back(it->first);
+	}
+}
+
+DispatchStatistics ContinuousQueryRegistry::getDispatchStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return searchIndex.getStatistics();
+}
+
+void ContinuousQueryRegistry::markDirty(Id id) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	bool isTriggered = false;
+	std::map<Id, std::set<std::string> >::const_iterator monitorIds = dependents.find(id);
+	if (monitorIds != dependents.end()) {
+		for (std::set<std::string>::const_iterator it = monitorIds->second.begin(); it != monitorIds->second.end(); ++it) {
+			std::map<std::string, ContinuousQuery>::iterator query = queries.find(*it);
+			if ((query != queries.end()) && !query->second.isDirty) {
+				query->second.isDirty = true;
+				isTriggered = true;
+			}
+		}
+	}
+	if (isTriggered) {
+		queryDirty.notify_all();
+	}
+}
+
+void ContinuousQueryRegistry::markSearchesDirty(Id id, const vector<Attribute>* attributes, unsigned int atomType) {
+	markDirty(id); // searches that returned the node before, e.g. if it lost a matching attribute
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (searches.empty()) {
+		return;
+	}
+	double startTime = DispatchIndex::now();
+	std::vector<unsigned int> candidates;
+	searchIndex.getCandidates(attributes, atomType, candidates);
+	bool isTriggered = false;
+	for (std::vector<unsigned int>::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+		std::map<std::string, ContinuousQuery>::iterator query = queries.find(searches[*it]);
+		if ((query != queries.end()) && !query->second.isDirty) {
+			query->second.isDirty = true;
+			isTriggered = true;
+		}
+	}
+	searchIndex.recordDispatch(startTime, candidates.size());
+	if (isTriggered) {
+		queryDirty.notify_all();
+	}
+}
+
+double ContinuousQueryRegistry::getNextDueTime() {
+	double nextDueTime = -1;
+	for (std::map<std::string, ContinuousQuery>::const_iterator it = queries.begin(); it != queries.end(); ++it) {
+		if (it->second.isDirty) {
+			double dueTime = it->second.lastEvaluationTime + it->second.minPeriod;
+			if ((nextDueTime < 0) || (dueTime < nextDueTime)) {
+				nextDueTime = dueTime;
+			}
+		}
+	}
+	return nextDueTime;
+}
+
+void ContinuousQueryRegistry::evaluateDueQueries() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (isRunning) {
+		double dueTime = getNextDueTime();
+		if (dueTime < 0) {
+			queryDirty.wait(lock);
+			continue;
+		}
+		double currentTime = now();
+		if (currentTime < dueTime) {
+			queryDirty.timed_wait(lock, boost::posix_time::microseconds(static_cast<long>((dueTime - currentTime) * 1.0e6) + 1));
+			continue;
+		}
+
+		/* The read lock has to be taken first, as updates hold the write lock while they mark queries */
+		lock.unlock();
+		std::vector<std::string> messages;
+		IOutputPort* currentOutput = 0;
+		{
+			WorldModelReadLock wmLock(access);
+			std::vector<std::pair<std::string, std::string> > dueQueries; // monitorId, query
+			lock.lock();
+			currentTime = now();
+			for (std::map<std::string, ContinuousQuery>::iterator it = queries.begin(); it != queries.end(); ++it) {
+				if (it->second.isDirty && (currentTime - it->second.lastEvaluationTime >= it->second.minPeriod)) {
+					dueQueries.push_back(std::make_pair(it->first, it->second.query));
+					it->second.isDirty = false;
+					it->second.lastEvaluationTime = currentTime;
+				}
+			}
+			lock.unlock();
+
+			std::vector<std::string> results(dueQueries.size());
+			std::vector<std::set<Id> > dependencies(dueQueries.size());
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			std::stringstream stamp;
+			stamp.precision(15);
+			stamp << (ts.tv_sec * 1.0e3 + ts.tv_nsec * 1.0e-6);
+			for (unsigned int i = 0; i < dueQueries.size(); ++i) {
+				std::string query = boost::regex_replace(dueQueries[i].second, nowPattern, stamp.str());
+				queryRunner->query(query, results[i]);
+				getDependencies(query, results[i], dependencies[i]);
+			}
+
+			/* Still under the read lock, so no change can be missed between evaluation and indexing */
+			lock.lock();
+			for (unsigned int i = 0; i < dueQueries.size(); ++i) {
+				std::map<std::string, ContinuousQuery>::iterator query = queries.find(dueQueries[i].first);
+				if (query == queries.end()) {
+					continue; // unregistered in the meantime
+				}
+				removeDependencies(query->second);
+				query->second.dependencies.swap(dependencies[i]);
+				for (std::set<Id>::const_iterator it = query->second.dependencies.begin(); it != query->second.dependencies.end(); ++it) {
+					dependents[*it].insert(query->first);
+				}
+
+				if (!boost::regex_search(results[i], successPattern)) {
+					LOG(DEBUG) << "ContinuousQueryRegistry: Query of " << query->first << " failed. Nothing is pushed.";
+					continue;
+				}
+				if ((query->second.pushCount > 0) && !hasChanged(query->second.lastResult, results[i], query->second.threshold)) {
+					continue;
+				}
+				query->second.lastResult = results[i];
+				query->second.pushCount++;
+				messages.push_back("{\"@worldmodeltype\": \"RSGMonitor\", \"monitorId\": \"" + query->first + "\", \"result\": " + results[i] + "}");
+			}
+			currentOutput = output;
+			if (currentOutput != 0) {
+				writeCount++; // the port is not replaced until the messages are written
+			}
+			lock.unlock();
+		}
+
+		if (currentOutput == 0 && !messages.empty()) {
+			LOG(WARNING) << "ContinuousQueryRegistry: No monitor port set. Discarding " << messages.size() << " results.";
+		}
+		for (unsigned int i = 0; (currentOutput != 0) && (i < messages.size()); ++i) {
+			int transferredBytes = 0;
+			currentOutput->write(messages[i].c_str(), static_cast<int>(messages[i].size()), transferredBytes);
+		}
+		lock.lock();
+		if (currentOutput != 0) {
+			writeCount--;
+			writeDone.notify_all();
+		}
+	}
+}
+
+bool ContinuousQueryRegistry::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_NODE);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_GROUP);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_TRANSFORM);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_TRANSFORM);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_GEOMETRIC_NODE);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	markSearchesDirty(rootId, &attributes, DISPATCH_GROUP);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	markSearchesDirty(assignedId, &attributes, DISPATCH_CONNECTION);
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	markSearchesDirty(id, &newAttributes, DISPATCH_ANY_ATOM);
+	return true;
+}
+
+bool ContinuousQueryRegistry::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	markDirty(id);
+	return true;
+}
+
+bool ContinuousQueryRegistry::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	markDirty(id);
+	return true;
+}
+
+bool ContinuousQueryRegistry::deleteNode(Id id) {
+	markSearchesDirty(id, 0, DISPATCH_ANY_ATOM);
+	return true;
+}
+
+bool ContinuousQueryRegistry::addParent(Id id, Id parentId) {
+	markSearchesDirty(id, 0, DISPATCH_ANY_ATOM); // e.g. a GET_NODES query on a subgraph
+	markDirty(parentId);
+	return true;
+}
+
+bool ContinuousQueryRegistry::removeParent(Id id, Id parentId) {
+	markSearchesDirty(id, 0, DISPATCH_ANY_ATOM);
+	markDirty(parentId);
+	return true;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,161 @@
+/*
+ * Queries that are re-evaluated on changes and pushed as monitor messages.
+ */
+
+#ifndef RSG_BRIDGE_CONTINUOUSQUERYREGISTRY_H_
+#define RSG_BRIDGE_CONTINUOUSQUERYREGISTRY_H_
+
+#include "WorldModelAccess.h"
+#include "DispatchIndex.h"
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+#include <brics_3d/worldModel/sceneGraph/IOutputPort.h>
+#include <brics_3d/worldModel/sceneGraph/JSONQueryRunner.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief A registered query and the state of its last evaluation.
+ */
+struct ContinuousQuery {
+	std::string monitorId;
+	std::string query;      // RSGQuery, may contain "$now" as stamp
+	bool isSearch;          // GET_NODES etc. can match new nodes
+	double minPeriod;       // [s] between two evaluations
+	double threshold;       // minimum change of a number in the reply to push it
+	double lastEvaluationTime;
+	bool isDirty;
+	std::string lastResult; // last pushed reply
+	std::set<brics_3d::rsg::Id> dependencies;
+	uint64_t pushCount;
+};
+
+/**
+ * @brief Continuous queries of a World Model, pushed via the monitor port.
+ *
+ * Instead of polling, a client registers any RSGQuery once:
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGContinuousQuery",
+ *   "operation": "REGISTER",  // or "UNREGISTER"
+ *   "monitorId": "<uuid>",
+ *   "minPeriod": 0.2,         // optional, in [s]
+ *   "threshold": 0.01,        // optional, minimum change of any number in the reply
+ *   "query": {"@worldmodeltype": "RSGQuery", "query": "GET_TRANSFORM", "id": "<uuid>", "idReferenceNode": "<uuid>",
+ *             "timeStamp": {"@stamptype": "TimeStampUTCms", "stamp": "$now"}}
+ * }
+ * @endcode
+ * The placeholder "$now" is replaced by the current time in [ms] on every evaluation.
+ * Results are pushed as monitor messages:
+ * @code
+ * {"@worldmodeltype": "RSGMonitor", "monitorId": "<uuid>", "result": <RSGQueryResult>}
+ * @endcode
+ *
+ * The registry observes the scene. A query depends on the nodes that appear in the
+ * query or in its last reply and on all their ancestors, so a changed Transform on the
+ * path of a GET_TRANSFORM query triggers it. Searches additionally depend on new nodes
+ * and attribute updates, selected by a DispatchIndex over the first attribute key of
+ * a GET_NODES query. A timer thread evaluates the triggered queries at most every
+ * minPeriod under the read lock of the World Model and pushes the result if it differs
+ * from the last pushed one by more than threshold. Updates never wait for an evaluation.
+ *
+ * The registry is shared by all blocks via ContinuousQueryRegistry::get(): rsg_json_query
+ * creates it with the first REGISTER and rsg_json_sender sets the monitor port via
+ * setOutputPort(wm, output), which also applies to a registry that is created later.
+ * So a World Model without continuous queries has no observer and no timer thread.
+ */
+class ContinuousQueryRegistry : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+
+	/// Get the registry for a World Model. It is created and attached to the scene on first use, so call it under the write lock.
+	static ContinuousQueryRegistry* get(brics_3d::WorldModel* wm);
+
+	/// Get the registry for a World Model or 0 if none has been created yet.
+	static ContinuousQueryRegistry* find(brics_3d::WorldModel* wm);
+
+	/// Set the monitor port of the current or of a later registry for a World Model. Not owned.
+	static void setOutputPort(brics_3d::WorldModel* wm, brics_3d::rsg::IOutputPort* output);
+
+	/// True for RSGContinuousQuery messages.
+	static bool isContinuousQueryMessage(const std::string& message);
+
+	/// True for RSGContinuousQuery messages with the REGISTER operation.
+	static bool isRegisterMessage(const std::string& message);
+
+	/// Create the RSGContinuousQueryResult for a message, e.g. a failed one for an UNREGISTER without registry.
+	static void createResult(const std::string& message, bool success, std::string& result);
+
+	/// Process an RSGContinuousQuery message and create the RSGContinuousQueryResult.
+	bool handleMessage(const std::string& message, std::string& result);
+
+	/// Port for the monitor messages, the same as the one of SceneGraphFacade::setMonitorPort(). Not owned.
+	/// Waits until the timer no longer writes to the former port, so it can be deleted afterwards.
+	void setOutputPort(brics_3d::rsg::IOutputPort* output);
+
+	unsigned int getSize();
+
+	/// Cost of selecting the search queries that are triggered by an update.
+	DispatchStatistics getDispatchStatistics();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	ContinuousQueryRegistry(brics_3d::WorldModel* wm);
+	virtual ~ContinuousQueryRegistry();
+
+	static double now();
+	static bool getString(const std::string& message, const std::string& key, std::string& value);
+	static bool getNumber(const std::string& message, const std::string& key, double& value);
+	static bool getObject(const std::string& message, const std::string& key, std::string& object);
+	static bool hasChanged(const std::string& lastResult, const std::string& result, double threshold);
+
+	void markDirty(brics_3d::rsg::Id id);
+	void markSearchesDirty(brics_3d::rsg::Id id, const vector<brics_3d::rsg::Attribute>* attributes, unsigned int atomType);
+	void removeDependencies(const ContinuousQuery& query);
+	void indexSearches();
+	double getNextDueTime();
+	void evaluateDueQueries();
+	void getDependencies(const std::string& query, const std::string& result, std::set<brics_3d::rsg::Id>& dependencies);
+
+	brics_3d::WorldModel* wm;
+	WorldModelAccess* access;
+	brics_3d::rsg::JSONQueryRunner* queryRunner; // only used by the timer
+	brics_3d::rsg::IOutputPort* output;
+
+	boost::mutex mutex;
+	boost::condition_variable queryDirty;
+	boost::condition_variable writeDone;
+	unsigned int writeCount; // writes to output in progress
+	boost::thread* timer;
+	bool isRunning;
+	std::map<std::string, ContinuousQuery> queries; // by monitorId
+	std::map<brics_3d::rsg::Id, std::set<std::string> > dependents; // monitorIds of the queries that depend on a node
+	std::vector<std::string> searches; // monitorIds of the search queries, numbered as listeners of searchIndex
+	DispatchIndex searchIndex;         // by the first attribute key of a GET_NODES query
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_CONTINUOUSQUERYREGISTRY_H_ */
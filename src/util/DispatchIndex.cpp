@@ -0,0 +1,171 @@
+#include "DispatchIndex.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <time.h>
+
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+DispatchIndex::DispatchIndex() : listenerCount(0) {
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+DispatchIndex::~DispatchIndex() {
+
+}
+
+double DispatchIndex::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+void DispatchIndex::clear() {
+	clearListeners();
+	known.clear();
+}
+
+void DispatchIndex::clearListeners() {
+	listenerCount = 0;
+	unkeyed.clear();
+	byKey.clear();
+	byPrefix.clear();
+	otherPrefixes.clear();
+}
+
+void DispatchIndex::remapKnown(const std::vector<int>& newListeners) {
+	std::map<Id, std::set<unsigned int> >::iterator it = known.begin();
+	while (it != known.end()) {
+		std::set<unsigned int> listeners;
+		for (std::set<unsigned int>::const_iterator listener = it->second.begin(); listener != it->second.end(); ++listener) {
+			if ((*listener < newListeners.size()) && (newListeners[*listener] >= 0)) {
+				listeners.insert(static_cast<unsigned int>(newListeners[*listener]));
+			}
+		}
+		if (listeners.empty()) {
+			known.erase(it++);
+		} else {
+			it->second.swap(listeners);
+			++it;
+		}
+	}
+}
+
+void DispatchIndex::addListener(unsigned int listener, const std::string& key, bool isPrefix, unsigned int atomTypes) {
+	Listener entry;
+	entry.listener = listener;
+	entry.atomTypes = atomTypes;
+	listenerCount++;
+
+	if (key.empty()) {
+		unkeyed.push_back(entry);
+	} else if (!isPrefix) {
+		byKey[key].push_back(entry);
+	} else if (key.find(':') == key.size() - 1) {
+		byPrefix[key].push_back(entry);
+	} else {
+		otherPrefixes.push_back(std::make_pair(key, entry));
+	}
+}
+
+void DispatchIndex::addKnown(Id id, unsigned int listener) {
+	known[id].insert(listener);
+}
+
+void DispatchIndex::removeKnown(Id id) {
+	known.erase(id);
+}
+
+bool DispatchIndex::getKnown(Id id, std::set<unsigned int>& listeners) const {
+	std::map<Id, std::set<unsigned int> >::const_iterator it = known.find(id);
+	if (it == known.end()) {
+		return false;
+	}
+	listeners = it->second;
+	return true;
+}
+
+void DispatchIndex::append(const std::vector<Listener>& listeners, unsigned int atomType, std::vector<unsigned int>& candidates) {
+	for (std::vector<Listener>::const_iterator it = listeners.begin(); it != listeners.end(); ++it) {
+		if (it->atomTypes & atomType) {
+			candidates.push_back(it->listener);
+		}
+	}
+}
+
+void DispatchIndex::getCandidates(const std::vector<Attribute>* attributes, unsigned int atomType, std::vector<unsigned int>& candidates) {
+	candidates.clear();
+	append(unkeyed, atomType, candidates);
+
+	if (attributes == 0) { // unknown attributes, so every keyed listener could match
+		for (std::map<std::string, std::vector<Listener> >::const_iterator it = byKey.begin(); it != byKey.end(); ++it) {
+			append(it->second, atomType, candidates);
+		}
+		for (std::map<std::string, std::vector<Listener> >::const_iterator it = byPrefix.begin(); it != byPrefix.end(); ++it) {
+			append(it->second, atomType, candidates);
+		}
+		for (std::vector<std::pair<std::string, Listener> >::const_iterator it = otherPrefixes.begin(); it != otherPrefixes.end(); ++it) {
+			if (it->second.atomTypes & atomType) {
+				candidates.push_back(it->second.listener);
+			}
+		}
+	} else {
+		for (std::vector<Attribute>::const_iterator attribute = attributes->begin(); attribute != attributes->end(); ++attribute) {
+			std::map<std::string, std::vector<Listener> >::const_iterator listeners = byKey.find(attribute->key);
+			if (listeners != byKey.end()) {
+				append(listeners->second, atomType, candidates);
+			}
+			size_t separator = attribute->key.find(':');
+			if (!byPrefix.empty() && (separator != std::string::npos)) {
+				listeners = byPrefix.find(attribute->key.substr(0, separator + 1));
+				if (listeners != byPrefix.end()) {
+					append(listeners->second, atomType, candidates);
+				}
+			}
+			for (std::vector<std::pair<std::string, Listener> >::const_iterator it = otherPrefixes.begin(); it != otherPrefixes.end(); ++it) {
+				if ((it->second.atomTypes & atomType) && (attribute->key.compare(0, it->first.size(), it->first) == 0)) {
+					candidates.push_back(it->second.listener);
+				}
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+void DispatchIndex::recordDispatch(double startTime, unsigned int evaluatedCount) {
+	double duration = now() - startTime;
+	statistics.dispatchCount++;
+	statistics.listenerCount += listenerCount;
+	statistics.candidateCount += evaluatedCount;
+	statistics.dispatchTime += duration;
+	if (duration > statistics.maxDispatchTime) {
+		statistics.maxDispatchTime = duration;
+	}
+}
+
+std::string DispatchIndex::getStatisticsAsString() const {
+	std::stringstream result;
+	result << "dispatches = " << statistics.dispatchCount
+			<< ", evaluated listeners = " << statistics.candidateCount
+			<< " of " << statistics.listenerCount
+			<< ", avg. dispatch time = " << ((statistics.dispatchCount > 0) ? statistics.dispatchTime / statistics.dispatchCount * 1.0e6 : 0.0) << " us"
+			<< ", max. dispatch time = " << statistics.maxDispatchTime * 1.0e6 << " us";
+	return result.str();
+}
+
+std::string DispatchIndex::getStatisticsAsJSON() const {
+	std::stringstream result;
+	result << "{\"dispatches\": " << statistics.dispatchCount
+			<< ", \"evaluatedListeners\": " << statistics.candidateCount
+			<< ", \"registeredListeners\": " << statistics.listenerCount
+			<< ", \"avgDispatchTime\": " << ((statistics.dispatchCount > 0) ? statistics.dispatchTime / statistics.dispatchCount : 0.0)
+			<< ", \"maxDispatchTime\": " << statistics.maxDispatchTime << "}";
+	return result.str();
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,121 @@
+/*
+ * Index that selects the listeners that could match an update.
+ */
+
+#ifndef RSG_BRIDGE_DISPATCHINDEX_H_
+#define RSG_BRIDGE_DISPATCHINDEX_H_
+
+#include <brics_3d/worldModel/sceneGraph/Id.h>
+#include <brics_3d/worldModel/sceneGraph/Attribute.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+/// Atom types as bit mask.
+enum DispatchAtomType {
+	DISPATCH_NODE = 1,
+	DISPATCH_GROUP = 2,
+	DISPATCH_TRANSFORM = 4,
+	DISPATCH_GEOMETRIC_NODE = 8,
+	DISPATCH_CONNECTION = 16,
+	DISPATCH_ANY_ATOM = 31
+};
+
+/**
+ * @brief Counters of a DispatchIndex.
+ */
+struct DispatchStatistics {
+	uint64_t dispatchCount;  // updates that were dispatched
+	uint64_t listenerCount;  // sum of the registered listeners, i.e. the evaluations without index
+	uint64_t candidateCount; // sum of the evaluated listeners
+	double dispatchTime;     // [s] spent in selecting and evaluating the listeners
+	double maxDispatchTime;  // [s]
+};
+
+/**
+ * @brief Selects the listeners that could possibly match an update.
+ *
+ * Listeners are numbered by their owner and registered with a necessary condition:
+ * an attribute key (or key prefix, e.g. "osm:") the node must have and a mask of atom
+ * types. Listeners without key are candidates for every node of their types. In
+ * addition, the index keeps for every node the listeners it matched before, so
+ * updates of known nodes are dispatched by a single lookup of the node Id.
+ *
+ * The owner evaluates the full condition of the candidates only. The index has no
+ * lock of its own.
+ */
+class DispatchIndex {
+public:
+	DispatchIndex();
+	virtual ~DispatchIndex();
+
+	/// Remove all listeners and known nodes.
+	void clear();
+
+	/// Remove all listeners but keep the known nodes, e.g. before the listeners are registered again.
+	void clearListeners();
+
+	/// Renumber the listeners of the known nodes. Listeners mapped to a negative number are dropped.
+	void remapKnown(const std::vector<int>& newListeners);
+
+	/**
+	 * @brief Register a listener.
+	 * @param key Attribute key a node needs to match. Empty for every node.
+	 * @param isPrefix If true, any key that starts with key is sufficient.
+	 * @param atomTypes Bit mask of DispatchAtomType.
+	 */
+	void addListener(unsigned int listener, const std::string& key, bool isPrefix = false, unsigned int atomTypes = DISPATCH_ANY_ATOM);
+
+	unsigned int getListenerCount() const { return listenerCount; }
+
+	/// Remember that a node matched a listener.
+	void addKnown(brics_3d::rsg::Id id, unsigned int listener);
+
+	/// Forget a node, e.g. when it has been deleted.
+	void removeKnown(brics_3d::rsg::Id id);
+
+	/// Listeners the node matched before. Returns false if there are none.
+	bool getKnown(brics_3d::rsg::Id id, std::set<unsigned int>& listeners) const;
+
+	/**
+	 * @brief Listeners whose condition is fulfilled by the attributes and the atom type.
+	 * @param attributes Attributes of the node. If 0, every listener of the atom type is a candidate.
+	 * @param[out] candidates Sorted and unique.
+	 */
+	void getCandidates(const std::vector<brics_3d::rsg::Attribute>* attributes, unsigned int atomType, std::vector<unsigned int>& candidates);
+
+	/// Account a dispatch that started at startTime (cf. now()) and evaluated the given number of listeners.
+	void recordDispatch(double startTime, unsigned int evaluatedCount);
+
+	/// Monotonic time in [s].
+	static double now();
+
+	DispatchStatistics getStatistics() const { return statistics; }
+	std::string getStatisticsAsString() const;
+	std::string getStatisticsAsJSON() const;
+
+private:
+	struct Listener {
+		unsigned int listener;
+		unsigned int atomTypes;
+	};
+
+	static void append(const std::vector<Listener>& listeners, unsigned int atomType, std::vector<unsigned int>& candidates);
+
+	unsigned int listenerCount;
+	std::vector<Listener> unkeyed;
+	std::map<std::string, std::vector<Listener> > byKey;
+	std::map<std::string, std::vector<Listener> > byPrefix; // prefix up to and including the first ':'
+	std::vector<std::pair<std::string, Listener> > otherPrefixes; // prefixes without ':'
+	std::map<brics_3d::rsg::Id, std::set<unsigned int> > known;
+	DispatchStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_DISPATCHINDEX_H_ */
@@ -0,0 +1,310 @@
+#include "JSONChunkSplitter.h"
+
+#include <ctype.h>
+
+namespace rsg_bridge {
+
+static bool isUuid(const std::string& text, size_t begin, size_t length) {
+	if (length != 36) {
+		return false;
+	}
+	for (size_t i = 0; i < length; ++i) {
+		char c = text[begin + i];
+		if ((i == 8) || (i == 13) || (i == 18) || (i == 23)) {
+			if (c != '-') {
+				return false;
+			}
+		} else if (!isxdigit(c)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+JSONChunkSplitter::JSONChunkSplitter() {
+
+}
+
+JSONChunkSplitter::~JSONChunkSplitter() {
+
+}
+
+size_t JSONChunkSplitter::skipWhitespace(const std::string& text, size_t pos) {
+	while (pos < text.size()) {
+		if (isspace(text[pos])) {
+			pos++;
+		} else if ((text[pos] == '#') || (text.compare(pos, 2, "//") == 0)) { // line comments
+			pos = text.find('\n', pos);
+		} else if (text.compare(pos, 2, "/*") == 0) { // block comments
+			pos = text.find("*/", pos + 2);
+			if (pos != std::string::npos) {
+				pos += 2;
+			}
+		} else {
+			break;
+		}
+	}
+	return (pos == std::string::npos) ? text.size() : pos;
+}
+
+size_t JSONChunkSplitter::skipString(const std::string& text, size_t pos) {
+	/* pos points to the opening quote; returns the position after the closing quote */
+	for (pos++; pos < text.size(); ++pos) {
+		if (text[pos] == '\\') {
+			pos++;
+		} else if (text[pos] == '"') {
+			return pos + 1;
+		}
+	}
+	return std::string::npos;
+}
+
+size_t JSONChunkSplitter::skipValue(const std::string& text, size_t pos) {
+	pos = skipWhitespace(text, pos);
+	if (pos >= text.size()) {
+		return std::string::npos;
+	}
+	if (text[pos] == '"') {
+		return skipString(text, pos);
+	}
+	if ((text[pos] == '{') || (text[pos] == '[')) {
+		int depth = 0;
+		while (pos < text.size()) {
+			char c = text[pos];
+			if (c == '"') {
+				pos = skipString(text, pos);
+				if (pos == std::string::npos) {
+					return pos;
+				}
+				continue;
+			}
+			if ((c == '{') || (c == '[')) {
+				depth++;
+			} else if ((c == '}') || (c == ']')) {
+				depth--;
+				if (depth == 0) {
+					return pos + 1;
+				}
+			}
+			pos++;
+		}
+		return std::string::npos;
+	}
+	/* numbers, true, false, null */
+	while ((pos < text.size()) && (text[pos] != ',') && (text[pos] != '}') && (text[pos] != ']') && !isspace(text[pos])) {
+		pos++;
+	}
+	return pos;
+}
+
+bool JSONChunkSplitter::getMembers(const std::string& text, size_t objectBegin, std::vector<Member>& members) {
+	members.clear();
+	size_t pos = skipWhitespace(text, objectBegin);
+	if ((pos >= text.size()) || (text[pos] != '{')) {
+		return false;
+	}
+	pos++;
+	while (true) {
+		pos = skipWhitespace(text, pos);
+		if (pos >= text.size()) {
+			return false;
+		}
+		if (text[pos] == '}') {
+			return true;
+		}
+		if (text[pos] == ',') {
+			pos++;
+			continue;
+		}
+		if (text[pos] != '"') {
+			return false;
+		}
+		size_t keyEnd = skipString(text, pos);
+		if (keyEnd == std::string::npos) {
+			return false;
+		}
+		Member member;
+		member.key = text.substr(pos + 1, keyEnd - pos - 2);
+		pos = skipWhitespace(text, keyEnd);
+		if ((pos >= text.size()) || (text[pos] != ':')) {
+			return false;
+		}
+		member.valueBegin = skipWhitespace(text, pos + 1);
+		member.valueEnd = skipValue(text, member.valueBegin);
+		if (member.valueEnd == std::string::npos) {
+			return false;
+		}
+		members.push_back(member);
+		pos = member.valueEnd;
+	}
+}
+
+bool JSONChunkSplitter::getElements(const std::string& text, size_t arrayBegin, std::vector<std::pair<size_t, size_t> >& elements) {
+	elements.clear();
+	size_t pos = skipWhitespace(text, arrayBegin);
+	if ((pos >= text.size()) || (text[pos] != '[')) {
+		return false;
+	}
+	pos++;
+	while (true) {
+		pos = skipWhitespace(text, pos);
+		if (pos >= text.size()) {
+			return false;
+		}
+		if (text[pos] == ']') {
+			return true;
+		}
+		if (text[pos] == ',') {
+			pos++;
+			continue;
+		}
+		size_t end = skipValue(text, pos);
+		if (end == std::string::npos) {
+			return false;
+		}
+		elements.push_back(std::make_pair(pos, end));
+		pos = end;
+	}
+}
+
+void JSONChunkSplitter::analyzeIds(JSONChunk& chunk) {
+	const std::string& text = chunk.document;
+	std::set<std::string> referencedIds;
+	bool previousWasIdKey = false;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		if (text[pos] != '"') {
+			if ((text[pos] == ',') || (text[pos] == '{') || (text[pos] == '[')) {
+				previousWasIdKey = false;
+			}
+			pos++;
+			continue;
+		}
+		size_t end = skipString(text, pos);
+		if (end == std::string::npos) {
+			break;
+		}
+		size_t length = end - pos - 2;
+		if (isUuid(text, pos + 1, length)) {
+			std::string id = text.substr(pos + 1, length);
+			if (previousWasIdKey) {
+				chunk.definedIds.insert(id);
+			} else {
+				referencedIds.insert(id);
+			}
+			previousWasIdKey = false;
+		} else {
+			previousWasIdKey = (text.compare(pos, end - pos, "\"id\"") == 0);
+		}
+		pos = end;
+	}
+
+	chunk.isIndependent = true;
+	for (std::set<std::string>::const_iterator it = referencedIds.begin(); it != referencedIds.end(); ++it) {
+		if ((chunk.definedIds.find(*it) == chunk.definedIds.end()) && (it->compare(rootId) != 0)) {
+			chunk.isIndependent = false;
+			break;
+		}
+	}
+}
+
+bool JSONChunkSplitter::split(const std::string& document, std::string& header, std::vector<JSONChunk>& chunks, std::string& trailer) {
+	header.clear();
+	trailer.clear();
+	chunks.clear();
+	rootId.clear();
+
+	std::vector<Member> topLevelMembers;
+	if (!getMembers(document, 0, topLevelMembers)) {
+		return false;
+	}
+
+	/* Everything except the graph itself is copied into every chunk */
+	std::string topLevel;
+	const Member* rootNode = 0;
+	const Member* remoteRootNodes = 0;
+	for (std::vector<Member>::const_iterator it = topLevelMembers.begin(); it != topLevelMembers.end(); ++it) {
+		if (it->key.compare("rootNode") == 0) {
+			rootNode = &(*it);
+		} else if (it->key.compare("remoteRootNodes") == 0) {
+			remoteRootNodes = &(*it);
+		} else {
+			topLevel += "\"" + it->key + "\": " + document.substr(it->valueBegin, it->valueEnd - it->valueBegin) + ", ";
+		}
+	}
+
+	/*
+	 * The root node is split into
+	 *  - its type and Id that are repeated in every chunk,
+	 *  - its attributes (and any other unknown member) for the header and
+	 *  - its connections for the trailer, as they might refer to any chunk.
+	 */
+	std::string rootNodeIdentity;
+	std::string rootNodeRemainder;
+	std::string rootNodeConnections;
+	const Member* childs = 0;
+	if (rootNode != 0) {
+		std::vector<Member> rootNodeMembers;
+		if (!getMembers(document, rootNode->valueBegin, rootNodeMembers)) {
+			return false;
+		}
+		for (std::vector<Member>::const_iterator it = rootNodeMembers.begin(); it != rootNodeMembers.end(); ++it) {
+			std::string member = "\"" + it->key + "\": " + document.substr(it->valueBegin, it->valueEnd - it->valueBegin) + ", ";
+			if (it->key.compare("childs") == 0) {
+				childs = &(*it);
+			} else if (it->key.compare("connections") == 0) {
+				std::vector<std::pair<size_t, size_t> > connections;
+				if (!getElements(document, it->valueBegin, connections) || !connections.empty()) {
+					rootNodeConnections = member;
+				}
+			} else if ((it->key.compare("@graphtype") == 0) || (it->key.compare("id") == 0)) {
+				rootNodeIdentity += member;
+				if ((it->key.compare("id") == 0) && (it->valueEnd - it->valueBegin > 2)) {
+					rootId = document.substr(it->valueBegin + 1, it->valueEnd - it->valueBegin - 2);
+				}
+			} else {
+				rootNodeRemainder += member;
+			}
+		}
+
+		header = "{" + topLevel + "\"rootNode\": {" + rootNodeIdentity + rootNodeRemainder + "\"childs\": []}}";
+		if (!rootNodeConnections.empty()) {
+			trailer = "{" + topLevel + "\"rootNode\": {" + rootNodeIdentity + rootNodeConnections + "\"attributes\": [], \"childs\": []}}";
+		}
+	}
+	std::string emptyRootNode;
+	if (rootNode != 0) {
+		emptyRootNode = "\"rootNode\": {" + rootNodeIdentity + "\"attributes\": [], \"childs\": []}, ";
+	}
+
+	std::vector<std::pair<size_t, size_t> > elements;
+	if (childs != 0) {
+		if (!getElements(document, childs->valueBegin, elements)) {
+			return false;
+		}
+		for (std::vector<std::pair<size_t, size_t> >::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+			JSONChunk chunk;
+			chunk.document = "{" + topLevel + "\"rootNode\": {" + rootNodeIdentity + "\"attributes\": [], \"childs\": [" +
+					document.substr(it->first, it->second - it->first) + "]}}";
+			analyzeIds(chunk);
+			chunks.push_back(chunk);
+		}
+	}
+
+	if (remoteRootNodes != 0) {
+		if (!getElements(document, remoteRootNodes->valueBegin, elements)) {
+			return false;
+		}
+		for (std::vector<std::pair<size_t, size_t> >::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+			JSONChunk chunk;
+			chunk.document = "{" + topLevel + emptyRootNode + "\"remoteRootNodes\": [" +
+					document.substr(it->first, it->second - it->first) + "]}";
+			analyzeIds(chunk);
+			chunks.push_back(chunk);
+		}
+	}
+
+	return true;
+}
+
+} // namespace rsg_bridge
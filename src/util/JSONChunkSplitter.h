@@ -0,0 +1,70 @@
+/*
+ * Splits a RSG-JSON WorldModelAgent document into independent chunks.
+ */
+
+#ifndef RSG_BRIDGE_JSONCHUNKSPLITTER_H_
+#define RSG_BRIDGE_JSONCHUNKSPLITTER_H_
+
+#include <string>
+#include <vector>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief A self contained part of a WorldModelAgent document.
+ */
+struct JSONChunk {
+	std::string document;             // standalone WorldModelAgent document
+	std::set<std::string> definedIds; // Ids that are defined within this chunk
+	bool isIndependent;               // true if the chunk does not refer to Ids of other chunks
+};
+
+/**
+ * @brief Lightweight scanner that splits a WorldModelAgent document without building a DOM.
+ *
+ * Every element of "rootNode"."childs" and of "remoteRootNodes" becomes a chunk
+ * of its own that has the same root node Id as the original document. The
+ * attributes of the root node are held back in a separate header and the
+ * connections of the root node in a separate trailer.
+ * The scanner is lenient like the files in examples/maps/rsg, i.e. trailing
+ * commas and comments are accepted.
+ */
+class JSONChunkSplitter {
+public:
+	JSONChunkSplitter();
+	virtual ~JSONChunkSplitter();
+
+	/**
+	 * @brief Split a document.
+	 * @param document The complete WorldModelAgent document.
+	 * @param[out] header Document with the root node attributes only. It has to be applied first.
+	 * @param[out] chunks Chunks in document order.
+	 * @param[out] trailer Document with the connections of the root node, if any. It has to be applied last.
+	 * @return False if the document does not have the expected structure. Then it should be processed as a whole.
+	 */
+	bool split(const std::string& document, std::string& header, std::vector<JSONChunk>& chunks, std::string& trailer);
+
+	/// Id of the root node in the document. Empty if none is specified.
+	std::string getRootId() const { return rootId; }
+
+private:
+	struct Member {
+		std::string key;
+		size_t valueBegin;
+		size_t valueEnd;
+	};
+
+	size_t skipWhitespace(const std::string& text, size_t pos);
+	size_t skipString(const std::string& text, size_t pos);
+	size_t skipValue(const std::string& text, size_t pos);
+	bool getMembers(const std::string& text, size_t objectBegin, std::vector<Member>& members);
+	bool getElements(const std::string& text, size_t arrayBegin, std::vector<std::pair<size_t, size_t> >& elements);
+	void analyzeIds(JSONChunk& chunk);
+
+	std::string rootId;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_JSONCHUNKSPLITTER_H_ */
@@ -0,0 +1,359 @@
+#include "LDJSONWriter.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+LDJSONWriter::LDJSONWriter() {
+
+}
+
+LDJSONWriter::~LDJSONWriter() {
+
+}
+
+bool LDJSONWriter::write(const SnapshotReader& reader, std::string fileName) {
+	std::ofstream output;
+	output.open(fileName.c_str(), std::ios::trunc);
+	if (output.fail()) {
+		LOG(ERROR) << "LDJSONWriter: Cannot write to file " << fileName;
+		return false;
+	}
+	write(reader, output);
+	output.close();
+	return !output.fail();
+}
+
+unsigned int LDJSONWriter::write(const SnapshotReader& reader, std::ostream& output) {
+	if (!reader.isOpen()) {
+		LOG(ERROR) << "LDJSONWriter: No snapshot opened.";
+		return 0;
+	}
+
+	const SnapshotHeader* header = reader.getHeader();
+	const SnapshotNode* nodes = reader.getNodes();
+	unsigned int lineCount = 0;
+	output << std::setprecision(17);
+
+	/* Header record: tells loaders which Id to map to their own root node */
+	output << "{\"@worldmodeltype\":\"" << RSG_LDJSON_HEADER_TYPE << "\",\"rootId\":";
+	writeId(header->rootId, output);
+	output << ",\"stamp\":";
+	writeStamp(header->stamp, output);
+	output << "}\n";
+
+	/* Tombstones of incremental dumps first, like SnapshotReader::apply() */
+	for (int pass = 0; pass < 2; ++pass) {
+		for (uint64_t i = 0; i < header->nodeCount; ++i) {
+			const SnapshotNode& node = nodes[i];
+			if (isSnapshotTombstone(node.type) != (pass == 0)) {
+				continue;
+			}
+
+			switch (node.type) {
+			case SNAPSHOT_ROOT_ATTRIBUTES:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"UPDATE_ATTRIBUTES\",\"node\":{\"@graphtype\":\"Node\",\"id\":";
+				writeId(header->rootId, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << "}}";
+				break;
+			case SNAPSHOT_NODE:
+			case SNAPSHOT_GROUP:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE\",\"node\":{\"@graphtype\":"
+						<< ((node.type == SNAPSHOT_GROUP) ? "\"Group\"" : "\"Node\"") << ",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << "},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			case SNAPSHOT_TRANSFORM: {
+				if (node.payloadIndex >= header->transformCount) {
+					continue;
+				}
+				/* Transforms are Connections that relate the parent with the children */
+				const SnapshotTransform& transform = reader.getTransforms()[node.payloadIndex];
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE\",\"node\":{\"@graphtype\":\"Connection\",\"@semanticContext\":\"Transform\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << ",\"sourceIds\":[";
+				writeId(node.parentId, output);
+				output << "],\"targetIds\":[],";
+				writeHistory(transform, output);
+				output << "},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			}
+			case SNAPSHOT_UPDATED_NODE:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"UPDATE_ATTRIBUTES\",\"node\":{\"@graphtype\":\"Node\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << "}}";
+				break;
+			case SNAPSHOT_UPDATED_TRANSFORM: {
+				if (node.payloadIndex >= header->transformCount) {
+					continue;
+				}
+				/* Two lines: the attributes and the latest sample */
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"UPDATE_ATTRIBUTES\",\"node\":{\"@graphtype\":\"Node\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << "}}\n";
+				lineCount++;
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"UPDATE_TRANSFORM\",\"node\":{\"@graphtype\":\"Connection\",\"@semanticContext\":\"Transform\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeHistory(reader.getTransforms()[node.payloadIndex], output);
+				output << "}}";
+				break;
+			}
+			case SNAPSHOT_GEOMETRIC_NODE: {
+				if (node.payloadIndex >= header->shapeCount) {
+					continue;
+				}
+				const SnapshotShape& shape = reader.getShapes()[node.payloadIndex];
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE\",\"node\":{\"@graphtype\":\"GeometricNode\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << ",\"geometry\":{";
+				if (shape.type == SNAPSHOT_BOX) {
+					output << "\"@geometrytype\":\"Box\",\"sizeX\":" << shape.parameters[0]
+							<< ",\"sizeY\":" << shape.parameters[1] << ",\"sizeZ\":" << shape.parameters[2];
+				} else if (shape.type == SNAPSHOT_CYLINDER) {
+					output << "\"@geometrytype\":\"Cylinder\",\"radius\":" << shape.parameters[0]
+							<< ",\"height\":" << shape.parameters[1];
+				} else {
+					output << "\"@geometrytype\":\"Sphere\",\"radius\":" << shape.parameters[0];
+				}
+				output << ",\"unit\":\"m\"}},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			}
+			case SNAPSHOT_CONNECTION: {
+				if (node.payloadIndex >= header->connectionCount) {
+					continue;
+				}
+				const SnapshotConnection& connection = reader.getConnections()[node.payloadIndex];
+				if ((static_cast<uint64_t>(connection.sourceIndex) + connection.sourceCount > header->idCount) ||
+					(static_cast<uint64_t>(connection.targetIndex) + connection.targetCount > header->idCount)) {
+					continue;
+				}
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE\",\"node\":{\"@graphtype\":\"Connection\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << ",\"sourceIds\":";
+				writeIds(reader.getIds(), connection.sourceIndex, connection.sourceCount, output);
+				output << ",\"targetIds\":";
+				writeIds(reader.getIds(), connection.targetIndex, connection.targetCount, output);
+				output << ",\"start\":";
+				writeStamp(connection.start, output);
+				output << ",\"end\":";
+				writeStamp(connection.end, output);
+				output << "},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			}
+			case SNAPSHOT_REMOTE_ROOT:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE_REMOTE_ROOT_NODE\",\"node\":{\"@graphtype\":\"Node\",\"id\":";
+				writeId(node.id, output);
+				output << ",";
+				writeAttributes(reader, node, output);
+				output << "}}";
+				break;
+			case SNAPSHOT_PARENT:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"CREATE_PARENT\",\"node\":{\"@graphtype\":\"Node\",\"childId\":";
+				writeId(node.id, output);
+				output << "},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			case SNAPSHOT_DELETED:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"DELETE_NODE\",\"node\":{\"@graphtype\":\"Node\",\"id\":";
+				writeId(node.id, output);
+				output << "}}";
+				break;
+			case SNAPSHOT_REMOVED_PARENT:
+				output << "{\"@worldmodeltype\":\"RSGUpdate\",\"operation\":\"DELETE_PARENT\",\"node\":{\"@graphtype\":\"Node\",\"childId\":";
+				writeId(node.id, output);
+				output << "},\"parentId\":";
+				writeId(node.parentId, output);
+				output << "}";
+				break;
+			default:
+				LOG(WARNING) << "LDJSONWriter: Unknown node type " << node.type << ". Skipping it.";
+				continue;
+			}
+			output << "\n";
+			lineCount++;
+		}
+	}
+
+	LOG(DEBUG) << "LDJSONWriter: Wrote " << lineCount << " lines.";
+	return lineCount;
+}
+
+static bool getQuotedValue(const std::string& line, const std::string& key, std::string& value) {
+	const std::string quotedKey = "\"" + key + "\":\"";
+	size_t start = line.find(quotedKey);
+	if (start == std::string::npos) {
+		return false;
+	}
+	start += quotedKey.size();
+	size_t end = line.find('"', start);
+	if (end == std::string::npos) {
+		return false;
+	}
+	value = line.substr(start, end - start);
+	return true;
+}
+
+bool LDJSONWriter::isHeader(const std::string& line) {
+	return line.find("\"@worldmodeltype\":\"" RSG_LDJSON_HEADER_TYPE "\"") != std::string::npos;
+}
+
+bool LDJSONWriter::getRootId(const std::string& firstLine, std::string& rootId) {
+	if (isHeader(firstLine)) {
+		return getQuotedValue(firstLine, "rootId", rootId);
+	}
+	if (firstLine.find("\"operation\":\"UPDATE_ATTRIBUTES\"") == std::string::npos) {
+		return false;
+	}
+	return getQuotedValue(firstLine, "id", rootId); // older dumps
+}
+
+bool LDJSONWriter::isRootAttributesUpdate(const std::string& line, const std::string& rootId) {
+	std::string id;
+	return !rootId.empty() && (line.find("\"operation\":\"UPDATE_ATTRIBUTES\"") != std::string::npos) &&
+			getQuotedValue(line, "id", id) && (id.compare(rootId) == 0);
+}
+
+/* Name of the key in front of position pos, e.g. "parentId" for ..."parentId":"<pos>..." */
+static std::string getKeyBefore(const std::string& line, size_t pos) {
+	if ((pos < 3) || (line[pos - 1] != ':') || (line[pos - 2] != '"')) {
+		return "";
+	}
+	size_t end = pos - 2;
+	size_t start = line.rfind('"', end - 1);
+	return (start == std::string::npos) ? "" : line.substr(start + 1, end - start - 1);
+}
+
+void LDJSONWriter::mapRootId(std::string& line, const std::string& dumpedRootId, const std::string& rootId) {
+	if (dumpedRootId.empty() || (dumpedRootId.compare(rootId) == 0)) {
+		return;
+	}
+	const std::string quotedId = "\"" + dumpedRootId + "\"";
+	for (size_t pos = line.find(quotedId); pos != std::string::npos; pos = line.find(quotedId, pos + 1)) {
+		std::string key = getKeyBefore(line, pos);
+		if (key.empty()) { // inside an array of Ids?
+			size_t arrayStart = line.find_last_of("[]:", pos);
+			if ((arrayStart != std::string::npos) && (line[arrayStart] == '[')) {
+				key = getKeyBefore(line, arrayStart);
+			}
+			if ((key.compare("sourceIds") != 0) && (key.compare("targetIds") != 0)) {
+				continue;
+			}
+		} else if ((key.compare("id") != 0) && (key.compare("childId") != 0) && (key.compare("parentId") != 0)) {
+			continue; // e.g. an attribute value
+		}
+		line.replace(pos + 1, dumpedRootId.size(), rootId);
+	}
+}
+
+void LDJSONWriter::writeId(const SnapshotId& id, std::ostream& output) {
+	char idAsString[39];
+	const uint8_t* d = id.data;
+	snprintf(idAsString, sizeof(idAsString),
+			"\"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x\"",
+			d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7],
+			d[8], d[9], d[10], d[11], d[12], d[13], d[14], d[15]);
+	output << idAsString;
+}
+
+void LDJSONWriter::writeIds(const SnapshotId* ids, uint32_t index, uint32_t count, std::ostream& output) {
+	output << "[";
+	for (uint32_t i = index; i < index + count; ++i) {
+		if (i != index) {
+			output << ",";
+		}
+		writeId(ids[i], output);
+	}
+	output << "]";
+}
+
+void LDJSONWriter::writeAttributes(const SnapshotReader& reader, const SnapshotNode& node, std::ostream& output) {
+	vector<Attribute> attributes;
+	reader.getAttributes(node, attributes);
+	output << "\"attributes\":[";
+	for (vector<Attribute>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+		if (it != attributes.begin()) {
+			output << ",";
+		}
+		output << "{\"key\":";
+		writeString(it->key, output);
+		output << ",\"value\":";
+		writeString(it->value, output);
+		output << "}";
+	}
+	output << "]";
+}
+
+void LDJSONWriter::writeHistory(const SnapshotTransform& transform, std::ostream& output) {
+	output << "\"history\":[{\"stamp\":";
+	writeStamp(transform.stamp, output);
+	output << ",\"transform\":{\"type\":\"HomogeneousMatrix44\",\"matrix\":[";
+	for (int row = 0; row < 4; ++row) {
+		output << ((row == 0) ? "[" : ",[");
+		for (int column = 0; column < 4; ++column) {
+			output << ((column == 0) ? "" : ",") << transform.matrix[column * 4 + row]; // stored column-major
+		}
+		output << "]";
+	}
+	output << "],\"unit\":\"m\"}}]";
+}
+
+void LDJSONWriter::writeStamp(double stampInSeconds, std::ostream& output) {
+	output << "{\"@stamptype\":\"TimeStampUTCms\",\"stamp\":" << stampInSeconds * 1000.0 << "}";
+}
+
+void LDJSONWriter::writeString(const std::string& value, std::ostream& output) {
+	output << "\"";
+	for (std::string::const_iterator it = value.begin(); it != value.end(); ++it) {
+		unsigned char c = static_cast<unsigned char>(*it);
+		switch (c) {
+		case '"':  output << "\\\""; break;
+		case '\\': output << "\\\\"; break;
+		case '\n': output << "\\n"; break;
+		case '\r': output << "\\r"; break;
+		case '\t': output << "\\t"; break;
+		default:
+			if (c < 0x20) {
+				char escaped[7];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				output << escaped;
+			} else {
+				output << *it;
+			}
+			break;
+		}
+	}
+	output << "\"";
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,84 @@
+/*
+ * Converts a snapshot (cf. SnapshotFormat.h) into line delimited RSG-JSON.
+ */
+
+#ifndef RSG_BRIDGE_LDJSONWRITER_H_
+#define RSG_BRIDGE_LDJSONWRITER_H_
+
+#include "SnapshotReader.h"
+
+#include <string>
+#include <ostream>
+
+namespace rsg_bridge {
+
+#define RSG_LDJSON_FILE_SUFFIX ".ldjson"
+#define RSG_LDJSON_HEADER_TYPE "RSGDumpHeader"
+
+/**
+ * @brief Writes one RSG-JSON update message (RSGUpdate) per line.
+ *
+ * Each line can be passed as it is to a JSONDeserializer, so a dump can be
+ * streamed line by line into a world model or processed by standard tools
+ * (e.g. grep or jq) without loading the complete graph. Lines appear in
+ * traversal order, i.e. a parent always precedes its children.
+ *
+ * The first line is a header record that must not be applied:
+ * @code
+ * {"@worldmodeltype":"RSGDumpHeader","rootId":"<uuid>","stamp":{...}}
+ * @endcode
+ * A loader maps the dumped root Id to its own root Id (cf. mapRootId()). If the
+ * snapshot contains the attributes of the root node, they follow as UPDATE_ATTRIBUTES
+ * message for the dumped root Id. A loader should merge them like
+ * SnapshotReader::mergeRootAttributes() instead of applying them. All other primitives
+ * are DELETE_NODE and DELETE_PARENT tombstones (incremental dumps) followed by CREATE,
+ * CREATE_REMOTE_ROOT_NODE or CREATE_PARENT messages. Nodes of incremental dumps that
+ * existed at the previous dump are written as UPDATE_ATTRIBUTES and (for Transforms)
+ * UPDATE_TRANSFORM messages, so a delta can be applied on top of its base dump.
+ */
+class LDJSONWriter {
+public:
+	LDJSONWriter();
+	virtual ~LDJSONWriter();
+
+	/// Write all primitives of the snapshot. Returns the number of written lines.
+	unsigned int write(const SnapshotReader& reader, std::ostream& output);
+
+	/// Write all primitives of the snapshot into a file. Returns false on I/O errors.
+	bool write(const SnapshotReader& reader, std::string fileName);
+
+	/**
+	 * @brief Extract the Id of the dumped root node from the first line of a dump.
+	 *
+	 * This is the header record. Dumps of older versions start with the UPDATE_ATTRIBUTES
+	 * message of the root node instead.
+	 * @return False if the line does not describe the root node.
+	 */
+	static bool getRootId(const std::string& firstLine, std::string& rootId);
+
+	/// True for the header record, i.e. the line is not an update.
+	static bool isHeader(const std::string& line);
+
+	/// True for the UPDATE_ATTRIBUTES message of the dumped root node.
+	static bool isRootAttributesUpdate(const std::string& line, const std::string& rootId);
+
+	/**
+	 * @brief Replace the dumped root Id by another one in the Id fields of an update.
+	 *
+	 * Only "id", "childId" and "parentId" values and the entries of "sourceIds" and
+	 * "targetIds" are replaced, attribute values that happen to contain the Id are not.
+	 */
+	static void mapRootId(std::string& line, const std::string& dumpedRootId, const std::string& rootId);
+
+private:
+	void writeId(const SnapshotId& id, std::ostream& output);
+	void writeIds(const SnapshotId* ids, uint32_t index, uint32_t count, std::ostream& output);
+	void writeAttributes(const SnapshotReader& reader, const SnapshotNode& node, std::ostream& output);
+	void writeHistory(const SnapshotTransform& transform, std::ostream& output);
+	void writeStamp(double stampInSeconds, std::ostream& output);
+	void writeString(const std::string& value, std::ostream& output);
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_LDJSONWRITER_H_ */
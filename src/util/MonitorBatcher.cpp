@@ -0,0 +1,285 @@
+#include "MonitorBatcher.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/bind.hpp>
+#include <boost/regex.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cassert>
+#include <time.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+static const boost::regex monitorIdPattern("\"monitorId\"\\s*:\\s*\"([^\"]*)\"");
+static const size_t minPruneSize = 64;
+
+MonitorBatcher::MonitorBatcher(brics_3d::rsg::IOutputPort* output) :
+		output(output), window(0), minInterval(0), latestOnly(false), maxQueueLength(1000), maxBatchSize(90000), pruneSize(minPruneSize), pendingCount(0), timer(0), isRunning(false) {
+	assert(output != 0);
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+MonitorBatcher::~MonitorBatcher() {
+	stop();
+}
+
+void MonitorBatcher::setWindow(double window) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->window = (window > 0) ? window : 0;
+}
+
+void MonitorBatcher::setMaxRate(double messagesPerSecond) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	minInterval = (messagesPerSecond > 0) ? 1.0 / messagesPerSecond : 0;
+}
+
+void MonitorBatcher::setLatestOnly(bool latestOnly) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->latestOnly = latestOnly;
+}
+
+void MonitorBatcher::setMaxQueueLength(unsigned int maxQueueLength) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->maxQueueLength = std::max(maxQueueLength, 1u);
+}
+
+void MonitorBatcher::setMaxBatchSize(unsigned int maxBatchSize) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->maxBatchSize = maxBatchSize;
+}
+
+void MonitorBatcher::start() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (isRunning) {
+		return;
+	}
+	isRunning = true;
+	timer = new boost::thread(boost::bind(&MonitorBatcher::flushBatches, this));
+}
+
+void MonitorBatcher::stop() {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (!isRunning) {
+			return;
+		}
+		isRunning = false;
+		messageQueued.notify_all();
+	}
+	timer->join();
+	delete timer;
+	timer = 0;
+
+	/* Nothing is lost: the remaining batches are sent right away */
+	std::deque<std::string> outgoing;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		takeDueMessages(now(), true, outgoing);
+	}
+	send(outgoing);
+}
+
+double MonitorBatcher::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+bool MonitorBatcher::getMonitorId(const char* dataBuffer, int dataLength, std::string& monitorId) {
+	boost::cmatch match;
+	if (!boost::regex_search(dataBuffer, dataBuffer + dataLength, match, monitorIdPattern)) {
+		return false;
+	}
+	monitorId = match[1];
+	return true;
+}
+
+MonitorBatcherStatistics MonitorBatcher::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	MonitorBatcherStatistics result = statistics;
+	result.pendingCount = pendingCount;
+	result.listenerCount = static_cast<unsigned int>(listeners.size());
+	return result;
+}
+
+std::string MonitorBatcher::getStatisticsAsString() {
+	MonitorBatcherStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Monitor messages: received = " << current.receivedCount
+			<< ", sent = " << current.sentCount
+			<< ", batched = " << current.batchedCount
+			<< ", coalesced = " << current.coalescedCount
+			<< ", dropped = " << current.droppedCount
+			<< ", pending = " << current.pendingCount
+			<< ", listeners = " << current.listenerCount;
+	return result.str();
+}
+
+int MonitorBatcher::write(const char *dataBuffer, int dataLength, int &transferredBytes) {
+	int length = dataLength;
+	while ((length > 0) && (dataBuffer[length - 1] == '\0')) { // terminators are added again by the output
+		length--;
+	}
+	std::string monitorId;
+	bool hasMonitorId = getMonitorId(dataBuffer, length, monitorId);
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	statistics.receivedCount++;
+	if (!hasMonitorId || !isRunning || ((window <= 0) && (minInterval <= 0))) {
+		statistics.sentCount++;
+		lock.unlock();
+		return output->write(dataBuffer, dataLength, transferredBytes);
+	}
+
+	double currentTime = now();
+	std::map<std::string, Listener>::iterator listener = listeners.find(monitorId);
+	if (listener == listeners.end()) {
+		if (listeners.size() >= pruneSize) { // e.g. many one-shot monitors
+			pruneIdleListeners(currentTime);
+			pruneSize = std::max(2 * listeners.size(), minPruneSize);
+		}
+		Listener newListener;
+		newListener.windowStart = currentTime;
+		newListener.lastSendTime = currentTime;
+		listeners.insert(std::make_pair(monitorId, newListener));
+		statistics.sentCount++;
+		lock.unlock();
+		return output->write(dataBuffer, dataLength, transferredBytes);
+	}
+
+	/* A quiet listener gets the first message of a burst without delay */
+	if (listener->second.messages.empty() && (currentTime - listener->second.lastSendTime >= std::max(window, minInterval))) {
+		listener->second.lastSendTime = currentTime;
+		statistics.sentCount++;
+		lock.unlock();
+		return output->write(dataBuffer, dataLength, transferredBytes);
+	}
+
+	if (listener->second.messages.empty()) {
+		listener->second.windowStart = currentTime;
+	}
+	if (latestOnly && !listener->second.messages.empty()) {
+		listener->second.messages.back().assign(dataBuffer, length);
+		statistics.coalescedCount++;
+	} else {
+		if (listener->second.messages.size() >= maxQueueLength) {
+			listener->second.messages.pop_front();
+			pendingCount--;
+			statistics.droppedCount++;
+		}
+		listener->second.messages.push_back(std::string(dataBuffer, length));
+		pendingCount++;
+	}
+	messageQueued.notify_one();
+	transferredBytes = dataLength;
+	return 0;
+}
+
+double MonitorBatcher::getDueTime(const Listener& listener) const {
+	return std::max(listener.windowStart + window, listener.lastSendTime + minInterval);
+}
+
+double MonitorBatcher::getNextDueTime() const {
+	double nextDueTime = -1;
+	if (pendingCount == 0) {
+		return nextDueTime;
+	}
+	for (std::map<std::string, Listener>::const_iterator it = listeners.begin(); it != listeners.end(); ++it) {
+		if (!it->second.messages.empty()) {
+			double dueTime = getDueTime(it->second);
+			if ((nextDueTime < 0) || (dueTime < nextDueTime)) {
+				nextDueTime = dueTime;
+			}
+		}
+	}
+	return nextDueTime;
+}
+
+void MonitorBatcher::takeDueMessages(double currentTime, bool all, std::deque<std::string>& outgoing) {
+	for (std::map<std::string, Listener>::iterator it = listeners.begin(); it != listeners.end(); ++it) {
+		Listener& listener = it->second;
+		if (listener.messages.empty() || (!all && (currentTime < getDueTime(listener)))) {
+			continue;
+		}
+		if (listener.messages.size() == 1) {
+			outgoing.push_back(listener.messages.front());
+			statistics.sentCount++;
+		} else {
+			std::string header = "{\"@worldmodeltype\": \"RSGMonitorBatch\", \"monitorId\": \"" + it->first + "\", \"monitors\": [";
+			std::string batch;
+			size_t batchCount = 0;
+			for (std::deque<std::string>::const_iterator message = listener.messages.begin(); message != listener.messages.end(); ++message) {
+				if ((batchCount > 0) && (batch.size() + 2 + message->size() + 2 > maxBatchSize)) { // ", " and "]}"
+					outgoing.push_back(batch + "]}");
+					statistics.sentCount++;
+					statistics.batchedCount += batchCount;
+					batchCount = 0;
+				}
+				if (batchCount == 0) {
+					batch = header; // a single oversized message still gets its own batch
+				} else {
+					batch += ", ";
+				}
+				batch += *message;
+				batchCount++;
+			}
+			outgoing.push_back(batch + "]}");
+			statistics.sentCount++;
+			statistics.batchedCount += batchCount;
+		}
+		pendingCount -= static_cast<unsigned int>(listener.messages.size());
+		listener.messages.clear();
+		listener.lastSendTime = currentTime;
+	}
+	pruneIdleListeners(currentTime);
+}
+
+void MonitorBatcher::pruneIdleListeners(double currentTime) {
+	/* An idle listener is sent immediately anyway, so a new one behaves the same */
+	for (std::map<std::string, Listener>::iterator it = listeners.begin(); it != listeners.end();) {
+		if (it->second.messages.empty() && (currentTime - it->second.lastSendTime >= std::max(window, minInterval))) {
+			listeners.erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+void MonitorBatcher::send(const std::deque<std::string>& outgoing) {
+	for (std::deque<std::string>::const_iterator it = outgoing.begin(); it != outgoing.end(); ++it) {
+		int transferredBytes = 0;
+		if (output->write(it->c_str(), static_cast<int>(it->size()), transferredBytes) != 0) {
+			LOG(WARNING) << "MonitorBatcher: Cannot send a monitor message.";
+		}
+	}
+}
+
+void MonitorBatcher::flushBatches() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (isRunning) {
+		double dueTime = getNextDueTime();
+		if (dueTime < 0) {
+			messageQueued.wait(lock);
+			continue;
+		}
+		double currentTime = now();
+		if (currentTime < dueTime) {
+			messageQueued.timed_wait(lock, boost::posix_time::microseconds(static_cast<long>((dueTime - currentTime) * 1.0e6) + 1));
+			continue;
+		}
+
+		std::deque<std::string> outgoing;
+		takeDueMessages(currentTime, false, outgoing);
+		lock.unlock();
+		LOG(DEBUG) << "MonitorBatcher: Sending " << outgoing.size() << " monitor messages.";
+		send(outgoing);
+		lock.lock();
+	}
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,122 @@
+/*
+ * Batching and rate limits for outgoing monitor messages.
+ */
+
+#ifndef RSG_BRIDGE_MONITORBATCHER_H_
+#define RSG_BRIDGE_MONITORBATCHER_H_
+
+#include <brics_3d/worldModel/sceneGraph/IOutputPort.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Counters of a MonitorBatcher.
+ */
+struct MonitorBatcherStatistics {
+	uint64_t receivedCount;  // monitor messages written to the batcher
+	uint64_t sentCount;      // messages sent to the output, a batch counts as one
+	uint64_t batchedCount;   // monitor messages that were sent as part of a batch
+	uint64_t coalescedCount; // replaced by a newer message of the same monitorId
+	uint64_t droppedCount;   // oldest messages dropped because a queue was full
+	unsigned int pendingCount;
+	unsigned int listenerCount;
+};
+
+/**
+ * @brief Output port that batches monitor messages per listener.
+ *
+ * Messages are queued per monitorId. The first message of a listener opens a time
+ * window. When it is over, all queued messages of the listener are sent as one batch:
+ * @code
+ * {"@worldmodeltype": "RSGMonitorBatch", "monitorId": "<uuid>", "monitors": [<RSGMonitor>, ...]}
+ * @endcode
+ * A single queued message is sent as it is. A batch that would exceed the maximum
+ * batch size is split into several ones, so it still fits into the transport (e.g.
+ * max_msg_length of the zyre bridge). Optionally, the number of messages per
+ * second and listener is limited and only the latest message of a listener is kept
+ * (latest-value-wins, as for Transform updates). A listener that has been quiet for
+ * longer than its window and rate interval is sent immediately. Such idle listeners
+ * are forgotten, so the number of listeners is bounded by the active monitorIds.
+ *
+ * Messages without monitorId are forwarded immediately. Without a started timer
+ * every message is forwarded immediately.
+ */
+class MonitorBatcher : public brics_3d::rsg::IOutputPort {
+public:
+	/**
+	 * @param output Port for the monitor messages and batches. Not owned.
+	 */
+	MonitorBatcher(brics_3d::rsg::IOutputPort* output);
+	virtual ~MonitorBatcher();
+
+	/// Length of a batch window in [s]. 0 means no batching.
+	void setWindow(double window);
+
+	/// Maximum number of messages per second and listener. 0 means unlimited.
+	void setMaxRate(double messagesPerSecond);
+
+	/// If true, a listener keeps only its latest message.
+	void setLatestOnly(bool latestOnly);
+
+	/// Maximum number of queued messages per listener. The oldest one is dropped.
+	void setMaxQueueLength(unsigned int maxQueueLength);
+
+	/// Maximum size of a batch in bytes. Larger batches are split. Default is 90000.
+	void setMaxBatchSize(unsigned int maxBatchSize);
+
+	void start();
+
+	/// Stop the timer. Queued messages are sent.
+	void stop();
+
+	int write(const char *dataBuffer, int dataLength, int &transferredBytes);
+
+	MonitorBatcherStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+	/// The monitorId of a message. Returns false if there is none.
+	static bool getMonitorId(const char* dataBuffer, int dataLength, std::string& monitorId);
+
+private:
+	struct Listener {
+		std::deque<std::string> messages;
+		double windowStart;  // arrival of the oldest queued message
+		double lastSendTime;
+	};
+
+	double getDueTime(const Listener& listener) const;
+	double getNextDueTime() const;
+	void takeDueMessages(double currentTime, bool all, std::deque<std::string>& outgoing);
+	void pruneIdleListeners(double currentTime);
+	void send(const std::deque<std::string>& outgoing);
+	void flushBatches();
+	static double now();
+
+	brics_3d::rsg::IOutputPort* output;
+	double window;
+	double minInterval;
+	bool latestOnly;
+	unsigned int maxQueueLength;
+	unsigned int maxBatchSize;
+
+	std::map<std::string, Listener> listeners; // by monitorId
+	size_t pruneSize;                           // number of listeners that triggers the next pruning in write()
+	unsigned int pendingCount;
+	MonitorBatcherStatistics statistics;
+
+	boost::mutex mutex;
+	boost::condition_variable messageQueued;
+	boost::thread* timer;
+	bool isRunning;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_MONITORBATCHER_H_ */
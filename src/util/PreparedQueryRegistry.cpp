@@ -0,0 +1,202 @@
+#include "PreparedQueryRegistry.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+static const boost::regex preparedQueryMessagePattern("\"@worldmodeltype\"\\s*:\\s*\"RSGPreparedQuery\"");
+static const boost::regex executionPattern("\"operation\"\\s*:\\s*\"EXECUTE\"");
+static const boost::regex placeholderPattern("\"\\$([A-Za-z_][A-Za-z0-9_]*)\"");
+static const boost::regex leadingQueryIdPattern("\"queryId\"\\s*:\\s*\"[^\"]*\"\\s*,");
+static const boost::regex trailingQueryIdPattern(",?\\s*\"queryId\"\\s*:\\s*\"[^\"]*\"");
+static const boost::regex parameterPattern("\"([^\"]*)\"\\s*:\\s*(\"(?:[^\"\\\\]|\\\\.)*\"|[-+0-9.eE]+|true|false|null)");
+
+PreparedQueryRegistry::PreparedQueryRegistry(unsigned int maxSize) : maxSize(maxSize), handleCount(0) {
+
+}
+
+PreparedQueryRegistry::~PreparedQueryRegistry() {
+
+}
+
+bool PreparedQueryRegistry::isPreparedQueryMessage(const std::string& message) {
+	return boost::regex_search(message, preparedQueryMessagePattern);
+}
+
+bool PreparedQueryRegistry::isExecution(const std::string& message) {
+	return boost::regex_search(message, executionPattern);
+}
+
+unsigned int PreparedQueryRegistry::getSize() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return static_cast<unsigned int>(queries.size());
+}
+
+bool PreparedQueryRegistry::getString(const std::string& message, const std::string& key, std::string& value) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+	value = match[1];
+	return true;
+}
+
+bool PreparedQueryRegistry::getObject(const std::string& message, const std::string& key, std::string& object) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*\\{");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+
+	/* Find the matching brace, skipping strings */
+	size_t begin = match.position(static_cast<size_t>(0)) + match.length(0) - 1;
+	int depth = 0;
+	bool isString = false;
+	for (size_t i = begin; i < message.size(); ++i) {
+		char c = message[i];
+		if (isString) {
+			if (c == '\\') {
+				++i;
+			} else if (c == '"') {
+				isString = false;
+			}
+		} else if (c == '"') {
+			isString = true;
+		} else if (c == '{') {
+			depth++;
+		} else if (c == '}') {
+			if (--depth == 0) {
+				object = message.substr(begin, i - begin + 1);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+std::string PreparedQueryRegistry::createReply(const std::string& operation, const std::string& queryId, const std::string& handle, bool success) {
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGPreparedQueryResult\", \"operation\": \"" << operation << "\", ";
+	if (!queryId.empty()) {
+		reply << "\"queryId\": \"" << queryId << "\", ";
+	}
+	if (!handle.empty()) {
+		reply << "\"handle\": \"" << handle << "\", ";
+	}
+	reply << "\"querySuccess\": " << (success ? "true" : "false") << "}";
+	return reply.str();
+}
+
+bool PreparedQueryRegistry::handleMessage(const std::string& message, Planner planner, std::string& result) {
+	std::string operation;
+	std::string queryId;
+	std::string handle;
+	bool success = false;
+	getString(message, "operation", operation);
+	getString(message, "queryId", queryId);
+	getString(message, "handle", handle);
+
+	if (operation == "PREPARE") {
+		std::string queryTemplate;
+		if (!getObject(message, "query", queryTemplate)) {
+			LOG(ERROR) << "PreparedQueryRegistry: PREPARE requires a query object.";
+		} else {
+
+			/* The queryId is set per execution */
+			if (boost::regex_search(queryTemplate, leadingQueryIdPattern)) {
+				queryTemplate = boost::regex_replace(queryTemplate, leadingQueryIdPattern, "");
+			} else {
+				queryTemplate = boost::regex_replace(queryTemplate, trailingQueryIdPattern, "");
+			}
+
+			PreparedQuery prepared;
+			prepared.executionCount = 0;
+			std::string::const_iterator literalBegin = queryTemplate.begin();
+			boost::sregex_iterator end;
+			for (boost::sregex_iterator it(queryTemplate.begin(), queryTemplate.end(), placeholderPattern); it != end; ++it) {
+				prepared.literals.push_back(std::string(literalBegin, (*it)[0].first));
+				prepared.parameters.push_back((*it)[1]);
+				literalBegin = (*it)[0].second;
+			}
+			prepared.literals.push_back(std::string(literalBegin, static_cast<std::string::const_iterator>(queryTemplate.end())));
+			prepared.plan = planner ? planner(queryTemplate) : 0;
+
+			boost::unique_lock<boost::mutex> lock(mutex);
+			if (queries.size() >= maxSize) {
+				LOG(ERROR) << "PreparedQueryRegistry: Maximum number of " << maxSize << " prepared queries reached. Release unused ones first.";
+				handle.clear();
+			} else {
+				std::stringstream newHandle;
+				newHandle << "prepared-" << ++handleCount;
+				handle = newHandle.str();
+				queries.insert(std::make_pair(handle, prepared));
+				success = true;
+				LOG(DEBUG) << "PreparedQueryRegistry: Prepared query " << handle << " with " << prepared.parameters.size() << " parameters.";
+			}
+		}
+	} else if (operation == "RELEASE") {
+		boost::unique_lock<boost::mutex> lock(mutex);
+		success = (queries.erase(handle) > 0);
+	} else {
+		LOG(ERROR) << "PreparedQueryRegistry: Unknown operation " << operation;
+	}
+
+	result = createReply(operation, queryId, handle, success);
+	return success;
+}
+
+bool PreparedQueryRegistry::expand(const std::string& message, std::string& query, int& plan, std::string& result) {
+	std::string queryId;
+	std::string handle;
+	getString(message, "queryId", queryId);
+	if (!getString(message, "handle", handle)) {
+		LOG(ERROR) << "PreparedQueryRegistry: EXECUTE requires a handle.";
+		result = createReply("EXECUTE", queryId, handle, false);
+		return false;
+	}
+
+	std::map<std::string, std::string> values;
+	std::string parameters;
+	if (getObject(message, "parameters", parameters)) {
+		boost::sregex_iterator end;
+		for (boost::sregex_iterator it(parameters.begin(), parameters.end(), parameterPattern); it != end; ++it) {
+			values[(*it)[1]] = (*it)[2];
+		}
+	}
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<std::string, PreparedQuery>::iterator prepared = queries.find(handle);
+	if (prepared == queries.end()) {
+		LOG(ERROR) << "PreparedQueryRegistry: Unknown handle " << handle << ". It has to be prepared again.";
+		result = createReply("EXECUTE", queryId, handle, false);
+		return false;
+	}
+
+	query.clear();
+	for (unsigned int i = 0; i < prepared->second.parameters.size(); ++i) {
+		std::map<std::string, std::string>::const_iterator value = values.find(prepared->second.parameters[i]);
+		if (value == values.end()) {
+			LOG(ERROR) << "PreparedQueryRegistry: Missing parameter " << prepared->second.parameters[i] << " for " << handle;
+			result = createReply("EXECUTE", queryId, handle, false);
+			return false;
+		}
+		query.append(prepared->second.literals[i]);
+		query.append(value->second);
+	}
+	query.append(prepared->second.literals.back());
+	if (!queryId.empty()) {
+		query.insert(1, "\"queryId\": \"" + queryId + "\", "); // right after the opening brace
+	}
+	plan = prepared->second.plan;
+	prepared->second.executionCount++;
+	return true;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,98 @@
+/*
+ * Parameterized queries that are registered once and executed by handle.
+ */
+
+#ifndef RSG_BRIDGE_PREPAREDQUERYREGISTRY_H_
+#define RSG_BRIDGE_PREPAREDQUERYREGISTRY_H_
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Prepared form of a query template.
+ *
+ * The template is split at its placeholders, so an execution only concatenates
+ * the literal parts and the parameter values.
+ */
+struct PreparedQuery {
+	std::vector<std::string> literals;   // one more than parameters
+	std::vector<std::string> parameters; // name of the placeholder between two literals
+	int plan;                            // as returned by the planner at preparation time
+	uint64_t executionCount;
+};
+
+/**
+ * @brief Registry of prepared queries.
+ *
+ * A client registers a query (RSGQuery, RSGUpdate or RSGFunctionBlock) once with
+ * placeholders "$<name>" as values and gets a handle:
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGPreparedQuery",
+ *   "operation": "PREPARE",
+ *   "query": {"@worldmodeltype": "RSGQuery", "query": "GET_NODE_ATTRIBUTES", "id": "$id"}
+ * }
+ * @endcode
+ * Then only the handle and the parameter values are sent:
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGPreparedQuery",
+ *   "operation": "EXECUTE",
+ *   "handle": "<handle>",
+ *   "queryId": "<uuid>", // optional
+ *   "parameters": {"id": "3304e4a0-44d4-4fc8-8834-b0b03b418d5b"}
+ * }
+ * @endcode
+ * Values can be strings, numbers, true, false or null. The reply is the reply of the
+ * expanded query. The operation RELEASE removes a prepared query.
+ *
+ * The planner passed to prepare() is evaluated once per template, e.g. to decide
+ * which lock or which handler a query needs.
+ */
+class PreparedQueryRegistry {
+public:
+	typedef boost::function<int (const std::string& query)> Planner;
+
+	PreparedQueryRegistry(unsigned int maxSize);
+	virtual ~PreparedQueryRegistry();
+
+	/// True for RSGPreparedQuery messages.
+	static bool isPreparedQueryMessage(const std::string& message);
+
+	/// True if the message is an EXECUTE operation.
+	static bool isExecution(const std::string& message);
+
+	/// Process a PREPARE or RELEASE operation and create the RSGPreparedQueryResult.
+	bool handleMessage(const std::string& message, Planner planner, std::string& result);
+
+	/**
+	 * @brief Expand an EXECUTE operation into the query to be executed.
+	 * @param[out] query Query with the parameter values and the queryId of the message.
+	 * @param[out] plan Plan of the prepared query.
+	 * @param[out] result Error reply, if false is returned.
+	 */
+	bool expand(const std::string& message, std::string& query, int& plan, std::string& result);
+
+	unsigned int getSize();
+
+private:
+	static bool getString(const std::string& message, const std::string& key, std::string& value);
+	static bool getObject(const std::string& message, const std::string& key, std::string& object);
+	static std::string createReply(const std::string& operation, const std::string& queryId, const std::string& handle, bool success);
+
+	unsigned int maxSize;
+	boost::mutex mutex;
+	std::map<std::string, PreparedQuery> queries; // by handle
+	uint64_t handleCount;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_PREPAREDQUERYREGISTRY_H_ */
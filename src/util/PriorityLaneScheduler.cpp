@@ -0,0 +1,336 @@
+#include "PriorityLaneScheduler.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#include <cassert>
+#include <time.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+static const char* laneNames[LANE_COUNT] = {"high", "normal", "bulk"};
+
+PriorityLaneScheduler::PriorityLaneScheduler() :
+		maxBulkRate(0), nextBulkTime(0), bulkMode(false), inFlight(0), dispatcher(0), isRunning(false), isDraining(false) {
+	for (int i = 0; i < LANE_COUNT; ++i) {
+		outputs[i] = 0;
+	}
+	setWeights(16, 4, 1);
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+PriorityLaneScheduler::~PriorityLaneScheduler() {
+	stop();
+}
+
+void PriorityLaneScheduler::setLaneOutput(PriorityLane lane, brics_3d::rsg::IOutputPort* output) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	outputs[lane] = output;
+}
+
+void PriorityLaneScheduler::setWeights(unsigned int highWeight, unsigned int normalWeight, unsigned int bulkWeight) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	weights[HIGH_LANE] = std::max(highWeight, 1u);
+	weights[NORMAL_LANE] = std::max(normalWeight, 1u);
+	weights[BULK_LANE] = std::max(bulkWeight, 1u);
+	for (int i = 0; i < LANE_COUNT; ++i) {
+		credits[i] = weights[i];
+	}
+}
+
+void PriorityLaneScheduler::setMaxBulkRate(double messagesPerSecond) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	maxBulkRate = (messagesPerSecond > 0) ? messagesPerSecond : 0;
+}
+
+void PriorityLaneScheduler::setBulkMode(bool bulkMode) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	this->bulkMode = bulkMode;
+}
+
+void PriorityLaneScheduler::start() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (isRunning) {
+		return;
+	}
+	isRunning = true;
+	dispatcher = new boost::thread(boost::bind(&PriorityLaneScheduler::dispatch, this));
+}
+
+void PriorityLaneScheduler::stop() {
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		if (!isRunning) {
+			return;
+		}
+		isRunning = false;
+		isDraining = true;
+		messageQueued.notify_all();
+		messageSent.notify_all();
+	}
+	dispatcher->join();
+	delete dispatcher;
+	dispatcher = 0;
+
+	/* Nothing is lost: the remaining messages are sent right away, without rate limit */
+	unsigned int drained = 0;
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (true) {
+		int lane = HIGH_LANE;
+		while ((lane < LANE_COUNT) && lanes[lane].empty()) {
+			lane++;
+		}
+		if (lane == LANE_COUNT) {
+			break;
+		}
+
+		Message message;
+		message.data.swap(lanes[lane].front().data);
+		message.ids.swap(lanes[lane].front().ids);
+		lanes[lane].pop_front();
+		brics_3d::rsg::IOutputPort* output = outputs[lane];
+
+		lock.unlock();
+		int transferredBytes = 0;
+		assert(output != 0);
+		output->write(&message.data[0], static_cast<int>(message.data.size()), transferredBytes);
+		lock.lock();
+
+		trackIds(static_cast<PriorityLane>(lane), message.ids, -1);
+		statistics.sentCount[lane]++;
+		drained++;
+	}
+	isDraining = false;
+	if (drained > 0) {
+		LOG(INFO) << "PriorityLaneScheduler: Sent " << drained << " queued messages while stopping.";
+	}
+}
+
+void PriorityLaneScheduler::flush() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (isRunning && ((inFlight > 0) || !lanes[HIGH_LANE].empty() || !lanes[NORMAL_LANE].empty() || !lanes[BULK_LANE].empty())) {
+		messageSent.wait(lock);
+	}
+}
+
+int PriorityLaneScheduler::write(const char *dataBuffer, int dataLength, int &transferredBytes) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	PriorityLane lane = classify(dataBuffer, dataLength, bulkMode);
+
+	if (!isRunning && !isDraining) {
+		brics_3d::rsg::IOutputPort* output = outputs[lane];
+		statistics.sentCount[lane]++;
+		lock.unlock();
+		assert(output != 0);
+		return output->write(dataBuffer, dataLength, transferredBytes);
+	}
+
+	Message message;
+	message.data.assign(dataBuffer, dataBuffer + dataLength);
+	message.enqueueTime = now();
+	if (!bulkMode) {
+		extractIds(dataBuffer, dataLength, message.ids);
+	}
+
+	/* Keep the order with respect to lower lanes that still hold a message about the same Id */
+	for (int lower = BULK_LANE; lower > lane; --lower) {
+		bool isPending = false;
+		for (std::vector<std::string>::const_iterator it = message.ids.begin(); it != message.ids.end(); ++it) {
+			if (pendingIds[lower].find(*it) != pendingIds[lower].end()) {
+				isPending = true;
+				break;
+			}
+		}
+		if (isPending) {
+			LOG(DEBUG) << "PriorityLaneScheduler: Demoting a message from the " << laneNames[lane] << " to the " << laneNames[lower] << " lane.";
+			lane = static_cast<PriorityLane>(lower);
+			statistics.demotedCount++;
+			break;
+		}
+	}
+	if (lane == HIGH_LANE) {
+		message.ids.clear(); // nothing can be demoted to the high lane
+	}
+	trackIds(lane, message.ids, 1);
+
+	lanes[lane].push_back(Message());
+	lanes[lane].back().data.swap(message.data);
+	lanes[lane].back().ids.swap(message.ids);
+	lanes[lane].back().enqueueTime = message.enqueueTime;
+	messageQueued.notify_one();
+
+	transferredBytes = dataLength;
+	return 0;
+}
+
+void PriorityLaneScheduler::dispatch() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (isRunning) {
+		double currentTime = now();
+		int lane = selectLane(currentTime);
+		if (lane < 0) {
+			if (lanes[BULK_LANE].empty()) {
+				messageQueued.wait(lock);
+			} else { // bulk lane is rate limited
+				messageQueued.timed_wait(lock, boost::posix_time::microseconds(static_cast<long>((nextBulkTime - currentTime) * 1.0e6) + 1));
+			}
+			continue;
+		}
+
+		Message message;
+		message.data.swap(lanes[lane].front().data);
+		message.ids.swap(lanes[lane].front().ids);
+		message.enqueueTime = lanes[lane].front().enqueueTime;
+		lanes[lane].pop_front();
+		if ((lane == BULK_LANE) && (maxBulkRate > 0)) {
+			nextBulkTime = currentTime + 1.0 / maxBulkRate;
+		}
+		brics_3d::rsg::IOutputPort* output = outputs[lane];
+		inFlight++;
+
+		lock.unlock(); // producers must not wait for the output
+		int transferredBytes = 0;
+		assert(output != 0);
+		output->write(&message.data[0], static_cast<int>(message.data.size()), transferredBytes);
+		lock.lock();
+
+		inFlight--;
+		trackIds(static_cast<PriorityLane>(lane), message.ids, -1);
+		double latency = now() - message.enqueueTime;
+		statistics.sentCount[lane]++;
+		if (latency > statistics.maxLatency[lane]) {
+			statistics.maxLatency[lane] = latency;
+		}
+		messageSent.notify_all();
+	}
+}
+
+int PriorityLaneScheduler::selectLane(double currentTime) {
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int lane = 0; lane < LANE_COUNT; ++lane) {
+			if (lanes[lane].empty() || (credits[lane] == 0)) {
+				continue;
+			}
+			if ((lane == BULK_LANE) && (maxBulkRate > 0) && (currentTime < nextBulkTime)) {
+				continue;
+			}
+			credits[lane]--;
+			return lane;
+		}
+
+		/* Start a new round */
+		for (int lane = 0; lane < LANE_COUNT; ++lane) {
+			credits[lane] = weights[lane];
+		}
+	}
+	return -1;
+}
+
+void PriorityLaneScheduler::trackIds(PriorityLane lane, const std::vector<std::string>& ids, int delta) {
+	for (std::vector<std::string>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+		if (delta > 0) {
+			pendingIds[lane][*it]++;
+		} else {
+			std::map<std::string, unsigned int>::iterator pending = pendingIds[lane].find(*it);
+			if ((pending != pendingIds[lane].end()) && (--pending->second == 0)) {
+				pendingIds[lane].erase(pending);
+			}
+		}
+	}
+}
+
+PriorityLaneStatistics PriorityLaneScheduler::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	PriorityLaneStatistics result = statistics;
+	for (int i = 0; i < LANE_COUNT; ++i) {
+		result.queuedCount[i] = static_cast<unsigned int>(lanes[i].size());
+	}
+	return result;
+}
+
+std::string PriorityLaneScheduler::getStatisticsAsString() {
+	PriorityLaneStatistics current = getStatistics();
+	std::stringstream result;
+	for (int i = 0; i < LANE_COUNT; ++i) {
+		result << laneNames[i] << " lane: sent = " << current.sentCount[i]
+				<< ", queued = " << current.queuedCount[i]
+				<< ", max latency = " << current.maxLatency[i] << " s; ";
+	}
+	result << "demoted = " << current.demotedCount;
+	return result.str();
+}
+
+PriorityLane PriorityLaneScheduler::classify(const char* dataBuffer, int dataLength, bool bulkMode) {
+	if (hasValue(dataBuffer, dataLength, "@worldmodeltype", "RSGMonitor") ||
+		hasValue(dataBuffer, dataLength, "operation", "UPDATE_TRANSFORM")) {
+		return HIGH_LANE;
+	}
+	if (bulkMode ||
+		hasValue(dataBuffer, dataLength, "@graphtype", "GeometricNode") ||
+		contains(dataBuffer, dataLength, "\"osm:")) {
+		return BULK_LANE;
+	}
+	return NORMAL_LANE;
+}
+
+void PriorityLaneScheduler::extractIds(const char* dataBuffer, int dataLength, std::vector<std::string>& ids) {
+	const int idLength = 36; // e.g. "3304e4a0-44d4-4fc8-8834-b0b03b418d5b"
+	for (int i = 0; i + idLength + 1 < dataLength; ++i) {
+		if ((dataBuffer[i] != '"') || (dataBuffer[i + idLength + 1] != '"')) {
+			continue;
+		}
+		const char* candidate = dataBuffer + i + 1;
+		bool isId = true;
+		for (int j = 0; (j < idLength) && isId; ++j) {
+			if ((j == 8) || (j == 13) || (j == 18) || (j == 23)) {
+				isId = (candidate[j] == '-');
+			} else {
+				isId = (isxdigit(static_cast<unsigned char>(candidate[j])) != 0);
+			}
+		}
+		if (isId) {
+			ids.push_back(std::string(candidate, idLength));
+			i += idLength + 1;
+		}
+	}
+}
+
+bool PriorityLaneScheduler::hasValue(const char* dataBuffer, int dataLength, const std::string& key, const std::string& value) {
+	const std::string quotedKey = "\"" + key + "\"";
+	const char* end = dataBuffer + dataLength;
+	const char* position = dataBuffer;
+	while ((position = std::search(position, end, quotedKey.begin(), quotedKey.end())) != end) {
+		position += quotedKey.size();
+		const char* cursor = position;
+		while ((cursor < end) && isspace(static_cast<unsigned char>(*cursor))) cursor++;
+		if ((cursor == end) || (*cursor++ != ':')) continue;
+		while ((cursor < end) && isspace(static_cast<unsigned char>(*cursor))) cursor++;
+		if ((cursor == end) || (*cursor++ != '"')) continue;
+		if ((end - cursor > static_cast<long>(value.size())) &&
+			(value.compare(0, value.size(), cursor, value.size()) == 0) &&
+			(cursor[value.size()] == '"')) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PriorityLaneScheduler::contains(const char* dataBuffer, int dataLength, const std::string& pattern) {
+	const char* end = dataBuffer + dataLength;
+	return std::search(dataBuffer, end, pattern.begin(), pattern.end()) != end;
+}
+
+double PriorityLaneScheduler::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,127 @@
+/*
+ * Priority lanes for outgoing RSG-JSON messages.
+ */
+
+#ifndef RSG_BRIDGE_PRIORITYLANESCHEDULER_H_
+#define RSG_BRIDGE_PRIORITYLANESCHEDULER_H_
+
+#include <brics_3d/worldModel/sceneGraph/IOutputPort.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Lane of an outgoing message. A lower value has a higher priority.
+ */
+enum PriorityLane {
+	HIGH_LANE = 0,   // UPDATE_TRANSFORM and monitor messages
+	NORMAL_LANE = 1, // attribute updates and all other updates
+	BULK_LANE = 2,   // geometry, OSM data and resynchronization traffic
+	LANE_COUNT = 3
+};
+
+/**
+ * @brief Counters of a PriorityLaneScheduler. Latencies are in seconds.
+ */
+struct PriorityLaneStatistics {
+	uint64_t sentCount[LANE_COUNT];
+	unsigned int queuedCount[LANE_COUNT];
+	double maxLatency[LANE_COUNT];
+	uint64_t demotedCount; // messages moved to a lower lane to keep the order per Id
+};
+
+/**
+ * @brief Output port that sorts messages into priority lanes.
+ *
+ * Every written message is classified into a lane. A dispatcher thread forwards the
+ * lanes to their outputs with weighted round robin scheduling: within one round a lane
+ * sends at most as many messages as its weight, higher lanes first. The bulk lane can
+ * be additionally limited to a maximum rate, so downstream buffers are not flooded
+ * and there is always room for pose updates.
+ *
+ * A message is never sent before an earlier message of a lower lane that refers to
+ * the same Id. Such a message is demoted to the lower lane. Resynchronization
+ * traffic (see setBulkMode()) is excluded from this rule, as it repeats nodes that
+ * peers usually know already.
+ *
+ * Without a started dispatcher every message is forwarded immediately.
+ */
+class PriorityLaneScheduler : public brics_3d::rsg::IOutputPort {
+public:
+	PriorityLaneScheduler();
+	virtual ~PriorityLaneScheduler();
+
+	/// Set the output for a lane. Not owned. All lanes must have an output.
+	void setLaneOutput(PriorityLane lane, brics_3d::rsg::IOutputPort* output);
+
+	/// Messages per round for each lane. A weight of 0 is treated as 1.
+	void setWeights(unsigned int highWeight, unsigned int normalWeight, unsigned int bulkWeight);
+
+	/// Maximum number of bulk messages per second. 0 means unlimited.
+	void setMaxBulkRate(double messagesPerSecond);
+
+	/// While enabled all messages except UPDATE_TRANSFORM and monitor messages go to the bulk lane.
+	void setBulkMode(bool bulkMode);
+
+	void start();
+
+	/// Stop the dispatcher. Queued messages are sent by the calling thread, highest lane first.
+	void stop();
+
+	/// Block until all queued messages are sent.
+	void flush();
+
+	int write(const char *dataBuffer, int dataLength, int &transferredBytes);
+
+	PriorityLaneStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+	/// Lane of a message based on its operation and content.
+	static PriorityLane classify(const char* dataBuffer, int dataLength, bool bulkMode = false);
+
+private:
+	struct Message {
+		std::vector<char> data;
+		std::vector<std::string> ids; // tracked Ids, empty for resynchronization traffic
+		double enqueueTime;
+	};
+
+	void dispatch();
+	int selectLane(double currentTime);
+	void trackIds(PriorityLane lane, const std::vector<std::string>& ids, int delta);
+
+	static void extractIds(const char* dataBuffer, int dataLength, std::vector<std::string>& ids);
+	static bool hasValue(const char* dataBuffer, int dataLength, const std::string& key, const std::string& value);
+	static bool contains(const char* dataBuffer, int dataLength, const std::string& pattern);
+	static double now();
+
+	brics_3d::rsg::IOutputPort* outputs[LANE_COUNT];
+	unsigned int weights[LANE_COUNT];
+	unsigned int credits[LANE_COUNT];
+	double maxBulkRate;
+	double nextBulkTime;
+	bool bulkMode;
+
+	std::deque<Message> lanes[LANE_COUNT];
+	std::map<std::string, unsigned int> pendingIds[LANE_COUNT];
+	unsigned int inFlight;
+	PriorityLaneStatistics statistics;
+
+	boost::mutex mutex;
+	boost::condition_variable messageQueued;
+	boost::condition_variable messageSent;
+	boost::thread* dispatcher;
+	bool isRunning;
+	bool isDraining; // stop() sends the remaining messages; new ones are still queued behind them
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_PRIORITYLANESCHEDULER_H_ */
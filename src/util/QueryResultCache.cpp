@@ -0,0 +1,301 @@
+#include "QueryResultCache.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+#include <cstring>
+#include <set>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+static const boost::regex cacheableQueryPattern("\"@worldmodeltype\"\\s*:\\s*\"RSGQuery\"");
+static const boost::regex queryTypePattern("\"query\"\\s*:\\s*\"(GET_NODES|GET_NODE_ATTRIBUTES|GET_NODE_PARENTS|GET_GROUP_CHILDREN|GET_ROOT_NODE|GET_REMOTE_ROOT_NODES|GET_GEOMETRY)\"");
+static const boost::regex searchQueryPattern("\"query\"\\s*:\\s*\"(GET_NODES|GET_ROOT_NODE|GET_REMOTE_ROOT_NODES)\"");
+static const boost::regex uuidPattern("[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex leadingQueryIdPattern("\"queryId\"\\s*:\\s*\"[^\"]*\"\\s*,\\s*");
+static const boost::regex trailingQueryIdPattern(",?\\s*\"queryId\"\\s*:\\s*\"[^\"]*\"");
+static const boost::regex successPattern("\"querySuccess\"\\s*:\\s*true");
+
+/* One cache per World Model. Blocks of the same process share it via this library. */
+static boost::mutex cacheMutex;
+static std::map<brics_3d::WorldModel*, QueryResultCache*> caches;
+
+static std::string removeQueryId(const std::string& message) {
+	if (boost::regex_search(message, leadingQueryIdPattern)) {
+		return boost::regex_replace(message, leadingQueryIdPattern, "", boost::format_first_only);
+	}
+	return boost::regex_replace(message, trailingQueryIdPattern, "", boost::format_first_only);
+}
+
+QueryResultCache* QueryResultCache::get(brics_3d::WorldModel* wm, unsigned int maxSize) {
+	boost::unique_lock<boost::mutex> lock(cacheMutex);
+	std::map<brics_3d::WorldModel*, QueryResultCache*>::iterator it = caches.find(wm);
+	if (it != caches.end()) {
+		return it->second;
+	}
+	QueryResultCache* cache = new QueryResultCache(wm, maxSize); // lives as long as the process
+	caches.insert(std::make_pair(wm, cache));
+	return cache;
+}
+
+QueryResultCache::QueryResultCache(brics_3d::WorldModel* wm, unsigned int maxSize) :
+		wm(wm), maxSize(maxSize), graphVersion(0) {
+	memset(&statistics, 0, sizeof(statistics));
+	wm->scene.attachUpdateObserver(this);
+	LOG(INFO) << "QueryResultCache: Caching up to " << maxSize << " query results.";
+}
+
+QueryResultCache::~QueryResultCache() {
+	wm->scene.detachUpdateObserver(this);
+}
+
+bool QueryResultCache::isCacheable(const std::string& query) {
+	return boost::regex_search(query, cacheableQueryPattern) && boost::regex_search(query, queryTypePattern);
+}
+
+std::string QueryResultCache::normalize(const std::string& query) {
+	std::string normalized;
+	normalized.reserve(query.size());
+	bool isString = false;
+	for (size_t i = 0; i < query.size(); ++i) {
+		char c = query[i];
+		if (isString) {
+			if (c == '\\' && (i + 1 < query.size())) {
+				normalized.push_back(c);
+				c = query[++i];
+			} else if (c == '"') {
+				isString = false;
+			}
+		} else if (c == '"') {
+			isString = true;
+		} else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			continue;
+		}
+		normalized.push_back(c);
+	}
+	return removeQueryId(normalized);
+}
+
+uint64_t QueryResultCache::getVersion(Id id) const {
+	std::map<Id, NodeVersion>::const_iterator version = versions.find(id);
+	return (version != versions.end()) ? version->second.version : 0;
+}
+
+void QueryResultCache::release(const CacheEntry& entry) {
+	for (std::vector<std::pair<Id, uint64_t> >::const_iterator it = entry.nodeVersions.begin(); it != entry.nodeVersions.end(); ++it) {
+		std::map<Id, NodeVersion>::iterator version = versions.find(it->first);
+		if ((version != versions.end()) && (--version->second.references == 0)) {
+			versions.erase(version); // a node that is tagged again starts over with version 0
+		}
+	}
+}
+
+void QueryResultCache::releaseAll() {
+	entries.clear();
+	versions.clear();
+}
+
+bool QueryResultCache::isValid(const CacheEntry& entry) const {
+	if (entry.isSearch && (entry.graphVersion != graphVersion)) {
+		return false;
+	}
+	for (std::vector<std::pair<Id, uint64_t> >::const_iterator it = entry.nodeVersions.begin(); it != entry.nodeVersions.end(); ++it) {
+		if (getVersion(it->first) != it->second) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool QueryResultCache::lookup(const std::string& query, std::string& result) {
+	std::string key = normalize(query);
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<std::string, CacheEntry>::iterator entry = entries.find(key);
+	if (entry == entries.end()) {
+		statistics.missCount++;
+		return false;
+	}
+	if (!isValid(entry->second)) {
+		release(entry->second);
+		entries.erase(entry);
+		statistics.invalidatedCount++;
+		statistics.missCount++;
+		return false;
+	}
+	statistics.hitCount++;
+
+	result = entry->second.result;
+	boost::smatch queryId;
+	if (boost::regex_search(query, queryId, queryIdPattern) && !result.empty()) {
+		result.insert(1, "\"queryId\": \"" + queryId[1] + "\", "); // right after the opening brace
+	}
+	return true;
+}
+
+void QueryResultCache::insert(const std::string& query, const std::string& result) {
+	if (!boost::regex_search(result, successPattern)) {
+		return;
+	}
+
+	CacheEntry entry;
+	entry.result = removeQueryId(result);
+	entry.isSearch = boost::regex_search(query, searchQueryPattern);
+	std::set<Id> touched;
+	boost::sregex_iterator end;
+	for (boost::sregex_iterator it(query.begin(), query.end(), uuidPattern); it != end; ++it) {
+		Id id;
+		if (id.fromString((*it)[0])) {
+			touched.insert(id);
+		}
+	}
+	for (boost::sregex_iterator it(result.begin(), result.end(), uuidPattern); it != end; ++it) {
+		Id id;
+		if (id.fromString((*it)[0])) {
+			touched.insert(id);
+		}
+	}
+	std::string key = normalize(query);
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if ((entries.size() >= maxSize) && (entries.find(key) == entries.end())) {
+		LOG(DEBUG) << "QueryResultCache: Maximum size reached. Clearing all " << entries.size() << " entries.";
+		releaseAll();
+	}
+	std::map<std::string, CacheEntry>::iterator previous = entries.find(key);
+	if (previous != entries.end()) {
+		release(previous->second);
+	}
+	entry.graphVersion = graphVersion;
+	entry.nodeVersions.reserve(touched.size());
+	for (std::set<Id>::const_iterator it = touched.begin(); it != touched.end(); ++it) {
+		NodeVersion& version = versions.insert(std::make_pair(*it, NodeVersion())).first->second; // value initialized to 0
+		version.references++;
+		entry.nodeVersions.push_back(std::make_pair(*it, version.version));
+	}
+	entries[key] = entry;
+}
+
+void QueryResultCache::touch(Id id, bool changesSearches) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, NodeVersion>::iterator version = versions.find(id);
+	if (version != versions.end()) {
+		version->second.version++;
+	} // otherwise no entry depends on it
+	if (changesSearches) {
+		graphVersion++;
+	}
+}
+
+void QueryResultCache::clear() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	releaseAll();
+}
+
+QueryResultCacheStatistics QueryResultCache::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	QueryResultCacheStatistics result = statistics;
+	result.size = static_cast<unsigned int>(entries.size());
+	return result;
+}
+
+std::string QueryResultCache::getStatisticsAsString() {
+	QueryResultCacheStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Query result cache: hits = " << current.hitCount
+			<< ", misses = " << current.missCount
+			<< ", invalidated = " << current.invalidatedCount
+			<< ", size = " << current.size;
+	return result.str();
+}
+
+std::string QueryResultCache::getStatisticsAsJSON() {
+	QueryResultCacheStatistics current = getStatistics();
+	uint64_t lookups = current.hitCount + current.missCount;
+	std::stringstream result;
+	result << "{\"hits\": " << current.hitCount
+			<< ", \"misses\": " << current.missCount
+			<< ", \"invalidated\": " << current.invalidatedCount
+			<< ", \"size\": " << current.size
+			<< ", \"hitRate\": " << ((lookups > 0) ? static_cast<double>(current.hitCount) / lookups : 0.0) << "}";
+	return result.str();
+}
+
+bool QueryResultCache::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	touch(rootId, true);
+	return true;
+}
+
+bool QueryResultCache::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	touch(parentId, true);
+	touch(assignedId, true);
+	return true;
+}
+
+bool QueryResultCache::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	touch(id, true);
+	return true;
+}
+
+bool QueryResultCache::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	return true; // no cacheable reply contains transform data
+}
+
+bool QueryResultCache::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	return true;
+}
+
+bool QueryResultCache::deleteNode(Id id) {
+	touch(id, true); // replies that list the node, e.g. the children of its parent, carry its id
+	return true;
+}
+
+bool QueryResultCache::addParent(Id id, Id parentId) {
+	touch(id, true);
+	touch(parentId, true);
+	return true;
+}
+
+bool QueryResultCache::removeParent(Id id, Id parentId) {
+	touch(id, true);
+	touch(parentId, true);
+	return true;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,126 @@
+/*
+ * Cache for the replies of polled read-only queries.
+ */
+
+#ifndef RSG_BRIDGE_QUERYRESULTCACHE_H_
+#define RSG_BRIDGE_QUERYRESULTCACHE_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Hit and invalidation counts of a QueryResultCache.
+ */
+struct QueryResultCacheStatistics {
+	uint64_t hitCount;
+	uint64_t missCount;
+	uint64_t invalidatedCount; // lookups that found an entry with outdated versions
+	unsigned int size;
+};
+
+/**
+ * @brief Keeps the replies of read-only queries until the atoms they touched change.
+ *
+ * Entries are keyed by the normalized query text, i.e. without whitespace outside
+ * of strings and without the queryId. Cacheable are the queries GET_NODES,
+ * GET_NODE_ATTRIBUTES, GET_NODE_PARENTS, GET_GROUP_CHILDREN, GET_ROOT_NODE,
+ * GET_REMOTE_ROOT_NODES and GET_GEOMETRY.
+ *
+ * The cache observes the scene and counts a version per node that is incremented
+ * whenever its attributes, parents, children or data change. Versions are only
+ * kept for nodes that a cached entry depends on, so the bookkeeping is bounded by
+ * the entries and not by the history of the scene. An entry is tagged
+ * with the versions of all ids that appear in the query or in the reply. Searches
+ * (GET_NODES and the root node queries) can match nodes that are not in their
+ * reply yet, so they are tagged with a graph wide version that changes with every
+ * new node, attribute update or deletion. Transform updates do not change it.
+ * A lookup compares the tags to the current versions, so an outdated entry is
+ * never returned.
+ *
+ * The cache is shared by all blocks via QueryResultCache::get(). Entries have to
+ * be inserted under the read lock of the WorldModelAccess of the live World Model,
+ * so the versions belong to the reply.
+ */
+class QueryResultCache : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+
+	/// Get the cache for a World Model. It is created and attached to the scene on first use.
+	static QueryResultCache* get(brics_3d::WorldModel* wm, unsigned int maxSize);
+
+	/// True for the read-only query types listed above.
+	static bool isCacheable(const std::string& query);
+
+	/// Query without whitespace outside of strings and without its queryId.
+	static std::string normalize(const std::string& query);
+
+	/// Look up the reply for a query. The queryId is replaced by the one of the query.
+	bool lookup(const std::string& query, std::string& result);
+
+	/// Store the reply of a query. Only successful replies are stored.
+	void insert(const std::string& query, const std::string& result);
+
+	void clear();
+
+	QueryResultCacheStatistics getStatistics();
+	std::string getStatisticsAsString();
+	std::string getStatisticsAsJSON();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	QueryResultCache(brics_3d::WorldModel* wm, unsigned int maxSize);
+	virtual ~QueryResultCache();
+
+	struct CacheEntry {
+		std::string result; // without queryId
+		bool isSearch;
+		uint64_t graphVersion;
+		std::vector<std::pair<brics_3d::rsg::Id, uint64_t> > nodeVersions;
+	};
+
+	struct NodeVersion {
+		uint64_t version;
+		unsigned int references; // entries that are tagged with this node
+	};
+
+	uint64_t getVersion(brics_3d::rsg::Id id) const;
+	bool isValid(const CacheEntry& entry) const;
+	void touch(brics_3d::rsg::Id id, bool changesSearches);
+	void release(const CacheEntry& entry);
+	void releaseAll();
+
+	brics_3d::WorldModel* wm;
+	unsigned int maxSize;
+
+	boost::mutex mutex;
+	std::map<std::string, CacheEntry> entries;         // by normalized query
+	std::map<brics_3d::rsg::Id, NodeVersion> versions; // only nodes that entries are tagged with
+	uint64_t graphVersion;
+	QueryResultCacheStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_QUERYRESULTCACHE_H_ */
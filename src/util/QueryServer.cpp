@@ -0,0 +1,160 @@
+#include "QueryServer.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/bind.hpp>
+
+#include <zmq.h>
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cassert>
+#include <cerrno>
+#include <time.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+QueryServer::QueryServer(const std::string& endpoint, unsigned int workerCount, QueryHandler handler) :
+		endpoint(endpoint), workerCount(std::max(workerCount, 1u)), handler(handler), context(0), proxyThread(0) {
+	std::stringstream backend;
+	backend << "inproc://rsg-query-workers-" << this; // unique per server
+	backendEndpoint = backend.str();
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+QueryServer::~QueryServer() {
+	stop();
+}
+
+double QueryServer::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+bool QueryServer::start() {
+	if (context != 0) {
+		return true;
+	}
+	context = zmq_ctx_new();
+	int linger = 0;
+
+	void* frontend = zmq_socket(context, ZMQ_ROUTER);
+	zmq_setsockopt(frontend, ZMQ_LINGER, &linger, sizeof(linger));
+	if (zmq_bind(frontend, endpoint.c_str()) != 0) {
+		LOG(ERROR) << "QueryServer: Cannot bind " << endpoint << ": " << zmq_strerror(zmq_errno());
+		zmq_close(frontend);
+		zmq_ctx_term(context);
+		context = 0;
+		return false;
+	}
+	void* backend = zmq_socket(context, ZMQ_DEALER);
+	zmq_setsockopt(backend, ZMQ_LINGER, &linger, sizeof(linger));
+	int rc = zmq_bind(backend, backendEndpoint.c_str()); // before the workers connect
+	assert(rc == 0);
+
+	for (unsigned int i = 0; i < workerCount; ++i) {
+		workers.push_back(new boost::thread(boost::bind(&QueryServer::serve, this, i)));
+	}
+	proxyThread = new boost::thread(boost::bind(&QueryServer::proxy, this, frontend, backend)); // the sockets move to the proxy thread
+	LOG(INFO) << "QueryServer: Serving queries on " << endpoint << " with " << workerCount << " workers.";
+	return true;
+}
+
+void QueryServer::stop() {
+	if (context == 0) {
+		return;
+	}
+
+	/* Blocking calls of all sockets return with ETERM, so the threads close their sockets and exit */
+	zmq_ctx_shutdown(context);
+	proxyThread->join();
+	delete proxyThread;
+	proxyThread = 0;
+	for (unsigned int i = 0; i < workers.size(); ++i) {
+		workers[i]->join();
+		delete workers[i];
+	}
+	workers.clear();
+	zmq_ctx_term(context);
+	context = 0;
+	LOG(INFO) << "QueryServer: Stopped serving queries on " << endpoint << ".";
+}
+
+void QueryServer::proxy(void* frontend, void* backend) {
+	zmq_proxy(frontend, backend, 0); // returns when the context is shut down
+	zmq_close(frontend);
+	zmq_close(backend);
+}
+
+void QueryServer::serve(unsigned int worker) {
+	void* socket = zmq_socket(context, ZMQ_REP); // keeps the envelope of the request for its reply
+	int linger = 0;
+	zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
+	if (zmq_connect(socket, backendEndpoint.c_str()) != 0) {
+		LOG(ERROR) << "QueryServer: Worker " << worker << " cannot connect: " << zmq_strerror(zmq_errno());
+		zmq_close(socket);
+		return;
+	}
+
+	while (true) {
+		zmq_msg_t request;
+		zmq_msg_init(&request);
+		if (zmq_msg_recv(&request, socket, 0) < 0) {
+			zmq_msg_close(&request);
+			if (zmq_errno() == EINTR) {
+				continue;
+			}
+			break; // ETERM
+		}
+		std::string query(static_cast<const char*>(zmq_msg_data(&request)), zmq_msg_size(&request));
+		zmq_msg_close(&request);
+		while (!query.empty() && (query[query.size() - 1] == '\0')) { // some clients send C strings
+			query.erase(query.size() - 1);
+		}
+
+		double startTime = now();
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			statistics.busyWorkers++;
+			statistics.maxBusyWorkers = std::max(statistics.maxBusyWorkers, statistics.busyWorkers);
+		}
+		std::string result;
+		LOG(DEBUG) << "QueryServer: Worker " << worker << " processing query = " << std::endl << query;
+		handler(worker, query, result);
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			statistics.busyWorkers--;
+			statistics.queryCount++;
+			statistics.maxQueryTime = std::max(statistics.maxQueryTime, now() - startTime);
+		}
+
+		if (zmq_send(socket, result.c_str(), result.size(), 0) < 0) {
+			if (zmq_errno() == ETERM) {
+				break;
+			}
+			LOG(WARNING) << "QueryServer: Worker " << worker << " cannot send a reply: " << zmq_strerror(zmq_errno());
+		}
+	}
+	zmq_close(socket);
+}
+
+QueryServerStatistics QueryServer::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return statistics;
+}
+
+std::string QueryServer::getStatisticsAsString() {
+	QueryServerStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Query server: queries = " << current.queryCount
+			<< ", workers = " << workerCount
+			<< ", max. busy workers = " << current.maxBusyWorkers
+			<< ", max. query time = " << current.maxQueryTime << " [s]";
+	return result.str();
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,87 @@
+/*
+ * ZMQ ROUTER front-end with a pool of query workers.
+ */
+
+#ifndef RSG_BRIDGE_QUERYSERVER_H_
+#define RSG_BRIDGE_QUERYSERVER_H_
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Counters of a QueryServer.
+ */
+struct QueryServerStatistics {
+	uint64_t queryCount;
+	unsigned int busyWorkers;
+	unsigned int maxBusyWorkers; // highest number of queries that were processed at the same time
+	double maxQueryTime;         // [s]
+};
+
+/**
+ * @brief Serves RSG-JSON queries of many clients in parallel.
+ *
+ * A ROUTER socket accepts the requests of all connected clients. It tags every
+ * request with the routing envelope of its client and forwards it via an inproc
+ * DEALER socket to a pool of worker threads. Each worker processes one query at a
+ * time with the handler and sends the reply back with the same envelope. Thus, a
+ * reply goes to the client that sent the request, and replies of different workers
+ * are sent as soon as they are ready, i.e. possibly out of order.
+ *
+ * Clients can use REQ sockets as for the zmq_server block. A client with a DEALER
+ * socket can keep the connection and pipeline requests: it sends an empty delimiter
+ * frame followed by the query and matches the replies by their queryId.
+ *
+ * The handler is called concurrently by the workers and gets the index of the
+ * worker, so it can use per worker resources.
+ */
+class QueryServer {
+public:
+	typedef boost::function<void (unsigned int worker, std::string& query, std::string& result)> QueryHandler;
+
+	/**
+	 * @param endpoint ZMQ endpoint to bind, e.g. "tcp://*:22423".
+	 * @param workerCount Number of worker threads. At least 1.
+	 * @param handler Processes a query and creates the reply.
+	 */
+	QueryServer(const std::string& endpoint, unsigned int workerCount, QueryHandler handler);
+	virtual ~QueryServer();
+
+	/// Bind the endpoint and start the workers. Returns false if the endpoint cannot be bound.
+	bool start();
+
+	/// Stop the workers. Queries in progress are completed, queued ones are discarded.
+	void stop();
+
+	unsigned int getWorkerCount() const { return workerCount; }
+
+	QueryServerStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+private:
+	void proxy(void* frontend, void* backend);
+	void serve(unsigned int worker);
+	static double now();
+
+	std::string endpoint;
+	std::string backendEndpoint;
+	unsigned int workerCount;
+	QueryHandler handler;
+
+	void* context;
+	boost::thread* proxyThread;
+	std::vector<boost::thread*> workers;
+
+	boost::mutex mutex;
+	QueryServerStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_QUERYSERVER_H_ */
@@ -0,0 +1,451 @@
+#include "RetentionSweeper.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+static const unsigned int MAX_OWNER_DEPTH = 256; // parents that are checked for the root node
+
+/* Parse a duration like "60 s", "5 min" or "2 h" into seconds */
+static bool parseDuration(const std::string& number, const std::string& unit, double& seconds) {
+	char* end = 0;
+	double value = strtod(number.c_str(), &end);
+	if ((end == number.c_str()) || (*end != '\0') || (value <= 0)) {
+		return false;
+	}
+	if ((unit.compare("s") == 0) || (unit.compare("sec") == 0)) {
+		seconds = value;
+	} else if (unit.compare("min") == 0) {
+		seconds = value * 60.0;
+	} else if (unit.compare("h") == 0) {
+		seconds = value * 3600.0;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/* Parse "key" or "key=value" */
+static void parseSelector(const std::string& selector, RetentionPolicy& policy) {
+	std::string::size_type separator = selector.find('=');
+	policy.key = selector.substr(0, separator);
+	policy.hasValue = (separator != std::string::npos);
+	policy.value = policy.hasValue ? selector.substr(separator + 1) : "";
+}
+
+bool RetentionPolicy::parse(const std::string& text, RetentionPolicy& policy) {
+	std::vector<std::string> tokens;
+	std::stringstream stream(text);
+	std::string token;
+	while (stream >> token) {
+		tokens.push_back(token);
+	}
+	policy = RetentionPolicy();
+
+	if ((tokens.size() == 7) && (tokens[0] == "keep") && (tokens[1] == "Nodes") && (tokens[2] == "with") && (tokens[4] == "for")) {
+		policy.type = RETENTION_MAX_AGE;
+		parseSelector(tokens[3], policy);
+		return !policy.key.empty() && parseDuration(tokens[5], tokens[6], policy.maxAge);
+	}
+	if ((tokens.size() == 7) && (tokens[0] == "keep") && (tokens[2] == "Nodes") && (tokens[3] == "with") && (tokens[5] == "per") && (tokens[6] == "parent")) {
+		policy.type = RETENTION_MAX_COUNT_PER_PARENT;
+		parseSelector(tokens[4], policy);
+		int maxCount = atoi(tokens[1].c_str());
+		policy.maxCount = (maxCount > 0) ? static_cast<unsigned int>(maxCount) : 0;
+		return !policy.key.empty() && (policy.maxCount > 0);
+	}
+	return false;
+}
+
+bool RetentionPolicy::matches(const std::vector<Attribute>& attributes) const {
+	for (unsigned int i = 0; i < attributes.size(); ++i) {
+		if ((attributes[i].key.compare(key) == 0) && (!hasValue || (attributes[i].value.compare(value) == 0))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+RetentionSweeper::RetentionSweeper(brics_3d::WorldModel* wm) : wm(wm) {
+	memset(&statistics, 0, sizeof(statistics));
+
+	/* Policies that have been declared before */
+	std::vector<Attribute> rootAttributes;
+	wm->scene.getNodeAttributes(wm->getRootNodeId(), rootAttributes);
+	updatePolicies(rootAttributes);
+	std::vector<Id> existingRemoteRootIds;
+	wm->scene.getRemoteRootNodes(existingRemoteRootIds);
+	remoteRootIds.insert(existingRemoteRootIds.begin(), existingRemoteRootIds.end());
+	wm->scene.attachUpdateObserver(this);
+}
+
+RetentionSweeper::~RetentionSweeper() {
+	wm->scene.detachUpdateObserver(this);
+}
+
+double RetentionSweeper::now() {
+	return static_cast<double>(wm->now().getSeconds());
+}
+
+void RetentionSweeper::updatePolicies(const std::vector<Attribute>& rootAttributes) {
+	std::vector<std::string> texts;
+	for (unsigned int i = 0; i < rootAttributes.size(); ++i) {
+		if (rootAttributes[i].key.compare(RSG_RETENTION_POLICY_KEY) == 0) {
+			texts.push_back(rootAttributes[i].value);
+		}
+	}
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (texts == policyTexts) {
+		return;
+	}
+
+	/* Keep the index of policies that did not change */
+	std::vector<RetentionPolicy> newPolicies;
+	std::vector<std::deque<std::pair<double, Id> > > newAgeQueues;
+	std::vector<std::map<Id, CountedChildren> > newCountedChildren;
+	std::vector<int> oldToNew(policies.size(), -1);
+	for (unsigned int i = 0; i < texts.size(); ++i) {
+		RetentionPolicy policy;
+		if (!RetentionPolicy::parse(texts[i], policy)) {
+			LOG(WARNING) << "RetentionSweeper: Ignoring invalid policy: " << texts[i];
+			continue;
+		}
+		newAgeQueues.push_back(std::deque<std::pair<double, Id> >());
+		newCountedChildren.push_back(std::map<Id, CountedChildren>());
+		std::vector<std::string>::iterator old = std::find(policyTexts.begin(), policyTexts.end(), texts[i]);
+		if ((old != policyTexts.end()) && (oldToNew[old - policyTexts.begin()] < 0)) {
+			unsigned int oldIndex = static_cast<unsigned int>(old - policyTexts.begin());
+			oldToNew[oldIndex] = static_cast<int>(newPolicies.size());
+			newAgeQueues.back().swap(ageQueues[oldIndex]);
+			newCountedChildren.back().swap(countedChildren[oldIndex]);
+		} else {
+			LOG(INFO) << "RetentionSweeper: Added policy: " << texts[i];
+		}
+		newPolicies.push_back(policy);
+	}
+	for (std::map<Id, TrackedNode>::iterator it = trackedNodes.begin(); it != trackedNodes.end(); ++it) {
+		std::vector<unsigned int> counted;
+		for (unsigned int i = 0; i < it->second.countedPolicies.size(); ++i) {
+			if (oldToNew[it->second.countedPolicies[i]] >= 0) {
+				counted.push_back(static_cast<unsigned int>(oldToNew[it->second.countedPolicies[i]]));
+			}
+		}
+		it->second.countedPolicies.swap(counted);
+	}
+
+	policyTexts = texts; // including invalid ones, so they are reported only once
+	policies.swap(newPolicies);
+	ageQueues.swap(newAgeQueues);
+	countedChildren.swap(newCountedChildren);
+	statistics.policyCount = static_cast<unsigned int>(policies.size());
+}
+
+bool RetentionSweeper::matchesAnyPolicy(const std::vector<Attribute>& attributes) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	for (unsigned int i = 0; i < policies.size(); ++i) {
+		if (policies[i].matches(attributes)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool RetentionSweeper::isOwned(Id parentId) {
+	/* Follow the first parents up to the own root or the root of another agent */
+	Id rootId = wm->getRootNodeId();
+	Id current = parentId;
+	for (unsigned int depth = 0; depth < MAX_OWNER_DEPTH; ++depth) {
+		if (current == rootId) {
+			return true;
+		}
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			if (remoteRootIds.find(current) != remoteRootIds.end()) {
+				return false;
+			}
+		}
+		vector<Id> parentIds;
+		if (!wm->scene.getNodeParents(current, parentIds) || parentIds.empty()) {
+			return false; // e.g. a subgraph that is not mounted
+		}
+		current = parentIds[0];
+	}
+	return false;
+}
+
+void RetentionSweeper::track(Id id, Id parentId, const std::vector<Attribute>& attributes) {
+	if (!matchesAnyPolicy(attributes) || !isOwned(parentId)) { // only then the parents are traversed
+		return;
+	}
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (policies.empty() || (trackedNodes.find(id) != trackedNodes.end())) {
+		return;
+	}
+	TrackedNode node;
+	node.addedTime = now();
+	node.parentId = parentId;
+	node.isExpired = false;
+	bool isMatched = false;
+	std::vector<Id> overflow;
+	for (unsigned int i = 0; i < policies.size(); ++i) {
+		if (!policies[i].matches(attributes)) {
+			continue;
+		}
+		isMatched = true;
+		if (policies[i].type == RETENTION_MAX_AGE) {
+			ageQueues[i].push_back(std::make_pair(node.addedTime, id));
+		} else if (policies[i].type == RETENTION_MAX_COUNT_PER_PARENT) {
+			CountedChildren& children = countedChildren[i][parentId];
+			children.order.push_back(id);
+			children.liveCount++;
+			node.countedPolicies.push_back(i);
+
+			/* The oldest live children above the limit expire */
+			while ((children.liveCount > policies[i].maxCount) && (children.order.size() > 1)) {
+				Id oldest = children.order.front();
+				children.order.pop_front();
+				std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(oldest);
+				if (tracked == trackedNodes.end()) {
+					continue; // deleted already
+				}
+				std::vector<unsigned int>& counted = tracked->second.countedPolicies;
+				std::vector<unsigned int>::iterator policy = std::find(counted.begin(), counted.end(), i);
+				if (policy != counted.end()) {
+					counted.erase(policy);
+					children.liveCount--;
+					overflow.push_back(oldest); // expired below, after all counters are updated
+				}
+			}
+
+			/* Drop deleted nodes from the order, so it does not grow with nodes that were deleted by others */
+			if (children.order.size() > 2 * static_cast<size_t>(policies[i].maxCount) + 16) {
+				std::deque<Id> live;
+				for (std::deque<Id>::iterator it = children.order.begin(); it != children.order.end(); ++it) {
+					if ((*it == id) || (trackedNodes.find(*it) != trackedNodes.end())) {
+						live.push_back(*it);
+					}
+				}
+				children.order.swap(live);
+			}
+		}
+	}
+	if (isMatched) {
+		trackedNodes.insert(std::make_pair(id, node));
+	}
+	for (unsigned int i = 0; i < overflow.size(); ++i) {
+		std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(overflow[i]);
+		if (tracked != trackedNodes.end()) {
+			expire(overflow[i], false);
+		}
+	}
+	statistics.trackedNodeCount = static_cast<unsigned int>(trackedNodes.size());
+}
+
+void RetentionSweeper::untrack(Id id) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(id);
+	if (tracked == trackedNodes.end()) {
+		return;
+	}
+	for (unsigned int i = 0; i < tracked->second.countedPolicies.size(); ++i) {
+		unsigned int policy = tracked->second.countedPolicies[i];
+		std::map<Id, CountedChildren>::iterator children = countedChildren[policy].find(tracked->second.parentId);
+		if ((children != countedChildren[policy].end()) && (children->second.liveCount > 0)) {
+			children->second.liveCount--;
+			if (children->second.liveCount == 0) {
+				countedChildren[policy].erase(children);
+			}
+		}
+	}
+	trackedNodes.erase(tracked);
+	statistics.trackedNodeCount = static_cast<unsigned int>(trackedNodes.size());
+}
+
+void RetentionSweeper::expire(Id id, bool byAge) {
+	/* Called with the lock held */
+	std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(id);
+	if ((tracked == trackedNodes.end()) || tracked->second.isExpired) {
+		return;
+	}
+	for (unsigned int i = 0; i < tracked->second.countedPolicies.size(); ++i) { // it no longer counts
+		unsigned int policy = tracked->second.countedPolicies[i];
+		std::map<Id, CountedChildren>::iterator children = countedChildren[policy].find(tracked->second.parentId);
+		if ((children != countedChildren[policy].end()) && (children->second.liveCount > 0)) {
+			children->second.liveCount--;
+		}
+	}
+	tracked->second.countedPolicies.clear();
+	tracked->second.isExpired = true;
+	expiredNodes.push_back(id);
+	(byAge ? statistics.expiredByAgeCount : statistics.expiredByCountCount)++;
+}
+
+unsigned int RetentionSweeper::sweep(unsigned int maxDeletions) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	double currentTime = now();
+
+	/* Collect the victims, but delete them without holding the lock: the deletions are observed by this sweeper as well */
+	std::vector<Id> victims;
+	std::vector<Id> connections;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		for (unsigned int i = 0; i < policies.size(); ++i) {
+			std::deque<std::pair<double, Id> >& queue = ageQueues[i];
+			while (!queue.empty() && (currentTime - queue.front().first >= policies[i].maxAge)) {
+				std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(queue.front().second);
+				if ((tracked != trackedNodes.end()) && (tracked->second.addedTime == queue.front().first)) { // not deleted and added again
+					expire(queue.front().second, true);
+				}
+				queue.pop_front();
+			}
+		}
+		while (!expiredNodes.empty() && (victims.size() < maxDeletions)) {
+			std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(expiredNodes.front());
+			if (tracked != trackedNodes.end()) {
+				victims.push_back(tracked->first);
+				connections.insert(connections.end(), tracked->second.connectionIds.begin(), tracked->second.connectionIds.end());
+			}
+			expiredNodes.pop_front();
+		}
+	}
+
+	unsigned int deletedConnections = 0;
+	for (unsigned int i = 0; i < connections.size(); ++i) {
+		if (wm->scene.deleteNode(connections[i])) {
+			deletedConnections++;
+		}
+	}
+	unsigned int deletedNodes = 0;
+	for (unsigned int i = 0; i < victims.size(); ++i) {
+		if (wm->scene.deleteNode(victims[i])) {
+			deletedNodes++;
+		}
+		untrack(victims[i]); // in case it was gone already
+	}
+
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double sweepTime = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+	boost::unique_lock<boost::mutex> lock(mutex);
+	statistics.deletedConnectionCount += deletedConnections;
+	statistics.maxSweepTime = std::max(statistics.maxSweepTime, sweepTime);
+	if (deletedNodes > 0) {
+		LOG(DEBUG) << "RetentionSweeper: Deleted " << deletedNodes << " expired nodes and " << deletedConnections << " connections.";
+	}
+	return deletedNodes;
+}
+
+RetentionStatistics RetentionSweeper::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return statistics;
+}
+
+std::string RetentionSweeper::getStatisticsAsString() {
+	RetentionStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Retention: policies = " << current.policyCount
+			<< ", tracked nodes = " << current.trackedNodeCount
+			<< ", expired by age = " << current.expiredByAgeCount
+			<< ", expired by count = " << current.expiredByCountCount
+			<< ", deleted connections = " << current.deletedConnectionCount
+			<< ", max. sweep time = " << current.maxSweepTime << " [s]";
+	return result.str();
+}
+
+/* implementations of observer interface */
+
+bool RetentionSweeper::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	return true;
+}
+
+bool RetentionSweeper::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	return true;
+}
+
+bool RetentionSweeper::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	return true;
+}
+
+bool RetentionSweeper::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	return true;
+}
+
+bool RetentionSweeper::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	return true;
+}
+
+bool RetentionSweeper::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	remoteRootIds.insert(rootId);
+	return true;
+}
+
+bool RetentionSweeper::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	track(assignedId, parentId, attributes);
+	boost::unique_lock<boost::mutex> lock(mutex);
+	for (unsigned int i = 0; i < targetIds.size(); ++i) {
+		std::map<Id, TrackedNode>::iterator tracked = trackedNodes.find(targetIds[i]);
+		if (tracked != trackedNodes.end()) {
+			tracked->second.connectionIds.push_back(assignedId);
+		}
+	}
+	return true;
+}
+
+bool RetentionSweeper::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	if (id == wm->getRootNodeId()) {
+		updatePolicies(newAttributes);
+		return true;
+	}
+
+	/* A node that matches only after an update, e.g. when it is tagged as observation later */
+	bool isTracked = false;
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		isTracked = (trackedNodes.find(id) != trackedNodes.end());
+	}
+	if (!isTracked && matchesAnyPolicy(newAttributes)) {
+		vector<Id> parentIds;
+		wm->scene.getNodeParents(id, parentIds);
+		track(id, parentIds.empty() ? Id() : parentIds[0], newAttributes);
+	}
+	return true;
+}
+
+bool RetentionSweeper::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	return true;
+}
+
+bool RetentionSweeper::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	return true;
+}
+
+bool RetentionSweeper::deleteNode(Id id) {
+	untrack(id);
+	return true;
+}
+
+bool RetentionSweeper::addParent(Id id, Id parentId) {
+	return true;
+}
+
+bool RetentionSweeper::removeParent(Id id, Id parentId) {
+	return true;
+}
+
+} // namespace rsg_bridge
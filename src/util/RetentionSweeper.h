@@ -0,0 +1,154 @@
+/*
+ * Retention policies for observations.
+ */
+
+#ifndef RSG_BRIDGE_RETENTIONSWEEPER_H_
+#define RSG_BRIDGE_RETENTIONSWEEPER_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+#define RSG_RETENTION_POLICY_KEY "rsg:retention_policy"
+
+enum RetentionPolicyType {
+	RETENTION_MAX_AGE = 0,
+	RETENTION_MAX_COUNT_PER_PARENT = 1
+};
+
+/**
+ * @brief A parsed rsg:retention_policy attribute of the root node.
+ */
+struct RetentionPolicy {
+	RetentionPolicyType type;
+	std::string key;        // nodes with this attribute key ...
+	std::string value;      // ... and this value, if hasValue
+	bool hasValue;
+	double maxAge;          // [s]
+	unsigned int maxCount;
+
+	/**
+	 * @brief Parse a policy. The accepted forms are:
+	 * @code
+	 * keep Nodes with sherpa:observation_type=image for 3600 s
+	 * keep 100 Nodes with sherpa:observation_type per parent
+	 * @endcode
+	 * Without "=value" any value of the key matches.
+	 */
+	static bool parse(const std::string& text, RetentionPolicy& policy);
+
+	bool matches(const std::vector<brics_3d::rsg::Attribute>& attributes) const;
+};
+
+/**
+ * @brief Counters of a RetentionSweeper.
+ */
+struct RetentionStatistics {
+	unsigned int policyCount;
+	unsigned int trackedNodeCount;
+	uint64_t expiredByAgeCount;
+	uint64_t expiredByCountCount;
+	uint64_t deletedConnectionCount;  // Connections that pointed to an expired node, e.g. geo poses
+	double maxSweepTime;              // [s]
+};
+
+/**
+ * @brief Enforces the retention policies of a World Model incrementally.
+ *
+ * Policies are declared like the rsg:agent_policy constraints as attributes of the
+ * root node, e.g.
+ * @code
+ * wm:addNodeAttribute(rootId, "rsg:retention_policy", "keep Nodes with sherpa:observation_type for 3600 s");
+ * @endcode
+ * The sweeper observes the scene and indexes every new node that matches a policy with
+ * the time it was added and its parents, so a sweep never traverses the graph. sweep()
+ * deletes at most a given number of expired nodes via the scene, i.e. as regular delete
+ * updates that the attached observers (senders, monitors, logs) see as well. Connections
+ * that point to an expired node (e.g. geo poses of observations) are deleted with it.
+ *
+ * Only nodes below the root node of this agent are indexed. Replicated nodes of other
+ * agents hang below their remote root nodes; the time they arrived here says nothing
+ * about their age, and their owner applies its own policies to them. Nodes that
+ * existed before a policy was declared are not indexed.
+ */
+class RetentionSweeper : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	RetentionSweeper(brics_3d::WorldModel* wm);
+	virtual ~RetentionSweeper();
+
+	/**
+	 * @brief Delete expired nodes. Has to be called under the write lock of the World Model.
+	 * @param maxDeletions Upper bound of deleted nodes per call. The rest is deleted by the next calls.
+	 * @return Number of deleted nodes.
+	 */
+	unsigned int sweep(unsigned int maxDeletions);
+
+	RetentionStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	/* Index entry of a node that matches at least one node policy */
+	struct TrackedNode {
+		double addedTime;                          // [s]
+		std::vector<unsigned int> countedPolicies; // count policies that count it below parentId
+		brics_3d::rsg::Id parentId;
+		std::vector<brics_3d::rsg::Id> connectionIds; // Connections that point to it
+		bool isExpired;                               // queued for deletion
+	};
+
+	/* Live children of a parent for a count policy, oldest first */
+	struct CountedChildren {
+		CountedChildren() : liveCount(0) {}
+		std::deque<brics_3d::rsg::Id> order; // may contain deleted nodes
+		unsigned int liveCount;
+	};
+
+	void updatePolicies(const std::vector<brics_3d::rsg::Attribute>& rootAttributes);
+	bool matchesAnyPolicy(const std::vector<brics_3d::rsg::Attribute>& attributes);
+	bool isOwned(brics_3d::rsg::Id parentId);
+	void track(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId, const std::vector<brics_3d::rsg::Attribute>& attributes);
+	void untrack(brics_3d::rsg::Id id);
+	void expire(brics_3d::rsg::Id id, bool byAge);
+	double now();
+
+	brics_3d::WorldModel* wm;
+
+	boost::mutex mutex;
+	std::vector<std::string> policyTexts; // as declared, to detect changes
+	std::vector<RetentionPolicy> policies;
+	std::map<brics_3d::rsg::Id, TrackedNode> trackedNodes;
+	std::vector<std::deque<std::pair<double, brics_3d::rsg::Id> > > ageQueues; // per policy, oldest first
+	std::vector<std::map<brics_3d::rsg::Id, CountedChildren> > countedChildren; // per policy and parent
+	std::deque<brics_3d::rsg::Id> expiredNodes; // to be deleted by the next sweeps
+	std::set<brics_3d::rsg::Id> remoteRootIds;  // roots of the replicated subgraphs of other agents
+	RetentionStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_RETENTIONSWEEPER_H_ */
@@ -0,0 +1,176 @@
+/*
+ * Lock-free single producer single consumer rings in a shared memory segment.
+ */
+
+#ifndef RSG_BRIDGE_SHMRING_H_
+#define RSG_BRIDGE_SHMRING_H_
+
+/*
+ * This header is shared by the ShmServer of the SWM and the C clients (cf. swmshm.h),
+ * so it is plain C.
+ *
+ * A segment has a fixed number of client slots. A client claims a free slot and
+ * then owns the producer side of its requests ring and the consumer side of its
+ * replies ring; the server owns the other sides. Thus, each ring has exactly one
+ * producer and one consumer and needs no locks. Messages are framed by a 4 byte
+ * length and padded to 4 bytes.
+ *
+ * Waiting is done with futexes on counters in the segment, so no file descriptors
+ * have to be exchanged between the processes. A producer increments the signal of
+ * a ring after publishing a frame and only enters the kernel if a consumer waits.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RSG_SHM_MAGIC 0x52534732u           /* "RSG2", changes with the layout */
+#define RSG_SHM_MAX_CLIENTS 16
+#define RSG_SHM_RING_SIZE (1u << 20)        /* bytes per direction and client, a power of two */
+#define RSG_SHM_CACHE_LINE 64
+#define RSG_SHM_MAX_MESSAGE_SIZE (RSG_SHM_RING_SIZE - sizeof(uint32_t) - 3) /* a larger frame never fits */
+
+enum rsg_shm_slot_state {
+	RSG_SHM_SLOT_FREE = 0,
+	RSG_SHM_SLOT_USED = 1,
+	RSG_SHM_SLOT_CLOSING = 2                /* set by a client that leaves, the server frees the slot */
+};
+
+typedef struct rsg_shm_ring {
+	uint32_t head;                          /* written by the producer only */
+	uint32_t data_signal;                   /* futex word, incremented by the producer */
+	uint32_t data_waiters;
+	char pad0[RSG_SHM_CACHE_LINE - 3 * sizeof(uint32_t)];
+	uint32_t tail;                          /* written by the consumer only */
+	uint32_t space_signal;                  /* futex word, incremented by the consumer */
+	uint32_t space_waiters;
+	char pad1[RSG_SHM_CACHE_LINE - 3 * sizeof(uint32_t)];
+	char data[RSG_SHM_RING_SIZE];
+} rsg_shm_ring_t;
+
+typedef struct rsg_shm_slot {
+	uint32_t state;                         /* rsg_shm_slot_state, claimed by compare and swap */
+	int32_t pid;                            /* of the client, to free the slots of crashed clients */
+	char pad[RSG_SHM_CACHE_LINE - 2 * sizeof(uint32_t)];
+	rsg_shm_ring_t requests;                /* client -> server */
+	rsg_shm_ring_t replies;                 /* server -> client */
+} rsg_shm_slot_t;
+
+typedef struct rsg_shm_segment {
+	uint32_t magic;                         /* set last by the server, when the segment is ready */
+	uint32_t ring_size;
+	uint32_t slot_count;
+	uint32_t server_alive;
+	uint32_t doorbell;                      /* futex word of the server, incremented for every request */
+	uint32_t doorbell_waiters;
+	int32_t server_pid;                     /* a new server only replaces the segment if this process is gone */
+	char pad[RSG_SHM_CACHE_LINE - 7 * sizeof(uint32_t)];
+	rsg_shm_slot_t slots[RSG_SHM_MAX_CLIENTS];
+} rsg_shm_segment_t;
+
+static inline long rsg_shm_futex(uint32_t* word, int operation, uint32_t value, const struct timespec* timeout) {
+	return syscall(SYS_futex, word, operation, value, timeout, NULL, 0); /* not private: shared between processes */
+}
+
+/* Wake up all waiters of a signal. Cheap if there are none. */
+static inline void rsg_shm_notify(uint32_t* signal, uint32_t* waiters) {
+	__atomic_add_fetch(signal, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiters, __ATOMIC_SEQ_CST) > 0) {
+		rsg_shm_futex(signal, FUTEX_WAKE, INT_MAX, NULL);
+	}
+}
+
+/*
+ * Wait until a signal differs from seen, i.e. the value it had before the
+ * condition was checked. Returns ETIMEDOUT after timeout_ms, a negative timeout
+ * waits forever. Spurious wake-ups are possible, so check the condition again.
+ */
+static inline int rsg_shm_wait(uint32_t* signal, uint32_t* waiters, uint32_t seen, int timeout_ms) {
+	struct timespec timeout;
+	long result;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	__atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	result = rsg_shm_futex(signal, FUTEX_WAIT, seen, (timeout_ms >= 0) ? &timeout : NULL); /* returns at once if the signal changed */
+	__atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	return ((result != 0) && (errno == ETIMEDOUT)) ? ETIMEDOUT : 0;
+}
+
+static inline uint32_t rsg_shm_frame_size(uint32_t length) {
+	return (uint32_t)sizeof(uint32_t) + ((length + 3u) & ~3u);
+}
+
+static inline void rsg_shm_copy_in(rsg_shm_ring_t* ring, uint32_t position, const char* source, uint32_t length) {
+	uint32_t offset = position & (RSG_SHM_RING_SIZE - 1);
+	uint32_t first = (length < RSG_SHM_RING_SIZE - offset) ? length : RSG_SHM_RING_SIZE - offset;
+	memcpy(ring->data + offset, source, first);
+	memcpy(ring->data, source + first, length - first); /* wrap around */
+}
+
+static inline void rsg_shm_copy_out(const rsg_shm_ring_t* ring, uint32_t position, char* target, uint32_t length) {
+	uint32_t offset = position & (RSG_SHM_RING_SIZE - 1);
+	uint32_t first = (length < RSG_SHM_RING_SIZE - offset) ? length : RSG_SHM_RING_SIZE - offset;
+	memcpy(target, ring->data + offset, first);
+	memcpy(target + first, ring->data, length - first);
+}
+
+/*
+ * Append a frame. Returns 0 on success, EAGAIN if the ring is full and EMSGSIZE
+ * if the message never fits. The producer notifies the consumer afterwards.
+ */
+static inline int rsg_shm_ring_try_write(rsg_shm_ring_t* ring, const char* data, uint32_t length) {
+	uint32_t head = ring->head; /* own index */
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint32_t frame;
+	if (length > RSG_SHM_MAX_MESSAGE_SIZE) {
+		return EMSGSIZE;
+	}
+	frame = rsg_shm_frame_size(length);
+	if (RSG_SHM_RING_SIZE - (head - tail) < frame) {
+		return EAGAIN;
+	}
+	rsg_shm_copy_in(ring, head, (const char*)&length, sizeof(length)); /* aligned, so it never wraps */
+	rsg_shm_copy_in(ring, head + sizeof(uint32_t), data, length);
+	__atomic_store_n(&ring->head, head + frame, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*
+ * Take the oldest frame. Returns 0 on success, EAGAIN if the ring is empty and
+ * EMSGSIZE if the buffer is too small; length is the size of the message then.
+ */
+static inline int rsg_shm_ring_try_read(rsg_shm_ring_t* ring, char* buffer, uint32_t capacity, uint32_t* length) {
+	uint32_t tail = ring->tail; /* own index */
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (head == tail) {
+		return EAGAIN;
+	}
+	rsg_shm_copy_out(ring, tail, (char*)length, sizeof(*length));
+	if (*length > capacity) {
+		return EMSGSIZE;
+	}
+	rsg_shm_copy_out(ring, tail + sizeof(uint32_t), buffer, *length);
+	__atomic_store_n(&ring->tail, tail + rsg_shm_frame_size(*length), __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Reset a ring that has neither a producer nor a consumer any more. */
+static inline void rsg_shm_ring_reset(rsg_shm_ring_t* ring) {
+	__atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->tail, 0, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RSG_BRIDGE_SHMRING_H_ */
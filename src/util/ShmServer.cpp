@@ -0,0 +1,270 @@
+#include "ShmServer.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/bind.hpp>
+#include <boost/regex.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+static const int STALE_CLIENT_CHECK_INTERVAL = 1000; // [ms]
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+
+ShmServer::ShmServer(const std::string& segmentName, MessageHandler handler, mode_t mode) :
+		segmentName(segmentName), handler(handler), mode(mode), segment(0), thread(0) {
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+ShmServer::~ShmServer() {
+	stop();
+}
+
+double ShmServer::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+bool ShmServer::start() {
+	if (segment != 0) {
+		return true;
+	}
+	if (isSegmentInUse()) {
+		LOG(ERROR) << "ShmServer: Shared memory segment " << segmentName << " is used by a running server.";
+		return false;
+	}
+	shm_unlink(segmentName.c_str()); // left over by a crashed server, if any
+	int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+	if (fd < 0) {
+		LOG(ERROR) << "ShmServer: Cannot create shared memory segment " << segmentName << ": " << strerror(errno);
+		return false;
+	}
+	if (ftruncate(fd, sizeof(rsg_shm_segment_t)) != 0) {
+		LOG(ERROR) << "ShmServer: Cannot resize shared memory segment " << segmentName << ": " << strerror(errno);
+		close(fd);
+		shm_unlink(segmentName.c_str());
+		return false;
+	}
+	void* memory = mmap(0, sizeof(rsg_shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); // the mapping stays valid
+	if (memory == MAP_FAILED) {
+		LOG(ERROR) << "ShmServer: Cannot map shared memory segment " << segmentName << ": " << strerror(errno);
+		shm_unlink(segmentName.c_str());
+		return false;
+	}
+
+	/* A new segment is zero filled, i.e. all slots are free and all rings empty */
+	segment = static_cast<rsg_shm_segment_t*>(memory);
+	segment->ring_size = RSG_SHM_RING_SIZE;
+	segment->slot_count = RSG_SHM_MAX_CLIENTS;
+	segment->server_alive = 1;
+	segment->server_pid = static_cast<int32_t>(getpid());
+	__atomic_store_n(&segment->magic, RSG_SHM_MAGIC, __ATOMIC_RELEASE); // clients may attach from now on
+
+	thread = new boost::thread(boost::bind(&ShmServer::serve, this));
+	LOG(INFO) << "ShmServer: Serving clients via shared memory segment " << segmentName << " (" << sizeof(rsg_shm_segment_t) << " bytes).";
+	return true;
+}
+
+void ShmServer::stop() {
+	if (segment == 0) {
+		return;
+	}
+	__atomic_store_n(&segment->server_alive, 0, __ATOMIC_RELEASE);
+	rsg_shm_notify(&segment->doorbell, &segment->doorbell_waiters);
+	for (unsigned int i = 0; i < RSG_SHM_MAX_CLIENTS; ++i) { // a server that waits for space in a replies ring
+		rsg_shm_notify(&segment->slots[i].replies.space_signal, &segment->slots[i].replies.space_waiters);
+	}
+	thread->join();
+	delete thread;
+	thread = 0;
+	releaseStaleSlots(); // updates the client count
+
+	/* Clients that wait for a reply see that the server is gone */
+	for (unsigned int i = 0; i < RSG_SHM_MAX_CLIENTS; ++i) {
+		rsg_shm_notify(&segment->slots[i].replies.data_signal, &segment->slots[i].replies.data_waiters);
+	}
+	munmap(segment, sizeof(rsg_shm_segment_t));
+	segment = 0;
+	shm_unlink(segmentName.c_str()); // attached clients keep their mapping until they leave
+	LOG(INFO) << "ShmServer: Removed shared memory segment " << segmentName << ".";
+}
+
+void ShmServer::serve() {
+	std::vector<char> buffer(RSG_SHM_RING_SIZE); // every frame fits
+	while (__atomic_load_n(&segment->server_alive, __ATOMIC_ACQUIRE)) {
+		uint32_t seen = __atomic_load_n(&segment->doorbell, __ATOMIC_SEQ_CST);
+		if (processRequests(buffer)) {
+			continue;
+		}
+		if (rsg_shm_wait(&segment->doorbell, &segment->doorbell_waiters, seen, STALE_CLIENT_CHECK_INTERVAL) == ETIMEDOUT) {
+			releaseStaleSlots();
+		}
+	}
+}
+
+bool ShmServer::processRequests(std::vector<char>& buffer) {
+	bool processed = false;
+	for (unsigned int i = 0; i < RSG_SHM_MAX_CLIENTS; ++i) { // one request per client and round, so no client starves
+		rsg_shm_slot_t* slot = &segment->slots[i];
+		uint32_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+		if (state == RSG_SHM_SLOT_CLOSING) {
+			releaseSlot(slot);
+			continue;
+		}
+		uint32_t length = 0;
+		if ((state != RSG_SHM_SLOT_USED) || (rsg_shm_ring_try_read(&slot->requests, &buffer[0], static_cast<uint32_t>(buffer.size()), &length) != 0)) {
+			continue;
+		}
+		rsg_shm_notify(&slot->requests.space_signal, &slot->requests.space_waiters);
+
+		std::string message(&buffer[0], length);
+		while (!message.empty() && (message[message.size() - 1] == '\0')) { // some clients send C strings
+			message.erase(message.size() - 1);
+		}
+		std::string reply;
+		double startTime = now();
+		handler(message, reply);
+		double processingTime = now() - startTime;
+
+		bool isOversized = (reply.size() > RSG_SHM_MAX_MESSAGE_SIZE);
+		if (isOversized) {
+			LOG(WARNING) << "ShmServer: A reply with " << reply.size() << " bytes does not fit into the ring of "
+					<< RSG_SHM_RING_SIZE << " bytes of the client in slot " << i << ". Sending an error reply instead.";
+			std::stringstream error;
+			error << "Reply with " << reply.size() << " bytes exceeds the shared memory ring size of " << RSG_SHM_RING_SIZE << " bytes.";
+			reply = createErrorReply(message, error.str());
+		}
+		bool isDropped = !reply.empty() && !sendReply(slot, reply);
+		if (isDropped) {
+			LOG(WARNING) << "ShmServer: Dropping a reply for the client in slot " << i << ", as it has left.";
+		}
+
+		boost::unique_lock<boost::mutex> lock(mutex);
+		statistics.requestCount++;
+		if (!reply.empty()) {
+			(isDropped ? statistics.droppedReplyCount : statistics.replyCount)++;
+		}
+		if (isOversized) {
+			statistics.oversizedReplyCount++;
+		}
+		statistics.maxProcessingTime = std::max(statistics.maxProcessingTime, processingTime);
+		processed = true;
+	}
+	return processed;
+}
+
+bool ShmServer::sendReply(rsg_shm_slot_t* slot, const std::string& reply) {
+	while (__atomic_load_n(&segment->server_alive, __ATOMIC_ACQUIRE)) {
+		uint32_t seen = __atomic_load_n(&slot->replies.space_signal, __ATOMIC_SEQ_CST);
+		if (rsg_shm_ring_try_write(&slot->replies, reply.c_str(), static_cast<uint32_t>(reply.size())) == 0) {
+			rsg_shm_notify(&slot->replies.data_signal, &slot->replies.data_waiters);
+			return true;
+		}
+		if (!isClientAlive(slot)) {
+			return false;
+		}
+
+		/* The ring is full: wait until the client takes its replies, but never for a client that is gone */
+		LOG(DEBUG) << "ShmServer: Waiting for space in the replies ring of slot " << (slot - segment->slots) << ".";
+		rsg_shm_wait(&slot->replies.space_signal, &slot->replies.space_waiters, seen, STALE_CLIENT_CHECK_INTERVAL);
+	}
+	return false;
+}
+
+bool ShmServer::isClientAlive(rsg_shm_slot_t* slot) {
+	if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != RSG_SHM_SLOT_USED) {
+		return false;
+	}
+	return (slot->pid <= 0) || (kill(slot->pid, 0) == 0) || (errno != ESRCH);
+}
+
+bool ShmServer::isSegmentInUse() {
+	int fd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat status;
+	bool isInUse = false;
+	if ((fstat(fd, &status) == 0) && (status.st_size >= static_cast<off_t>(sizeof(rsg_shm_segment_t)))) {
+		void* memory = mmap(0, sizeof(rsg_shm_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+		if (memory != MAP_FAILED) {
+			const rsg_shm_segment_t* existing = static_cast<const rsg_shm_segment_t*>(memory);
+			isInUse = (__atomic_load_n(&existing->magic, __ATOMIC_ACQUIRE) == RSG_SHM_MAGIC)
+					&& (__atomic_load_n(&existing->server_alive, __ATOMIC_ACQUIRE) != 0)
+					&& (existing->server_pid > 0)
+					&& ((kill(existing->server_pid, 0) == 0) || (errno != ESRCH));
+			munmap(memory, sizeof(rsg_shm_segment_t));
+		}
+	}
+	close(fd);
+	return isInUse;
+}
+
+std::string ShmServer::createErrorReply(const std::string& message, const std::string& error) {
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", ";
+	boost::smatch queryId;
+	if (boost::regex_search(message, queryId, queryIdPattern)) {
+		reply << "\"queryId\": \"" << queryId[1] << "\", ";
+	}
+	reply << "\"querySuccess\": false, \"error\": \"" << error << "\"}";
+	return reply.str();
+}
+
+void ShmServer::releaseSlot(rsg_shm_slot_t* slot) {
+	rsg_shm_ring_reset(&slot->requests);
+	rsg_shm_ring_reset(&slot->replies);
+	slot->pid = 0;
+	__atomic_store_n(&slot->state, RSG_SHM_SLOT_FREE, __ATOMIC_RELEASE);
+	LOG(DEBUG) << "ShmServer: Released slot " << (slot - segment->slots) << ".";
+}
+
+void ShmServer::releaseStaleSlots() {
+	unsigned int clientCount = 0;
+	for (unsigned int i = 0; i < RSG_SHM_MAX_CLIENTS; ++i) {
+		rsg_shm_slot_t* slot = &segment->slots[i];
+		if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != RSG_SHM_SLOT_USED) {
+			continue;
+		}
+		if ((slot->pid > 0) && (kill(slot->pid, 0) != 0) && (errno == ESRCH)) {
+			LOG(WARNING) << "ShmServer: Client with pid " << slot->pid << " is gone. Releasing its slot.";
+			releaseSlot(slot);
+			continue;
+		}
+		clientCount++;
+	}
+	boost::unique_lock<boost::mutex> lock(mutex);
+	statistics.clientCount = clientCount;
+}
+
+ShmServerStatistics ShmServer::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return statistics;
+}
+
+std::string ShmServer::getStatisticsAsString() {
+	ShmServerStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Shared memory server: requests = " << current.requestCount
+			<< ", replies = " << current.replyCount
+			<< ", dropped replies = " << current.droppedReplyCount
+			<< ", oversized replies = " << current.oversizedReplyCount
+			<< ", clients = " << current.clientCount
+			<< ", max. processing time = " << current.maxProcessingTime << " [s]";
+	return result.str();
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,93 @@
+/*
+ * Shared memory transport for clients on the same computer.
+ */
+
+#ifndef RSG_BRIDGE_SHMSERVER_H_
+#define RSG_BRIDGE_SHMSERVER_H_
+
+#include "ShmRing.h"
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Counters of a ShmServer.
+ */
+struct ShmServerStatistics {
+	uint64_t requestCount;
+	uint64_t replyCount;
+	uint64_t droppedReplyCount; // the client left before there was space for the reply
+	uint64_t oversizedReplyCount; // replaced by an error reply, as they never fit into a ring
+	unsigned int clientCount;
+	double maxProcessingTime;   // [s]
+};
+
+/**
+ * @brief Serves RSG-JSON messages of co-located clients via shared memory.
+ *
+ * The server creates a POSIX shared memory segment with the layout of ShmRing.h.
+ * Every client claims a slot with a requests and a replies ring. One thread takes
+ * the requests of all clients in turn, processes them with the handler and writes
+ * non-empty replies to the ring of the requesting client. Neither side copies more
+ * than the message into the ring, and an idle server or client sleeps on a futex.
+ *
+ * If the replies ring of a client is full, the server waits until the client has
+ * taken enough replies. A reply that is larger than a ring is replaced by a failed
+ * RSGQueryResult with an error message. Slots of clients that left or crashed are
+ * freed, and a reply for such a client is dropped.
+ *
+ * The segment is created with the given access mode, by default only for the user
+ * of the SWM. An existing segment of a running server is never replaced.
+ */
+class ShmServer {
+public:
+	typedef boost::function<void (std::string& message, std::string& reply)> MessageHandler;
+
+	/**
+	 * @param segmentName Name of the shared memory segment, e.g. "/swm_query".
+	 * @param handler Processes a message. An empty reply is not sent.
+	 * @param mode Access permissions of the segment. Clients of other users need e.g. 0660 or 0666.
+	 */
+	ShmServer(const std::string& segmentName, MessageHandler handler, mode_t mode = 0600);
+	virtual ~ShmServer();
+
+	/// Create the segment and start the thread. Returns false if the segment cannot be created or is used by a running server.
+	bool start();
+
+	/// Stop the thread and remove the segment. Waiting clients return.
+	void stop();
+
+	ShmServerStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+private:
+	void serve();
+	bool processRequests(std::vector<char>& buffer);
+	bool sendReply(rsg_shm_slot_t* slot, const std::string& reply);
+	bool isClientAlive(rsg_shm_slot_t* slot);
+	bool isSegmentInUse();
+	static std::string createErrorReply(const std::string& message, const std::string& error);
+	void releaseSlot(rsg_shm_slot_t* slot);
+	void releaseStaleSlots();
+	static double now();
+
+	std::string segmentName;
+	MessageHandler handler;
+	mode_t mode;
+	rsg_shm_segment_t* segment;
+	boost::thread* thread;
+
+	boost::mutex mutex;
+	ShmServerStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SHMSERVER_H_ */
@@ -0,0 +1,130 @@
+#include "SnapshotFilter.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <map>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+SnapshotFilter::SnapshotFilter() : maxDepth(-1), matchAnyValue(true) {
+
+}
+
+SnapshotFilter::~SnapshotFilter() {
+
+}
+
+void SnapshotFilter::setMaxDepth(int maxDepth) {
+	this->maxDepth = maxDepth;
+}
+
+void SnapshotFilter::setAttributeFilter(std::string expression) {
+	size_t separator = expression.find('=');
+	if (separator == std::string::npos) {
+		attributeKey = expression;
+		attributeValue = "";
+		matchAnyValue = true;
+	} else {
+		attributeKey = expression.substr(0, separator);
+		attributeValue = expression.substr(separator + 1);
+		matchAnyValue = false;
+	}
+}
+
+bool SnapshotFilter::isActive() const {
+	return (maxDepth >= 0) || !attributeKey.empty();
+}
+
+bool SnapshotFilter::matches(const SnapshotReader& reader, const SnapshotNode& node) const {
+	vector<Attribute> attributes;
+	reader.getAttributes(node, attributes);
+	for (vector<Attribute>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+		if ((it->key.compare(attributeKey) == 0) && (matchAnyValue || (it->value.compare(attributeValue) == 0))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned int SnapshotFilter::select(const SnapshotReader& reader, std::vector<bool>& selection) const {
+	const SnapshotHeader* header = reader.getHeader();
+	const SnapshotNode* nodes = reader.getNodes();
+	selection.assign(header->nodeCount, true);
+	if (!isActive()) {
+		return static_cast<unsigned int>(header->nodeCount);
+	}
+
+	/* Parents precede their children, so a single pass is sufficient to determine depth and parent record. */
+	std::map<SnapshotId, int, SnapshotIdLess> depths;
+	std::map<SnapshotId, uint64_t, SnapshotIdLess> recordIndices;
+	std::vector<uint64_t> parentRecords(header->nodeCount, header->nodeCount);
+	depths[header->rootId] = 0;
+	for (uint64_t i = 0; i < header->nodeCount; ++i) {
+		const SnapshotNode& node = nodes[i];
+		if (isSnapshotTombstone(node.type)) {
+			selection[i] = false; // a filtered view only shows existing nodes
+			continue;
+		}
+		if ((node.type == SNAPSHOT_ROOT_ATTRIBUTES) || (node.type == SNAPSHOT_PARENT)) {
+			continue;
+		}
+		int depth = 0;
+		if (node.type != SNAPSHOT_REMOTE_ROOT) {
+			std::map<SnapshotId, int, SnapshotIdLess>::const_iterator parentDepth = depths.find(node.parentId);
+			depth = (parentDepth != depths.end()) ? parentDepth->second + 1 : 1; // unknown parents are treated like the root
+			std::map<SnapshotId, uint64_t, SnapshotIdLess>::const_iterator parentRecord = recordIndices.find(node.parentId);
+			if (parentRecord != recordIndices.end()) {
+				parentRecords[i] = parentRecord->second;
+			}
+		}
+		depths[node.id] = depth;
+		recordIndices[node.id] = i;
+		selection[i] = (maxDepth < 0) || (depth <= maxDepth);
+	}
+
+	/* Attribute filter: keep matches and all of their ancestors */
+	if (!attributeKey.empty()) {
+		std::vector<bool> isMatchOrAncestor(header->nodeCount, false);
+		for (uint64_t i = header->nodeCount; i-- > 0;) {
+			const SnapshotNode& node = nodes[i];
+			if ((node.type == SNAPSHOT_ROOT_ATTRIBUTES) || (node.type == SNAPSHOT_PARENT) || isSnapshotTombstone(node.type)) {
+				continue;
+			}
+			if (selection[i] && matches(reader, node)) {
+				isMatchOrAncestor[i] = true;
+			}
+			if (isMatchOrAncestor[i] && (parentRecords[i] < header->nodeCount)) {
+				isMatchOrAncestor[parentRecords[i]] = true;
+			}
+		}
+		for (uint64_t i = 0; i < header->nodeCount; ++i) {
+			if ((nodes[i].type != SNAPSHOT_ROOT_ATTRIBUTES) && (nodes[i].type != SNAPSHOT_PARENT) && !isSnapshotTombstone(nodes[i].type)) {
+				selection[i] = isMatchOrAncestor[i];
+			}
+		}
+	}
+
+	/* Additional parent relations are kept if both ends are kept */
+	unsigned int selectedCount = 0;
+	for (uint64_t i = 0; i < header->nodeCount; ++i) {
+		const SnapshotNode& node = nodes[i];
+		if (node.type == SNAPSHOT_PARENT) {
+			std::map<SnapshotId, uint64_t, SnapshotIdLess>::const_iterator child = recordIndices.find(node.id);
+			std::map<SnapshotId, uint64_t, SnapshotIdLess>::const_iterator parent = recordIndices.find(node.parentId);
+			bool isParentSelected = isSameSnapshotId(node.parentId, header->rootId) ||
+					((parent != recordIndices.end()) && selection[parent->second]);
+			selection[i] = (child != recordIndices.end()) && selection[child->second] && isParentSelected;
+		}
+		if (selection[i]) {
+			selectedCount++;
+		}
+	}
+
+	LOG(DEBUG) << "SnapshotFilter: Selected " << selectedCount << " of " << header->nodeCount << " primitives.";
+	return selectedCount;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,61 @@
+/*
+ * Selects a part of a snapshot (cf. SnapshotFormat.h), e.g. to restrict a
+ * visualization to the top levels of a large graph.
+ */
+
+#ifndef RSG_BRIDGE_SNAPSHOTFILTER_H_
+#define RSG_BRIDGE_SNAPSHOTFILTER_H_
+
+#include "SnapshotReader.h"
+
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Filters the primitives of a snapshot by depth and by attributes.
+ *
+ * The depth of the root node and of remote root nodes is 0. An attribute filter
+ * selects all nodes with a matching attribute together with their ancestors, so
+ * the result is still a connected graph. Both filters can be combined.
+ */
+class SnapshotFilter {
+public:
+	SnapshotFilter();
+	virtual ~SnapshotFilter();
+
+	/// Only select nodes up to the given depth. A negative value means unlimited.
+	void setMaxDepth(int maxDepth);
+	int getMaxDepth() const { return maxDepth; }
+
+	/**
+	 * @brief Only select nodes with a matching attribute.
+	 * @param expression Either "key" to match any value or "key=value". An empty
+	 *        string disables the attribute filter.
+	 */
+	void setAttributeFilter(std::string expression);
+
+	/// True if any filter is set, i.e. select() might reject primitives.
+	bool isActive() const;
+
+	/**
+	 * @brief Decide for every entry of the node table if it passes the filters.
+	 * @param reader Opened snapshot.
+	 * @param[out] selection One entry per node record.
+	 * @return Number of selected records.
+	 */
+	unsigned int select(const SnapshotReader& reader, std::vector<bool>& selection) const;
+
+private:
+	bool matches(const SnapshotReader& reader, const SnapshotNode& node) const;
+
+	int maxDepth;
+	std::string attributeKey;
+	std::string attributeValue;
+	bool matchAnyValue;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SNAPSHOTFILTER_H_ */
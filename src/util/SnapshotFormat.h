@@ -0,0 +1,144 @@
+/*
+ * Binary snapshot format of a Robot Scene Graph.
+ *
+ * A snapshot file consists of a fixed size header followed by a set of
+ * tables. All tables are arrays of plain structs that can be used directly
+ * from a memory mapped file without any parsing. All strings (attribute keys
+ * and values) are stored in a single string table and referenced by offset
+ * and length. Nodes are stored in traversal order, i.e. a parent always
+ * precedes its children. Incremental dumps may contain tombstones for deleted
+ * nodes and removed parent relations, and update records for nodes that existed
+ * already at the previous dump. Data is stored in host byte order.
+ *
+ *  +-------------------+
+ *  | SnapshotHeader    |
+ *  +-------------------+
+ *  | string table      |  char[stringTableSize]
+ *  | attribute table   |  SnapshotAttribute[attributeCount]
+ *  | node table        |  SnapshotNode[nodeCount]
+ *  | id table          |  SnapshotId[idCount] (sources and targets of Connections)
+ *  | transform table   |  SnapshotTransform[transformCount]
+ *  | shape table       |  SnapshotShape[shapeCount]
+ *  | connection table  |  SnapshotConnection[connectionCount]
+ *  +-------------------+
+ */
+
+#ifndef RSG_BRIDGE_SNAPSHOTFORMAT_H_
+#define RSG_BRIDGE_SNAPSHOTFORMAT_H_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace rsg_bridge {
+
+#define RSG_SNAPSHOT_MAGIC "RSGSNAP"
+#define RSG_SNAPSHOT_VERSION 1
+#define RSG_SNAPSHOT_FILE_SUFFIX ".rsgsnap"
+#define RSG_SNAPSHOT_NO_INDEX 0xFFFFFFFF
+#define RSG_SNAPSHOT_MAX_INDEX 0xFFFFFFFEu // largest 32 bit offset, index or count within the tables
+
+enum SnapshotNodeType {
+	SNAPSHOT_ROOT_ATTRIBUTES = 0, // Attributes of the root node of the dumped graph.
+	SNAPSHOT_NODE = 1,
+	SNAPSHOT_GROUP = 2,
+	SNAPSHOT_TRANSFORM = 3,
+	SNAPSHOT_GEOMETRIC_NODE = 4,
+	SNAPSHOT_CONNECTION = 5,
+	SNAPSHOT_REMOTE_ROOT = 6,
+	SNAPSHOT_PARENT = 7,           // Additional parent-child relation of an existing node.
+	SNAPSHOT_DELETED = 8,          // Tombstone: the node has been deleted (incremental dumps).
+	SNAPSHOT_REMOVED_PARENT = 9,   // Tombstone: the parent-child relation has been removed (incremental dumps).
+	SNAPSHOT_UPDATED_NODE = 10,    // New attributes of a node that existed at the previous dump (incremental dumps).
+	SNAPSHOT_UPDATED_TRANSFORM = 11 // New attributes and latest sample of a Transform that existed at the previous dump.
+};
+
+/* Tombstones are applied before all other records of a snapshot */
+inline bool isSnapshotTombstone(uint32_t type) {
+	return (type == SNAPSHOT_DELETED) || (type == SNAPSHOT_REMOVED_PARENT);
+}
+
+enum SnapshotShapeType {
+	SNAPSHOT_BOX = 0,
+	SNAPSHOT_CYLINDER = 1,
+	SNAPSHOT_SPHERE = 2
+};
+
+/* 16 byte binary representation of a brics_3d::rsg::Id */
+struct SnapshotId {
+	uint8_t data[16];
+};
+
+/* Ordering of binary Ids, e.g. to be used in a std::set */
+struct SnapshotIdLess {
+	bool operator()(const SnapshotId& a, const SnapshotId& b) const {
+		return memcmp(a.data, b.data, sizeof(a.data)) < 0;
+	}
+};
+
+inline bool isSameSnapshotId(const SnapshotId& a, const SnapshotId& b) {
+	return memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+struct SnapshotHeader {
+	char magic[8];                // RSG_SNAPSHOT_MAGIC
+	uint32_t version;             // RSG_SNAPSHOT_VERSION
+	uint32_t headerSize;          // sizeof(SnapshotHeader), for sanity checks
+	SnapshotId rootId;            // root Id of the dumped World Model Agent
+	double stamp;                 // creation time in seconds
+
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+	uint64_t attributeTableOffset;
+	uint64_t attributeCount;
+	uint64_t nodeTableOffset;
+	uint64_t nodeCount;
+	uint64_t idTableOffset;
+	uint64_t idCount;
+	uint64_t transformTableOffset;
+	uint64_t transformCount;
+	uint64_t shapeTableOffset;
+	uint64_t shapeCount;
+	uint64_t connectionTableOffset;
+	uint64_t connectionCount;
+};
+
+struct SnapshotAttribute {
+	uint32_t keyOffset;
+	uint32_t keyLength;
+	uint32_t valueOffset;
+	uint32_t valueLength;
+};
+
+struct SnapshotNode {
+	SnapshotId id;
+	SnapshotId parentId;
+	uint32_t type;                // SnapshotNodeType
+	uint32_t attributeIndex;      // first entry in the attribute table
+	uint32_t attributeCount;
+	uint32_t payloadIndex;        // index into the transform, shape or connection table; otherwise RSG_SNAPSHOT_NO_INDEX
+};
+
+struct SnapshotTransform {
+	double matrix[16];            // column-major as returned by IHomogeneousMatrix44::getRawData()
+	double stamp;                 // in seconds
+};
+
+struct SnapshotShape {
+	uint32_t type;                // SnapshotShapeType
+	uint32_t reserved;
+	double parameters[3];         // Box: x, y, z; Cylinder: radius, height; Sphere: radius
+	double stamp;                 // in seconds
+};
+
+struct SnapshotConnection {
+	uint32_t sourceIndex;         // first entry in the id table
+	uint32_t sourceCount;
+	uint32_t targetIndex;
+	uint32_t targetCount;
+	double start;                 // in seconds
+	double end;                   // in seconds
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SNAPSHOTFORMAT_H_ */
@@ -0,0 +1,371 @@
+#include "SnapshotReader.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+#include <brics_3d/worldModel/sceneGraph/Box.h>
+#include <brics_3d/worldModel/sceneGraph/Cylinder.h>
+#include <brics_3d/worldModel/sceneGraph/Sphere.h>
+
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+SnapshotReader::SnapshotReader() : data(0), size(0), isMapped(false), header(0) {
+
+}
+
+SnapshotReader::~SnapshotReader() {
+	close();
+}
+
+bool SnapshotReader::open(std::string fileName) {
+	close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		LOG(ERROR) << "SnapshotReader: Cannot open file " << fileName;
+		return false;
+	}
+	struct stat fileStatus;
+	if ((fstat(fd, &fileStatus) != 0) || (fileStatus.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))) {
+		LOG(ERROR) << "SnapshotReader: File " << fileName << " is too small to be a snapshot.";
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(0, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping stays valid
+	if (mapping == MAP_FAILED) {
+		LOG(ERROR) << "SnapshotReader: Cannot map file " << fileName;
+		return false;
+	}
+	madvise(mapping, fileStatus.st_size, MADV_SEQUENTIAL);
+
+	data = static_cast<const char*>(mapping);
+	size = fileStatus.st_size;
+	isMapped = true;
+	if (!validate()) {
+		LOG(ERROR) << "SnapshotReader: File " << fileName << " has an invalid format.";
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool SnapshotReader::open(const char* buffer, size_t size) {
+	close();
+	if ((buffer == 0) || (size < sizeof(SnapshotHeader))) {
+		return false;
+	}
+	this->data = buffer;
+	this->size = size;
+	isMapped = false;
+	if (!validate()) {
+		LOG(ERROR) << "SnapshotReader: Buffer has an invalid format.";
+		close();
+		return false;
+	}
+	return true;
+}
+
+void SnapshotReader::close() {
+	if (isMapped && (data != 0)) {
+		munmap(const_cast<char*>(data), size);
+	}
+	data = 0;
+	size = 0;
+	isMapped = false;
+	header = 0;
+}
+
+/* True if count elements of elementSize bytes at offset lie within size bytes */
+static bool fitsInto(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size) {
+	if (offset > size) {
+		return false;
+	}
+	return count <= (size - offset) / elementSize;
+}
+
+bool SnapshotReader::validate() {
+	header = reinterpret_cast<const SnapshotHeader*>(data);
+	if ((strncmp(header->magic, RSG_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) ||
+		(header->version != RSG_SNAPSHOT_VERSION) ||
+		(header->headerSize != sizeof(SnapshotHeader))) {
+		return false;
+	}
+
+	/* check that all tables fit into the data, without overflows of corrupted offsets and counts */
+	if (!fitsInto(header->stringTableOffset, header->stringTableSize, 1, size) ||
+		!fitsInto(header->attributeTableOffset, header->attributeCount, sizeof(SnapshotAttribute), size) ||
+		!fitsInto(header->nodeTableOffset, header->nodeCount, sizeof(SnapshotNode), size) ||
+		!fitsInto(header->idTableOffset, header->idCount, sizeof(SnapshotId), size) ||
+		!fitsInto(header->transformTableOffset, header->transformCount, sizeof(SnapshotTransform), size) ||
+		!fitsInto(header->shapeTableOffset, header->shapeCount, sizeof(SnapshotShape), size) ||
+		!fitsInto(header->connectionTableOffset, header->connectionCount, sizeof(SnapshotConnection), size)) {
+		return false;
+	}
+	return true;
+}
+
+const SnapshotNode* SnapshotReader::getNodes() const {
+	return reinterpret_cast<const SnapshotNode*>(data + header->nodeTableOffset);
+}
+
+const SnapshotTransform* SnapshotReader::getTransforms() const {
+	return reinterpret_cast<const SnapshotTransform*>(data + header->transformTableOffset);
+}
+
+const SnapshotShape* SnapshotReader::getShapes() const {
+	return reinterpret_cast<const SnapshotShape*>(data + header->shapeTableOffset);
+}
+
+const SnapshotConnection* SnapshotReader::getConnections() const {
+	return reinterpret_cast<const SnapshotConnection*>(data + header->connectionTableOffset);
+}
+
+const SnapshotId* SnapshotReader::getIds() const {
+	return reinterpret_cast<const SnapshotId*>(data + header->idTableOffset);
+}
+
+void SnapshotReader::getAttributes(const SnapshotNode& node, vector<Attribute>& attributes) const {
+	attributes.clear();
+	if (static_cast<uint64_t>(node.attributeIndex) + node.attributeCount > header->attributeCount) {
+		return;
+	}
+	const SnapshotAttribute* attributeTable = reinterpret_cast<const SnapshotAttribute*>(data + header->attributeTableOffset);
+	const char* strings = data + header->stringTableOffset;
+	attributes.reserve(node.attributeCount);
+	for (uint32_t i = node.attributeIndex; i < node.attributeIndex + node.attributeCount; ++i) {
+		const SnapshotAttribute& attribute = attributeTable[i];
+		if ((static_cast<uint64_t>(attribute.keyOffset) + attribute.keyLength > header->stringTableSize) ||
+			(static_cast<uint64_t>(attribute.valueOffset) + attribute.valueLength > header->stringTableSize)) {
+			continue;
+		}
+		attributes.push_back(Attribute(std::string(strings + attribute.keyOffset, attribute.keyLength),
+				std::string(strings + attribute.valueOffset, attribute.valueLength)));
+	}
+}
+
+Id SnapshotReader::toId(const SnapshotId& snapshotId) {
+	Id id;
+	memcpy(id.data, snapshotId.data, sizeof(snapshotId.data)); // same byte order as the uuid, no parsing
+	return id;
+}
+
+bool SnapshotReader::mergeRootAttributes(brics_3d::WorldModel* wm, const vector<Attribute>& attributes) {
+	Id rootId = wm->getRootNodeId();
+	vector<Attribute> mergedAttributes;
+	wm->scene.getNodeAttributes(rootId, mergedAttributes);
+	bool hasNewAttributes = false;
+	for (vector<Attribute>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+		bool isPresent = false;
+		for (vector<Attribute>::const_iterator existing = mergedAttributes.begin(); existing != mergedAttributes.end(); ++existing) {
+			if (existing->key.compare(it->key) == 0) {
+				isPresent = true;
+				break;
+			}
+		}
+		if (!isPresent) {
+			mergedAttributes.push_back(*it);
+			hasNewAttributes = true;
+		}
+	}
+	return hasNewAttributes ? wm->scene.setNodeAttributes(rootId, mergedAttributes) : true;
+}
+
+bool SnapshotReader::isExisting(brics_3d::WorldModel* wm, Id id) {
+	vector<Attribute> existingAttributes;
+	return wm->scene.getNodeAttributes(id, existingAttributes);
+}
+
+bool SnapshotReader::hasParent(brics_3d::WorldModel* wm, Id id, Id parentId) {
+	vector<Id> parentIds;
+	wm->scene.getNodeParents(id, parentIds);
+	return std::find(parentIds.begin(), parentIds.end(), parentId) != parentIds.end();
+}
+
+brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr SnapshotReader::toTransform(const SnapshotTransform& snapshotTransform) {
+	brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+	memcpy(transform->setRawData(), snapshotTransform.matrix, sizeof(snapshotTransform.matrix));
+	return transform;
+}
+
+bool SnapshotReader::update(brics_3d::WorldModel* wm, const SnapshotNode& node, Id id, Id parentId, const vector<Attribute>& attributes) {
+	bool success = true;
+	vector<Attribute> existingAttributes;
+	wm->scene.getNodeAttributes(id, existingAttributes);
+	if (existingAttributes != attributes) {
+		success = wm->scene.setNodeAttributes(id, attributes);
+	}
+	if (((node.type == SNAPSHOT_TRANSFORM) || (node.type == SNAPSHOT_UPDATED_TRANSFORM)) && (node.payloadIndex < header->transformCount)) {
+		const SnapshotTransform& snapshotTransform = getTransforms()[node.payloadIndex];
+		success = wm->scene.setTransform(id, toTransform(snapshotTransform), TimeStamp(snapshotTransform.stamp, brics_3d::Units::Second)) && success;
+	}
+	if ((node.type != SNAPSHOT_REMOTE_ROOT) && !hasParent(wm, id, parentId)) { // e.g. a node that got another parent
+		success = wm->scene.addParent(id, parentId) && success;
+	}
+	return success;
+}
+
+unsigned int SnapshotReader::apply(brics_3d::WorldModel* wm, bool mapUnknownParentIdsToRootId, const std::vector<bool>* selection) {
+	if (!isOpen()) {
+		LOG(ERROR) << "SnapshotReader: No snapshot opened.";
+		return 0;
+	}
+
+	unsigned int successCount = 0;
+	Id rootId = wm->getRootNodeId();
+	std::set<SnapshotId, SnapshotIdLess> knownIds;
+	const SnapshotNode* nodes = getNodes();
+	vector<Attribute> attributes;
+
+	/* Tombstones first, so a delta never restores deleted nodes or parent relations */
+	for (uint64_t i = 0; i < header->nodeCount; ++i) {
+		const SnapshotNode& node = nodes[i];
+		if (!isSnapshotTombstone(node.type) || ((selection != 0) && ((i >= selection->size()) || !(*selection)[i]))) {
+			continue;
+		}
+		Id id = toId(node.id);
+		if (!wm->scene.getNodeAttributes(id, attributes)) {
+			continue; // not known here, e.g. added and deleted between two dumps
+		}
+		bool success = false;
+		if (node.type == SNAPSHOT_DELETED) {
+			success = wm->scene.deleteNode(id);
+		} else {
+			Id parentId = isSameSnapshotId(node.parentId, header->rootId) ? rootId : toId(node.parentId);
+			success = wm->scene.removeParent(id, parentId);
+		}
+		if (success) {
+			successCount++;
+		}
+	}
+
+	for (uint64_t i = 0; i < header->nodeCount; ++i) {
+		if ((selection != 0) && ((i >= selection->size()) || !(*selection)[i])) {
+			continue;
+		}
+		const SnapshotNode& node = nodes[i];
+		if (isSnapshotTombstone(node.type)) {
+			continue;
+		}
+		getAttributes(node, attributes);
+		Id id = toId(node.id);
+
+		/* resolve the parent */
+		Id parentId;
+		if (isSameSnapshotId(node.parentId, header->rootId)) {
+			parentId = rootId;
+		} else {
+			parentId = toId(node.parentId);
+			if (mapUnknownParentIdsToRootId && (knownIds.find(node.parentId) == knownIds.end())) {
+				vector<Attribute> parentAttributes;
+				if (!wm->scene.getNodeAttributes(parentId, parentAttributes)) {
+					LOG(DEBUG) << "SnapshotReader: Parent " << parentId << " is unknown. Mapping it to root Id.";
+					parentId = rootId;
+				}
+			}
+		}
+
+		/* Records of nodes that exist already update them, e.g. when a delta follows its base dump */
+		bool success = false;
+		if ((node.type != SNAPSHOT_ROOT_ATTRIBUTES) && (node.type != SNAPSHOT_PARENT) && isExisting(wm, id)) {
+			success = update(wm, node, id, parentId, attributes);
+			knownIds.insert(node.id);
+			if (success) {
+				successCount++;
+			}
+			continue;
+		}
+
+		switch (node.type) {
+		case SNAPSHOT_ROOT_ATTRIBUTES:
+			success = mergeRootAttributes(wm, attributes);
+			break;
+		case SNAPSHOT_NODE:
+		case SNAPSHOT_UPDATED_NODE: // only a delta is loaded, so the type of the node is unknown
+			success = wm->scene.addNode(parentId, id, attributes, true);
+			break;
+		case SNAPSHOT_GROUP:
+			success = wm->scene.addGroup(parentId, id, attributes, true);
+			break;
+		case SNAPSHOT_TRANSFORM:
+		case SNAPSHOT_UPDATED_TRANSFORM: {
+			if (node.payloadIndex >= header->transformCount) {
+				break;
+			}
+			const SnapshotTransform& snapshotTransform = getTransforms()[node.payloadIndex];
+			success = wm->scene.addTransformNode(parentId, id, attributes, toTransform(snapshotTransform), TimeStamp(snapshotTransform.stamp, brics_3d::Units::Second), true);
+			break;
+		}
+		case SNAPSHOT_GEOMETRIC_NODE: {
+			if (node.payloadIndex >= header->shapeCount) {
+				break;
+			}
+			const SnapshotShape& snapshotShape = getShapes()[node.payloadIndex];
+			Shape::ShapePtr shape;
+			if (snapshotShape.type == SNAPSHOT_BOX) {
+				shape.reset(new Box(snapshotShape.parameters[0], snapshotShape.parameters[1], snapshotShape.parameters[2]));
+			} else if (snapshotShape.type == SNAPSHOT_CYLINDER) {
+				shape.reset(new Cylinder(snapshotShape.parameters[0], snapshotShape.parameters[1]));
+			} else if (snapshotShape.type == SNAPSHOT_SPHERE) {
+				shape.reset(new Sphere(snapshotShape.parameters[0]));
+			} else {
+				LOG(WARNING) << "SnapshotReader: Unknown shape type " << snapshotShape.type << " for node " << id;
+				break;
+			}
+			success = wm->scene.addGeometricNode(parentId, id, attributes, shape, TimeStamp(snapshotShape.stamp, brics_3d::Units::Second), true);
+			break;
+		}
+		case SNAPSHOT_CONNECTION: {
+			if (node.payloadIndex >= header->connectionCount) {
+				break;
+			}
+			const SnapshotConnection& connection = getConnections()[node.payloadIndex];
+			if ((static_cast<uint64_t>(connection.sourceIndex) + connection.sourceCount > header->idCount) ||
+				(static_cast<uint64_t>(connection.targetIndex) + connection.targetCount > header->idCount)) {
+				break;
+			}
+			vector<Id> sourceIds;
+			vector<Id> targetIds;
+			for (uint32_t j = connection.sourceIndex; j < connection.sourceIndex + connection.sourceCount; ++j) {
+				sourceIds.push_back(isSameSnapshotId(getIds()[j], header->rootId) ? rootId : toId(getIds()[j]));
+			}
+			for (uint32_t j = connection.targetIndex; j < connection.targetIndex + connection.targetCount; ++j) {
+				targetIds.push_back(isSameSnapshotId(getIds()[j], header->rootId) ? rootId : toId(getIds()[j]));
+			}
+			success = wm->scene.addConnection(parentId, id, attributes, sourceIds, targetIds,
+					TimeStamp(connection.start, brics_3d::Units::Second), TimeStamp(connection.end, brics_3d::Units::Second), true);
+			break;
+		}
+		case SNAPSHOT_REMOTE_ROOT:
+			success = wm->scene.addRemoteRootNode(id, attributes);
+			break;
+		case SNAPSHOT_PARENT:
+			success = hasParent(wm, id, parentId) || wm->scene.addParent(id, parentId);
+			break;
+		default:
+			LOG(WARNING) << "SnapshotReader: Unknown node type " << node.type << ". Skipping it.";
+			break;
+		}
+
+		knownIds.insert(node.id);
+		if (success) {
+			successCount++;
+		}
+	}
+
+	LOG(INFO) << "SnapshotReader: Added " << successCount << " of " << header->nodeCount << " primitives.";
+	return successCount;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,93 @@
+/*
+ * Loads a Robot Scene Graph from the binary snapshot format (cf. SnapshotFormat.h).
+ */
+
+#ifndef RSG_BRIDGE_SNAPSHOTREADER_H_
+#define RSG_BRIDGE_SNAPSHOTREADER_H_
+
+#include "SnapshotFormat.h"
+
+#include <brics_3d/worldModel/WorldModel.h>
+
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Memory maps a snapshot file and applies it to a world model.
+ *
+ * The tables are used in place, i.e. there is no parsing step involved.
+ */
+class SnapshotReader {
+public:
+	SnapshotReader();
+	virtual ~SnapshotReader();
+
+	/// Memory map a snapshot file. Returns false if the file does not exist or has an invalid format.
+	bool open(std::string fileName);
+
+	/// Use a snapshot that is already in memory. The buffer has to stay valid until close() is called.
+	bool open(const char* buffer, size_t size);
+
+	void close();
+
+	bool isOpen() const { return data != 0; }
+
+	/**
+	 * @brief Add all stored primitives to the world model.
+	 *
+	 * All primitives are added with their stored Ids. The root node of the dumped graph is mapped to
+	 * the root node of wm. Tombstones (deleted nodes and removed parent relations of incremental
+	 * dumps) are applied first; tombstones of nodes that do not exist in wm are ignored.
+	 *
+	 * Records of nodes that exist in wm already update them: their attributes are replaced, a
+	 * Transform gets the stored sample and a missing parent relation is added. So an incremental
+	 * dump can be applied on top of the dump it is based on. Update records of nodes that do not
+	 * exist (e.g. if only a delta is loaded) add them as Node or Transform.
+	 *
+	 * @param wm The world model to be loaded.
+	 * @param mapUnknownParentIdsToRootId If true, nodes that refer to parents that are neither part
+	 *        of the snapshot nor of the world model will be added to the root node.
+	 * @param selection Optional flag per node record (cf. SnapshotFilter). Only selected records are added.
+	 * @return Number of successfully added primitives.
+	 */
+	unsigned int apply(brics_3d::WorldModel* wm, bool mapUnknownParentIdsToRootId = true, const std::vector<bool>* selection = 0);
+
+	/* read access to the tables */
+	const SnapshotHeader* getHeader() const { return header; }
+	const SnapshotNode* getNodes() const;
+	const SnapshotTransform* getTransforms() const;
+	const SnapshotShape* getShapes() const;
+	const SnapshotConnection* getConnections() const;
+	const SnapshotId* getIds() const;
+
+	void getAttributes(const SnapshotNode& node, vector<brics_3d::rsg::Attribute>& attributes) const;
+
+	/// Convert a 16 byte representation into an Id.
+	static brics_3d::rsg::Id toId(const SnapshotId& snapshotId);
+
+	/**
+	 * @brief Add dumped root attributes to the root node of wm.
+	 *
+	 * Only keys that are not yet present are added, so the identity and the policies of
+	 * the loading World Model Agent (e.g. its name or rsg:agent_policy) are preserved.
+	 */
+	static bool mergeRootAttributes(brics_3d::WorldModel* wm, const vector<brics_3d::rsg::Attribute>& attributes);
+
+private:
+	bool validate();
+	bool update(brics_3d::WorldModel* wm, const SnapshotNode& node, brics_3d::rsg::Id id, brics_3d::rsg::Id parentId, const vector<brics_3d::rsg::Attribute>& attributes);
+	static bool isExisting(brics_3d::WorldModel* wm, brics_3d::rsg::Id id);
+	static bool hasParent(brics_3d::WorldModel* wm, brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	static brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr toTransform(const SnapshotTransform& snapshotTransform);
+
+	const char* data;
+	size_t size;
+	bool isMapped;
+	const SnapshotHeader* header;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SNAPSHOTREADER_H_ */
@@ -0,0 +1,415 @@
+#include "SnapshotWriter.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/sceneGraph/SceneGraphToUpdatesTraverser.h>
+#include <brics_3d/worldModel/sceneGraph/Box.h>
+#include <brics_3d/worldModel/sceneGraph/Cylinder.h>
+#include <brics_3d/worldModel/sceneGraph/Sphere.h>
+
+#include <fstream>
+#include <cstring>
+#include <ctime>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+SnapshotWriter::SnapshotWriter() {
+	reset();
+}
+
+SnapshotWriter::~SnapshotWriter() {
+
+}
+
+void SnapshotWriter::reset() {
+	memset(&rootId, 0, sizeof(rootId));
+	strings.clear();
+	attributes.clear();
+	nodes.clear();
+	ids.clear();
+	transforms.clear();
+	shapes.clear();
+	connections.clear();
+	recordedIds.clear();
+	isOverflowed = false;
+	addedIds = 0;
+}
+
+void SnapshotWriter::capture(brics_3d::WorldModel* wm) {
+	reset();
+	captureGraph(wm);
+}
+
+void SnapshotWriter::captureGraph(brics_3d::WorldModel* wm) {
+	Id root = wm->getRootNodeId();
+	toSnapshotId(root, rootId);
+
+	/* root attributes are not part of a traversal */
+	vector<Attribute> rootAttributes;
+	wm->scene.getNodeAttributes(root, rootAttributes);
+	appendNode(SNAPSHOT_ROOT_ATTRIBUTES, root, root, rootAttributes);
+
+	SceneGraphToUpdatesTraverser traverser(this);
+	wm->scene.executeGraphTraverser(&traverser, root);
+
+	vector<Id> remoteRootNodeIds;
+	wm->scene.getRemoteRootNodes(remoteRootNodeIds);
+	for(vector<Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
+		vector<Attribute> remoteRootAttributes;
+		wm->scene.getNodeAttributes(*it, remoteRootAttributes);
+		addRemoteRootNode(*it, remoteRootAttributes);
+		traverser.reset();
+		wm->scene.executeGraphTraverser(&traverser, *it);
+	}
+	LOG(DEBUG) << "SnapshotWriter: Captured " << nodes.size() << " nodes.";
+}
+
+void SnapshotWriter::captureSubgraphs(brics_3d::WorldModel* wm, const std::vector<Id>& subgraphRootIds, const std::set<Id>* addedIds) {
+	Id root = wm->getRootNodeId();
+	for(vector<Id>::const_iterator it = subgraphRootIds.begin(); it != subgraphRootIds.end(); ++it) {
+		if (*it == root) {
+			reset();
+			this->addedIds = addedIds;
+			captureGraph(wm);
+			this->addedIds = 0;
+			return;
+		}
+	}
+
+	reset();
+	toSnapshotId(root, rootId);
+	this->addedIds = addedIds;
+	SceneGraphToUpdatesTraverser traverser(this);
+	for(vector<Id>::const_iterator it = subgraphRootIds.begin(); it != subgraphRootIds.end(); ++it) {
+		if (!captureNode(wm, *it)) {
+			continue; // e.g. deleted in the meantime
+		}
+		traverser.reset();
+		wm->scene.executeGraphTraverser(&traverser, *it);
+	}
+	this->addedIds = 0;
+	LOG(DEBUG) << "SnapshotWriter: Captured " << nodes.size() << " nodes of " << subgraphRootIds.size() << " subgraphs.";
+}
+
+bool SnapshotWriter::captureNode(brics_3d::WorldModel* wm, Id id) {
+	vector<Attribute> nodeAttributes;
+	if (!wm->scene.getNodeAttributes(id, nodeAttributes)) {
+		return false;
+	}
+	vector<Id> parentIds;
+	wm->scene.getNodeParents(id, parentIds);
+	if (parentIds.empty()) { // remote root node
+		return addRemoteRootNode(id, nodeAttributes);
+	}
+
+	/*
+	 * Any other node is emitted by the traversal that starts at it, like every node with a parent.
+	 * So a Transform keeps its latest sample and the stamp of that sample.
+	 */
+	return true;
+}
+
+bool SnapshotWriter::isRecorded(Id id, Id parentId) {
+	SnapshotId snapshotId;
+	toSnapshotId(id, snapshotId);
+	if (recordedIds.insert(snapshotId).second) {
+		return false;
+	}
+
+	/* A node that is reached via another parent is stored as additional parent relation */
+	SnapshotId snapshotParentId;
+	toSnapshotId(parentId, snapshotParentId);
+	for (vector<SnapshotNode>::const_reverse_iterator it = nodes.rbegin(); it != nodes.rend(); ++it) {
+		if (isSameSnapshotId(it->id, snapshotId) && isSameSnapshotId(it->parentId, snapshotParentId)) {
+			return true;
+		}
+	}
+	addParent(id, parentId);
+	return true;
+}
+
+bool SnapshotWriter::write(std::vector<char>& buffer) {
+	if (isOverflowed) {
+		LOG(ERROR) << "SnapshotWriter: The captured graph exceeds the 32 bit offsets of the snapshot format. Discarding it.";
+		buffer.clear();
+		return false;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, RSG_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = RSG_SNAPSHOT_VERSION;
+	header.headerSize = sizeof(SnapshotHeader);
+	header.rootId = rootId;
+	header.stamp = static_cast<double>(time(0));
+
+	/* All tables are 8 byte aligned, so they can be accessed in place after mmap */
+	uint64_t offset = sizeof(SnapshotHeader);
+	header.stringTableOffset = offset;
+	header.stringTableSize = strings.size();
+	offset += (strings.size() + 7) & ~static_cast<uint64_t>(7);
+	header.attributeTableOffset = offset;
+	header.attributeCount = attributes.size();
+	offset += attributes.size() * sizeof(SnapshotAttribute);
+	header.nodeTableOffset = offset;
+	header.nodeCount = nodes.size();
+	offset += nodes.size() * sizeof(SnapshotNode);
+	header.idTableOffset = offset;
+	header.idCount = ids.size();
+	offset += ids.size() * sizeof(SnapshotId);
+	header.transformTableOffset = offset;
+	header.transformCount = transforms.size();
+	offset += transforms.size() * sizeof(SnapshotTransform);
+	header.shapeTableOffset = offset;
+	header.shapeCount = shapes.size();
+	offset += shapes.size() * sizeof(SnapshotShape);
+	header.connectionTableOffset = offset;
+	header.connectionCount = connections.size();
+	offset += connections.size() * sizeof(SnapshotConnection);
+
+	buffer.assign(offset, 0);
+	memcpy(&buffer[0], &header, sizeof(header));
+	if(!strings.empty()) {
+		memcpy(&buffer[header.stringTableOffset], strings.data(), strings.size());
+	}
+	if(!attributes.empty()) {
+		memcpy(&buffer[header.attributeTableOffset], &attributes[0], attributes.size() * sizeof(SnapshotAttribute));
+	}
+	if(!nodes.empty()) {
+		memcpy(&buffer[header.nodeTableOffset], &nodes[0], nodes.size() * sizeof(SnapshotNode));
+	}
+	if(!ids.empty()) {
+		memcpy(&buffer[header.idTableOffset], &ids[0], ids.size() * sizeof(SnapshotId));
+	}
+	if(!transforms.empty()) {
+		memcpy(&buffer[header.transformTableOffset], &transforms[0], transforms.size() * sizeof(SnapshotTransform));
+	}
+	if(!shapes.empty()) {
+		memcpy(&buffer[header.shapeTableOffset], &shapes[0], shapes.size() * sizeof(SnapshotShape));
+	}
+	if(!connections.empty()) {
+		memcpy(&buffer[header.connectionTableOffset], &connections[0], connections.size() * sizeof(SnapshotConnection));
+	}
+	return true;
+}
+
+bool SnapshotWriter::write(std::string fileName) {
+	std::vector<char> buffer;
+	if (!write(buffer)) {
+		LOG(ERROR) << "SnapshotWriter: Cannot write file " << fileName;
+		return false;
+	}
+
+	std::ofstream output;
+	output.open(fileName.c_str(), std::ios::trunc | std::ios::binary);
+	if (output.fail()) {
+		LOG(ERROR) << "SnapshotWriter: Cannot write to file " << fileName;
+		return false;
+	}
+	output.write(&buffer[0], buffer.size());
+	output.close();
+	LOG(INFO) << "SnapshotWriter: Wrote " << nodes.size() << " nodes (" << buffer.size() << " bytes) to file " << fileName;
+	return !output.fail();
+}
+
+void SnapshotWriter::toSnapshotId(const Id& id, SnapshotId& snapshotId) {
+	memcpy(snapshotId.data, id.data, sizeof(snapshotId.data)); // the 16 bytes of the uuid
+}
+
+uint32_t SnapshotWriter::toIndex(size_t index) {
+	if (index > RSG_SNAPSHOT_MAX_INDEX) {
+		isOverflowed = true; // write() fails instead of storing wrapped offsets
+		return 0;
+	}
+	return static_cast<uint32_t>(index);
+}
+
+uint32_t SnapshotWriter::appendString(const std::string& value) {
+	uint32_t offset = toIndex(strings.size());
+	toIndex(strings.size() + value.size()); // the end of the string has to be addressable as well
+	if (isOverflowed) {
+		return 0;
+	}
+	strings.append(value);
+	return offset;
+}
+
+SnapshotNode& SnapshotWriter::appendNode(SnapshotNodeType type, Id id, Id parentId, vector<Attribute>& nodeAttributes) {
+	SnapshotNode node;
+	memset(&node, 0, sizeof(node));
+	toSnapshotId(id, node.id);
+	toSnapshotId(parentId, node.parentId);
+	node.type = type;
+	node.attributeIndex = toIndex(attributes.size());
+	node.attributeCount = toIndex(nodeAttributes.size());
+	node.payloadIndex = RSG_SNAPSHOT_NO_INDEX;
+
+	for (vector<Attribute>::const_iterator it = nodeAttributes.begin(); it != nodeAttributes.end(); ++it) {
+		SnapshotAttribute attribute;
+		attribute.keyOffset = appendString(it->key);
+		attribute.keyLength = toIndex(it->key.size());
+		attribute.valueOffset = appendString(it->value);
+		attribute.valueLength = toIndex(it->value.size());
+		attributes.push_back(attribute);
+	}
+
+	nodes.push_back(node);
+	return nodes.back();
+}
+
+bool SnapshotWriter::isUpdate(Id id) const {
+	return (addedIds != 0) && (addedIds->find(id) == addedIds->end());
+}
+
+bool SnapshotWriter::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	if (isRecorded(assignedId, parentId)) {
+		return true;
+	}
+	appendNode(isUpdate(assignedId) ? SNAPSHOT_UPDATED_NODE : SNAPSHOT_NODE, assignedId, parentId, attributes);
+	return true;
+}
+
+bool SnapshotWriter::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	if (isRecorded(assignedId, parentId)) {
+		return true;
+	}
+	appendNode(isUpdate(assignedId) ? SNAPSHOT_UPDATED_NODE : SNAPSHOT_GROUP, assignedId, parentId, attributes);
+	return true;
+}
+
+bool SnapshotWriter::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	if (isRecorded(assignedId, parentId)) {
+		return true;
+	}
+	SnapshotNode& node = appendNode(isUpdate(assignedId) ? SNAPSHOT_UPDATED_TRANSFORM : SNAPSHOT_TRANSFORM, assignedId, parentId, attributes);
+	node.payloadIndex = toIndex(transforms.size());
+
+	SnapshotTransform snapshotTransform;
+	memcpy(snapshotTransform.matrix, transform->getRawData(), sizeof(snapshotTransform.matrix));
+	snapshotTransform.stamp = static_cast<double>(timeStamp.getSeconds());
+	transforms.push_back(snapshotTransform);
+	return true;
+}
+
+bool SnapshotWriter::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	LOG(WARNING) << "SnapshotWriter: Uncertainty of node " << assignedId << " is not stored. Storing it as Transform.";
+	return addTransformNode(parentId, assignedId, attributes, transform, timeStamp, forcedId);
+}
+
+bool SnapshotWriter::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	if (isRecorded(assignedId, parentId)) {
+		return true;
+	}
+	if (isUpdate(assignedId)) { // the shape of a GeometricNode cannot change
+		appendNode(SNAPSHOT_UPDATED_NODE, assignedId, parentId, attributes);
+		return true;
+	}
+	SnapshotShape snapshotShape;
+	memset(&snapshotShape, 0, sizeof(snapshotShape));
+	snapshotShape.stamp = static_cast<double>(timeStamp.getSeconds());
+
+	Box::BoxPtr box = boost::dynamic_pointer_cast<Box>(shape);
+	Cylinder::CylinderPtr cylinder = boost::dynamic_pointer_cast<Cylinder>(shape);
+	Sphere::SpherePtr sphere = boost::dynamic_pointer_cast<Sphere>(shape);
+	if(box) {
+		snapshotShape.type = SNAPSHOT_BOX;
+		snapshotShape.parameters[0] = box->getSizeX();
+		snapshotShape.parameters[1] = box->getSizeY();
+		snapshotShape.parameters[2] = box->getSizeZ();
+	} else if (cylinder) {
+		snapshotShape.type = SNAPSHOT_CYLINDER;
+		snapshotShape.parameters[0] = cylinder->getRadius();
+		snapshotShape.parameters[1] = cylinder->getHeight();
+	} else if (sphere) {
+		snapshotShape.type = SNAPSHOT_SPHERE;
+		snapshotShape.parameters[0] = sphere->getRadius();
+	} else {
+		LOG(WARNING) << "SnapshotWriter: Shape of GeometricNode " << assignedId << " is not supported. Storing it as Node.";
+		appendNode(SNAPSHOT_NODE, assignedId, parentId, attributes);
+		return true;
+	}
+
+	SnapshotNode& node = appendNode(SNAPSHOT_GEOMETRIC_NODE, assignedId, parentId, attributes);
+	node.payloadIndex = toIndex(shapes.size());
+	shapes.push_back(snapshotShape);
+	return true;
+}
+
+bool SnapshotWriter::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	SnapshotId snapshotId;
+	toSnapshotId(rootId, snapshotId);
+	if (!recordedIds.insert(snapshotId).second) {
+		return true;
+	}
+	appendNode(SNAPSHOT_REMOTE_ROOT, rootId, rootId, attributes);
+	return true;
+}
+
+bool SnapshotWriter::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	if (isRecorded(assignedId, parentId)) {
+		return true;
+	}
+	if (isUpdate(assignedId)) { // only attributes of a Connection are updated by incremental dumps
+		appendNode(SNAPSHOT_UPDATED_NODE, assignedId, parentId, attributes);
+		return true;
+	}
+	SnapshotConnection connection;
+	connection.sourceIndex = toIndex(ids.size());
+	connection.sourceCount = toIndex(sourceIds.size());
+	for (vector<Id>::const_iterator it = sourceIds.begin(); it != sourceIds.end(); ++it) {
+		SnapshotId id;
+		toSnapshotId(*it, id);
+		ids.push_back(id);
+	}
+	connection.targetIndex = toIndex(ids.size());
+	connection.targetCount = toIndex(targetIds.size());
+	for (vector<Id>::const_iterator it = targetIds.begin(); it != targetIds.end(); ++it) {
+		SnapshotId id;
+		toSnapshotId(*it, id);
+		ids.push_back(id);
+	}
+	connection.start = static_cast<double>(start.getSeconds());
+	connection.end = static_cast<double>(end.getSeconds());
+
+	SnapshotNode& node = appendNode(SNAPSHOT_CONNECTION, assignedId, parentId, attributes);
+	node.payloadIndex = toIndex(connections.size());
+	connections.push_back(connection);
+	return true;
+}
+
+bool SnapshotWriter::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	LOG(DEBUG) << "SnapshotWriter: Ignoring setNodeAttributes for " << id;
+	return true;
+}
+
+bool SnapshotWriter::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	LOG(DEBUG) << "SnapshotWriter: Ignoring setTransform for " << id;
+	return true;
+}
+
+bool SnapshotWriter::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	LOG(DEBUG) << "SnapshotWriter: Ignoring setUncertainTransform for " << id;
+	return true;
+}
+
+bool SnapshotWriter::deleteNode(Id id) {
+	vector<Attribute> noAttributes;
+	appendNode(SNAPSHOT_DELETED, id, id, noAttributes);
+	return true;
+}
+
+bool SnapshotWriter::addParent(Id id, Id parentId) {
+	vector<Attribute> noAttributes;
+	appendNode(SNAPSHOT_PARENT, id, parentId, noAttributes);
+	return true;
+}
+
+bool SnapshotWriter::removeParent(Id id, Id parentId) {
+	vector<Attribute> noAttributes;
+	appendNode(SNAPSHOT_REMOVED_PARENT, id, parentId, noAttributes);
+	return true;
+}
+
+} // namespace rsg_bridge
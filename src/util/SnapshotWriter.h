@@ -0,0 +1,102 @@
+/*
+ * Captures a Robot Scene Graph into the binary snapshot format
+ * (cf. SnapshotFormat.h) and writes it to a file.
+ */
+
+#ifndef RSG_BRIDGE_SNAPSHOTWRITER_H_
+#define RSG_BRIDGE_SNAPSHOTWRITER_H_
+
+#include "SnapshotFormat.h"
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <string>
+#include <vector>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Records a scene graph as snapshot tables.
+ *
+ * The writer acts as an update observer that is fed by a SceneGraphToUpdatesTraverser.
+ * Use capture() to record a complete World Model Agent including its remote root nodes.
+ * The recorded tables are a copy, so they can be written after the world model has been
+ * modified again. Calls of deleteNode() and removeParent() are recorded as tombstones,
+ * e.g. for incremental dumps.
+ */
+class SnapshotWriter : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	SnapshotWriter();
+	virtual ~SnapshotWriter();
+
+	/// Record the graph of the world model below its root node and all remote root nodes.
+	void capture(brics_3d::WorldModel* wm);
+
+	/**
+	 * @brief Record only the subgraphs below the given nodes (including the nodes themselves).
+	 *
+	 * Parents outside of the recorded subgraphs are referenced by their Ids. If one of the
+	 * Ids is the root node the complete graph is recorded like in capture().
+	 *
+	 * @param addedIds Optional Ids of the nodes that have been added since the previous capture.
+	 *        All other nodes existed already, so they are recorded as updates (SNAPSHOT_UPDATED_NODE
+	 *        and SNAPSHOT_UPDATED_TRANSFORM) rather than being added again.
+	 */
+	void captureSubgraphs(brics_3d::WorldModel* wm, const std::vector<brics_3d::rsg::Id>& subgraphRootIds, const std::set<brics_3d::rsg::Id>* addedIds = 0);
+
+	/// Discard all recorded data.
+	void reset();
+
+	/// Write the recorded data to a file. Returns false on I/O errors or if the data does not fit into the format.
+	bool write(std::string fileName);
+
+	/// Serialize the recorded data into a buffer. Returns false (and an empty buffer) if a table exceeds the 32 bit offsets.
+	bool write(std::vector<char>& buffer);
+
+	unsigned int getNodeCount() const { return static_cast<unsigned int>(nodes.size()); }
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+	/// Convert an Id into its 16 byte representation.
+	static void toSnapshotId(const brics_3d::rsg::Id& id, SnapshotId& snapshotId);
+
+private:
+	void captureGraph(brics_3d::WorldModel* wm);
+	bool captureNode(brics_3d::WorldModel* wm, brics_3d::rsg::Id id);
+	bool isRecorded(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool isUpdate(brics_3d::rsg::Id id) const;
+	SnapshotNode& appendNode(SnapshotNodeType type, brics_3d::rsg::Id id, brics_3d::rsg::Id parentId, vector<brics_3d::rsg::Attribute>& attributes);
+	uint32_t appendString(const std::string& value);
+	uint32_t toIndex(size_t index);
+
+	SnapshotId rootId;
+	std::string strings;
+	std::vector<SnapshotAttribute> attributes;
+	std::vector<SnapshotNode> nodes;
+	std::vector<SnapshotId> ids;
+	std::vector<SnapshotTransform> transforms;
+	std::vector<SnapshotShape> shapes;
+	std::vector<SnapshotConnection> connections;
+	std::set<SnapshotId, SnapshotIdLess> recordedIds;
+	bool isOverflowed; // a table or the string table exceeded RSG_SNAPSHOT_MAX_INDEX
+	const std::set<brics_3d::rsg::Id>* addedIds; // only during captureSubgraphs()
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SNAPSHOTWRITER_H_ */
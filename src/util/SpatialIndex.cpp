@@ -0,0 +1,544 @@
+#include "SpatialIndex.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+
+#include <boost/regex.hpp>
+#include <boost/thread.hpp>
+
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+#define NUMBER "(-?[0-9]+(?:\\.[0-9]*)?(?:[eE][-+]?[0-9]+)?)"
+
+static const boost::regex spatialQueryPattern("\"query\"\\s*:\\s*\"(GET_NODES_IN_BOX|GET_NODES_IN_POLYGON|GET_NEAREST_NODES)\"");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex areaIdPattern("\"areaId\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex minPattern("\"min\"\\s*:\\s*\\[\\s*" NUMBER "\\s*,\\s*" NUMBER);
+static const boost::regex maxPattern("\"max\"\\s*:\\s*\\[\\s*" NUMBER "\\s*,\\s*" NUMBER);
+static const boost::regex pointPattern("\"point\"\\s*:\\s*\\[\\s*" NUMBER "\\s*,\\s*" NUMBER);
+static const boost::regex polygonPattern("\"polygon\"\\s*:\\s*\\[((?:\\s*\\[[^\\]]*\\]\\s*,?)*)\\s*\\]");
+static const boost::regex polygonPointPattern("\\[\\s*" NUMBER "\\s*,\\s*" NUMBER "[^\\]]*\\]");
+static const boost::regex kPattern("\"k\"\\s*:\\s*([0-9]+)");
+static const boost::regex maxDistancePattern("\"maxDistance\"\\s*:\\s*" NUMBER);
+static const boost::regex attributesPattern("\"attributes\"\\s*:\\s*\\[([^\\]]*)\\]");
+static const boost::regex attributePattern("\\{\\s*\"key\"\\s*:\\s*\"([^\"]*)\"\\s*,\\s*\"value\"\\s*:\\s*\"([^\"]*)\"\\s*\\}");
+
+/* One index per World Model. Blocks of the same process share it via this library. */
+static boost::mutex indexMutex;
+static std::map<brics_3d::WorldModel*, SpatialIndex*> indices;
+
+SpatialIndex* SpatialIndex::get(brics_3d::WorldModel* wm, double cellSize, const std::string& originType) {
+	boost::unique_lock<boost::mutex> lock(indexMutex);
+	std::map<brics_3d::WorldModel*, SpatialIndex*>::iterator it = indices.find(wm);
+	if (it != indices.end()) {
+		return it->second;
+	}
+	SpatialIndex* index = new SpatialIndex(wm, cellSize, originType); // lives as long as the process
+	indices.insert(std::make_pair(wm, index));
+	return index;
+}
+
+SpatialIndex::SpatialIndex(brics_3d::WorldModel* wm, double cellSize, const std::string& originType) :
+		wm(wm), cellSize(cellSize), originType(originType), hasOrigin(false) {
+	if (this->cellSize <= 0) {
+		this->cellSize = 1.0;
+	}
+
+	vector<Attribute> originAttributes;
+	originAttributes.push_back(Attribute("gis:origin", originType));
+	vector<Id> originIds;
+	wm->scene.getNodes(originAttributes, originIds);
+	if (!originIds.empty()) {
+		originId = originIds[0];
+		hasOrigin = true;
+		rebuild();
+	}
+	wm->scene.attachUpdateObserver(this);
+	LOG(INFO) << "SpatialIndex: Indexing Transforms below gis:origin = " << originType << " with a cell size of " << this->cellSize;
+}
+
+SpatialIndex::~SpatialIndex() {
+	wm->scene.detachUpdateObserver(this);
+}
+
+SpatialIndex::Cell SpatialIndex::getCell(double x, double y) const {
+	return Cell(static_cast<long>(floor(x / cellSize)), static_cast<long>(floor(y / cellSize)));
+}
+
+bool SpatialIndex::isOrigin(const vector<Attribute>& attributes) const {
+	for (vector<Attribute>::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+		if ((it->key == "gis:origin") && (it->value == originType)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SpatialIndex::isBelowOrigin(Id id) {
+	if (!hasOrigin) {
+		return false;
+	}
+	std::vector<Id> pending(1, id);
+	std::set<Id> visited;
+	while (!pending.empty()) {
+		Id current = pending.back();
+		pending.pop_back();
+		if (current == originId) {
+			return true;
+		}
+		if (!visited.insert(current).second) {
+			continue;
+		}
+		vector<Id> parentIds;
+		if (wm->scene.getNodeParents(current, parentIds)) {
+			pending.insert(pending.end(), parentIds.begin(), parentIds.end());
+		}
+	}
+	return false;
+}
+
+void SpatialIndex::rebuild() {
+	entries.clear();
+	cells.clear();
+	if (hasOrigin) {
+		updateSubgraph(originId, true);
+	}
+	LOG(INFO) << "SpatialIndex: Rebuilt index with " << entries.size() << " Transforms.";
+}
+
+bool SpatialIndex::getPosition(Id id, SpatialIndexEntry& position) {
+	if (!hasOrigin) {
+		return false;
+	}
+	brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+	if (!wm->scene.getTransformForNode(id, originId, wm->now(), transform)) {
+		return false;
+	}
+	const double* matrix = transform->getRawData(); // column-major
+	position.x = matrix[12];
+	position.y = matrix[13];
+	position.z = matrix[14];
+	return true;
+}
+
+void SpatialIndex::updateEntry(Id id) {
+	SpatialIndexEntry position;
+	if (!getPosition(id, position)) {
+		removeEntry(id);
+		return;
+	}
+
+	std::map<Id, SpatialIndexEntry>::iterator entry = entries.find(id);
+	Cell newCell = getCell(position.x, position.y);
+	if (entry != entries.end()) {
+		Cell oldCell = getCell(entry->second.x, entry->second.y);
+		if (oldCell != newCell) {
+			std::map<Cell, std::set<Id> >::iterator cell = cells.find(oldCell);
+			cell->second.erase(id);
+			if (cell->second.empty()) {
+				cells.erase(cell);
+			}
+			cells[newCell].insert(id);
+		}
+		entry->second = position;
+	} else {
+		entries.insert(std::make_pair(id, position));
+		cells[newCell].insert(id);
+	}
+}
+
+void SpatialIndex::removeEntry(Id id) {
+	std::map<Id, SpatialIndexEntry>::iterator entry = entries.find(id);
+	if (entry == entries.end()) {
+		return;
+	}
+	std::map<Cell, std::set<Id> >::iterator cell = cells.find(getCell(entry->second.x, entry->second.y));
+	if (cell != cells.end()) {
+		cell->second.erase(id);
+		if (cell->second.empty()) {
+			cells.erase(cell);
+		}
+	}
+	entries.erase(entry);
+}
+
+void SpatialIndex::updateSubgraph(Id id, bool probeTransforms) {
+	std::vector<Id> pending(1, id);
+	std::set<Id> visited;
+	bool belowOrigin = isBelowOrigin(id);
+	while (!pending.empty()) {
+		Id current = pending.back();
+		pending.pop_back();
+		if (!visited.insert(current).second) {
+			continue;
+		}
+
+		if (entries.find(current) != entries.end()) {
+			if (belowOrigin) {
+				updateEntry(current);
+			} else {
+				removeEntry(current);
+			}
+		} else if (probeTransforms && belowOrigin && (current != originId)) {
+			brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+			if (wm->scene.getTransform(current, wm->now(), transform)) { // only Transforms have one
+				updateEntry(current);
+			}
+		}
+
+		vector<Id> childIds;
+		if (wm->scene.getGroupChildren(current, childIds)) {
+			pending.insert(pending.end(), childIds.begin(), childIds.end());
+		}
+	}
+}
+
+bool SpatialIndex::isMatch(Id id, const std::vector<Attribute>& attributes) {
+	if (attributes.empty()) {
+		return true;
+	}
+	vector<Attribute> nodeAttributes;
+	if (!wm->scene.getNodeAttributes(id, nodeAttributes)) {
+		return false;
+	}
+	for (std::vector<Attribute>::const_iterator required = attributes.begin(); required != attributes.end(); ++required) {
+		bool hasAttribute = false;
+		for (vector<Attribute>::const_iterator it = nodeAttributes.begin(); it != nodeAttributes.end() && !hasAttribute; ++it) {
+			hasAttribute = (it->key == required->key) && ((required->value == "*") || (it->value == required->value));
+		}
+		if (!hasAttribute) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SpatialIndex::collect(Id transformId, const std::vector<Attribute>& attributes, std::vector<Id>& ids) {
+	if (isMatch(transformId, attributes)) {
+		ids.push_back(transformId);
+	}
+
+	/* Children share the position of the Transform unless they are Transforms themselves */
+	vector<Id> childIds;
+	wm->scene.getGroupChildren(transformId, childIds);
+	for (vector<Id>::const_iterator child = childIds.begin(); child != childIds.end(); ++child) {
+		if ((entries.find(*child) == entries.end()) && isMatch(*child, attributes)) {
+			ids.push_back(*child);
+		}
+	}
+}
+
+void SpatialIndex::getNodesInBox(double minX, double minY, double maxX, double maxY, const std::vector<Attribute>& attributes, std::vector<Id>& ids) {
+	Cell minCell = getCell(minX, minY);
+	Cell maxCell = getCell(maxX, maxY);
+	std::map<Cell, std::set<Id> >::const_iterator end = cells.upper_bound(maxCell);
+	for (std::map<Cell, std::set<Id> >::const_iterator cell = cells.lower_bound(minCell); cell != end; ++cell) {
+		if ((cell->first.second < minCell.second) || (cell->first.second > maxCell.second)) {
+			continue;
+		}
+		for (std::set<Id>::const_iterator id = cell->second.begin(); id != cell->second.end(); ++id) {
+			const SpatialIndexEntry& entry = entries[*id];
+			if ((entry.x >= minX) && (entry.x <= maxX) && (entry.y >= minY) && (entry.y <= maxY)) {
+				collect(*id, attributes, ids);
+			}
+		}
+	}
+}
+
+static bool isInPolygon(double x, double y, const std::vector<std::pair<double, double> >& polygon) {
+	bool isInside = false;
+	for (unsigned int i = 0, j = static_cast<unsigned int>(polygon.size()) - 1; i < polygon.size(); j = i++) {
+		const std::pair<double, double>& a = polygon[i];
+		const std::pair<double, double>& b = polygon[j];
+		if (((a.second > y) != (b.second > y)) && (x < (b.first - a.first) * (y - a.second) / (b.second - a.second) + a.first)) {
+			isInside = !isInside;
+		}
+	}
+	return isInside;
+}
+
+void SpatialIndex::getNodesInPolygon(const std::vector<std::pair<double, double> >& polygon, const std::vector<Attribute>& attributes, std::vector<Id>& ids) {
+	if (polygon.size() < 3) {
+		return;
+	}
+	double minX = polygon[0].first, maxX = polygon[0].first;
+	double minY = polygon[0].second, maxY = polygon[0].second;
+	for (std::vector<std::pair<double, double> >::const_iterator it = polygon.begin(); it != polygon.end(); ++it) {
+		minX = std::min(minX, it->first);
+		maxX = std::max(maxX, it->first);
+		minY = std::min(minY, it->second);
+		maxY = std::max(maxY, it->second);
+	}
+
+	Cell minCell = getCell(minX, minY);
+	Cell maxCell = getCell(maxX, maxY);
+	std::map<Cell, std::set<Id> >::const_iterator end = cells.upper_bound(maxCell);
+	for (std::map<Cell, std::set<Id> >::const_iterator cell = cells.lower_bound(minCell); cell != end; ++cell) {
+		if ((cell->first.second < minCell.second) || (cell->first.second > maxCell.second)) {
+			continue;
+		}
+		for (std::set<Id>::const_iterator id = cell->second.begin(); id != cell->second.end(); ++id) {
+			const SpatialIndexEntry& entry = entries[*id];
+			if (isInPolygon(entry.x, entry.y, polygon)) {
+				collect(*id, attributes, ids);
+			}
+		}
+	}
+}
+
+void SpatialIndex::getNearestNodes(double x, double y, unsigned int k, double maxDistance, const std::vector<Attribute>& attributes, std::vector<Id>& ids) {
+	if ((k == 0) || cells.empty()) {
+		return;
+	}
+
+	/* Largest ring around the cell of the point that contains entries */
+	Cell center = getCell(x, y);
+	long maxRing = 0;
+	for (std::map<Cell, std::set<Id> >::const_iterator cell = cells.begin(); cell != cells.end(); ++cell) {
+		maxRing = std::max(maxRing, std::max(labs(cell->first.first - center.first), labs(cell->first.second - center.second)));
+	}
+
+	/* Visit the rings of cells until the k-th candidate is closer than any unvisited cell */
+	std::vector<std::pair<double, Id> > candidates; // distance, id
+	for (long ring = 0; ring <= maxRing; ++ring) {
+		double ringDistance = (ring - 1) * cellSize; // lower bound for the distance of the entries in this ring
+		if ((maxDistance > 0) && (ringDistance > maxDistance)) {
+			break;
+		}
+		if ((candidates.size() >= k) && (ringDistance > candidates[k - 1].first)) {
+			break;
+		}
+
+		std::vector<Cell> ringCells;
+		if (static_cast<size_t>(8 * ring) > cells.size()) { // sparse grid: cheaper to check the occupied cells
+			for (std::map<Cell, std::set<Id> >::const_iterator cell = cells.begin(); cell != cells.end(); ++cell) {
+				if (std::max(labs(cell->first.first - center.first), labs(cell->first.second - center.second)) == ring) {
+					ringCells.push_back(cell->first);
+				}
+			}
+		} else if (ring == 0) {
+			ringCells.push_back(center);
+		} else {
+			for (long i = -ring; i <= ring; ++i) {
+				ringCells.push_back(Cell(center.first + i, center.second - ring));
+				ringCells.push_back(Cell(center.first + i, center.second + ring));
+			}
+			for (long j = -ring + 1; j < ring; ++j) {
+				ringCells.push_back(Cell(center.first - ring, center.second + j));
+				ringCells.push_back(Cell(center.first + ring, center.second + j));
+			}
+		}
+
+		for (std::vector<Cell>::const_iterator ringCell = ringCells.begin(); ringCell != ringCells.end(); ++ringCell) {
+			std::map<Cell, std::set<Id> >::const_iterator cell = cells.find(*ringCell);
+			if (cell == cells.end()) {
+				continue;
+			}
+			for (std::set<Id>::const_iterator id = cell->second.begin(); id != cell->second.end(); ++id) {
+				const SpatialIndexEntry& entry = entries[*id];
+				double distance = sqrt((entry.x - x) * (entry.x - x) + (entry.y - y) * (entry.y - y));
+				if ((maxDistance > 0) && (distance > maxDistance)) {
+					continue;
+				}
+				std::vector<Id> matches;
+				collect(*id, attributes, matches);
+				for (std::vector<Id>::const_iterator match = matches.begin(); match != matches.end(); ++match) {
+					candidates.push_back(std::make_pair(distance, *match));
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+	}
+
+	for (unsigned int i = 0; (i < candidates.size()) && (i < k); ++i) {
+		ids.push_back(candidates[i].second);
+	}
+}
+
+bool SpatialIndex::isSpatialQuery(const std::string& message) {
+	return boost::regex_search(message, spatialQueryPattern);
+}
+
+bool SpatialIndex::handleQuery(const std::string& message, std::string& result) {
+	boost::smatch match;
+	boost::regex_search(message, match, spatialQueryPattern);
+	std::string query = match[1];
+
+	std::vector<Attribute> attributes;
+	if (boost::regex_search(message, match, attributesPattern)) {
+		std::string list = match[1];
+		boost::sregex_iterator end;
+		for (boost::sregex_iterator it(list.begin(), list.end(), attributePattern); it != end; ++it) {
+			attributes.push_back(Attribute((*it)[1], (*it)[2]));
+		}
+	}
+
+	std::vector<Id> ids;
+	bool success = hasOrigin;
+	if (!hasOrigin) {
+		LOG(WARNING) << "SpatialIndex: No node with gis:origin = " << originType << " exists.";
+	} else if (query == "GET_NODES_IN_BOX") {
+		boost::smatch min;
+		boost::smatch max;
+		if (boost::regex_search(message, min, minPattern) && boost::regex_search(message, max, maxPattern)) {
+			getNodesInBox(atof(min[1].str().c_str()), atof(min[2].str().c_str()), atof(max[1].str().c_str()), atof(max[2].str().c_str()), attributes, ids);
+		} else {
+			LOG(ERROR) << "SpatialIndex: GET_NODES_IN_BOX requires a min and a max point.";
+			success = false;
+		}
+	} else if (query == "GET_NODES_IN_POLYGON") {
+		std::vector<std::pair<double, double> > polygon;
+		if (boost::regex_search(message, match, areaIdPattern)) {
+			Id areaId;
+			vector<Id> pointIds;
+			if (!areaId.fromString(match[1]) || !wm->scene.getConnectionTargetIds(areaId, pointIds)) {
+				LOG(ERROR) << "SpatialIndex: Invalid areaId " << match[1];
+				success = false;
+			}
+			for (vector<Id>::const_iterator it = pointIds.begin(); it != pointIds.end() && success; ++it) {
+				SpatialIndexEntry position;
+				if (getPosition(*it, position)) {
+					polygon.push_back(std::make_pair(position.x, position.y));
+				} else {
+					LOG(ERROR) << "SpatialIndex: Polygon point " << *it << " has no position relative to the origin.";
+					success = false;
+				}
+			}
+		} else if (boost::regex_search(message, match, polygonPattern)) {
+			std::string points = match[1];
+			boost::sregex_iterator end;
+			for (boost::sregex_iterator it(points.begin(), points.end(), polygonPointPattern); it != end; ++it) {
+				polygon.push_back(std::make_pair(atof((*it)[1].str().c_str()), atof((*it)[2].str().c_str())));
+			}
+		}
+		if (success && (polygon.size() < 3)) {
+			LOG(ERROR) << "SpatialIndex: GET_NODES_IN_POLYGON requires a polygon or an areaId with at least three points.";
+			success = false;
+		}
+		if (success) {
+			getNodesInPolygon(polygon, attributes, ids);
+		}
+	} else {
+		boost::smatch point;
+		if (boost::regex_search(message, point, pointPattern)) {
+			unsigned int k = 1;
+			double maxDistance = 0;
+			if (boost::regex_search(message, match, kPattern)) {
+				k = static_cast<unsigned int>(atoi(match[1].str().c_str()));
+			}
+			if (boost::regex_search(message, match, maxDistancePattern)) {
+				maxDistance = atof(match[1].str().c_str());
+			}
+			getNearestNodes(atof(point[1].str().c_str()), atof(point[2].str().c_str()), k, maxDistance, attributes, ids);
+		} else {
+			LOG(ERROR) << "SpatialIndex: GET_NEAREST_NODES requires a point.";
+			success = false;
+		}
+	}
+
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"" << query << "\", ";
+	if (boost::regex_search(message, match, queryIdPattern)) {
+		reply << "\"queryId\": \"" << match[1] << "\", ";
+	}
+	reply << "\"querySuccess\": " << (success ? "true" : "false") << ", \"ids\": [";
+	for (std::vector<Id>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+		reply << ((it == ids.begin()) ? "\"" : ", \"") << *it << "\"";
+	}
+	reply << "]}";
+	result = reply.str();
+	return success;
+}
+
+bool SpatialIndex::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	if (!hasOrigin && isOrigin(attributes)) {
+		originId = assignedId;
+		hasOrigin = true;
+		rebuild();
+	}
+	return true;
+}
+
+bool SpatialIndex::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return addNode(parentId, assignedId, attributes, forcedId);
+}
+
+bool SpatialIndex::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	if (!hasOrigin && isOrigin(attributes)) {
+		return addNode(parentId, assignedId, attributes, forcedId);
+	}
+	if (isBelowOrigin(parentId)) {
+		updateEntry(assignedId);
+	}
+	return true;
+}
+
+bool SpatialIndex::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	return addTransformNode(parentId, assignedId, attributes, transform, timeStamp, forcedId);
+}
+
+bool SpatialIndex::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	return true;
+}
+
+bool SpatialIndex::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	return true;
+}
+
+bool SpatialIndex::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	return true;
+}
+
+bool SpatialIndex::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	if (!hasOrigin && isOrigin(newAttributes)) {
+		originId = id;
+		hasOrigin = true;
+		rebuild();
+	}
+	return true;
+}
+
+bool SpatialIndex::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	if (entries.find(id) != entries.end()) {
+		updateSubgraph(id, false); // descendants move along
+	}
+	return true;
+}
+
+bool SpatialIndex::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	return setTransform(id, transform, timeStamp);
+}
+
+bool SpatialIndex::deleteNode(Id id) {
+	if (hasOrigin && (id == originId)) {
+		LOG(WARNING) << "SpatialIndex: The gis:origin node has been deleted.";
+		hasOrigin = false;
+		entries.clear();
+		cells.clear();
+		return true;
+	}
+	removeEntry(id);
+	return true;
+}
+
+bool SpatialIndex::addParent(Id id, Id parentId) {
+	if (isBelowOrigin(parentId)) {
+		updateSubgraph(id, true);
+	}
+	return true;
+}
+
+bool SpatialIndex::removeParent(Id id, Id parentId) {
+	updateSubgraph(id, false); // drops the Transforms that are no longer below the origin
+	return true;
+}
+
+} // namespace rsg_bridge
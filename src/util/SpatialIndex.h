@@ -0,0 +1,120 @@
+/*
+ * Grid index over the positions of geo-located nodes.
+ */
+
+#ifndef RSG_BRIDGE_SPATIALINDEX_H_
+#define RSG_BRIDGE_SPATIALINDEX_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Position of a node relative to the origin of a SpatialIndex.
+ */
+struct SpatialIndexEntry {
+	double x;
+	double y;
+	double z;
+};
+
+/**
+ * @brief Incrementally maintained grid index over the Transforms below the GIS origin.
+ *
+ * The origin is the node with the attribute ("gis:origin", <originType>), e.g. "wgs84".
+ * Every Transform in the subgraph of the origin is indexed with the translation of
+ * getTransformForNode(transformId, originId); the x/y plane is split into square
+ * cells of cellSize (in units of the origin frame, e.g. degrees for wgs84).
+ * Non-Transform children of an indexed Transform share its position, so queries
+ * with attributes also find e.g. the image Nodes below a geo pose.
+ *
+ * The index observes the scene of the World Model and is shared by all blocks via
+ * SpatialIndex::get(). Updates have to be performed under the write lock of the
+ * WorldModelAccess, queries under the read lock.
+ *
+ * Queries are RSGQuery messages:
+ * @code
+ * {"@worldmodeltype": "RSGQuery", "query": "GET_NODES_IN_BOX", "min": [x, y], "max": [x, y], "attributes": [..]}
+ * {"@worldmodeltype": "RSGQuery", "query": "GET_NODES_IN_POLYGON", "polygon": [[x, y], ..], "attributes": [..]}
+ * {"@worldmodeltype": "RSGQuery", "query": "GET_NODES_IN_POLYGON", "areaId": "<uuid>", "attributes": [..]}
+ * {"@worldmodeltype": "RSGQuery", "query": "GET_NEAREST_NODES", "point": [x, y], "k": 5, "maxDistance": d, "attributes": [..]}
+ * @endcode
+ * "attributes" is optional; a value "*" matches every value. An areaId denotes a Connection
+ * with the polygon points as targetIds, as created by add_area.py.
+ */
+class SpatialIndex : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+
+	/// Get the index for a World Model. It is created and attached to the scene on first use.
+	static SpatialIndex* get(brics_3d::WorldModel* wm, double cellSize, const std::string& originType = "wgs84");
+
+	/// True for the RSGQuery messages that are answered by the index.
+	static bool isSpatialQuery(const std::string& message);
+
+	/// Process a spatial query and create the RSGQueryResult.
+	bool handleQuery(const std::string& message, std::string& result);
+
+	/// Ids of nodes within the axis aligned box.
+	void getNodesInBox(double minX, double minY, double maxX, double maxY, const std::vector<brics_3d::rsg::Attribute>& attributes, std::vector<brics_3d::rsg::Id>& ids);
+
+	/// Ids of nodes within the polygon given as x/y pairs.
+	void getNodesInPolygon(const std::vector<std::pair<double, double> >& polygon, const std::vector<brics_3d::rsg::Attribute>& attributes, std::vector<brics_3d::rsg::Id>& ids);
+
+	/// Ids of the k nearest nodes (x/y distance), the closest first. maxDistance <= 0 means unlimited.
+	void getNearestNodes(double x, double y, unsigned int k, double maxDistance, const std::vector<brics_3d::rsg::Attribute>& attributes, std::vector<brics_3d::rsg::Id>& ids);
+
+	/// Position of a polygon point, Transform or any other node relative to the origin.
+	bool getPosition(brics_3d::rsg::Id id, SpatialIndexEntry& position);
+
+	unsigned int getSize() const { return static_cast<unsigned int>(entries.size()); }
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	SpatialIndex(brics_3d::WorldModel* wm, double cellSize, const std::string& originType);
+	virtual ~SpatialIndex();
+
+	typedef std::pair<long, long> Cell;
+
+	Cell getCell(double x, double y) const;
+	bool isOrigin(const vector<brics_3d::rsg::Attribute>& attributes) const;
+	bool isBelowOrigin(brics_3d::rsg::Id id);
+	void rebuild();
+	void updateEntry(brics_3d::rsg::Id id);
+	void removeEntry(brics_3d::rsg::Id id);
+	void updateSubgraph(brics_3d::rsg::Id id, bool probeTransforms);
+	void collect(brics_3d::rsg::Id transformId, const std::vector<brics_3d::rsg::Attribute>& attributes, std::vector<brics_3d::rsg::Id>& ids);
+	bool isMatch(brics_3d::rsg::Id id, const std::vector<brics_3d::rsg::Attribute>& attributes);
+
+	brics_3d::WorldModel* wm;
+	double cellSize;
+	std::string originType;
+	brics_3d::rsg::Id originId;
+	bool hasOrigin;
+
+	std::map<brics_3d::rsg::Id, SpatialIndexEntry> entries;   // indexed Transforms
+	std::map<Cell, std::set<brics_3d::rsg::Id> > cells;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SPATIALINDEX_H_ */
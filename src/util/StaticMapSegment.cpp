@@ -0,0 +1,260 @@
+#include "StaticMapSegment.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+static const int MOUNT_POLL_INTERVAL = 10; // [ms]
+
+static int64_t nowInMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleepMs(int duration) {
+	struct timespec ts;
+	ts.tv_sec = duration / 1000;
+	ts.tv_nsec = (duration % 1000) * 1000000L;
+	nanosleep(&ts, 0);
+}
+
+static bool isAlive(int32_t pid) {
+	return (pid <= 0) || (kill(pid, 0) == 0) || (errno != ESRCH);
+}
+
+static size_t getSnapshotOffset() {
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	return ((sizeof(StaticMapSegmentHeader) + pageSize - 1) / pageSize) * pageSize;
+}
+
+StaticMapSegment::StaticMapSegment(const std::string& segmentName, const std::string& source) :
+		segmentName(segmentName), source(source), fd(-1), mapping(0), mappingSize(0), header(0) {
+}
+
+StaticMapSegment::~StaticMapSegment() {
+	unmap();
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+void StaticMapSegment::unmap() {
+	if (mapping != 0) {
+		munmap(const_cast<char*>(mapping), mappingSize);
+	}
+	mapping = 0;
+	mappingSize = 0;
+	header = 0;
+}
+
+bool StaticMapSegment::acquire() {
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd >= 0) {
+			break;
+		}
+		if (errno != EEXIST) {
+			LOG(ERROR) << "StaticMapSegment: Cannot create shared memory segment " << segmentName << ": " << strerror(errno);
+			return false;
+		}
+
+		/* Replace a segment that will never become usable, e.g. left over by a crashed publisher */
+		int existing = shm_open(segmentName.c_str(), O_RDONLY, 0);
+		struct stat status;
+		if ((existing < 0) || (fstat(existing, &status) != 0) || (status.st_size < static_cast<off_t>(sizeof(StaticMapSegmentHeader)))) {
+			if (existing >= 0) {
+				close(existing);
+			}
+			return false; // just created by another publisher
+		}
+		void* memory = mmap(0, sizeof(StaticMapSegmentHeader), PROT_READ, MAP_SHARED, existing, 0);
+		close(existing);
+		if (memory == MAP_FAILED) {
+			return false;
+		}
+		const StaticMapSegmentHeader* existingHeader = static_cast<const StaticMapSegmentHeader*>(memory);
+		uint32_t state = __atomic_load_n(&existingHeader->state, __ATOMIC_ACQUIRE);
+		bool isStale = (strncmp(existingHeader->magic, RSG_STATIC_MAP_MAGIC, sizeof(existingHeader->magic)) == 0) &&
+				((existingHeader->version != RSG_STATIC_MAP_VERSION) ||
+				(state == STATIC_MAP_FAILED) ||
+				((state == STATIC_MAP_LOADING) && !isAlive(existingHeader->publisherPid)) ||
+				((state == STATIC_MAP_READY) && (strncmp(existingHeader->source, source.c_str(), sizeof(existingHeader->source)) != 0)));
+		munmap(memory, sizeof(StaticMapSegmentHeader));
+		if (!isStale) {
+			return false;
+		}
+		LOG(WARNING) << "StaticMapSegment: Replacing outdated shared memory segment " << segmentName << ".";
+		shm_unlink(segmentName.c_str()); // processes that mounted it keep their mapping
+	}
+	if (fd < 0) {
+		return false;
+	}
+
+	/* Mounting processes can see who is loading the map */
+	StaticMapSegmentHeader initialHeader;
+	memset(&initialHeader, 0, sizeof(initialHeader));
+	strncpy(initialHeader.magic, RSG_STATIC_MAP_MAGIC, sizeof(initialHeader.magic));
+	initialHeader.version = RSG_STATIC_MAP_VERSION;
+	initialHeader.state = STATIC_MAP_LOADING;
+	initialHeader.publisherPid = getpid();
+	initialHeader.snapshotOffset = getSnapshotOffset();
+	strncpy(initialHeader.source, source.c_str(), sizeof(initialHeader.source) - 1);
+	if ((ftruncate(fd, initialHeader.snapshotOffset) != 0) ||
+			(pwrite(fd, &initialHeader, sizeof(initialHeader), 0) != static_cast<ssize_t>(sizeof(initialHeader)))) {
+		LOG(ERROR) << "StaticMapSegment: Cannot initialize shared memory segment " << segmentName << ": " << strerror(errno);
+		abandon();
+		return false;
+	}
+	LOG(INFO) << "StaticMapSegment: Acquired shared memory segment " << segmentName << ". This process publishes the static map.";
+	return true;
+}
+
+bool StaticMapSegment::publish(const std::vector<char>& snapshot) {
+	if ((fd < 0) || snapshot.empty()) {
+		abandon();
+		return false;
+	}
+	size_t offset = getSnapshotOffset();
+	size_t size = offset + snapshot.size();
+	if (ftruncate(fd, size) != 0) {
+		LOG(ERROR) << "StaticMapSegment: Cannot resize shared memory segment " << segmentName << ": " << strerror(errno);
+		abandon();
+		return false;
+	}
+	void* memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED) {
+		LOG(ERROR) << "StaticMapSegment: Cannot map shared memory segment " << segmentName << ": " << strerror(errno);
+		abandon();
+		return false;
+	}
+	StaticMapSegmentHeader* writableHeader = static_cast<StaticMapSegmentHeader*>(memory);
+	memcpy(static_cast<char*>(memory) + offset, &snapshot[0], snapshot.size());
+	writableHeader->snapshotSize = snapshot.size();
+	__atomic_store_n(&writableHeader->state, STATIC_MAP_READY, __ATOMIC_RELEASE); // mounting processes may use it from now on
+
+	/* Seal the segment: from now on nobody writes to it */
+	mprotect(memory, size, PROT_READ);
+	fchmod(fd, 0444);
+	close(fd);
+	fd = -1;
+
+	mapping = static_cast<const char*>(memory);
+	mappingSize = size;
+	header = writableHeader;
+	LOG(INFO) << "StaticMapSegment: Published " << snapshot.size() << " bytes of static map content in " << segmentName << ".";
+	return true;
+}
+
+void StaticMapSegment::abandon() {
+	if (fd < 0) {
+		return;
+	}
+	uint32_t state = STATIC_MAP_FAILED;
+	if (pwrite(fd, &state, sizeof(state), offsetof(StaticMapSegmentHeader, state)) != static_cast<ssize_t>(sizeof(state))) {
+		LOG(WARNING) << "StaticMapSegment: Cannot mark shared memory segment " << segmentName << " as failed.";
+	}
+	close(fd);
+	fd = -1;
+	shm_unlink(segmentName.c_str()); // the next world model tries again
+}
+
+bool StaticMapSegment::mount(int timeout) {
+	unmap();
+	int64_t deadline = nowInMs() + timeout;
+	while (true) {
+		int segmentFd = shm_open(segmentName.c_str(), O_RDONLY, 0);
+		if (segmentFd < 0) {
+			LOG(ERROR) << "StaticMapSegment: Cannot open shared memory segment " << segmentName << ": " << strerror(errno);
+			return false;
+		}
+		struct stat status;
+		const StaticMapSegmentHeader* current = 0;
+		if ((fstat(segmentFd, &status) == 0) && (status.st_size >= static_cast<off_t>(sizeof(StaticMapSegmentHeader)))) {
+			void* memory = mmap(0, status.st_size, PROT_READ, MAP_SHARED, segmentFd, 0);
+			if (memory != MAP_FAILED) {
+				current = static_cast<const StaticMapSegmentHeader*>(memory);
+				mapping = static_cast<const char*>(memory);
+				mappingSize = status.st_size;
+			}
+		}
+		close(segmentFd); // the mapping stays valid
+
+		if ((current != 0) && (strncmp(current->magic, RSG_STATIC_MAP_MAGIC, sizeof(current->magic)) == 0)) {
+			uint32_t state = __atomic_load_n(&current->state, __ATOMIC_ACQUIRE);
+			if (current->version != RSG_STATIC_MAP_VERSION) {
+				LOG(ERROR) << "StaticMapSegment: Shared memory segment " << segmentName << " has version " << current->version << ".";
+				unmap();
+				return false;
+			}
+			if (state == STATIC_MAP_FAILED) {
+				LOG(ERROR) << "StaticMapSegment: Publisher of shared memory segment " << segmentName << " failed.";
+				unmap();
+				return false;
+			}
+			if ((state == STATIC_MAP_LOADING) && !isAlive(current->publisherPid)) {
+				LOG(ERROR) << "StaticMapSegment: Publisher with pid " << current->publisherPid << " of shared memory segment " << segmentName << " is gone.";
+				unmap();
+				return false;
+			}
+			if ((state == STATIC_MAP_READY) && (strncmp(current->source, source.c_str(), sizeof(current->source)) != 0)) {
+				LOG(ERROR) << "StaticMapSegment: Shared memory segment " << segmentName << " holds another map: " << std::string(current->source, strnlen(current->source, sizeof(current->source)));
+				unmap();
+				return false;
+			}
+			if ((state == STATIC_MAP_READY) && (current->snapshotOffset + current->snapshotSize <= mappingSize)) { // otherwise mapped before the final size was set
+				header = current;
+				LOG(INFO) << "StaticMapSegment: Mounted " << header->snapshotSize << " bytes of static map content from " << segmentName
+						<< " (published by pid " << header->publisherPid << ").";
+				return true;
+			}
+		}
+
+		unmap(); // still loading
+		if (nowInMs() >= deadline) {
+			LOG(ERROR) << "StaticMapSegment: Timeout while waiting for the publisher of shared memory segment " << segmentName << ".";
+			return false;
+		}
+		sleepMs(MOUNT_POLL_INTERVAL);
+	}
+}
+
+const char* StaticMapSegment::getSnapshot() const {
+	return (header != 0) ? mapping + header->snapshotOffset : 0;
+}
+
+size_t StaticMapSegment::getSnapshotSize() const {
+	return (header != 0) ? header->snapshotSize : 0;
+}
+
+void StaticMapSegment::unlink(const std::string& segmentName) {
+	shm_unlink(segmentName.c_str());
+}
+
+std::string StaticMapSegment::describeFile(const std::string& fileName) {
+	std::stringstream description;
+	char resolvedName[PATH_MAX];
+	description << ((realpath(fileName.c_str(), resolvedName) != 0) ? std::string(resolvedName) : fileName);
+	struct stat status;
+	if (stat(fileName.c_str(), &status) == 0) {
+		description << " " << status.st_size << " " << status.st_mtime;
+	}
+	return description.str();
+}
+
+} // namespace rsg_bridge
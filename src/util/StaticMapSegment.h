@@ -0,0 +1,99 @@
+/*
+ * Snapshot cache of the static map for the world models on one computer.
+ */
+
+#ifndef RSG_BRIDGE_STATICMAPSEGMENT_H_
+#define RSG_BRIDGE_STATICMAPSEGMENT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+#define RSG_STATIC_MAP_MAGIC "RSGSMAP"
+#define RSG_STATIC_MAP_VERSION 1
+
+enum StaticMapState {
+	STATIC_MAP_LOADING = 0, // a new segment is zero filled
+	STATIC_MAP_READY = 1,
+	STATIC_MAP_FAILED = 2
+};
+
+/* Header at the beginning of the segment, followed by a snapshot (cf. SnapshotFormat.h) */
+struct StaticMapSegmentHeader {
+	char magic[8];                // RSG_STATIC_MAP_MAGIC
+	uint32_t version;             // RSG_STATIC_MAP_VERSION
+	uint32_t state;               // StaticMapState
+	int32_t publisherPid;
+	uint32_t reserved;
+	uint64_t snapshotOffset;      // page aligned
+	uint64_t snapshotSize;
+	char source[512];             // identifies the loaded files, e.g. name, size and modification time
+};
+
+/**
+ * @brief Immutable snapshot of static map content in a POSIX shared memory segment.
+ *
+ * This is a cache that speeds up loading, not a shared map. The first world model on a
+ * computer that acquires the segment becomes the publisher. It loads the map files as
+ * usual and publishes the result as snapshot. All other world models mount the segment
+ * read-only and copy the snapshot into their own World Model, i.e. without reading or
+ * parsing the map files. Every world model still holds and queries its own nodes, so the
+ * memory of the map is not saved.
+ *
+ * A published segment is sealed (read-only mapping and permissions) and outlives the
+ * publisher, so world models that are started later can still mount it. It is removed
+ * by unlink() or with the shared memory of the computer.
+ */
+class StaticMapSegment {
+public:
+
+	/**
+	 * @param segmentName E.g. "/swm_static_map".
+	 * @param source Identifies the map content. Mounting fails if the segment has been
+	 *        published for another source.
+	 */
+	StaticMapSegment(const std::string& segmentName, const std::string& source);
+	virtual ~StaticMapSegment();
+
+	/// True if this process created the segment and has to publish() it, false if it has to mount() it.
+	bool acquire();
+
+	/// Copy the snapshot into the segment and seal it. Returns false on errors; mounting world models then load the files themselves.
+	bool publish(const std::vector<char>& snapshot);
+
+	/// Mark an acquired segment as failed, e.g. if the map files cannot be loaded.
+	void abandon();
+
+	/**
+	 * @brief Map a segment that is published by another process.
+	 * @param timeout [ms] to wait for a publisher that is still loading.
+	 * @return False on timeout, a failed or dead publisher or another source.
+	 */
+	bool mount(int timeout);
+
+	/// The snapshot in the segment. Valid after publish() or mount() until the object is deleted.
+	const char* getSnapshot() const;
+	size_t getSnapshotSize() const;
+
+	/// Remove the segment from the computer. Mappings stay valid until they are unmapped.
+	static void unlink(const std::string& segmentName);
+
+	/// Source description of a file, i.e. its name, size and modification time.
+	static std::string describeFile(const std::string& fileName);
+
+private:
+	void unmap();
+
+	std::string segmentName;
+	std::string source;
+	int fd;
+	const char* mapping;
+	size_t mappingSize;
+	const StaticMapSegmentHeader* header;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_STATICMAPSEGMENT_H_ */
@@ -0,0 +1,185 @@
+#include "SubscriptionRegistry.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+static const boost::regex subscriptionMessagePattern("\"@worldmodeltype\"\\s*:\\s*\"RSGSubscription\"");
+static const boost::regex attributesPattern("\"attributes\"\\s*:\\s*\\[([^\\]]*)\\]");
+static const boost::regex attributePattern("\\{\\s*\"key\"\\s*:\\s*\"([^\"]*)\"\\s*,\\s*\"value\"\\s*:\\s*\"([^\"]*)\"\\s*\\}");
+
+/* One registry per World Model. Blocks of the same process share it via this library. */
+static boost::mutex registryMutex;
+static std::map<brics_3d::WorldModel*, SubscriptionRegistry*> registry;
+
+SubscriptionRegistry* SubscriptionRegistry::get(brics_3d::WorldModel* wm) {
+	boost::unique_lock<boost::mutex> lock(registryMutex);
+	std::map<brics_3d::WorldModel*, SubscriptionRegistry*>::iterator it = registry.find(wm);
+	if (it != registry.end()) {
+		return it->second;
+	}
+	SubscriptionRegistry* subscriptions = new SubscriptionRegistry(); // lives as long as the process
+	registry.insert(std::make_pair(wm, subscriptions));
+	return subscriptions;
+}
+
+SubscriptionRegistry::SubscriptionRegistry() : version(0) {
+
+}
+
+SubscriptionRegistry::~SubscriptionRegistry() {
+
+}
+
+void SubscriptionRegistry::subscribe(const Subscription& subscription) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	subscriptions[subscription.subscriptionId] = subscription;
+	version++;
+	LOG(INFO) << "SubscriptionRegistry: Added subscription " << subscription.subscriptionId << " for subscriber " << subscription.subscriberId;
+}
+
+bool SubscriptionRegistry::unsubscribe(const std::string& subscriptionId) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (subscriptions.erase(subscriptionId) == 0) {
+		return false;
+	}
+	version++;
+	LOG(INFO) << "SubscriptionRegistry: Removed subscription " << subscriptionId;
+	return true;
+}
+
+unsigned int SubscriptionRegistry::unsubscribeAll(const std::string& subscriberId) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	unsigned int count = 0;
+	std::map<std::string, Subscription>::iterator it = subscriptions.begin();
+	while (it != subscriptions.end()) {
+		if (it->second.subscriberId == subscriberId) {
+			subscriptions.erase(it++);
+			count++;
+		} else {
+			++it;
+		}
+	}
+	if (count > 0) {
+		version++;
+		LOG(INFO) << "SubscriptionRegistry: Removed " << count << " subscriptions of subscriber " << subscriberId;
+	}
+	return count;
+}
+
+uint64_t SubscriptionRegistry::getVersion() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return version;
+}
+
+void SubscriptionRegistry::getSubscriptions(std::vector<Subscription>& subscriptions, uint64_t& version) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	subscriptions.clear();
+	for (std::map<std::string, Subscription>::const_iterator it = this->subscriptions.begin(); it != this->subscriptions.end(); ++it) {
+		subscriptions.push_back(it->second);
+	}
+	version = this->version;
+}
+
+void SubscriptionRegistry::getSubscriberIds(std::set<std::string>& subscriberIds) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	subscriberIds.clear();
+	for (std::map<std::string, Subscription>::const_iterator it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+		subscriberIds.insert(it->second.subscriberId);
+	}
+}
+
+bool SubscriptionRegistry::getSubscriberId(const std::string& message, std::string& subscriberId) {
+	return getString(message, "subscriberId", subscriberId);
+}
+
+bool SubscriptionRegistry::isSubscriptionMessage(const std::string& message) {
+	return boost::regex_search(message, subscriptionMessagePattern);
+}
+
+bool SubscriptionRegistry::getString(const std::string& message, const std::string& key, std::string& value) {
+	boost::regex pattern("\"" + key + "\"\\s*:\\s*\"([^\"]*)\"");
+	boost::smatch match;
+	if (!boost::regex_search(message, match, pattern)) {
+		return false;
+	}
+	value = match[1];
+	return true;
+}
+
+bool SubscriptionRegistry::isValidId(const std::string& id) {
+	for (std::string::const_iterator it = id.begin(); it != id.end(); ++it) {
+		if ((*it == '"') || (*it == '\\') || (static_cast<unsigned char>(*it) < 0x20)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SubscriptionRegistry::handleMessage(const std::string& message, std::string& result) {
+	std::string operation;
+	std::string queryId;
+	Subscription subscription;
+	subscription.hasRootId = false;
+	bool success = false;
+
+	getString(message, "operation", operation);
+	getString(message, "subscriberId", subscription.subscriberId);
+	getString(message, "subscriptionId", subscription.subscriptionId);
+	bool hasQueryId = getString(message, "queryId", queryId);
+
+	if (operation == "SUBSCRIBE") {
+		std::string rootId;
+		if (subscription.subscriberId.empty() || subscription.subscriptionId.empty()) {
+			LOG(ERROR) << "SubscriptionRegistry: SUBSCRIBE requires a subscriberId and a subscriptionId.";
+		} else if (!isValidId(subscription.subscriberId) || !isValidId(subscription.subscriptionId)) {
+			LOG(ERROR) << "SubscriptionRegistry: The subscriberId and the subscriptionId must not contain backslashes or control characters.";
+		} else if (getString(message, "rootId", rootId) && !subscription.rootId.fromString(rootId)) {
+			LOG(ERROR) << "SubscriptionRegistry: Invalid rootId " << rootId;
+		} else {
+			subscription.hasRootId = !rootId.empty();
+			getString(message, "semanticContext", subscription.semanticContext);
+			boost::smatch attributes;
+			if (boost::regex_search(message, attributes, attributesPattern)) {
+				std::string list = attributes[1];
+				boost::sregex_iterator end;
+				for (boost::sregex_iterator it(list.begin(), list.end(), attributePattern); it != end; ++it) {
+					subscription.attributes.push_back(Attribute((*it)[1], (*it)[2]));
+				}
+			}
+			subscribe(subscription);
+			success = true;
+		}
+	} else if (operation == "UNSUBSCRIBE") {
+		if (!subscription.subscriptionId.empty()) {
+			success = unsubscribe(subscription.subscriptionId);
+		} else if (!subscription.subscriberId.empty()) {
+			success = (unsubscribeAll(subscription.subscriberId) > 0);
+		} else {
+			LOG(ERROR) << "SubscriptionRegistry: UNSUBSCRIBE requires a subscriberId or a subscriptionId.";
+		}
+	} else {
+		LOG(ERROR) << "SubscriptionRegistry: Unknown operation " << operation;
+	}
+
+	std::stringstream reply;
+	reply << "{\"@worldmodeltype\": \"RSGSubscriptionResult\", \"operation\": \"" << (isValidId(operation) ? operation : "") << "\", ";
+	if (hasQueryId && isValidId(queryId)) { // the reply is sent to the peer that sent these strings
+		reply << "\"queryId\": \"" << queryId << "\", ";
+	}
+	if (!subscription.subscriptionId.empty() && isValidId(subscription.subscriptionId)) {
+		reply << "\"subscriptionId\": \"" << subscription.subscriptionId << "\", ";
+	}
+	reply << "\"subscriptionSuccess\": " << (success ? "true" : "false") << "}";
+	result = reply.str();
+	return success;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,103 @@
+/*
+ * Interest subscriptions of peers for selective replication.
+ */
+
+#ifndef RSG_BRIDGE_SUBSCRIPTIONREGISTRY_H_
+#define RSG_BRIDGE_SUBSCRIPTIONREGISTRY_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Interest of a peer in a part of the graph.
+ *
+ * All given predicates have to be fulfilled. A subscription without predicates matches every node.
+ */
+struct Subscription {
+	std::string subscriptionId;
+	std::string subscriberId;  // Zyre peer or ZMQ topic the updates are routed to
+	bool hasRootId;
+	brics_3d::rsg::Id rootId;  // node has to be rootId or one of its descendants
+	std::string semanticContext; // node needs an attribute with the key prefix "<semanticContext>:", e.g. "osm"
+	std::vector<brics_3d::rsg::Attribute> attributes; // node needs all of them; a value "*" matches every value
+};
+
+/**
+ * @brief Registry of the subscriptions for a World Model.
+ *
+ * The registry is shared by all blocks of a process via SubscriptionRegistry::get():
+ * rsg_json_query registers the RSGSubscription messages of the peers and
+ * rsg_json_sender routes the matching updates to them.
+ *
+ * Subscription messages:
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGSubscription",
+ *   "operation": "SUBSCRIBE",  // or "UNSUBSCRIBE"
+ *   "subscriberId": "<peer>",
+ *   "subscriptionId": "<uuid>",
+ *   "rootId": "<uuid>",            // optional
+ *   "semanticContext": "osm",      // optional
+ *   "attributes": [{"key": "sherpa:agent_name", "value": "*"}] // optional
+ * }
+ * @endcode
+ * UNSUBSCRIBE without subscriptionId removes all subscriptions of the subscriber.
+ */
+class SubscriptionRegistry {
+public:
+
+	/// Get the registry for a World Model. It is created on first use.
+	static SubscriptionRegistry* get(brics_3d::WorldModel* wm);
+
+	/// Add or replace a subscription with the same subscriptionId.
+	void subscribe(const Subscription& subscription);
+
+	/// Remove a subscription. Returns false if it does not exist.
+	bool unsubscribe(const std::string& subscriptionId);
+
+	/// Remove all subscriptions of a subscriber. Returns the number of removed subscriptions.
+	unsigned int unsubscribeAll(const std::string& subscriberId);
+
+	/// Changes with every (un)subscription.
+	uint64_t getVersion();
+
+	void getSubscriptions(std::vector<Subscription>& subscriptions, uint64_t& version);
+
+	/// Subscribers with at least one subscription.
+	void getSubscriberIds(std::set<std::string>& subscriberIds);
+
+	/// The (first) subscriberId of a message, e.g. of an RSGSubscriptionUpdate envelope.
+	static bool getSubscriberId(const std::string& message, std::string& subscriberId);
+
+	/// True for RSGSubscription messages.
+	static bool isSubscriptionMessage(const std::string& message);
+
+	/// Process an RSGSubscription message and create the RSGSubscriptionResult.
+	bool handleMessage(const std::string& message, std::string& result);
+
+private:
+	SubscriptionRegistry();
+	virtual ~SubscriptionRegistry();
+
+	static bool getString(const std::string& message, const std::string& key, std::string& value);
+
+	/// True if the Id can be copied into a JSON string as it is, i.e. it has no quotes, backslashes or control characters.
+	static bool isValidId(const std::string& id);
+
+	boost::mutex mutex;
+	std::map<std::string, Subscription> subscriptions; // by subscriptionId
+	uint64_t version;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SUBSCRIPTIONREGISTRY_H_ */
@@ -0,0 +1,319 @@
+#include "SubscriptionRouter.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/sceneGraph/JSONSerializer.h>
+
+#include <sstream>
+#include <map>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+SubscriptionRouter::SubscriptionRouter(brics_3d::WorldModel* wm, SubscriptionRegistry* registry, IOutputPort* output) :
+		wm(wm), registry(registry), output(output), registryVersion(0), sentCount(0) {
+	serializer = new JSONSerializer(wm, &capture);
+}
+
+SubscriptionRouter::~SubscriptionRouter() {
+	delete serializer;
+}
+
+static bool isSameSubscription(const Subscription& a, const Subscription& b) {
+	return (a.subscriberId == b.subscriberId) && (a.hasRootId == b.hasRootId) && (!a.hasRootId || (a.rootId == b.rootId)) &&
+			(a.semanticContext == b.semanticContext) && (a.attributes == b.attributes);
+}
+
+void SubscriptionRouter::refresh() {
+	if (registry->getVersion() == registryVersion) {
+		return;
+	}
+
+	/* Keep the known nodes of unchanged subscriptions, so their deletions are still routed */
+	std::vector<Subscription> newSubscriptions;
+	registry->getSubscriptions(newSubscriptions, registryVersion);
+	std::vector<int> newListeners(subscriptions.size(), -1);
+	for (unsigned int i = 0; i < subscriptions.size(); ++i) {
+		for (unsigned int j = 0; j < newSubscriptions.size(); ++j) {
+			if ((subscriptions[i].subscriptionId == newSubscriptions[j].subscriptionId) && isSameSubscription(subscriptions[i], newSubscriptions[j])) {
+				newListeners[i] = j;
+				break;
+			}
+		}
+	}
+	subscriptions.swap(newSubscriptions);
+	index.remapKnown(newListeners);
+	settledIds.clear(); // new subscriptions have to be evaluated
+
+	/* A node has to have the first required attribute or at least one attribute of the semantic context */
+	index.clearListeners();
+	for (unsigned int i = 0; i < subscriptions.size(); ++i) {
+		if (!subscriptions[i].attributes.empty()) {
+			index.addListener(i, subscriptions[i].attributes[0].key);
+		} else if (!subscriptions[i].semanticContext.empty()) {
+			index.addListener(i, subscriptions[i].semanticContext + ":", true);
+		} else {
+			index.addListener(i, "");
+		}
+	}
+	LOG(DEBUG) << "SubscriptionRouter: Serving " << subscriptions.size() << " subscriptions.";
+}
+
+std::string SubscriptionRouter::getStatisticsAsString() const {
+	std::stringstream result;
+	result << "Subscription router: sent = " << sentCount << ", " << index.getStatisticsAsString();
+	return result.str();
+}
+
+bool SubscriptionRouter::isInSubtree(Id id, Id rootId) {
+	std::vector<Id> pending(1, id);
+	std::set<Id> visited;
+	while (!pending.empty()) {
+		Id current = pending.back();
+		pending.pop_back();
+		if (current == rootId) {
+			return true;
+		}
+		if (!visited.insert(current).second) {
+			continue;
+		}
+		vector<Id> parentIds;
+		if (wm->scene.getNodeParents(current, parentIds)) {
+			pending.insert(pending.end(), parentIds.begin(), parentIds.end());
+		}
+	}
+	return false;
+}
+
+bool SubscriptionRouter::isMatch(const Subscription& subscription, Id id, Id parentId, const vector<Attribute>* attributes) {
+	if (subscription.hasRootId && !isInSubtree(id, subscription.rootId) &&
+		(parentId.isNil() || !isInSubtree(parentId, subscription.rootId))) {
+		return false;
+	}
+	if (subscription.semanticContext.empty() && subscription.attributes.empty()) {
+		return true;
+	}
+
+	vector<Attribute> nodeAttributes;
+	if (attributes == 0) {
+		wm->scene.getNodeAttributes(id, nodeAttributes);
+		attributes = &nodeAttributes;
+	}
+
+	if (!subscription.semanticContext.empty()) {
+		const std::string prefix = subscription.semanticContext + ":";
+		bool hasContext = false;
+		for (vector<Attribute>::const_iterator it = attributes->begin(); it != attributes->end() && !hasContext; ++it) {
+			hasContext = (it->key.compare(0, prefix.size(), prefix) == 0);
+		}
+		if (!hasContext) {
+			return false;
+		}
+	}
+
+	for (std::vector<Attribute>::const_iterator required = subscription.attributes.begin(); required != subscription.attributes.end(); ++required) {
+		bool hasAttribute = false;
+		for (vector<Attribute>::const_iterator it = attributes->begin(); it != attributes->end() && !hasAttribute; ++it) {
+			hasAttribute = (it->key == required->key) && ((required->value == "*") || (it->value == required->value));
+		}
+		if (!hasAttribute) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void SubscriptionRouter::select(Id id, Id parentId, const vector<Attribute>* attributes, unsigned int atomType, Selection selection, std::vector<unsigned int>& matches) {
+	refresh();
+	double startTime = DispatchIndex::now();
+	std::set<unsigned int> known;
+	index.getKnown(id, known);
+	matches.assign(known.begin(), known.end());
+	if ((selection == ONLY_KNOWN) || ((selection == EVALUATE) && (settledIds.find(id) != settledIds.end()))) {
+		index.recordDispatch(startTime, 0);
+		return;
+	}
+
+	/* Only subscriptions with a matching key are evaluated. The others are implicitly rejected. */
+	vector<Attribute> nodeAttributes;
+	if (attributes == 0) {
+		wm->scene.getNodeAttributes(id, nodeAttributes);
+		attributes = &nodeAttributes;
+	}
+	std::vector<unsigned int> candidates;
+	index.getCandidates(attributes, atomType, candidates);
+	unsigned int evaluatedCount = 0;
+	for (std::vector<unsigned int>::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+		if (known.find(*it) != known.end()) {
+			continue;
+		}
+		evaluatedCount++;
+		if (isMatch(subscriptions[*it], id, parentId, attributes)) {
+			index.addKnown(id, *it);
+			matches.push_back(*it);
+		}
+	}
+	settledIds.insert(id);
+	index.recordDispatch(startTime, evaluatedCount);
+}
+
+bool SubscriptionRouter::send(const std::vector<unsigned int>& matches) {
+	if (capture.message.empty()) {
+		return true;
+	}
+
+	/* One envelope per subscriber */
+	std::map<std::string, std::vector<std::string> > subscribers;
+	for (std::vector<unsigned int>::const_iterator it = matches.begin(); it != matches.end(); ++it) {
+		const Subscription& subscription = subscriptions[*it];
+		subscribers[subscription.subscriberId].push_back(subscription.subscriptionId);
+	}
+
+	bool success = true;
+	for (std::map<std::string, std::vector<std::string> >::const_iterator it = subscribers.begin(); it != subscribers.end(); ++it) {
+		std::stringstream envelope;
+		envelope << "{\"@worldmodeltype\": \"RSGSubscriptionUpdate\", \"subscriberId\": \"" << it->first << "\", \"subscriptionIds\": [";
+		for (std::vector<std::string>::const_iterator id = it->second.begin(); id != it->second.end(); ++id) {
+			envelope << ((id == it->second.begin()) ? "\"" : ", \"") << *id << "\"";
+		}
+		envelope << "], \"payload\": " << capture.message << "}";
+		std::string message = envelope.str();
+		int transferredBytes = 0;
+		if (output->write(message.c_str(), static_cast<int>(message.size()), transferredBytes) != 0) {
+			success = false;
+		}
+		sentCount++;
+	}
+	capture.message.clear();
+	return success;
+}
+
+bool SubscriptionRouter::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_NODE, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addNode(parentId, assignedId, attributes, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_GROUP, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addGroup(parentId, assignedId, attributes, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_TRANSFORM, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addTransformNode(parentId, assignedId, attributes, transform, timeStamp, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_TRANSFORM, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addUncertainTransformNode(parentId, assignedId, attributes, transform, uncertainty, timeStamp, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_GEOMETRIC_NODE, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addGeometricNode(parentId, assignedId, attributes, shape, timeStamp, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	return true; // advertisements are for World Model Agents, not for subscribers
+}
+
+bool SubscriptionRouter::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	std::vector<unsigned int> matches;
+	select(assignedId, parentId, &attributes, DISPATCH_CONNECTION, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addConnection(parentId, assignedId, attributes, sourceIds, targetIds, start, end, forcedId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	std::vector<unsigned int> matches;
+	select(id, Id(), &newAttributes, DISPATCH_ANY_ATOM, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->setNodeAttributes(id, newAttributes, timeStamp);
+	return send(matches);
+}
+
+bool SubscriptionRouter::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	std::vector<unsigned int> matches;
+	select(id, Id(), 0, DISPATCH_TRANSFORM, EVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->setTransform(id, transform, timeStamp);
+	return send(matches);
+}
+
+bool SubscriptionRouter::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	std::vector<unsigned int> matches;
+	select(id, Id(), 0, DISPATCH_TRANSFORM, EVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->setUncertainTransform(id, transform, uncertainty, timeStamp);
+	return send(matches);
+}
+
+bool SubscriptionRouter::deleteNode(Id id) {
+	std::vector<unsigned int> matches;
+	select(id, Id(), 0, DISPATCH_ANY_ATOM, ONLY_KNOWN, matches);
+	index.removeKnown(id);
+	settledIds.erase(id);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->deleteNode(id);
+	return send(matches);
+}
+
+bool SubscriptionRouter::addParent(Id id, Id parentId) {
+	settledIds.clear(); // descendants might be part of a subtree now
+	std::vector<unsigned int> matches;
+	select(id, parentId, 0, DISPATCH_ANY_ATOM, REEVALUATE, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->addParent(id, parentId);
+	return send(matches);
+}
+
+bool SubscriptionRouter::removeParent(Id id, Id parentId) {
+	std::vector<unsigned int> matches;
+	select(id, Id(), 0, DISPATCH_ANY_ATOM, ONLY_KNOWN, matches);
+	if (matches.empty()) {
+		return true;
+	}
+	serializer->removeParent(id, parentId);
+	return send(matches);
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,115 @@
+/*
+ * Routes updates to the peers that subscribed to them.
+ */
+
+#ifndef RSG_BRIDGE_SUBSCRIPTIONROUTER_H_
+#define RSG_BRIDGE_SUBSCRIPTIONROUTER_H_
+
+#include "SubscriptionRegistry.h"
+#include "DispatchIndex.h"
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+#include <brics_3d/worldModel/sceneGraph/IOutputPort.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Sends the updates that match a subscription of the SubscriptionRegistry to its subscriber.
+ *
+ * An update is serialized once if at least one subscription matches. It is then written
+ * for each matching subscriber as envelope to the output port:
+ * @code
+ * {"@worldmodeltype": "RSGSubscriptionUpdate", "subscriberId": "<peer>", "subscriptionIds": ["<uuid>"], "payload": <RSGUpdate>}
+ * @endcode
+ * The communication layer delivers it to the subscriber only, e.g. via a Zyre whisper
+ * or a ZMQ topic.
+ *
+ * Once a node matched a subscription, all further updates of the node including its
+ * deletion are routed to the subscriber. Nodes that do not match are remembered until
+ * their attributes or the graph structure change, so frequent Transform updates of such
+ * nodes are rejected without a graph traversal.
+ *
+ * A DispatchIndex keyed by the first required attribute key (or the semantic context)
+ * selects the subscriptions that are evaluated for a node, so the cost of an update
+ * scales with the number of subscriptions that could match rather than with all of them.
+ *
+ * The router has to be called under the write lock of the World Model.
+ */
+class SubscriptionRouter : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	/**
+	 * @param wm World Model to look up attributes and parents of nodes.
+	 * @param registry Subscriptions to be served.
+	 * @param output Port for the envelopes. Not owned.
+	 */
+	SubscriptionRouter(brics_3d::WorldModel* wm, SubscriptionRegistry* registry, brics_3d::rsg::IOutputPort* output);
+	virtual ~SubscriptionRouter();
+
+	/// Number of sent envelopes.
+	uint64_t getSentCount() const { return sentCount; }
+
+	/// Cost of selecting the subscriptions per update.
+	DispatchStatistics getDispatchStatistics() const { return index.getStatistics(); }
+	std::string getStatisticsAsString() const;
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	/// Keeps the last serialized message.
+	class CapturePort : public brics_3d::rsg::IOutputPort {
+	public:
+		int write(const char *dataBuffer, int dataLength, int &transferredBytes) {
+			message.append(dataBuffer, dataLength);
+			transferredBytes = dataLength;
+			return 0;
+		}
+		std::string message;
+	};
+
+	enum Selection {
+		EVALUATE,         // evaluate the predicates if the node is neither known nor rejected
+		REEVALUATE,       // attributes or parents changed
+		ONLY_KNOWN        // e.g. for deletions
+	};
+
+	void refresh();
+	void select(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId, const vector<brics_3d::rsg::Attribute>* attributes, unsigned int atomType, Selection selection, std::vector<unsigned int>& matches);
+	bool isMatch(const Subscription& subscription, brics_3d::rsg::Id id, brics_3d::rsg::Id parentId, const vector<brics_3d::rsg::Attribute>* attributes);
+	bool isInSubtree(brics_3d::rsg::Id id, brics_3d::rsg::Id rootId);
+	bool send(const std::vector<unsigned int>& matches);
+
+	brics_3d::WorldModel* wm;
+	SubscriptionRegistry* registry;
+	brics_3d::rsg::IOutputPort* output;
+	CapturePort capture;
+	brics_3d::rsg::ISceneGraphUpdateObserver* serializer;
+
+	std::vector<Subscription> subscriptions;
+	DispatchIndex index;                  // listeners are the indices of subscriptions
+	std::set<brics_3d::rsg::Id> settledIds; // evaluated for all subscriptions with the current attributes and parents
+	uint64_t registryVersion;
+	uint64_t sentCount;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_SUBSCRIPTIONROUTER_H_ */
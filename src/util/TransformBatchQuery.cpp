@@ -0,0 +1,128 @@
+#include "TransformBatchQuery.h"
+#include "TransformHistoryStore.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <map>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+/* Element of a column-major homogeneous matrix */
+#define M(matrix, row, column) matrix[(column) * 4 + (row)]
+
+static const boost::regex batchQueryPattern("\"query\"\\s*:\\s*\"GET_TRANSFORMS\"");
+static const boost::regex idsPattern("\"ids\"\\s*:\\s*\\[([^\\]]*)\\]");
+static const boost::regex uuidPattern("\"([^\"]*)\"");
+static const boost::regex referenceIdPattern("\"idReferenceNode\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+
+bool TransformBatchQuery::isBatchQuery(const std::string& query) {
+	return boost::regex_search(query, batchQueryPattern);
+}
+
+static void multiply(const double* a, const double* b, double* result) {
+	for (unsigned int row = 0; row < 4; ++row) {
+		for (unsigned int column = 0; column < 4; ++column) {
+			M(result, row, column) = M(a, row, 0) * M(b, 0, column) + M(a, row, 1) * M(b, 1, column) +
+					M(a, row, 2) * M(b, 2, column) + M(a, row, 3) * M(b, 3, column);
+		}
+	}
+}
+
+void TransformBatchQuery::getTransforms(brics_3d::WorldModel* wm, const std::vector<Id>& ids, Id referenceId, TimeStamp timeStamp,
+		std::vector<double>& matrices, std::vector<bool>& success) {
+	matrices.assign(ids.size() * 16, 0.0);
+	success.assign(ids.size(), false);
+
+	/* The inverse path of the reference node is shared by all ids: T(id, ref) = T(root, ref) * T(id, root) */
+	Id rootId = wm->getRootNodeId();
+	brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr rootToReference(new brics_3d::HomogeneousMatrix44());
+	bool hasReferencePath = wm->scene.getTransformForNode(rootId, referenceId, timeStamp, rootToReference);
+
+	std::map<Id, unsigned int> done; // first index of an id
+	for (unsigned int i = 0; i < ids.size(); ++i) {
+		std::map<Id, unsigned int>::const_iterator duplicate = done.find(ids[i]);
+		if (duplicate != done.end()) {
+			memcpy(&matrices[i * 16], &matrices[duplicate->second * 16], 16 * sizeof(double));
+			success[i] = success[duplicate->second];
+			continue;
+		}
+		done.insert(std::make_pair(ids[i], i));
+
+		brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+		if (hasReferencePath && wm->scene.getTransformForNode(ids[i], rootId, timeStamp, transform)) {
+			multiply(rootToReference->getRawData(), transform->getRawData(), &matrices[i * 16]);
+			success[i] = true;
+		} else if (wm->scene.getTransformForNode(ids[i], referenceId, timeStamp, transform)) { // e.g. below a remote root node
+			memcpy(&matrices[i * 16], transform->getRawData(), 16 * sizeof(double));
+			success[i] = true;
+		}
+	}
+}
+
+bool TransformBatchQuery::handleQuery(brics_3d::WorldModel* wm, const std::string& query, std::string& result) {
+	boost::smatch match;
+	std::vector<Id> ids;
+	Id referenceId;
+	bool success = true;
+
+	if (boost::regex_search(query, match, idsPattern)) {
+		std::string list = match[1];
+		boost::sregex_iterator end;
+		for (boost::sregex_iterator it(list.begin(), list.end(), uuidPattern); it != end; ++it) {
+			Id id;
+			if (!id.fromString((*it)[1])) {
+				LOG(ERROR) << "TransformBatchQuery: Invalid id " << (*it)[1];
+				success = false;
+			}
+			ids.push_back(id);
+		}
+	}
+	if (!boost::regex_search(query, match, referenceIdPattern) || !referenceId.fromString(match[1])) {
+		LOG(ERROR) << "TransformBatchQuery: GET_TRANSFORMS requires an idReferenceNode.";
+		success = false;
+	}
+
+	double stamp;
+	TimeStamp timeStamp = TransformHistoryStore::getStamp(query, "timeStamp", stamp) ? TimeStamp(stamp, brics_3d::Units::Second) : wm->now();
+
+	std::vector<double> matrices;
+	std::vector<bool> found;
+	if (success) {
+		getTransforms(wm, ids, referenceId, timeStamp, matrices, found);
+	}
+
+	std::stringstream reply;
+	reply << std::setprecision(15);
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"GET_TRANSFORMS\", ";
+	if (boost::regex_search(query, match, queryIdPattern)) {
+		reply << "\"queryId\": \"" << match[1] << "\", ";
+	}
+	reply << "\"querySuccess\": " << (success ? "true" : "false") << ", \"transforms\": [";
+	for (unsigned int i = 0; i < found.size(); ++i) {
+		reply << ((i == 0) ? "" : ", ") << "{\"id\": \"" << ids[i] << "\", \"success\": " << (found[i] ? "true" : "false");
+		if (found[i]) {
+			const double* matrix = &matrices[i * 16];
+			reply << ", \"transform\": {\"type\": \"HomogeneousMatrix44\", \"matrix\": [";
+			for (unsigned int row = 0; row < 4; ++row) {
+				reply << ((row == 0) ? "[" : ", [") << M(matrix, row, 0) << ", " << M(matrix, row, 1) << ", " << M(matrix, row, 2) << ", " << M(matrix, row, 3) << "]";
+			}
+			reply << "]}";
+		}
+		reply << "}";
+	}
+	reply << "]}";
+	result = reply.str();
+	return success;
+}
+
+} // namespace rsg_bridge
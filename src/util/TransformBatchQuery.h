@@ -0,0 +1,54 @@
+/*
+ * Batched transform queries for many nodes w.r.t. one reference node.
+ */
+
+#ifndef RSG_BRIDGE_TRANSFORMBATCHQUERY_H_
+#define RSG_BRIDGE_TRANSFORMBATCHQUERY_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+
+#include <string>
+#include <vector>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Answers GET_TRANSFORMS queries: N nodes, one reference node and one time stamp.
+ *
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGQuery",
+ *   "query": "GET_TRANSFORMS",
+ *   "ids": ["<uuid>", "<uuid>"],
+ *   "idReferenceNode": "<uuid>",
+ *   "timeStamp": {"@stamptype": "TimeStampUTCms", "stamp": 1464686442000.0} // optional, default is now
+ * }
+ * @endcode
+ * A single GET_TRANSFORM walks the paths of the node and of the reference node to the
+ * root. Here the path of the reference node is walked and inverted only once and the
+ * pose of every node is composed from its path to the root. Each node is looked up once,
+ * even if it is listed several times. Common prefixes of the node paths are not shared:
+ * the scene graph API does not reveal which ancestors are Transforms without walking them.
+ *
+ * The reply lists a "transforms" entry per id with the matrix in the format of GET_TRANSFORM.
+ * Ids without a solution are returned with "success": false.
+ *
+ * Has to be called under the read lock of the World Model.
+ */
+class TransformBatchQuery {
+public:
+
+	/// True for GET_TRANSFORMS queries.
+	static bool isBatchQuery(const std::string& query);
+
+	/// Process a GET_TRANSFORMS query on the World Model and create the RSGQueryResult.
+	static bool handleQuery(brics_3d::WorldModel* wm, const std::string& query, std::string& result);
+
+	/// Transforms of all ids w.r.t. the reference node as column-major matrices (16 values per id).
+	static void getTransforms(brics_3d::WorldModel* wm, const std::vector<brics_3d::rsg::Id>& ids, brics_3d::rsg::Id referenceId,
+			brics_3d::rsg::TimeStamp timeStamp, std::vector<double>& matrices, std::vector<bool>& success);
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_TRANSFORMBATCHQUERY_H_ */
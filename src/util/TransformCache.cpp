@@ -0,0 +1,263 @@
+#include "TransformCache.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+static const boost::regex transformQueryPattern("\"query\"\\s*:\\s*\"GET_TRANSFORM\"");
+static const boost::regex idPattern("\"id\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex referenceIdPattern("\"idReferenceNode\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex stampTypePattern("\"@stamptype\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex stampPattern("\"stamp\"\\s*:\\s*(\"[^\"]*\"|[-+0-9.eE]+)");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex successPattern("\"querySuccess\"\\s*:\\s*true");
+
+/* One cache per World Model. Blocks of the same process share it via this library. */
+static boost::mutex cacheMutex;
+static std::map<brics_3d::WorldModel*, TransformCache*> caches;
+
+TransformCache* TransformCache::get(brics_3d::WorldModel* wm, double bucketDuration, unsigned int maxSize) {
+	boost::unique_lock<boost::mutex> lock(cacheMutex);
+	std::map<brics_3d::WorldModel*, TransformCache*>::iterator it = caches.find(wm);
+	if (it != caches.end()) {
+		return it->second;
+	}
+	TransformCache* cache = new TransformCache(wm, bucketDuration, maxSize); // lives as long as the process
+	caches.insert(std::make_pair(wm, cache));
+	return cache;
+}
+
+TransformCache::TransformCache(brics_3d::WorldModel* wm, double bucketDuration, unsigned int maxSize) :
+		wm(wm), bucketDuration(bucketDuration), maxSize(maxSize) {
+	memset(&statistics, 0, sizeof(statistics));
+	wm->scene.attachUpdateObserver(this);
+	LOG(INFO) << "TransformCache: Caching up to " << maxSize << " transforms with a time bucket of " << bucketDuration << " s.";
+}
+
+TransformCache::~TransformCache() {
+	wm->scene.detachUpdateObserver(this);
+}
+
+bool TransformCache::isTransformQuery(const std::string& query) {
+	return boost::regex_search(query, transformQueryPattern);
+}
+
+bool TransformCache::getKey(const std::string& query, std::string& key, Id& id, Id& referenceId) {
+	boost::smatch match;
+	if (!boost::regex_search(query, match, idPattern) || !id.fromString(match[1])) {
+		return false;
+	}
+	if (!boost::regex_search(query, match, referenceIdPattern) || !referenceId.fromString(match[1])) {
+		return false;
+	}
+
+	std::string bucket;
+	if (boost::regex_search(query, match, stampPattern)) {
+		bucket = match[1];
+		boost::smatch stampType;
+		if ((bucketDuration > 0) && boost::regex_search(query, stampType, stampTypePattern) && (stampType[1] == "TimeStampUTCms")) {
+			std::stringstream bucketIndex;
+			bucketIndex << static_cast<long long>(floor(atof(bucket.c_str()) * 1.0e-3 / bucketDuration));
+			bucket = bucketIndex.str();
+		}
+	}
+
+	std::stringstream result;
+	result << id << "/" << referenceId << "/" << bucket;
+	key = result.str();
+	return true;
+}
+
+void TransformCache::getAncestors(Id id, std::set<Id>& ancestors) {
+	std::vector<Id> pending(1, id);
+	while (!pending.empty()) {
+		Id current = pending.back();
+		pending.pop_back();
+		if (!ancestors.insert(current).second) {
+			continue;
+		}
+		vector<Id> parentIds;
+		if (wm->scene.getNodeParents(current, parentIds)) {
+			pending.insert(pending.end(), parentIds.begin(), parentIds.end());
+		}
+	}
+}
+
+bool TransformCache::lookup(const std::string& query, std::string& result) {
+	std::string key;
+	Id id;
+	Id referenceId;
+	if (!getKey(query, key, id, referenceId)) {
+		return false;
+	}
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<std::string, CacheEntry>::const_iterator entry = entries.find(key);
+	if (entry == entries.end()) {
+		statistics.missCount++;
+		return false;
+	}
+	statistics.hitCount++;
+
+	boost::smatch queryId;
+	if (boost::regex_search(query, queryId, queryIdPattern)) {
+		result = boost::regex_replace(entry->second.result, queryIdPattern, "\"queryId\": \"" + queryId[1] + "\"", boost::format_first_only);
+	} else {
+		result = entry->second.result;
+	}
+	return true;
+}
+
+void TransformCache::insert(const std::string& query, const std::string& result) {
+	std::string key;
+	Id id;
+	Id referenceId;
+	if (!boost::regex_search(result, successPattern) || !getKey(query, key, id, referenceId)) {
+		return;
+	}
+
+	std::set<Id> path;
+	getAncestors(id, path);
+	getAncestors(referenceId, path);
+
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<std::string, CacheEntry>::iterator existing = entries.find(key);
+	if (existing != entries.end()) {
+		erase(existing);
+	}
+	if (entries.size() >= maxSize) {
+		LOG(DEBUG) << "TransformCache: Maximum size reached. Clearing all " << entries.size() << " entries.";
+		entries.clear();
+		dependents.clear();
+	}
+
+	CacheEntry& entry = entries[key];
+	entry.result = result;
+	entry.path.assign(path.begin(), path.end());
+	for (std::vector<Id>::const_iterator it = entry.path.begin(); it != entry.path.end(); ++it) {
+		dependents[*it].insert(key);
+	}
+}
+
+void TransformCache::erase(std::map<std::string, CacheEntry>::iterator entry) {
+	for (std::vector<Id>::const_iterator it = entry->second.path.begin(); it != entry->second.path.end(); ++it) {
+		std::map<Id, std::set<std::string> >::iterator keys = dependents.find(*it);
+		if (keys != dependents.end()) {
+			keys->second.erase(entry->first);
+			if (keys->second.empty()) {
+				dependents.erase(keys);
+			}
+		}
+	}
+	entries.erase(entry);
+}
+
+void TransformCache::invalidate(Id id) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, std::set<std::string> >::iterator keys = dependents.find(id);
+	if (keys == dependents.end()) {
+		return;
+	}
+	std::set<std::string> invalidKeys;
+	invalidKeys.swap(keys->second);
+	for (std::set<std::string>::const_iterator key = invalidKeys.begin(); key != invalidKeys.end(); ++key) {
+		std::map<std::string, CacheEntry>::iterator entry = entries.find(*key);
+		if (entry != entries.end()) {
+			erase(entry);
+			statistics.invalidatedCount++;
+		}
+	}
+	dependents.erase(id);
+}
+
+void TransformCache::clear() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	entries.clear();
+	dependents.clear();
+}
+
+TransformCacheStatistics TransformCache::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	TransformCacheStatistics result = statistics;
+	result.size = static_cast<unsigned int>(entries.size());
+	return result;
+}
+
+std::string TransformCache::getStatisticsAsString() {
+	TransformCacheStatistics current = getStatistics();
+	std::stringstream result;
+	result << "Transform cache: hits = " << current.hitCount
+			<< ", misses = " << current.missCount
+			<< ", invalidated = " << current.invalidatedCount
+			<< ", size = " << current.size;
+	return result.str();
+}
+
+bool TransformCache::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	return true;
+}
+
+bool TransformCache::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	return true;
+}
+
+bool TransformCache::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	return true;
+}
+
+bool TransformCache::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	invalidate(id);
+	return true;
+}
+
+bool TransformCache::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	invalidate(id);
+	return true;
+}
+
+bool TransformCache::deleteNode(Id id) {
+	invalidate(id);
+	return true;
+}
+
+bool TransformCache::addParent(Id id, Id parentId) {
+	invalidate(id); // the node and its descendants have an additional path now
+	return true;
+}
+
+bool TransformCache::removeParent(Id id, Id parentId) {
+	invalidate(id);
+	return true;
+}
+
+} // namespace rsg_bridge
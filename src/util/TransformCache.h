@@ -0,0 +1,109 @@
+/*
+ * Cache for the replies of GET_TRANSFORM queries.
+ */
+
+#ifndef RSG_BRIDGE_TRANSFORMCACHE_H_
+#define RSG_BRIDGE_TRANSFORMCACHE_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Hit and invalidation counts of a TransformCache.
+ */
+struct TransformCacheStatistics {
+	uint64_t hitCount;
+	uint64_t missCount;
+	uint64_t invalidatedCount; // entries removed because a node on their path changed
+	unsigned int size;
+};
+
+/**
+ * @brief Keeps the composed transforms of GET_TRANSFORM queries.
+ *
+ * Entries are keyed by (id, idReferenceNode, time bucket). Stamps of TimeStampUTCms
+ * queries fall into buckets of bucketDuration seconds, so repeated pose lookups
+ * of the same agent/origin pair hit the cache even though every request carries
+ * the current time. Other stamps are used as they are.
+ *
+ * An entry depends on all ancestors of both nodes, which contain the path between
+ * them. It is removed as soon as one of these nodes receives a setTransform or
+ * its parents change. Thus, a cached reply equals the computed one unless the
+ * history of a Transform on the path holds different samples within the same bucket.
+ *
+ * The cache observes the scene of the World Model and is shared by all blocks via
+ * TransformCache::get(). Entries have to be inserted under the read lock of the
+ * WorldModelAccess, as the ancestors are looked up.
+ */
+class TransformCache : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+
+	/// Get the cache for a World Model. It is created and attached to the scene on first use.
+	static TransformCache* get(brics_3d::WorldModel* wm, double bucketDuration, unsigned int maxSize);
+
+	/// True for GET_TRANSFORM queries.
+	static bool isTransformQuery(const std::string& query);
+
+	/// Look up the reply for a GET_TRANSFORM query. The queryId is replaced by the one of the query.
+	bool lookup(const std::string& query, std::string& result);
+
+	/// Store the reply of a GET_TRANSFORM query. Only successful replies are stored.
+	void insert(const std::string& query, const std::string& result);
+
+	void clear();
+
+	TransformCacheStatistics getStatistics();
+	std::string getStatisticsAsString();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	TransformCache(brics_3d::WorldModel* wm, double bucketDuration, unsigned int maxSize);
+	virtual ~TransformCache();
+
+	struct CacheEntry {
+		std::string result;
+		std::vector<brics_3d::rsg::Id> path; // ancestors of id and idReferenceNode
+	};
+
+	bool getKey(const std::string& query, std::string& key, brics_3d::rsg::Id& id, brics_3d::rsg::Id& referenceId);
+	void getAncestors(brics_3d::rsg::Id id, std::set<brics_3d::rsg::Id>& ancestors);
+	void invalidate(brics_3d::rsg::Id id);
+	void erase(std::map<std::string, CacheEntry>::iterator entry);
+
+	brics_3d::WorldModel* wm;
+	double bucketDuration;
+	unsigned int maxSize;
+
+	boost::mutex mutex;
+	std::map<std::string, CacheEntry> entries;                       // by key
+	std::map<brics_3d::rsg::Id, std::set<std::string> > dependents;  // keys of the entries with the node on their path
+	TransformCacheStatistics statistics;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_TRANSFORMCACHE_H_ */
@@ -0,0 +1,558 @@
+#include "TransformHistoryStore.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/worldModel/sceneGraph/SceneGraphToUpdatesTraverser.h>
+
+#include <boost/regex.hpp>
+
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <algorithm>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+/* Element of a column-major homogeneous matrix */
+#define M(matrix, row, column) matrix[(column) * 4 + (row)]
+
+TransformHistory::TransformHistory(unsigned int capacity) :
+		capacity(capacity > 0 ? capacity : 1), head(0), count(0) {
+	stamps.resize(this->capacity);
+	tx.resize(this->capacity);
+	ty.resize(this->capacity);
+	tz.resize(this->capacity);
+	qw.resize(this->capacity);
+	qx.resize(this->capacity);
+	qy.resize(this->capacity);
+	qz.resize(this->capacity);
+}
+
+void TransformHistory::set(unsigned int index, double stamp, const double* matrix) {
+	unsigned int i = physical(index);
+	stamps[i] = stamp;
+	tx[i] = M(matrix, 0, 3);
+	ty[i] = M(matrix, 1, 3);
+	tz[i] = M(matrix, 2, 3);
+
+	/* Rotation matrix to unit quaternion */
+	double trace = M(matrix, 0, 0) + M(matrix, 1, 1) + M(matrix, 2, 2);
+	double w, x, y, z;
+	if (trace > 0) {
+		double s = 0.5 / sqrt(trace + 1.0);
+		w = 0.25 / s;
+		x = (M(matrix, 2, 1) - M(matrix, 1, 2)) * s;
+		y = (M(matrix, 0, 2) - M(matrix, 2, 0)) * s;
+		z = (M(matrix, 1, 0) - M(matrix, 0, 1)) * s;
+	} else if ((M(matrix, 0, 0) > M(matrix, 1, 1)) && (M(matrix, 0, 0) > M(matrix, 2, 2))) {
+		double s = 2.0 * sqrt(1.0 + M(matrix, 0, 0) - M(matrix, 1, 1) - M(matrix, 2, 2));
+		w = (M(matrix, 2, 1) - M(matrix, 1, 2)) / s;
+		x = 0.25 * s;
+		y = (M(matrix, 0, 1) + M(matrix, 1, 0)) / s;
+		z = (M(matrix, 0, 2) + M(matrix, 2, 0)) / s;
+	} else if (M(matrix, 1, 1) > M(matrix, 2, 2)) {
+		double s = 2.0 * sqrt(1.0 + M(matrix, 1, 1) - M(matrix, 0, 0) - M(matrix, 2, 2));
+		w = (M(matrix, 0, 2) - M(matrix, 2, 0)) / s;
+		x = (M(matrix, 0, 1) + M(matrix, 1, 0)) / s;
+		y = 0.25 * s;
+		z = (M(matrix, 1, 2) + M(matrix, 2, 1)) / s;
+	} else {
+		double s = 2.0 * sqrt(1.0 + M(matrix, 2, 2) - M(matrix, 0, 0) - M(matrix, 1, 1));
+		w = (M(matrix, 1, 0) - M(matrix, 0, 1)) / s;
+		x = (M(matrix, 0, 2) + M(matrix, 2, 0)) / s;
+		y = (M(matrix, 1, 2) + M(matrix, 2, 1)) / s;
+		z = 0.25 * s;
+	}
+	qw[i] = w;
+	qx[i] = x;
+	qy[i] = y;
+	qz[i] = z;
+}
+
+static void toMatrix(double x, double y, double z, double qw, double qx, double qy, double qz, double* matrix) {
+	M(matrix, 0, 0) = 1 - 2 * (qy * qy + qz * qz);
+	M(matrix, 0, 1) = 2 * (qx * qy - qz * qw);
+	M(matrix, 0, 2) = 2 * (qx * qz + qy * qw);
+	M(matrix, 1, 0) = 2 * (qx * qy + qz * qw);
+	M(matrix, 1, 1) = 1 - 2 * (qx * qx + qz * qz);
+	M(matrix, 1, 2) = 2 * (qy * qz - qx * qw);
+	M(matrix, 2, 0) = 2 * (qx * qz - qy * qw);
+	M(matrix, 2, 1) = 2 * (qy * qz + qx * qw);
+	M(matrix, 2, 2) = 1 - 2 * (qx * qx + qy * qy);
+	M(matrix, 0, 3) = x;
+	M(matrix, 1, 3) = y;
+	M(matrix, 2, 3) = z;
+	M(matrix, 3, 0) = 0;
+	M(matrix, 3, 1) = 0;
+	M(matrix, 3, 2) = 0;
+	M(matrix, 3, 3) = 1;
+}
+
+static void multiply(const double* a, const double* b, double* result) {
+	for (unsigned int row = 0; row < 4; ++row) {
+		for (unsigned int column = 0; column < 4; ++column) {
+			M(result, row, column) = M(a, row, 0) * M(b, 0, column) + M(a, row, 1) * M(b, 1, column) +
+					M(a, row, 2) * M(b, 2, column) + M(a, row, 3) * M(b, 3, column);
+		}
+	}
+}
+
+/* Inverse of a rigid transform: the transposed rotation and the rotated, negated translation */
+static void invert(const double* matrix, double* result) {
+	for (unsigned int row = 0; row < 3; ++row) {
+		for (unsigned int column = 0; column < 3; ++column) {
+			M(result, row, column) = M(matrix, column, row);
+		}
+		M(result, row, 3) = -(M(matrix, 0, row) * M(matrix, 0, 3) + M(matrix, 1, row) * M(matrix, 1, 3) + M(matrix, 2, row) * M(matrix, 2, 3));
+		M(result, 3, row) = 0;
+	}
+	M(result, 3, 3) = 1;
+}
+
+static void setIdentity(double* matrix) {
+	for (unsigned int i = 0; i < 16; ++i) {
+		matrix[i] = ((i % 5) == 0) ? 1.0 : 0.0;
+	}
+}
+
+static void appendMatrix(std::stringstream& reply, const double* matrix) {
+	reply << "\"matrix\": [";
+	for (unsigned int row = 0; row < 4; ++row) {
+		reply << ((row == 0) ? "[" : ", [") << M(matrix, row, 0) << ", " << M(matrix, row, 1) << ", " << M(matrix, row, 2) << ", " << M(matrix, row, 3) << "]";
+	}
+	reply << "]";
+}
+
+void TransformHistory::append(double stamp, const double* matrix) {
+	if ((count == 0) || (stamp >= getStamp(count - 1))) {
+		if (count < capacity) {
+			count++;
+		} else {
+			head = (head + 1) % capacity; // drop the oldest sample
+		}
+		set(count - 1, stamp, matrix);
+		return;
+	}
+
+	/* Out of order: shift the newer samples */
+	unsigned int position = lowerBound(stamp);
+	if ((position == 0) && (count == capacity)) {
+		return; // older than everything in a full ring
+	}
+	if (count < capacity) {
+		count++;
+	} else {
+		head = (head + 1) % capacity;
+		position--;
+	}
+	for (unsigned int index = count - 1; index > position; --index) {
+		unsigned int to = physical(index);
+		unsigned int from = physical(index - 1);
+		stamps[to] = stamps[from];
+		tx[to] = tx[from];
+		ty[to] = ty[from];
+		tz[to] = tz[from];
+		qw[to] = qw[from];
+		qx[to] = qx[from];
+		qy[to] = qy[from];
+		qz[to] = qz[from];
+	}
+	set(position, stamp, matrix);
+}
+
+void TransformHistory::getMatrix(unsigned int index, double* matrix) const {
+	unsigned int i = physical(index);
+	toMatrix(tx[i], ty[i], tz[i], qw[i], qx[i], qy[i], qz[i], matrix);
+}
+
+unsigned int TransformHistory::lowerBound(double stamp) const {
+	unsigned int first = 0;
+	unsigned int length = count;
+	while (length > 0) {
+		unsigned int half = length / 2;
+		if (stamps[physical(first + half)] < stamp) {
+			first += half + 1;
+			length -= half + 1;
+		} else {
+			length = half;
+		}
+	}
+	return first;
+}
+
+bool TransformHistory::interpolate(const double* queryStamps, unsigned int queryCount, double* matrices) const {
+	if (count == 0) {
+		return false;
+	}
+
+	/* Gather the bracketing samples and weights, then blend all components in flat loops */
+	std::vector<unsigned int> lower(queryCount), upper(queryCount);
+	std::vector<double> weights(queryCount);
+	unsigned int index = lowerBound(queryCount > 0 ? queryStamps[0] : 0);
+	for (unsigned int q = 0; q < queryCount; ++q) {
+		while ((index < count) && (getStamp(index) < queryStamps[q])) {
+			index++;
+		}
+		if (index == 0) {
+			lower[q] = upper[q] = physical(0);
+			weights[q] = 0;
+		} else if (index == count) {
+			lower[q] = upper[q] = physical(count - 1);
+			weights[q] = 0;
+		} else {
+			double t0 = getStamp(index - 1);
+			double t1 = getStamp(index);
+			lower[q] = physical(index - 1);
+			upper[q] = physical(index);
+			weights[q] = (t1 > t0) ? (queryStamps[q] - t0) / (t1 - t0) : 0;
+		}
+	}
+
+	std::vector<double> x(queryCount), y(queryCount), z(queryCount), w(queryCount), i(queryCount), j(queryCount), k(queryCount);
+	for (unsigned int q = 0; q < queryCount; ++q) {
+		double a = weights[q];
+		double sign = (qw[lower[q]] * qw[upper[q]] + qx[lower[q]] * qx[upper[q]] + qy[lower[q]] * qy[upper[q]] + qz[lower[q]] * qz[upper[q]]) < 0 ? -1.0 : 1.0;
+		x[q] = (1 - a) * tx[lower[q]] + a * tx[upper[q]];
+		y[q] = (1 - a) * ty[lower[q]] + a * ty[upper[q]];
+		z[q] = (1 - a) * tz[lower[q]] + a * tz[upper[q]];
+		w[q] = (1 - a) * qw[lower[q]] + a * sign * qw[upper[q]];
+		i[q] = (1 - a) * qx[lower[q]] + a * sign * qx[upper[q]];
+		j[q] = (1 - a) * qy[lower[q]] + a * sign * qy[upper[q]];
+		k[q] = (1 - a) * qz[lower[q]] + a * sign * qz[upper[q]];
+	}
+	for (unsigned int q = 0; q < queryCount; ++q) { // normalized linear interpolation of the rotation
+		double norm = sqrt(w[q] * w[q] + i[q] * i[q] + j[q] * j[q] + k[q] * k[q]);
+		toMatrix(x[q], y[q], z[q], w[q] / norm, i[q] / norm, j[q] / norm, k[q] / norm, &matrices[q * 16]);
+	}
+	return true;
+}
+
+static const boost::regex historyQueryPattern("\"query\"\\s*:\\s*\"GET_TRANSFORM_HISTORY\"");
+static const boost::regex transformQueryPattern("\"query\"\\s*:\\s*\"GET_TRANSFORM\"");
+static const boost::regex idPattern("\"id\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex referenceIdPattern("\"idReferenceNode\"\\s*:\\s*\"([^\"]*)\"");
+static const boost::regex intervalPattern("\"interval\"\\s*:\\s*([-+0-9.eE]+)");
+static const boost::regex queryIdPattern("\"queryId\"\\s*:\\s*\"([^\"]*)\"");
+
+/* One store per World Model. Blocks of the same process share it via this library. */
+static boost::mutex storeMutex;
+static std::map<brics_3d::WorldModel*, TransformHistoryStore*> stores;
+
+TransformHistoryStore* TransformHistoryStore::get(brics_3d::WorldModel* wm, unsigned int capacity) {
+	boost::unique_lock<boost::mutex> lock(storeMutex);
+	std::map<brics_3d::WorldModel*, TransformHistoryStore*>::iterator it = stores.find(wm);
+	if (it != stores.end()) {
+		return it->second;
+	}
+	TransformHistoryStore* store = new TransformHistoryStore(wm, capacity); // lives as long as the process
+	stores.insert(std::make_pair(wm, store));
+	return store;
+}
+
+TransformHistoryStore::TransformHistoryStore(brics_3d::WorldModel* wm, unsigned int capacity) :
+		wm(wm), capacity(capacity) {
+	wm->scene.attachUpdateObserver(this);
+
+	/* The existing Transforms start with their latest sample */
+	SceneGraphToUpdatesTraverser traverser(this);
+	wm->scene.executeGraphTraverser(&traverser, wm->getRootNodeId());
+	vector<Id> remoteRootNodeIds;
+	wm->scene.getRemoteRootNodes(remoteRootNodeIds);
+	for (vector<Id>::const_iterator it = remoteRootNodeIds.begin(); it != remoteRootNodeIds.end(); ++it) {
+		traverser.reset();
+		wm->scene.executeGraphTraverser(&traverser, *it);
+	}
+	LOG(INFO) << "TransformHistoryStore: Keeping up to " << capacity << " samples per Transform for " << histories.size() << " Transforms.";
+}
+
+TransformHistoryStore::~TransformHistoryStore() {
+	wm->scene.detachUpdateObserver(this);
+	for (std::map<Id, TransformHistory*>::iterator it = histories.begin(); it != histories.end(); ++it) {
+		delete it->second;
+	}
+}
+
+void TransformHistoryStore::append(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	if (!transform) {
+		return;
+	}
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TransformHistory*>::iterator history = histories.find(id);
+	if (history == histories.end()) {
+		history = histories.insert(std::make_pair(id, new TransformHistory(capacity))).first;
+	}
+	history->second->append(static_cast<double>(timeStamp.getSeconds()), transform->getRawData());
+}
+
+bool TransformHistoryStore::getPose(Id id, double stamp, double* matrix) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TransformHistory*>::const_iterator history = histories.find(id);
+	if ((history == histories.end()) || (history->second->size() == 0)) {
+		return false;
+	}
+	return history->second->interpolate(&stamp, 1, matrix);
+}
+
+bool TransformHistoryStore::getGlobalTransform(Id id, double stamp, double* matrix) {
+	double pose[16];
+	double product[16];
+	vector<Id> parentIds;
+	setIdentity(matrix);
+	Id current = id;
+	while (true) {
+		if (getPose(current, stamp, pose)) { // i.e. a Transform
+			multiply(pose, matrix, product);
+			memcpy(matrix, product, sizeof(product));
+		}
+		parentIds.clear();
+		if (!wm->scene.getNodeParents(current, parentIds)) {
+			return false;
+		}
+		if (parentIds.empty()) {
+			return true; // the root or a remote root node
+		}
+		current = parentIds[0]; // the first path, as for GET_TRANSFORM of the World Model
+	}
+}
+
+bool TransformHistoryStore::getTransformForNode(Id id, Id referenceId, double stamp, double* matrix) {
+	double nodeToRoot[16];
+	double referenceToRoot[16];
+	double rootToReference[16];
+	if (!getGlobalTransform(id, stamp, nodeToRoot) || !getGlobalTransform(referenceId, stamp, referenceToRoot)) {
+		return false;
+	}
+	invert(referenceToRoot, rootToReference);
+	multiply(rootToReference, nodeToRoot, matrix);
+	return true;
+}
+
+bool TransformHistoryStore::getSamples(Id id, double start, double end, std::vector<double>& stamps, std::vector<double>& matrices) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TransformHistory*>::const_iterator history = histories.find(id);
+	if (history == histories.end()) {
+		return false;
+	}
+	const TransformHistory* samples = history->second;
+	for (unsigned int index = samples->lowerBound(start); (index < samples->size()) && (samples->getStamp(index) <= end); ++index) {
+		stamps.push_back(samples->getStamp(index));
+		matrices.resize(matrices.size() + 16);
+		samples->getMatrix(index, &matrices[matrices.size() - 16]);
+	}
+	return true;
+}
+
+bool TransformHistoryStore::getResampled(Id id, double start, double end, double interval, std::vector<double>& stamps, std::vector<double>& matrices) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TransformHistory*>::const_iterator history = histories.find(id);
+	if ((history == histories.end()) || (history->second->size() == 0) || (interval <= 0)) {
+		return false;
+	}
+
+	/* Clamp an open range to the stored samples */
+	const TransformHistory* samples = history->second;
+	start = std::max(start, samples->getStamp(0));
+	end = std::min(end, samples->getStamp(samples->size() - 1));
+	for (double stamp = start; (stamp <= end) && (stamps.size() < capacity); stamp += interval) { // as many as a full history at most
+		stamps.push_back(stamp);
+	}
+	matrices.resize(stamps.size() * 16);
+	return stamps.empty() || samples->interpolate(&stamps[0], static_cast<unsigned int>(stamps.size()), &matrices[0]);
+}
+
+bool TransformHistoryStore::getStamp(const std::string& query, const std::string& key, double& stamp) {
+	boost::regex stampPattern("\"" + key + "\"\\s*:\\s*\\{([^}]*)\\}");
+	boost::smatch match;
+	if (!boost::regex_search(query, match, stampPattern)) {
+		return false;
+	}
+	std::string object = match[1];
+	static const boost::regex msPattern("\"stamp\"\\s*:\\s*([-+0-9.eE]+)");
+	static const boost::regex datePattern("\"stamp\"\\s*:\\s*\"([0-9]+)-([0-9]+)-([0-9]+)T([0-9]+):([0-9]+):([0-9.]+)Z?\"");
+	if (boost::regex_search(object, match, msPattern)) {
+		stamp = atof(match[1].str().c_str()) * 1.0e-3;
+		return true;
+	}
+	if (boost::regex_search(object, match, datePattern)) {
+		struct tm date = {};
+		date.tm_year = atoi(match[1].str().c_str()) - 1900;
+		date.tm_mon = atoi(match[2].str().c_str()) - 1;
+		date.tm_mday = atoi(match[3].str().c_str());
+		date.tm_hour = atoi(match[4].str().c_str());
+		date.tm_min = atoi(match[5].str().c_str());
+		double seconds = atof(match[6].str().c_str());
+		date.tm_sec = static_cast<int>(seconds);
+		stamp = static_cast<double>(timegm(&date)) + (seconds - date.tm_sec);
+		return true;
+	}
+	return false;
+}
+
+bool TransformHistoryStore::isHistoryQuery(const std::string& query) {
+	return boost::regex_search(query, historyQueryPattern);
+}
+
+bool TransformHistoryStore::isTransformQuery(const std::string& query) {
+	double stamp;
+	return boost::regex_search(query, transformQueryPattern) && getStamp(query, "timeStamp", stamp);
+}
+
+bool TransformHistoryStore::hasReferenceNode(const std::string& query) {
+	return boost::regex_search(query, referenceIdPattern);
+}
+
+bool TransformHistoryStore::handleTransformQuery(const std::string& query, std::string& result) {
+	boost::smatch match;
+	Id id;
+	Id referenceId;
+	double stamp;
+	if (!boost::regex_search(query, match, idPattern) || !id.fromString(match[1]) ||
+			!boost::regex_search(query, match, referenceIdPattern) || !referenceId.fromString(match[1]) ||
+			!getStamp(query, "timeStamp", stamp)) {
+		return false; // the World Model reports the error
+	}
+	double matrix[16];
+	if (!getTransformForNode(id, referenceId, stamp, matrix)) {
+		return false;
+	}
+
+	std::stringstream reply;
+	reply << std::setprecision(15);
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"GET_TRANSFORM\", ";
+	if (boost::regex_search(query, match, queryIdPattern)) {
+		reply << "\"queryId\": \"" << match[1] << "\", ";
+	}
+	reply << "\"querySuccess\": true, \"transform\": {\"type\": \"HomogeneousMatrix44\", ";
+	appendMatrix(reply, matrix);
+	reply << ", \"unit\": \"m\"}}";
+	result = reply.str();
+	return true;
+}
+
+bool TransformHistoryStore::handleQuery(const std::string& query, std::string& result) {
+	boost::smatch match;
+	Id id;
+	bool success = false;
+	std::vector<double> stamps;
+	std::vector<double> matrices;
+
+	if (!boost::regex_search(query, match, idPattern) || !id.fromString(match[1])) {
+		LOG(ERROR) << "TransformHistoryStore: GET_TRANSFORM_HISTORY requires the id of a Transform.";
+	} else {
+		double start = -std::numeric_limits<double>::max();
+		double end = std::numeric_limits<double>::max();
+		getStamp(query, "start", start);
+		getStamp(query, "end", end);
+		if (boost::regex_search(query, match, intervalPattern)) {
+			success = getResampled(id, start, end, atof(match[1].str().c_str()), stamps, matrices);
+		} else {
+			success = getSamples(id, start, end, stamps, matrices);
+		}
+		if (!success) {
+			LOG(WARNING) << "TransformHistoryStore: No history for Transform " << id;
+		}
+
+		/* Poses relative to a reference node at the stamps of the history */
+		Id referenceId;
+		if (success && boost::regex_search(query, match, referenceIdPattern)) {
+			if (!referenceId.fromString(match[1])) {
+				LOG(ERROR) << "TransformHistoryStore: Invalid idReferenceNode " << match[1];
+				success = false;
+			}
+			for (unsigned int s = 0; success && (s < stamps.size()); ++s) {
+				success = getTransformForNode(id, referenceId, stamps[s], &matrices[s * 16]);
+			}
+			if (!success) {
+				stamps.clear();
+			}
+		}
+	}
+
+	std::stringstream reply;
+	reply << std::setprecision(15);
+	reply << "{\"@worldmodeltype\": \"RSGQueryResult\", \"query\": \"GET_TRANSFORM_HISTORY\", ";
+	if (boost::regex_search(query, match, queryIdPattern)) {
+		reply << "\"queryId\": \"" << match[1] << "\", ";
+	}
+	reply << "\"querySuccess\": " << (success ? "true" : "false") << ", \"history\": [";
+	for (unsigned int s = 0; s < stamps.size(); ++s) {
+		const double* matrix = &matrices[s * 16];
+		reply << ((s == 0) ? "" : ", ") << "{\"stamp\": {\"@stamptype\": \"TimeStampUTCms\", \"stamp\": " << stamps[s] * 1.0e3 << "}, "
+				<< "\"transform\": {\"type\": \"HomogeneousMatrix44\", ";
+		appendMatrix(reply, matrix);
+		reply << "}}";
+	}
+	reply << "]}";
+	result = reply.str();
+	return success;
+}
+
+bool TransformHistoryStore::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return true;
+}
+
+bool TransformHistoryStore::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return true;
+}
+
+bool TransformHistoryStore::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	append(assignedId, transform, timeStamp);
+	return true;
+}
+
+bool TransformHistoryStore::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	append(assignedId, transform, timeStamp);
+	return true;
+}
+
+bool TransformHistoryStore::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	return true;
+}
+
+bool TransformHistoryStore::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	return true;
+}
+
+bool TransformHistoryStore::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	return true;
+}
+
+bool TransformHistoryStore::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	return true;
+}
+
+bool TransformHistoryStore::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	append(id, transform, timeStamp);
+	return true;
+}
+
+bool TransformHistoryStore::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	append(id, transform, timeStamp);
+	return true;
+}
+
+bool TransformHistoryStore::deleteNode(Id id) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<Id, TransformHistory*>::iterator history = histories.find(id);
+	if (history != histories.end()) {
+		delete history->second;
+		histories.erase(history);
+	}
+	return true;
+}
+
+bool TransformHistoryStore::addParent(Id id, Id parentId) {
+	return true;
+}
+
+bool TransformHistoryStore::removeParent(Id id, Id parentId) {
+	return true;
+}
+
+} // namespace rsg_bridge
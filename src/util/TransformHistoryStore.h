@@ -0,0 +1,151 @@
+/*
+ * Compact histories of Transform updates.
+ */
+
+#ifndef RSG_BRIDGE_TRANSFORMHISTORYSTORE_H_
+#define RSG_BRIDGE_TRANSFORMHISTORYSTORE_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Fixed capacity ring of stamped poses with one contiguous array per component.
+ *
+ * Rotations are stored as unit quaternions. Stamps are in seconds and kept in
+ * ascending order, so samples are found by binary search.
+ */
+class TransformHistory {
+public:
+	TransformHistory(unsigned int capacity);
+
+	/// Add a sample given as column-major homogeneous matrix. The oldest sample is dropped if the ring is full.
+	void append(double stamp, const double* matrix);
+
+	unsigned int size() const { return count; }
+	double getStamp(unsigned int index) const { return stamps[physical(index)]; }
+	void getMatrix(unsigned int index, double* matrix) const;
+
+	/// Index of the first sample with a stamp >= the given one. Returns size() if there is none.
+	unsigned int lowerBound(double stamp) const;
+
+	/// Interpolated pose at the given stamps (ascending). Stamps outside of the history are clamped.
+	bool interpolate(const double* queryStamps, unsigned int queryCount, double* matrices) const;
+
+private:
+	unsigned int physical(unsigned int index) const { return (head + index) % capacity; }
+	void set(unsigned int index, double stamp, const double* matrix);
+
+	unsigned int capacity;
+	unsigned int head;  // physical index of the oldest sample
+	unsigned int count;
+	std::vector<double> stamps;
+	std::vector<double> tx, ty, tz;
+	std::vector<double> qw, qx, qy, qz;
+};
+
+/**
+ * @brief Histories of all Transforms of a World Model.
+ *
+ * The store observes the scene and appends every new or updated Transform to a
+ * TransformHistory of fixed capacity. It is shared by all blocks via
+ * TransformHistoryStore::get() and answers GET_TRANSFORM_HISTORY queries:
+ * @code
+ * {
+ *   "@worldmodeltype": "RSGQuery",
+ *   "query": "GET_TRANSFORM_HISTORY",
+ *   "id": "<uuid of a Transform>",
+ *   "start": {"@stamptype": "TimeStampUTCms", "stamp": 1464686442000.0}, // optional
+ *   "end": {"@stamptype": "TimeStampUTCms", "stamp": 1464686452000.0},   // optional
+ *   "interval": 0.5 // optional, resample every 0.5 s instead of returning the stored samples
+ * }
+ * @endcode
+ * Stamps of type TimeStampDate are accepted as well. The reply holds the samples
+ * as "history" in the format of an UPDATE_TRANSFORM message. With an additional
+ * "idReferenceNode" the samples are the poses relative to that node, like the ones
+ * of the posehistory function block.
+ *
+ * GET_TRANSFORM queries with a "timeStamp" are answered from the store as well, so the
+ * temporal caches of the World Model only need to cover the latest samples (cf.
+ * tf:max_duration). The poses along the path to the root are interpolated from the
+ * histories; nodes without a history are no Transforms. The existing Transforms are
+ * added with their latest sample when the store is created.
+ *
+ * The store has its own lock. Queries that follow the paths to a reference node also
+ * need the read lock of the World Model, the others do not.
+ */
+class TransformHistoryStore : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+
+	/// Get the store for a World Model. It is created and attached to the scene on first use.
+	static TransformHistoryStore* get(brics_3d::WorldModel* wm, unsigned int capacity);
+
+	/// True for GET_TRANSFORM_HISTORY queries.
+	static bool isHistoryQuery(const std::string& query);
+
+	/// True for GET_TRANSFORM queries with a timeStamp.
+	static bool isTransformQuery(const std::string& query);
+
+	/// True for queries with an idReferenceNode, i.e. the caller has to hold the read lock of the World Model.
+	static bool hasReferenceNode(const std::string& query);
+
+	/// Process a GET_TRANSFORM_HISTORY query and create the RSGQueryResult.
+	bool handleQuery(const std::string& query, std::string& result);
+
+	/// Process a GET_TRANSFORM query with a timeStamp. Returns false if the store cannot answer it, e.g. for an unknown node.
+	bool handleTransformQuery(const std::string& query, std::string& result);
+
+	/// Pose of a node relative to the reference node, composed from the histories. The caller holds the read lock of the World Model.
+	bool getTransformForNode(brics_3d::rsg::Id id, brics_3d::rsg::Id referenceId, double stamp, double* matrix);
+
+	/// Stored samples of a Transform within [start, end]. Stamps are in seconds.
+	bool getSamples(brics_3d::rsg::Id id, double start, double end, std::vector<double>& stamps, std::vector<double>& matrices);
+
+	/// Interpolated samples of a Transform for every interval within [start, end].
+	bool getResampled(brics_3d::rsg::Id id, double start, double end, double interval, std::vector<double>& stamps, std::vector<double>& matrices);
+
+	unsigned int getCapacity() const { return capacity; }
+
+	/// Parse the TimeStampUTCms or TimeStampDate object with the given key of a query into seconds.
+	static bool getStamp(const std::string& query, const std::string& key, double& stamp);
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	TransformHistoryStore(brics_3d::WorldModel* wm, unsigned int capacity);
+	virtual ~TransformHistoryStore();
+
+	void append(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool getPose(brics_3d::rsg::Id id, double stamp, double* matrix);
+	bool getGlobalTransform(brics_3d::rsg::Id id, double stamp, double* matrix);
+
+	brics_3d::WorldModel* wm;
+	unsigned int capacity;
+
+	boost::mutex mutex;
+	std::map<brics_3d::rsg::Id, TransformHistory*> histories;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_TRANSFORMHISTORYSTORE_H_ */
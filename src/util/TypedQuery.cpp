@@ -0,0 +1,148 @@
+#include "TypedQuery.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+/* Fixed size strings of the requests are not necessarily terminated */
+template <size_t size>
+static std::string toString(const char (&text)[size]) {
+	return std::string(text, strnlen(text, size));
+}
+
+template <size_t size>
+static void copy(const std::string& source, char (&target)[size]) {
+	size_t length = std::min(source.size(), size - 1);
+	memcpy(target, source.c_str(), length);
+	target[length] = '\0';
+}
+
+static TimeStamp toTimeStamp(brics_3d::WorldModel* wm, double stamp) {
+	return (stamp > 0) ? TimeStamp(stamp, brics_3d::Units::Second) : wm->now();
+}
+
+static std::vector<Attribute> toAttributes(const rsg_typed_request& request) {
+	std::vector<Attribute> attributes;
+	for (uint32_t i = 0; (i < request.attribute_count) && (i < sizeof(request.attributes) / sizeof(request.attributes[0])); ++i) {
+		attributes.push_back(Attribute(toString(request.attributes[i].key), toString(request.attributes[i].value)));
+	}
+	return attributes;
+}
+
+static void initReply(const rsg_typed_request& request, rsg_typed_reply& reply) {
+	memset(&reply, 0, sizeof(reply));
+	reply.request_id = request.request_id;
+	reply.operation = request.operation;
+}
+
+bool TypedQuery::isUpdate(const rsg_typed_request& request) {
+	return request.operation >= RSG_TYPED_ADD_NODE;
+}
+
+void TypedQuery::query(brics_3d::WorldModel* wm, const rsg_typed_request& request, rsg_typed_reply& reply) {
+	initReply(request, reply);
+	Id id;
+	Id referenceId;
+	id.fromString(toString(request.id)); // stays nil if not given
+	referenceId.fromString(toString(request.reference_id));
+	bool success = false;
+
+	switch (request.operation) {
+	case RSG_TYPED_GET_NODES: {
+		std::vector<Id> ids;
+		success = wm->scene.getNodes(toAttributes(request), ids);
+		const uint32_t capacity = sizeof(reply.ids) / sizeof(reply.ids[0]);
+		for (unsigned int i = 0; i < ids.size(); ++i) {
+			if (reply.id_count < capacity) {
+				copy(ids[i].toString(), reply.ids[reply.id_count++]);
+			} else {
+				reply.truncated++;
+			}
+		}
+		break;
+	}
+	case RSG_TYPED_GET_NODE_ATTRIBUTES: {
+		std::vector<Attribute> attributes;
+		success = wm->scene.getNodeAttributes(id, attributes);
+		const uint32_t capacity = sizeof(reply.attributes) / sizeof(reply.attributes[0]);
+		for (unsigned int i = 0; i < attributes.size(); ++i) {
+			if (reply.attribute_count < capacity) {
+				copy(attributes[i].key, reply.attributes[reply.attribute_count].key);
+				copy(attributes[i].value, reply.attributes[reply.attribute_count].value);
+				reply.attribute_count++;
+			} else {
+				reply.truncated++;
+			}
+		}
+		break;
+	}
+	case RSG_TYPED_GET_TRANSFORM: {
+		brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+		success = wm->scene.getTransformForNode(id, referenceId, toTimeStamp(wm, request.time_stamp), transform);
+		if (success) {
+			memcpy(reply.transform, transform->getRawData(), sizeof(reply.transform));
+		}
+		break;
+	}
+	default:
+		LOG(WARNING) << "TypedQuery: Unknown query operation " << request.operation;
+		break;
+	}
+	reply.success = success ? 1 : 0;
+}
+
+void TypedQuery::update(brics_3d::WorldModel* wm, brics_3d::rsg::ISceneGraphUpdateObserver* updater, const rsg_typed_request& request, rsg_typed_reply& reply) {
+	initReply(request, reply);
+	Id id;
+	id.fromString(toString(request.id));
+	bool success = false;
+
+	switch (request.operation) {
+	case RSG_TYPED_ADD_NODE: {
+		Id assignedId;
+		success = updater->addNode(id, assignedId, toAttributes(request));
+		if (success) {
+			copy(assignedId.toString(), reply.ids[0]);
+			reply.id_count = 1;
+		}
+		break;
+	}
+	case RSG_TYPED_ADD_TRANSFORM_NODE: {
+		Id assignedId;
+		brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+		memcpy(transform->setRawData(), request.transform, sizeof(request.transform));
+		success = updater->addTransformNode(id, assignedId, toAttributes(request), transform, toTimeStamp(wm, request.time_stamp));
+		if (success) {
+			copy(assignedId.toString(), reply.ids[0]);
+			reply.id_count = 1;
+		}
+		break;
+	}
+	case RSG_TYPED_UPDATE_ATTRIBUTES:
+		success = updater->setNodeAttributes(id, toAttributes(request), toTimeStamp(wm, request.time_stamp));
+		break;
+	case RSG_TYPED_UPDATE_TRANSFORM: {
+		brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform(new brics_3d::HomogeneousMatrix44());
+		memcpy(transform->setRawData(), request.transform, sizeof(request.transform));
+		success = updater->setTransform(id, transform, toTimeStamp(wm, request.time_stamp));
+		break;
+	}
+	case RSG_TYPED_DELETE_NODE:
+		success = updater->deleteNode(id);
+		break;
+	default:
+		LOG(WARNING) << "TypedQuery: Unknown update operation " << request.operation;
+		break;
+	}
+	reply.success = success ? 1 : 0;
+}
+
+} // namespace rsg_bridge
@@ -0,0 +1,42 @@
+/*
+ * Typed queries and updates for function blocks in the same process.
+ */
+
+#ifndef RSG_BRIDGE_TYPEDQUERY_H_
+#define RSG_BRIDGE_TYPEDQUERY_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <stdint.h>
+#include "../types/rsg_typed_query.h"
+
+namespace rsg_bridge {
+
+/**
+ * @brief Processes the typed requests of rsg_typed_query.h.
+ *
+ * The requests map directly to the scene graph API, so neither the caller nor
+ * the query block builds or parses RSG-JSON. Queries are answered by query(),
+ * updates by update(). The caller takes the same locks as for RSG-JSON messages,
+ * i.e. the read lock (or a pinned version) for queries and the write lock for updates.
+ */
+class TypedQuery {
+public:
+
+	/// True for operations that modify the World Model.
+	static bool isUpdate(const rsg_typed_request& request);
+
+	/// Answer a query. Has to be called under the read lock of the World Model.
+	static void query(brics_3d::WorldModel* wm, const rsg_typed_request& request, rsg_typed_reply& reply);
+
+	/**
+	 * Apply an update. Has to be called under the write lock of the World Model.
+	 * @param updater Receives the update, e.g. a constraint filter in front of the World Model.
+	 */
+	static void update(brics_3d::WorldModel* wm, brics_3d::rsg::ISceneGraphUpdateObserver* updater, const rsg_typed_request& request, rsg_typed_reply& reply);
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_TYPEDQUERY_H_ */
@@ -0,0 +1,202 @@
+#include "WorldModelAccess.h"
+
+#include <brics_3d/core/Logger.h>
+
+#include <sstream>
+#include <cstring>
+#include <cassert>
+#include <time.h>
+
+using brics_3d::Logger;
+
+namespace rsg_bridge {
+
+/* One access object per World Model. Blocks of the same process share it via this library. */
+static boost::mutex registryMutex;
+static std::map<brics_3d::WorldModel*, WorldModelAccess*> registry;
+
+WorldModelAccess* WorldModelAccess::get(brics_3d::WorldModel* wm) {
+	boost::unique_lock<boost::mutex> lock(registryMutex);
+	std::map<brics_3d::WorldModel*, WorldModelAccess*>::iterator it = registry.find(wm);
+	if (it != registry.end()) {
+		return it->second;
+	}
+	WorldModelAccess* access = new WorldModelAccess(wm); // lives as long as the process
+	registry.insert(std::make_pair(wm, access));
+	LOG(DEBUG) << "WorldModelAccess: Created access for world model with root Id " << wm->getRootNodeId();
+	return access;
+}
+
+WorldModelAccess::WorldModelAccess(brics_3d::WorldModel* wm) :
+		wm(wm), isWriterActive(false), writerDepth(0), waitingWriters(0), isUpgradePending(false), writeLockStart(0) {
+	resetStatistics();
+}
+
+WorldModelAccess::~WorldModelAccess() {
+
+}
+
+double WorldModelAccess::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+void WorldModelAccess::lockRead() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	boost::thread::id self = boost::this_thread::get_id();
+	std::map<boost::thread::id, unsigned int>::iterator reader = readerDepths.find(self);
+
+	/* nested locks never wait */
+	if (reader != readerDepths.end()) {
+		reader->second++;
+		return;
+	}
+	if (isWriterActive && (writerId == self)) {
+		readerDepths[self] = 1;
+		return;
+	}
+
+	statistics.readLockCount++;
+	if (isWriterActive || (waitingWriters > 0)) { // writer preference
+		double start = now();
+		while (isWriterActive || (waitingWriters > 0)) {
+			readersAllowed.wait(lock);
+		}
+		double waitTime = now() - start;
+		statistics.contendedReadLockCount++;
+		statistics.readWaitTime += waitTime;
+		if (waitTime > statistics.maxReadWaitTime) {
+			statistics.maxReadWaitTime = waitTime;
+		}
+	}
+	readerDepths[self] = 1;
+}
+
+void WorldModelAccess::unlockRead() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	std::map<boost::thread::id, unsigned int>::iterator reader = readerDepths.find(boost::this_thread::get_id());
+	if (reader == readerDepths.end()) {
+		LOG(ERROR) << "WorldModelAccess: Read lock released by a thread that does not hold it.";
+		return;
+	}
+	if (--reader->second == 0) {
+		readerDepths.erase(reader);
+		if (waitingWriters > 0) {
+			writerAllowed.notify_all();
+		}
+	}
+}
+
+bool WorldModelAccess::lockWrite() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	boost::thread::id self = boost::this_thread::get_id();
+	if (isWriterActive && (writerId == self)) {
+		writerDepth++;
+		return true;
+	}
+
+	/*
+	 * A reader that wants to write only waits for the other readers. Two of them would
+	 * wait for each other forever, so only one upgrade at a time is allowed.
+	 */
+	unsigned int ownReadLocks = (readerDepths.find(self) != readerDepths.end()) ? 1 : 0;
+	if (ownReadLocks > 0) {
+		if (isUpgradePending) {
+			LOG(ERROR) << "WorldModelAccess: Another reader is upgrading to the write lock. Rejecting this upgrade, as both would wait forever.";
+			assert(false && "concurrent upgrades of read locks");
+			return false;
+		}
+		isUpgradePending = true;
+	}
+	statistics.writeLockCount++;
+	if (isWriterActive || (readerDepths.size() > ownReadLocks)) {
+		double start = now();
+		waitingWriters++;
+		while (isWriterActive || (readerDepths.size() > ownReadLocks)) {
+			writerAllowed.wait(lock);
+		}
+		waitingWriters--;
+		double waitTime = now() - start;
+		statistics.contendedWriteLockCount++;
+		statistics.writeWaitTime += waitTime;
+		if (waitTime > statistics.maxWriteWaitTime) {
+			statistics.maxWriteWaitTime = waitTime;
+		}
+	}
+	if (ownReadLocks > 0) {
+		isUpgradePending = false;
+	}
+	isWriterActive = true;
+	writerId = self;
+	writerDepth = 1;
+	writeLockStart = now();
+	return true;
+}
+
+void WorldModelAccess::unlockWrite() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if (!isWriterActive || (writerId != boost::this_thread::get_id())) {
+		LOG(ERROR) << "WorldModelAccess: Write lock released by a thread that does not hold it.";
+		return;
+	}
+	if (--writerDepth > 0) {
+		return;
+	}
+
+	double holdTime = now() - writeLockStart;
+	statistics.writeHoldTime += holdTime;
+	if (holdTime > statistics.maxWriteHoldTime) {
+		statistics.maxWriteHoldTime = holdTime;
+	}
+	isWriterActive = false;
+	writerId = boost::thread::id();
+	if (waitingWriters > 0) {
+		writerAllowed.notify_all();
+	} else {
+		readersAllowed.notify_all();
+	}
+}
+
+WorldModelAccessStatistics WorldModelAccess::getStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	WorldModelAccessStatistics result = statistics;
+	result.activeReaders = static_cast<unsigned int>(readerDepths.size());
+	result.waitingWriters = waitingWriters;
+	return result;
+}
+
+void WorldModelAccess::resetStatistics() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	memset(&statistics, 0, sizeof(statistics));
+}
+
+std::string WorldModelAccess::getStatisticsAsJSON() {
+	WorldModelAccessStatistics current = getStatistics();
+	std::stringstream result;
+	result << "{"
+			<< "\"readLockCount\": " << current.readLockCount << ", "
+			<< "\"writeLockCount\": " << current.writeLockCount << ", "
+			<< "\"contendedReadLockCount\": " << current.contendedReadLockCount << ", "
+			<< "\"contendedWriteLockCount\": " << current.contendedWriteLockCount << ", "
+			<< "\"readWaitTime\": " << current.readWaitTime << ", "
+			<< "\"writeWaitTime\": " << current.writeWaitTime << ", "
+			<< "\"maxReadWaitTime\": " << current.maxReadWaitTime << ", "
+			<< "\"maxWriteWaitTime\": " << current.maxWriteWaitTime << ", "
+			<< "\"writeHoldTime\": " << current.writeHoldTime << ", "
+			<< "\"maxWriteHoldTime\": " << current.maxWriteHoldTime << ", "
+			<< "\"activeReaders\": " << current.activeReaders << ", "
+			<< "\"waitingWriters\": " << current.waitingWriters
+			<< "}";
+	return result.str();
+}
+
+} // namespace rsg_bridge
+
+void rsg_bridge_lock_write(void* wm) {
+	rsg_bridge::WorldModelAccess::get(reinterpret_cast<brics_3d::WorldModel*>(wm))->lockWrite();
+}
+
+void rsg_bridge_unlock_write(void* wm) {
+	rsg_bridge::WorldModelAccess::get(reinterpret_cast<brics_3d::WorldModel*>(wm))->unlockWrite();
+}
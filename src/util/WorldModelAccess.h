@@ -0,0 +1,140 @@
+/*
+ * Synchronized access to a World Model that is shared by several function blocks.
+ */
+
+#ifndef RSG_BRIDGE_WORLDMODELACCESS_H_
+#define RSG_BRIDGE_WORLDMODELACCESS_H_
+
+#include <brics_3d/worldModel/WorldModel.h>
+
+#include <boost/thread.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <map>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Contention metrics of a WorldModelAccess.
+ *
+ * Only the outermost lock of a thread is counted. Times are in seconds.
+ */
+struct WorldModelAccessStatistics {
+	uint64_t readLockCount;
+	uint64_t writeLockCount;
+	uint64_t contendedReadLockCount;  // the reader had to wait
+	uint64_t contendedWriteLockCount; // the writer had to wait
+	double readWaitTime;
+	double writeWaitTime;
+	double maxReadWaitTime;
+	double maxWriteWaitTime;
+	double writeHoldTime;
+	double maxWriteHoldTime;
+	unsigned int activeReaders;
+	unsigned int waitingWriters;
+};
+
+/**
+ * @brief Reader/writer lock for a World Model with writer preference.
+ *
+ * All function blocks that share the same World Model get the same instance via
+ * WorldModelAccess::get(). Updates (including the triggered update observers) have
+ * to be performed under the write lock, queries and traversals under the read lock.
+ * Then every block can be triggered by its own thread.
+ *
+ * The lock is reentrant: a thread that holds the write lock can acquire the read and
+ * write lock again and a reader can acquire further read locks even if writers are
+ * waiting. A reader can upgrade to the write lock, but only one at a time: a second
+ * reader that tries to upgrade while the first one waits is rejected (lockWrite()
+ * returns false and asserts), as both would wait for each other forever.
+ *
+ * Hard constraint: the lock only protects the World Model if every mutator takes it.
+ * Several blocks read or serialize the World Model on their own threads (query server
+ * workers, shared memory server, timers of the sender and of continuous queries). Code
+ * that does not belong to this package (the wm: Lua API, blocks like the osm loader) does
+ * not know this lock. Such mutators have to run under rsg_bridge_lock_write() and
+ * rsg_bridge_unlock_write(), e.g. via with_wm_write_lock() of the SHERPA compositions,
+ * or only while no other block is running.
+ */
+class WorldModelAccess {
+public:
+
+	/// Get the access object for a World Model. It is created on first use.
+	static WorldModelAccess* get(brics_3d::WorldModel* wm);
+
+	brics_3d::WorldModel* getWorldModel() { return wm; }
+
+	void lockRead();
+	void unlockRead();
+
+	/// Returns false (without the lock) only for a rejected upgrade of a read lock.
+	bool lockWrite();
+	void unlockWrite();
+
+	WorldModelAccessStatistics getStatistics();
+	void resetStatistics();
+
+	/// Statistics as JSON object, e.g. to be returned as query result.
+	std::string getStatisticsAsJSON();
+
+private:
+	WorldModelAccess(brics_3d::WorldModel* wm);
+	virtual ~WorldModelAccess();
+
+	static double now();
+
+	brics_3d::WorldModel* wm;
+
+	boost::mutex mutex;
+	boost::condition_variable readersAllowed;
+	boost::condition_variable writerAllowed;
+	std::map<boost::thread::id, unsigned int> readerDepths; // per thread with an active read lock
+	bool isWriterActive;
+	boost::thread::id writerId;
+	unsigned int writerDepth;
+	unsigned int waitingWriters;
+	bool isUpgradePending; // a reader waits for the write lock
+	double writeLockStart;
+
+	WorldModelAccessStatistics statistics;
+};
+
+/// Scoped read lock.
+class WorldModelReadLock {
+public:
+	WorldModelReadLock(WorldModelAccess* access) : access(access) {
+		access->lockRead();
+	}
+	virtual ~WorldModelReadLock() {
+		access->unlockRead();
+	}
+private:
+	WorldModelAccess* access;
+};
+
+/// Scoped write lock.
+class WorldModelWriteLock {
+public:
+	WorldModelWriteLock(WorldModelAccess* access) : access(access) {
+		isLocked = access->lockWrite();
+	}
+	virtual ~WorldModelWriteLock() {
+		if (isLocked) {
+			access->unlockWrite();
+		}
+	}
+private:
+	WorldModelAccess* access;
+	bool isLocked;
+};
+
+} // namespace rsg_bridge
+
+/* C interface, e.g. for the LuaJIT ffi of a system composition. wm is a brics_3d::WorldModel* as in rsg_wm_handle. */
+extern "C" {
+void rsg_bridge_lock_write(void* wm);
+void rsg_bridge_unlock_write(void* wm);
+}
+
+#endif /* RSG_BRIDGE_WORLDMODELACCESS_H_ */
@@ -0,0 +1,270 @@
+#include "WorldModelVersions.h"
+#include "SnapshotWriter.h"
+#include "SnapshotReader.h"
+
+#include <brics_3d/core/Logger.h>
+#include <brics_3d/core/HomogeneousMatrix44.h>
+#include <brics_3d/worldModel/sceneGraph/UuidGenerator.h>
+
+#include <boost/bind.hpp>
+
+#include <cstring>
+
+using brics_3d::Logger;
+using namespace brics_3d::rsg;
+
+namespace rsg_bridge {
+
+WorldModelVersions::WorldModelVersions(WorldModelAccess* access, unsigned int versionCount, unsigned int maxLogSize) :
+		access(access), logStartSequence(0), nextSequence(0), maxLogSize(maxLogSize) {
+	if (versionCount < 1) {
+		versionCount = 1;
+	}
+
+	/* Copy the current graph and start recording without any update in between */
+	std::vector<char> snapshot;
+	{
+		WorldModelWriteLock lock(access);
+		SnapshotWriter writer;
+		writer.capture(access->getWorldModel());
+		if (!writer.write(snapshot)) {
+			LOG(ERROR) << "WorldModelVersions: Cannot copy the World Model. The versions start empty.";
+		}
+		access->getWorldModel()->scene.attachUpdateObserver(this);
+	}
+
+	Id rootId = access->getWorldModel()->getRootNodeId();
+	SnapshotReader reader;
+	reader.open(snapshot.empty() ? 0 : &snapshot[0], snapshot.size());
+	for (unsigned int i = 0; i < versionCount; ++i) {
+		Version version;
+		version.wm = new brics_3d::WorldModel(new UuidGenerator(rootId));
+		version.appliedSequence = 0;
+		version.pinCount = 0;
+		version.isUpdating = false;
+		version.isStale = false;
+		reader.apply(version.wm, true);
+		versions.push_back(version);
+	}
+	LOG(INFO) << "WorldModelVersions: Created " << versionCount << " versions.";
+}
+
+WorldModelVersions::~WorldModelVersions() {
+	{
+		WorldModelWriteLock lock(access);
+		access->getWorldModel()->scene.detachUpdateObserver(this);
+	}
+	boost::unique_lock<boost::mutex> lock(mutex);
+	for (unsigned int i = 0; i < versions.size(); ++i) {
+		if (versions[i].pinCount > 0) {
+			LOG(WARNING) << "WorldModelVersions: Version " << i << " is still pinned while it is deleted.";
+		}
+		delete versions[i].wm;
+	}
+	versions.clear();
+	log.clear();
+}
+
+unsigned int WorldModelVersions::pin() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	while (true) {
+		uint64_t latestSequence = nextSequence;
+
+		/* An up to date version can be shared */
+		for (unsigned int i = 0; i < versions.size(); ++i) {
+			if (!versions[i].isUpdating && (versions[i].appliedSequence == latestSequence)) {
+				versions[i].pinCount++;
+				return i;
+			}
+		}
+
+		/* Otherwise advance the oldest version that is not in use, so the log can be reclaimed */
+		int freeIndex = -1;
+		for (unsigned int i = 0; i < versions.size(); ++i) {
+			if (!versions[i].isUpdating && (versions[i].pinCount == 0) &&
+				((freeIndex < 0) || (versions[i].appliedSequence < versions[freeIndex].appliedSequence))) {
+				freeIndex = i;
+			}
+		}
+		if (freeIndex >= 0) {
+			Version& version = versions[freeIndex];
+			version.isUpdating = true;
+			version.pinCount = 1;
+			if (version.isStale) {
+				rebuild(version, lock);
+				version.isUpdating = false;
+				reclaimLog();
+				versionUpdated.notify_all();
+				return freeIndex;
+			}
+			std::vector<UpdatePtr> pendingUpdates(log.begin() + (version.appliedSequence - logStartSequence), log.end());
+
+			lock.unlock(); // updates continue to be recorded while this version is advanced
+			for (std::vector<UpdatePtr>::const_iterator it = pendingUpdates.begin(); it != pendingUpdates.end(); ++it) {
+				(**it)(&version.wm->scene);
+			}
+			lock.lock();
+
+			version.appliedSequence = latestSequence;
+			version.isUpdating = false;
+			reclaimLog();
+			versionUpdated.notify_all();
+			return freeIndex;
+		}
+
+		/* All versions are in use: share the most recent one */
+		int recentIndex = -1;
+		for (unsigned int i = 0; i < versions.size(); ++i) {
+			if (!versions[i].isUpdating &&
+				((recentIndex < 0) || (versions[i].appliedSequence > versions[recentIndex].appliedSequence))) {
+				recentIndex = i;
+			}
+		}
+		if (recentIndex >= 0) {
+			LOG(DEBUG) << "WorldModelVersions: All versions are in use. Sharing a version that lags "
+					<< latestSequence - versions[recentIndex].appliedSequence << " updates behind.";
+			versions[recentIndex].pinCount++;
+			return recentIndex;
+		}
+
+		/* Only other readers are updating versions right now */
+		versionUpdated.wait(lock);
+	}
+}
+
+void WorldModelVersions::unpin(unsigned int index) {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if ((index >= versions.size()) || (versions[index].pinCount == 0)) {
+		LOG(ERROR) << "WorldModelVersions: Version " << index << " is not pinned.";
+		return;
+	}
+	versions[index].pinCount--;
+	reclaimLog();
+}
+
+unsigned int WorldModelVersions::getLogSize() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return static_cast<unsigned int>(log.size());
+}
+
+void WorldModelVersions::reclaimLog() {
+	uint64_t oldestSequence = nextSequence;
+	for (unsigned int i = 0; i < versions.size(); ++i) {
+		if (!versions[i].isStale && (versions[i].appliedSequence < oldestSequence)) {
+			oldestSequence = versions[i].appliedSequence;
+		}
+	}
+	while (logStartSequence < oldestSequence) {
+		log.pop_front();
+		logStartSequence++;
+	}
+}
+
+bool WorldModelVersions::record(const Update& update) {
+	UpdatePtr entry(new Update(update));
+	boost::unique_lock<boost::mutex> lock(mutex);
+	log.push_back(entry);
+	nextSequence++;
+
+	if (log.size() > maxLogSize) {
+		LOG(WARNING) << "WorldModelVersions: More than " << maxLogSize << " updates recorded. Discarding them; versions will be rebuilt.";
+		for (unsigned int i = 0; i < versions.size(); ++i) {
+			versions[i].isStale = true;
+		}
+	}
+	reclaimLog();
+	return true;
+}
+
+void WorldModelVersions::rebuild(Version& version, boost::unique_lock<boost::mutex>& lock) {
+	version.isStale = false; // record() marks it again if the log overflows while it is rebuilt
+	lock.unlock();
+
+	std::vector<char> snapshot;
+	uint64_t snapshotSequence;
+	{
+		WorldModelReadLock accessLock(access); // no update is recorded while the copy is taken
+		SnapshotWriter writer;
+		writer.capture(access->getWorldModel());
+		if (!writer.write(snapshot)) {
+			LOG(ERROR) << "WorldModelVersions: Cannot copy the World Model. The rebuilt version is empty.";
+		}
+		boost::unique_lock<boost::mutex> sequenceLock(mutex);
+		snapshotSequence = nextSequence;
+	}
+
+	brics_3d::WorldModel* wm = new brics_3d::WorldModel(new UuidGenerator(access->getWorldModel()->getRootNodeId()));
+	SnapshotReader reader;
+	reader.open(snapshot.empty() ? 0 : &snapshot[0], snapshot.size());
+	reader.apply(wm, true);
+	LOG(DEBUG) << "WorldModelVersions: Rebuilt a version with " << snapshot.size() << " bytes.";
+
+	lock.lock();
+	delete version.wm;
+	version.wm = wm;
+	version.appliedSequence = snapshotSequence;
+}
+
+brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr WorldModelVersions::copyTransform(brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform) {
+	brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr copy(new brics_3d::HomogeneousMatrix44());
+	if (transform) {
+		memcpy(copy->setRawData(), transform->getRawData(), 16 * sizeof(double));
+	}
+	return copy;
+}
+
+/* All updates are applied with forced Ids, so the versions have the same Ids as the primary World Model. */
+
+bool WorldModelVersions::addNode(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addNode, _1, parentId, assignedId, attributes, true));
+}
+
+bool WorldModelVersions::addGroup(Id parentId, Id& assignedId, vector<Attribute> attributes, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addGroup, _1, parentId, assignedId, attributes, true));
+}
+
+bool WorldModelVersions::addTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addTransformNode, _1, parentId, assignedId, attributes, copyTransform(transform), timeStamp, true));
+}
+
+bool WorldModelVersions::addUncertainTransformNode(Id parentId, Id& assignedId, vector<Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addUncertainTransformNode, _1, parentId, assignedId, attributes, copyTransform(transform), uncertainty, timeStamp, true));
+}
+
+bool WorldModelVersions::addGeometricNode(Id parentId, Id& assignedId, vector<Attribute> attributes, Shape::ShapePtr shape, TimeStamp timeStamp, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addGeometricNode, _1, parentId, assignedId, attributes, shape, timeStamp, true));
+}
+
+bool WorldModelVersions::addRemoteRootNode(Id rootId, vector<Attribute> attributes) {
+	return record(boost::bind(&ISceneGraphUpdate::addRemoteRootNode, _1, rootId, attributes));
+}
+
+bool WorldModelVersions::addConnection(Id parentId, Id& assignedId, vector<Attribute> attributes, vector<Id> sourceIds, vector<Id> targetIds, TimeStamp start, TimeStamp end, bool forcedId) {
+	return record(boost::bind(&ISceneGraphUpdate::addConnection, _1, parentId, assignedId, attributes, sourceIds, targetIds, start, end, true));
+}
+
+bool WorldModelVersions::setNodeAttributes(Id id, vector<Attribute> newAttributes, TimeStamp timeStamp) {
+	return record(boost::bind(&ISceneGraphUpdate::setNodeAttributes, _1, id, newAttributes, timeStamp));
+}
+
+bool WorldModelVersions::setTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, TimeStamp timeStamp) {
+	return record(boost::bind(&ISceneGraphUpdate::setTransform, _1, id, copyTransform(transform), timeStamp));
+}
+
+bool WorldModelVersions::setUncertainTransform(Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, TimeStamp timeStamp) {
+	return record(boost::bind(&ISceneGraphUpdate::setUncertainTransform, _1, id, copyTransform(transform), uncertainty, timeStamp));
+}
+
+bool WorldModelVersions::deleteNode(Id id) {
+	return record(boost::bind(&ISceneGraphUpdate::deleteNode, _1, id));
+}
+
+bool WorldModelVersions::addParent(Id id, Id parentId) {
+	return record(boost::bind(&ISceneGraphUpdate::addParent, _1, id, parentId));
+}
+
+bool WorldModelVersions::removeParent(Id id, Id parentId) {
+	return record(boost::bind(&ISceneGraphUpdate::removeParent, _1, id, parentId));
+}
+
+} // namespace rsg_bridge
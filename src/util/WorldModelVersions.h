@@ -0,0 +1,109 @@
+/*
+ * Immutable versions of a World Model for queries that must not block updates.
+ */
+
+#ifndef RSG_BRIDGE_WORLDMODELVERSIONS_H_
+#define RSG_BRIDGE_WORLDMODELVERSIONS_H_
+
+#include "WorldModelAccess.h"
+
+#include <brics_3d/worldModel/WorldModel.h>
+#include <brics_3d/worldModel/sceneGraph/ISceneGraphUpdateObserver.h>
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace rsg_bridge {
+
+/**
+ * @brief Multi-version copies of a World Model for snapshot reads.
+ *
+ * The versions are private World Models with the same root Id as the primary one.
+ * Every update of the primary World Model is recorded in a log with increasing
+ * sequence numbers. Recording is the only work done on the update path.
+ *
+ * A query pins a version with pin(). A pinned version is never modified, so the
+ * query sees a consistent state while updates continue on the primary World Model.
+ * A version that is not pinned by any query is brought up to date by replaying the
+ * log when it is pinned the next time. The oldest free version is advanced first, so
+ * every version moves forward and log entries are reclaimed as soon as all versions
+ * have passed them. If the log exceeds its maximum size (e.g. no queries arrive for a
+ * long time), it is discarded and the lagging versions are rebuilt from a fresh copy of
+ * the primary World Model when they are pinned the next time.
+ *
+ * If all versions are pinned, a query shares the most recent one.
+ */
+class WorldModelVersions : public brics_3d::rsg::ISceneGraphUpdateObserver {
+public:
+	/**
+	 * @brief Create the versions as copies of the primary World Model.
+	 * @param access Access to the primary World Model. The write lock is taken while it is copied.
+	 * @param versionCount Number of versions (at least 1).
+	 * @param maxLogSize Maximum number of recorded updates before the versions have to be rebuilt.
+	 */
+	WorldModelVersions(WorldModelAccess* access, unsigned int versionCount = 2, unsigned int maxLogSize = 100000);
+	virtual ~WorldModelVersions();
+
+	unsigned int getVersionCount() const { return static_cast<unsigned int>(versions.size()); }
+	brics_3d::WorldModel* getVersion(unsigned int index) { return versions[index].wm; }
+
+	/// Pin a version that reflects all updates so far (or the most recent one if all are pinned). Returns its index.
+	unsigned int pin();
+
+	/// Release a version pinned by pin().
+	void unpin(unsigned int index);
+
+	/// Number of recorded updates that are not yet reclaimed.
+	unsigned int getLogSize();
+
+	/* implementations of observer interface */
+	bool addNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addGroup(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, bool forcedId = false);
+	bool addTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addUncertainTransformNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addGeometricNode(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, brics_3d::rsg::Shape::ShapePtr shape, brics_3d::rsg::TimeStamp timeStamp, bool forcedId = false);
+	bool addRemoteRootNode(brics_3d::rsg::Id rootId, vector<brics_3d::rsg::Attribute> attributes);
+	bool addConnection(brics_3d::rsg::Id parentId, brics_3d::rsg::Id& assignedId, vector<brics_3d::rsg::Attribute> attributes, vector<brics_3d::rsg::Id> sourceIds, vector<brics_3d::rsg::Id> targetIds, brics_3d::rsg::TimeStamp start, brics_3d::rsg::TimeStamp end, bool forcedId = false);
+	bool setNodeAttributes(brics_3d::rsg::Id id, vector<brics_3d::rsg::Attribute> newAttributes, brics_3d::rsg::TimeStamp timeStamp = brics_3d::rsg::TimeStamp(0));
+	bool setTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::rsg::TimeStamp timeStamp);
+	bool setUncertainTransform(brics_3d::rsg::Id id, brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform, brics_3d::ITransformUncertainty::ITransformUncertaintyPtr uncertainty, brics_3d::rsg::TimeStamp timeStamp);
+	bool deleteNode(brics_3d::rsg::Id id);
+	bool addParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+	bool removeParent(brics_3d::rsg::Id id, brics_3d::rsg::Id parentId);
+
+private:
+	typedef boost::function<bool (brics_3d::rsg::ISceneGraphUpdate*)> Update;
+	typedef boost::shared_ptr<Update> UpdatePtr;
+
+	struct Version {
+		brics_3d::WorldModel* wm;
+		uint64_t appliedSequence; // all updates before this sequence number are applied
+		unsigned int pinCount;
+		bool isUpdating;
+		bool isStale; // the log entries after appliedSequence are discarded, so it has to be rebuilt
+	};
+
+	bool record(const Update& update);
+	void reclaimLog();
+	void rebuild(Version& version, boost::unique_lock<boost::mutex>& lock);
+	static brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr copyTransform(brics_3d::IHomogeneousMatrix44::IHomogeneousMatrix44Ptr transform);
+
+	WorldModelAccess* access;
+	std::vector<Version> versions;
+	std::deque<UpdatePtr> log;
+	uint64_t logStartSequence; // sequence number of the first entry in log
+	uint64_t nextSequence;
+	unsigned int maxLogSize;
+	boost::mutex mutex;
+	boost::condition_variable versionUpdated;
+};
+
+} // namespace rsg_bridge
+
+#endif /* RSG_BRIDGE_WORLDMODELVERSIONS_H_ */
@@ -0,0 +1,133 @@
+/*
+ * Standalone test of the shared memory rings in src/util/ShmRing.h.
+ * It needs no segment, as the rings work the same in process memory.
+ */
+
+#include "ShmRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		failures++; \
+	} \
+} while (0)
+
+static rsg_shm_ring_t* create_ring(uint32_t position) {
+	rsg_shm_ring_t* ring = (rsg_shm_ring_t*) calloc(1, sizeof(rsg_shm_ring_t));
+	ring->head = position; /* an empty ring at an arbitrary, 4 byte aligned position */
+	ring->tail = position;
+	return ring;
+}
+
+static void fill(char* data, uint32_t length, char seed) {
+	uint32_t i;
+	for (i = 0; i < length; ++i) {
+		data[i] = (char)(seed + i % 251);
+	}
+}
+
+static void test_round_trip(void) {
+	rsg_shm_ring_t* ring = create_ring(0);
+	char buffer[64];
+	uint32_t length = 0;
+	CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == EAGAIN);
+	CHECK(rsg_shm_ring_try_write(ring, "hello", 5) == 0);
+	CHECK(rsg_shm_ring_try_write(ring, "", 0) == 0);
+	CHECK(ring->head == rsg_shm_frame_size(5) + rsg_shm_frame_size(0));
+	CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == 0);
+	CHECK((length == 5) && (memcmp(buffer, "hello", 5) == 0));
+	CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == 0);
+	CHECK(length == 0);
+	CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == EAGAIN);
+	free(ring);
+}
+
+static void test_wrap_around(void) {
+	uint32_t positions[] = {RSG_SHM_RING_SIZE - 8, RSG_SHM_RING_SIZE - 4, 0xFFFFFFF8u}; /* data, length and index overflow wrap */
+	unsigned int i;
+	for (i = 0; i < sizeof(positions) / sizeof(positions[0]); ++i) {
+		rsg_shm_ring_t* ring = create_ring(positions[i]);
+		char message[1000];
+		char buffer[1000];
+		uint32_t length = 0;
+		int round;
+		for (round = 0; round < 3; ++round) {
+			fill(message, sizeof(message), (char)(i + round));
+			CHECK(rsg_shm_ring_try_write(ring, message, sizeof(message)) == 0);
+			CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == 0);
+			CHECK((length == sizeof(message)) && (memcmp(buffer, message, sizeof(message)) == 0));
+		}
+		CHECK(ring->head == ring->tail);
+		free(ring);
+	}
+}
+
+static void test_full_ring(void) {
+	rsg_shm_ring_t* ring = create_ring(RSG_SHM_RING_SIZE / 2);
+	uint32_t size = 4096 - sizeof(uint32_t); /* frames of 4096 bytes fill the ring exactly */
+	char* message = (char*) malloc(size);
+	char* buffer = (char*) malloc(size);
+	uint32_t length = 0;
+	unsigned int count = 0;
+	fill(message, size, 7);
+	while (rsg_shm_ring_try_write(ring, message, size) == 0) {
+		count++;
+	}
+	CHECK(count == RSG_SHM_RING_SIZE / 4096);
+	CHECK(rsg_shm_ring_try_write(ring, "x", 1) == EAGAIN);
+
+	/* One frame taken makes room for exactly one more */
+	CHECK(rsg_shm_ring_try_read(ring, buffer, size, &length) == 0);
+	CHECK(rsg_shm_ring_try_write(ring, message, size) == 0);
+	CHECK(rsg_shm_ring_try_write(ring, "x", 1) == EAGAIN);
+	while (rsg_shm_ring_try_read(ring, buffer, size, &length) == 0) {
+		CHECK((length == size) && (memcmp(buffer, message, size) == 0));
+		count--;
+	}
+	CHECK(count == 0);
+	free(buffer);
+	free(message);
+	free(ring);
+}
+
+static void test_message_size(void) {
+	rsg_shm_ring_t* ring = create_ring(0);
+	char* message = (char*) calloc(1, RSG_SHM_RING_SIZE);
+	char buffer[16];
+	uint32_t length = 0;
+	CHECK(rsg_shm_ring_try_write(ring, message, RSG_SHM_RING_SIZE) == EMSGSIZE);
+	CHECK(rsg_shm_ring_try_write(ring, message, RSG_SHM_MAX_MESSAGE_SIZE + 1) == EMSGSIZE);
+	CHECK(ring->head == 0);
+
+	/* The largest message fits into an empty ring */
+	CHECK(rsg_shm_ring_try_write(ring, message, RSG_SHM_MAX_MESSAGE_SIZE) == 0);
+	CHECK(rsg_shm_ring_try_read(ring, message, RSG_SHM_RING_SIZE, &length) == 0);
+	CHECK(length == RSG_SHM_MAX_MESSAGE_SIZE);
+
+	/* A reader with a small buffer gets the size and can retry */
+	CHECK(rsg_shm_ring_try_write(ring, "0123456789abcdefXYZ", 19) == 0);
+	CHECK(rsg_shm_ring_try_read(ring, buffer, sizeof(buffer), &length) == EMSGSIZE);
+	CHECK(length == 19);
+	CHECK(rsg_shm_ring_try_read(ring, message, RSG_SHM_RING_SIZE, &length) == 0);
+	CHECK((length == 19) && (memcmp(message, "0123456789abcdefXYZ", 19) == 0));
+	free(message);
+	free(ring);
+}
+
+int main(void) {
+	test_round_trip();
+	test_wrap_around();
+	test_full_ring();
+	test_message_size();
+	if (failures > 0) {
+		fprintf(stderr, "shm_ring_test: %d checks failed.\n", failures);
+		return 1;
+	}
+	printf("shm_ring_test: all checks passed.\n");
+	return 0;
+}